@@ -0,0 +1,272 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+#include "clibatch.h"
+
+#ifndef __MINGW32__
+#include <pthread.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/common.h"
+#include "core/constants.h"
+#include "core/search.h"
+#include "clisearch.h"
+
+#define DEEN_BATCH_LINE_SIZE_DEFAULT 128
+
+/*
+The workers take turns to read a line from the input and each line is given
+a sequence number.  Once a worker has searched, it waits until the records
+for all of the earlier lines have been written before writing its own record.
+*/
+
+typedef struct deen_batch deen_batch;
+struct deen_batch {
+	FILE *in;
+	deen_term *term;
+	deen_search_pool *pool;
+	uint32_t result_count;
+	uint64_t next_read_sequence;
+	uint64_t next_write_sequence;
+#ifndef __MINGW32__
+	pthread_mutex_t lock;
+	pthread_cond_t written_cond;
+#endif
+};
+
+
+typedef struct deen_batch_worker deen_batch_worker;
+struct deen_batch_worker {
+	deen_batch *batch;
+	char *line;
+	size_t line_size;
+#ifndef __MINGW32__
+	pthread_t thread;
+#endif
+};
+
+
+/*
+Reads the next line from the input into the worker's buffer; enlarging the
+buffer as necessary.  The line ending is removed.  Returns false once there
+are no more lines.
+*/
+
+static deen_bool deen_batch_read_line(deen_batch_worker *worker, FILE *in) {
+	size_t len = 0;
+
+	while (NULL != fgets(&worker->line[len], (int) (worker->line_size - len), in)) {
+		len += strlen(&worker->line[len]);
+
+		if (len > 0 && '\n' == worker->line[len - 1]) {
+			break;
+		}
+
+		if (len == worker->line_size - 1) {
+			worker->line_size *= 2;
+			worker->line = (char *) deen_erealloc(worker->line, worker->line_size);
+		}
+	}
+
+	if (0 == len) {
+		return DEEN_FALSE;
+	}
+
+	while (len > 0 && ('\n' == worker->line[len - 1] || '\r' == worker->line[len - 1])) {
+		len--;
+	}
+
+	worker->line[len] = 0;
+
+	return DEEN_TRUE;
+}
+
+
+/*
+Searches for the line that the worker has read and writes the record to the
+stream.  An empty line yields an empty record so that each line of the
+input has a record in the output.  A search that fails yields a record with
+a single line starting "ERR" so that the following records still line up with
+the input; the error is not logged because the log would be mixed in with the
+records.
+*/
+
+static void deen_batch_search(deen_batch_worker *worker, FILE *out) {
+	deen_term term = *(worker->batch->term);
+
+	term.out = out;
+
+	if (0 != worker->line[0]) {
+		deen_search_context *context = deen_search_pool_acquire(worker->batch->pool);
+
+		if (NULL == context) {
+			fputs("ERR no search context\n", out);
+		}
+		else {
+			if (!deen_cli_search_render_plain(
+				context,
+				&term,
+				(uint8_t *) worker->line,
+				worker->batch->result_count)) {
+				fputs("ERR search failed\n", out);
+			}
+
+			deen_search_pool_release(worker->batch->pool, context);
+		}
+	}
+
+	fputs(DEEN_BATCH_RECORD_SEPARATOR, out);
+}
+
+
+/*
+When there is only a single worker, the records are already in order and so
+they can be written straight to the terminal.
+*/
+
+static void deen_batch_work_serial(deen_batch_worker *worker) {
+	while (deen_batch_read_line(worker, worker->batch->in)) {
+		deen_batch_search(worker, worker->batch->term->out);
+		fflush(worker->batch->term->out);
+	}
+}
+
+
+#ifndef __MINGW32__
+
+static void *deen_batch_work_parallel(void *context) {
+	deen_batch_worker *worker = (deen_batch_worker *) context;
+	deen_batch *batch = worker->batch;
+
+	while (DEEN_TRUE) {
+		uint64_t sequence;
+		char *record = NULL;
+		size_t record_len = 0;
+		FILE *out;
+
+		pthread_mutex_lock(&batch->lock);
+
+		if (!deen_batch_read_line(worker, batch->in)) {
+			pthread_mutex_unlock(&batch->lock);
+			return NULL;
+		}
+
+		sequence = batch->next_read_sequence++;
+		pthread_mutex_unlock(&batch->lock);
+
+		// the record is rendered into memory so that it can be written out
+		// when its turn comes.
+
+		if (NULL == (out = open_memstream(&record, &record_len))) {
+			deen_log_error_and_exit("unable to create a stream for a batch record");
+		}
+
+		deen_batch_search(worker, out);
+		fclose(out);
+
+		pthread_mutex_lock(&batch->lock);
+
+		while (sequence != batch->next_write_sequence) {
+			pthread_cond_wait(&batch->written_cond, &batch->lock);
+		}
+
+		fwrite(record, sizeof(char), record_len, batch->term->out);
+		fflush(batch->term->out);
+		batch->next_write_sequence++;
+		pthread_cond_broadcast(&batch->written_cond);
+
+		pthread_mutex_unlock(&batch->lock);
+
+		// the record is from open_memstream and so is not accounted.
+
+		(free)((void *) record);
+	}
+}
+
+#endif
+
+
+deen_bool deen_cli_batch_run(
+	const char *root_dir,
+	FILE *in,
+	deen_term *term,
+	uint32_t result_count,
+	uint32_t worker_count) {
+
+	deen_batch batch;
+	deen_batch_worker *workers;
+	deen_search_context *context;
+	uint32_t i;
+
+	// the searches are not able to run concurrently on windows.
+
+#ifdef __MINGW32__
+	worker_count = 1;
+#endif
+
+	// each worker acquires a search context from the pool for each search.
+
+	batch.in = in;
+	batch.term = term;
+	batch.pool = deen_search_pool_create(root_dir, worker_count);
+	batch.result_count = result_count;
+	batch.next_read_sequence = 0;
+	batch.next_write_sequence = 0;
+
+	// check that searching is possible at all before starting.
+
+	if (NULL == (context = deen_search_pool_acquire(batch.pool))) {
+		DEEN_LOG_ERROR0("unable to create a search context for the batch");
+		deen_search_pool_free(batch.pool);
+		return DEEN_FALSE;
+	}
+
+	deen_search_pool_release(batch.pool, context);
+
+	workers = (deen_batch_worker *) deen_emalloc(sizeof(deen_batch_worker) * worker_count);
+
+	for (i = 0; i < worker_count; i++) {
+		workers[i].batch = &batch;
+		workers[i].line_size = DEEN_BATCH_LINE_SIZE_DEFAULT;
+		workers[i].line = (char *) deen_emalloc(sizeof(char) * workers[i].line_size);
+	}
+
+	if (1 == worker_count) {
+		deen_batch_work_serial(&workers[0]);
+	}
+#ifndef __MINGW32__
+	else {
+		pthread_mutex_init(&batch.lock, NULL);
+		pthread_cond_init(&batch.written_cond, NULL);
+
+		for (i = 0; i < worker_count; i++) {
+			if (0 != pthread_create(&workers[i].thread, NULL, deen_batch_work_parallel, &workers[i])) {
+				deen_log_error_and_exit("unable to start a batch worker");
+			}
+		}
+
+		for (i = 0; i < worker_count; i++) {
+			pthread_join(workers[i].thread, NULL);
+		}
+
+		pthread_cond_destroy(&batch.written_cond);
+		pthread_mutex_destroy(&batch.lock);
+	}
+#endif
+
+	for (i = 0; i < worker_count; i++) {
+		free((void *) workers[i].line);
+	}
+
+	free((void *) workers);
+	deen_search_pool_free(batch.pool);
+
+	return DEEN_TRUE;
+}
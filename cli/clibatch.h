@@ -0,0 +1,32 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+#ifndef CLIBATCH_H
+#define CLIBATCH_H
+
+#include <stdio.h>
+
+#include "core/types.h"
+#include "rendercommon.h"
+
+/*
+Reads search expressions from the input stream; one per line.  Each is
+searched for and the output is written to the terminal followed by a record
+separator.  The records are written in the same order as the lines were read
+even when a number of workers are searching concurrently.  Returns false if
+the batch was not able to be started.
+*/
+
+deen_bool deen_cli_batch_run(
+	const char *root_dir,
+	FILE *in,
+	deen_term *term,
+	uint32_t result_count,
+	uint32_t worker_count);
+
+#endif /* CLIBATCH_H */
@@ -0,0 +1,731 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+#include "clidaemon.h"
+
+#include <stdlib.h>
+#include <string.h>
+#ifndef __MINGW32__
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "core/common.h"
+#include "core/keyword.h"
+#include "core/search.h"
+#include "clisearch.h"
+#include "renderplain.h"
+
+#ifndef __MINGW32__
+
+/*
+The daemon will only serve this many clients at once; further clients wait
+in the listen backlog until a client has been served.
+*/
+
+#define DEEN_DAEMON_CLIENTS_MAX 64
+#define DEEN_DAEMON_LISTEN_BACKLOG 16
+
+/*
+A request that is longer than this is rejected.
+*/
+
+#define DEEN_DAEMON_REQUEST_LEN_MAX 4096
+
+#define DEEN_DAEMON_READ_BUFFER_SIZE 4096
+
+/*
+Latencies are counted into buckets where each bucket covers latencies up to
+twice those of the previous bucket.  The last bucket covers anything longer.
+*/
+
+#define DEEN_DAEMON_LATENCY_BUCKETS 32
+
+
+typedef struct deen_daemon_client deen_daemon_client;
+struct deen_daemon_client {
+	int fd;
+	char *request;
+	size_t request_len;
+	char *response;
+	size_t response_len;
+	size_t response_sent;
+};
+
+
+typedef struct deen_daemon_stats deen_daemon_stats;
+struct deen_daemon_stats {
+	uint64_t query_count;
+	deen_micros total_micros;
+	deen_micros min_micros;
+	deen_micros max_micros;
+	uint64_t buckets[DEEN_DAEMON_LATENCY_BUCKETS];
+};
+
+
+typedef struct deen_daemon deen_daemon;
+struct deen_daemon {
+	deen_search_context *context;
+	int listen_fd;
+	deen_daemon_client clients[DEEN_DAEMON_CLIENTS_MAX];
+	size_t client_count;
+	deen_daemon_stats stats;
+};
+
+
+static volatile sig_atomic_t deen_daemon_stop_requested = 0;
+
+
+static void deen_daemon_stop_handler(int signal_number) {
+	deen_daemon_stop_requested = 1;
+}
+
+
+// ---------------------------------------------------------------
+// STATISTICS
+// ---------------------------------------------------------------
+
+
+static void deen_daemon_stats_add(deen_daemon_stats *stats, deen_micros micros) {
+	uint32_t bucket = 0;
+
+	while (bucket < DEEN_DAEMON_LATENCY_BUCKETS - 1 && (1ULL << bucket) <= micros) {
+		bucket++;
+	}
+
+	if (0 == stats->query_count || micros < stats->min_micros) {
+		stats->min_micros = micros;
+	}
+
+	if (micros > stats->max_micros) {
+		stats->max_micros = micros;
+	}
+
+	stats->query_count++;
+	stats->total_micros += micros;
+	stats->buckets[bucket]++;
+}
+
+
+/*
+Returns the upper bound of the bucket in which the percentile falls.  This is
+only an approximation of the percentile, but it is within a factor of two.
+*/
+
+static deen_micros deen_daemon_stats_percentile(deen_daemon_stats *stats, uint32_t percentile) {
+	uint64_t threshold = ((stats->query_count * percentile) + 99) / 100;
+	uint64_t accumulated = 0;
+	uint32_t bucket;
+
+	for (bucket = 0; bucket < DEEN_DAEMON_LATENCY_BUCKETS - 1; bucket++) {
+		accumulated += stats->buckets[bucket];
+
+		if (accumulated >= threshold) {
+			break;
+		}
+	}
+
+	if (0 == bucket) {
+		return 0;
+	}
+
+	return (deen_micros) ((1ULL << bucket) - 1);
+}
+
+
+static void deen_daemon_stats_write(deen_daemon_stats *stats, FILE *out) {
+	fprintf(out, "queries; %llu\n", (unsigned long long) stats->query_count);
+
+	if (0 != stats->query_count) {
+		fprintf(out, "mean latency; %llu us\n", stats->total_micros / stats->query_count);
+		fprintf(out, "min latency; %llu us\n", stats->min_micros);
+		fprintf(out, "max latency; %llu us\n", stats->max_micros);
+		fprintf(out, "p50 latency; <= %llu us\n", deen_daemon_stats_percentile(stats, 50));
+		fprintf(out, "p90 latency; <= %llu us\n", deen_daemon_stats_percentile(stats, 90));
+		fprintf(out, "p99 latency; <= %llu us\n", deen_daemon_stats_percentile(stats, 99));
+	}
+}
+
+
+// ---------------------------------------------------------------
+// SOCKET
+// ---------------------------------------------------------------
+
+
+static deen_bool deen_daemon_socket_address(const char *root_dir, struct sockaddr_un *address) {
+	char *socket_path = deen_socket_path(root_dir);
+	deen_bool result = DEEN_TRUE;
+
+	memset(address, 0, sizeof(struct sockaddr_un));
+	address->sun_family = AF_UNIX;
+
+	if (strlen(socket_path) >= sizeof(address->sun_path)) {
+		DEEN_LOG_ERROR1("the path to the daemon's socket is too long; %s", socket_path);
+		result = DEEN_FALSE;
+	}
+	else {
+		strcpy(address->sun_path, socket_path);
+	}
+
+	free((void *) socket_path);
+
+	return result;
+}
+
+
+/*
+Connects to the daemon's socket.  If there is no daemon running then -1 is
+returned.
+*/
+
+static int deen_daemon_connect(const char *root_dir) {
+	struct sockaddr_un address;
+	int fd;
+
+	if (!deen_daemon_socket_address(root_dir, &address)) {
+		return -1;
+	}
+
+	if (-1 == (fd = socket(AF_UNIX, SOCK_STREAM, 0))) {
+		DEEN_LOG_ERROR0("unable to create a socket to connect to the daemon");
+		return -1;
+	}
+
+	if (-1 == connect(fd, (struct sockaddr *) &address, sizeof(struct sockaddr_un))) {
+#ifdef DEBUG
+		DEEN_LOG_INFO1("no daemon is running at; %s", address.sun_path);
+#endif
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+
+static deen_bool deen_daemon_set_nonblocking(int fd) {
+	int flags = fcntl(fd, F_GETFL, 0);
+	return -1 != flags && -1 != fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+
+/*
+Creates the socket on which the daemon listens for clients.  If a socket file
+is left over from a daemon that is no longer running then it is replaced.
+Returns -1 if the socket was not able to be created.
+*/
+
+static int deen_daemon_listen(const char *root_dir) {
+	struct sockaddr_un address;
+	int fd;
+
+	if (!deen_daemon_socket_address(root_dir, &address)) {
+		return -1;
+	}
+
+	if (-1 != (fd = deen_daemon_connect(root_dir))) {
+		DEEN_LOG_ERROR1("a daemon is already running at; %s", address.sun_path);
+		close(fd);
+		return -1;
+	}
+
+	unlink(address.sun_path);
+
+	if (-1 == (fd = socket(AF_UNIX, SOCK_STREAM, 0))) {
+		DEEN_LOG_ERROR0("unable to create the daemon's socket");
+		return -1;
+	}
+
+	if (-1 == bind(fd, (struct sockaddr *) &address, sizeof(struct sockaddr_un))
+		|| -1 == chmod(address.sun_path, S_IRUSR | S_IWUSR)
+		|| -1 == listen(fd, DEEN_DAEMON_LISTEN_BACKLOG)
+		|| !deen_daemon_set_nonblocking(fd)) {
+		DEEN_LOG_ERROR2("unable to listen on the daemon's socket; %s (%s)", address.sun_path, strerror(errno));
+		close(fd);
+		unlink(address.sun_path);
+		return -1;
+	}
+
+	return fd;
+}
+
+
+static deen_bool deen_daemon_write_fully(int fd, const char *data, size_t len) {
+	while (len > 0) {
+		ssize_t written = write(fd, data, len);
+
+		if (-1 == written) {
+			if (EINTR != errno) {
+				return DEEN_FALSE;
+			}
+		}
+		else {
+			data += written;
+			len -= (size_t) written;
+		}
+	}
+
+	return DEEN_TRUE;
+}
+
+
+// ---------------------------------------------------------------
+// SERVING
+// ---------------------------------------------------------------
+
+
+static void deen_daemon_client_close(deen_daemon *daemon, size_t i) {
+	deen_daemon_client *client = &daemon->clients[i];
+
+	close(client->fd);
+	free((void *) client->request);
+
+	// the response is from open_memstream and so is not accounted.
+
+	(free)((void *) client->response);
+
+	daemon->client_count--;
+	daemon->clients[i] = daemon->clients[daemon->client_count];
+}
+
+
+static void deen_daemon_accept(deen_daemon *daemon) {
+	while (daemon->client_count < DEEN_DAEMON_CLIENTS_MAX) {
+		deen_daemon_client *client;
+		int fd = accept(daemon->listen_fd, NULL, NULL);
+
+		if (-1 == fd) {
+			if (EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno) {
+				DEEN_LOG_ERROR1("unable to accept a client; %s", strerror(errno));
+			}
+
+			return;
+		}
+
+		if (!deen_daemon_set_nonblocking(fd)) {
+			DEEN_LOG_ERROR0("unable to configure a client's socket");
+			close(fd);
+		}
+		else {
+			client = &daemon->clients[daemon->client_count++];
+			client->fd = fd;
+			client->request = NULL;
+			client->request_len = 0;
+			client->response = NULL;
+			client->response_len = 0;
+			client->response_sent = 0;
+		}
+	}
+}
+
+
+/*
+Carries out the request and writes the response to the stream.  The request
+has had its newline removed.
+*/
+
+static void deen_daemon_respond(deen_daemon *daemon, char *request, FILE *out) {
+	unsigned int result_count;
+	unsigned int is_tty;
+	unsigned int is_utf8;
+	int expression_offset = -1;
+
+	if (0 == strcmp(request, "S")) {
+		fputs("OK\n", out);
+		deen_daemon_stats_write(&daemon->stats, out);
+		fprintf(out, "lookup cache hits; %llu\n", (unsigned long long) daemon->context->lookup_cache_hits);
+		fprintf(out, "lookup cache misses; %llu\n", (unsigned long long) daemon->context->lookup_cache_misses);
+		deen_alloc_accounting_write(out);
+		return;
+	}
+
+	if ('Q' == request[0]
+		&& 3 == sscanf(request, "Q %u %u %u %n", &result_count, &is_tty, &is_utf8, &expression_offset)
+		&& -1 != expression_offset
+		&& 0 != result_count
+		&& 0 != request[expression_offset]) {
+
+		deen_term term;
+		deen_keywords *keywords;
+		deen_search_result *result;
+		deen_micros start_micros = deen_micros_since_epoc();
+		deen_micros micros;
+
+		term.out = out;
+		term.is_tty = 0 != is_tty;
+		term.is_utf8 = 0 != is_utf8;
+
+		result = deen_cli_search(
+			daemon->context,
+			(uint8_t *) &request[expression_offset],
+			(uint32_t) result_count,
+			&keywords,
+			NULL);
+
+		if (NULL == result) {
+			fputs("ERR search failed\n", out);
+			return;
+		}
+
+		fputs("OK\n", out);
+		deen_render_plain(&term, result, keywords);
+
+		micros = deen_micros_since_epoc() - start_micros;
+		deen_daemon_stats_add(&daemon->stats, micros);
+
+		DEEN_LOG_INFO3("searched [%s] finding %u in %llu us",
+			&request[expression_offset], result->total_count, micros);
+
+		deen_search_result_free(result);
+		deen_keywords_free(keywords);
+		return;
+	}
+
+	DEEN_LOG_ERROR1("bad request [%s]", request);
+	fputs("ERR bad request\n", out);
+}
+
+
+/*
+Reads what is available from the client.  Once the whole request has been
+read, the response is prepared.  Returns false if the client should be
+closed.
+*/
+
+static deen_bool deen_daemon_client_read(deen_daemon *daemon, deen_daemon_client *client) {
+	char buffer[DEEN_DAEMON_READ_BUFFER_SIZE];
+	char *newline_c;
+	ssize_t actuallyread = read(client->fd, buffer, sizeof(buffer));
+	FILE *out;
+
+	switch (actuallyread) {
+		case 0:
+			return DEEN_FALSE;
+
+		case -1:
+			return EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno;
+
+		default:
+			break;
+	}
+
+	client->request = (char *) deen_erealloc(client->request, client->request_len + (size_t) actuallyread + 1);
+	memcpy(&client->request[client->request_len], buffer, (size_t) actuallyread);
+	client->request_len += (size_t) actuallyread;
+	client->request[client->request_len] = 0;
+
+	newline_c = strchr(client->request, '\n');
+
+	if (NULL == newline_c) {
+		if (client->request_len > DEEN_DAEMON_REQUEST_LEN_MAX) {
+			DEEN_LOG_ERROR0("request is too long");
+			return DEEN_FALSE;
+		}
+
+		return DEEN_TRUE;
+	}
+
+	*newline_c = 0;
+
+	if (NULL == (out = open_memstream(&client->response, &client->response_len))) {
+		DEEN_LOG_ERROR0("unable to create a stream for the response");
+		return DEEN_FALSE;
+	}
+
+	deen_daemon_respond(daemon, client->request, out);
+	fclose(out);
+
+	return DEEN_TRUE;
+}
+
+
+/*
+Writes what it can of the response to the client.  Returns false if the
+client should be closed; either because the response has been written or
+because there was a problem.
+*/
+
+static deen_bool deen_daemon_client_write(deen_daemon_client *client) {
+	ssize_t written = write(
+		client->fd,
+		&client->response[client->response_sent],
+		client->response_len - client->response_sent);
+
+	if (-1 == written) {
+		return EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno;
+	}
+
+	client->response_sent += (size_t) written;
+
+	return client->response_sent < client->response_len;
+}
+
+
+static void deen_daemon_serve(deen_daemon *daemon) {
+	struct pollfd fds[DEEN_DAEMON_CLIENTS_MAX + 1];
+
+	while (!deen_daemon_stop_requested) {
+		size_t i;
+
+		// the listening socket is only polled if there is room for another
+		// client.  Each client is polled for reading until the response has
+		// been prepared and then for writing.
+
+		fds[0].fd = daemon->listen_fd;
+		fds[0].events = (daemon->client_count < DEEN_DAEMON_CLIENTS_MAX) ? POLLIN : 0;
+		fds[0].revents = 0;
+
+		for (i = 0; i < daemon->client_count; i++) {
+			fds[i + 1].fd = daemon->clients[i].fd;
+			fds[i + 1].events = (NULL == daemon->clients[i].response) ? POLLIN : POLLOUT;
+			fds[i + 1].revents = 0;
+		}
+
+		if (-1 == poll(fds, (nfds_t) (daemon->client_count + 1), -1)) {
+			if (EINTR != errno) {
+				DEEN_LOG_ERROR1("unable to poll the daemon's sockets; %s", strerror(errno));
+				return;
+			}
+
+			continue;
+		}
+
+		// clients are closed by moving the last one into its place so it is
+		// necessary to work backwards.
+
+		for (i = daemon->client_count; i > 0; i--) {
+			deen_daemon_client *client = &daemon->clients[i - 1];
+			short revents = fds[i].revents;
+			deen_bool keep = DEEN_TRUE;
+
+			if (0 != (revents & (POLLERR | POLLNVAL))) {
+				keep = DEEN_FALSE;
+			}
+			else {
+				if (NULL == client->response) {
+					if (0 != (revents & (POLLIN | POLLHUP))) {
+						keep = deen_daemon_client_read(daemon, client);
+					}
+				}
+				else {
+					if (0 != (revents & (POLLOUT | POLLHUP))) {
+						keep = deen_daemon_client_write(client);
+					}
+				}
+			}
+
+			if (!keep) {
+				deen_daemon_client_close(daemon, i - 1);
+			}
+		}
+
+		if (0 != (fds[0].revents & POLLIN)) {
+			deen_daemon_accept(daemon);
+		}
+	}
+}
+
+
+deen_bool deen_cli_daemon_run(const char *root_dir) {
+	deen_daemon daemon;
+	struct sigaction stop_action;
+	char *socket_path;
+
+	memset(&daemon, 0, sizeof(deen_daemon));
+
+	if (NULL == (daemon.context = deen_search_init((char *) root_dir))) {
+		DEEN_LOG_ERROR0("unable to create a search context for the daemon");
+		return DEEN_FALSE;
+	}
+
+	if (-1 == (daemon.listen_fd = deen_daemon_listen(root_dir))) {
+		deen_search_free(daemon.context);
+		return DEEN_FALSE;
+	}
+
+	// the handler does not restart the poll so that the loop is able to
+	// notice that it should stop.  A client that goes away before its
+	// response is written should not stop the daemon.
+
+	memset(&stop_action, 0, sizeof(struct sigaction));
+	stop_action.sa_handler = deen_daemon_stop_handler;
+	sigemptyset(&stop_action.sa_mask);
+	sigaction(SIGINT, &stop_action, NULL);
+	sigaction(SIGTERM, &stop_action, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	socket_path = deen_socket_path(root_dir);
+	DEEN_LOG_INFO1("daemon is listening at; %s", socket_path);
+
+	deen_daemon_serve(&daemon);
+
+	while (daemon.client_count > 0) {
+		deen_daemon_client_close(&daemon, daemon.client_count - 1);
+	}
+
+	close(daemon.listen_fd);
+	unlink(socket_path);
+	free((void *) socket_path);
+
+	deen_search_free(daemon.context);
+
+	DEEN_LOG_INFO0("daemon has stopped");
+	deen_daemon_stats_write(&daemon.stats, stdout);
+	deen_alloc_accounting_log("daemon");
+
+	return DEEN_TRUE;
+}
+
+
+// ---------------------------------------------------------------
+// CLIENT
+// ---------------------------------------------------------------
+
+
+/*
+Sends the request to the daemon and then copies the output of the response
+to the stream.  Returns false if the daemon is not running or was not able to
+respond.
+*/
+
+static deen_bool deen_daemon_request(const char *root_dir, const char *request, FILE *out) {
+	char buffer[DEEN_DAEMON_READ_BUFFER_SIZE];
+	char status[DEEN_DAEMON_READ_BUFFER_SIZE];
+	size_t status_len = 0;
+	deen_bool is_status_read = DEEN_FALSE;
+	deen_bool is_ok = DEEN_FALSE;
+	deen_bool is_done = DEEN_FALSE;
+	int fd = deen_daemon_connect(root_dir);
+
+	if (-1 == fd) {
+		return DEEN_FALSE;
+	}
+
+	if (!deen_daemon_write_fully(fd, request, strlen(request))) {
+		DEEN_LOG_ERROR0("unable to send the request to the daemon");
+		close(fd);
+		return DEEN_FALSE;
+	}
+
+	while (!is_done) {
+		ssize_t actuallyread = read(fd, buffer, sizeof(buffer));
+		size_t offset = 0;
+
+		switch (actuallyread) {
+			case 0:
+				is_done = DEEN_TRUE;
+				break;
+
+			case -1:
+				if (EINTR != errno) {
+					DEEN_LOG_ERROR0("unable to read the response from the daemon");
+					is_done = DEEN_TRUE;
+				}
+				break;
+
+			default:
+
+				// the status line comes first and then the output.
+
+				while (!is_status_read && offset < (size_t) actuallyread) {
+					char c = buffer[offset++];
+
+					if ('\n' == c) {
+						status[status_len] = 0;
+						is_status_read = DEEN_TRUE;
+						is_ok = 0 == strcmp(status, "OK");
+
+						if (!is_ok) {
+							DEEN_LOG_ERROR1("the daemon was not able to respond; %s", status);
+							is_done = DEEN_TRUE;
+						}
+					}
+					else {
+						if (status_len < sizeof(status) - 1) {
+							status[status_len++] = c;
+						}
+					}
+				}
+
+				if (is_ok) {
+					fwrite(&buffer[offset], sizeof(char), (size_t) actuallyread - offset, out);
+				}
+				break;
+		}
+	}
+
+	close(fd);
+
+	return is_ok;
+}
+
+
+deen_bool deen_cli_daemon_query(
+	const char *root_dir,
+	deen_term *term,
+	const uint8_t *search_expression,
+	uint32_t result_count) {
+
+	size_t request_len = strlen((char *) search_expression) + 64;
+	char *request;
+	deen_bool result;
+
+	// the request is a single line so it is not possible to send an
+	// expression that has a newline in it.
+
+	if (NULL != strchr((char *) search_expression, '\n')) {
+		return DEEN_FALSE;
+	}
+
+	request = (char *) deen_emalloc(request_len);
+	snprintf(request, request_len, "Q %u %u %u %s\n",
+		result_count,
+		term->is_tty ? 1 : 0,
+		term->is_utf8 ? 1 : 0,
+		(char *) search_expression);
+
+	result = deen_daemon_request(root_dir, request, term->out);
+
+	free((void *) request);
+
+	return result;
+}
+
+
+deen_bool deen_cli_daemon_stats(const char *root_dir, FILE *out) {
+	return deen_daemon_request(root_dir, "S\n", out);
+}
+
+#else
+
+deen_bool deen_cli_daemon_run(const char *root_dir) {
+	DEEN_LOG_ERROR0("the daemon is not supported on this platform");
+	return DEEN_FALSE;
+}
+
+
+deen_bool deen_cli_daemon_query(
+	const char *root_dir,
+	deen_term *term,
+	const uint8_t *search_expression,
+	uint32_t result_count) {
+	return DEEN_FALSE;
+}
+
+
+deen_bool deen_cli_daemon_stats(const char *root_dir, FILE *out) {
+	return DEEN_FALSE;
+}
+
+#endif
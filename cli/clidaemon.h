@@ -0,0 +1,60 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+#ifndef CLIDAEMON_H
+#define CLIDAEMON_H
+
+#include <stdio.h>
+
+#include "core/types.h"
+#include "rendercommon.h"
+
+/*
+The daemon keeps a search context open and serves searches to clients over a
+unix domain socket in the root directory.  This avoids each search having to
+open the index and the data afresh.
+
+A client sends a single line request and the daemon replies with a status
+line followed by the output and then closes the connection.  The requests
+are;
+
+  Q <result-count> <is-tty> <is-utf8> <search-expression>
+  S
+
+The first is a search and the second asks for the statistics on latency and on
+the lookup cache.  The status line is either "OK" or "ERR <message>".
+*/
+
+/*
+Runs the daemon.  This function only returns once the daemon is stopped by
+an interrupt or termination signal.  It returns false if the daemon was not
+able to be started.
+*/
+
+deen_bool deen_cli_daemon_run(const char *root_dir);
+
+/*
+If a daemon is running then this will have the daemon perform the search and
+will write the output to the terminal.  It returns false if no daemon was
+able to perform the search in which case the caller should search itself.
+*/
+
+deen_bool deen_cli_daemon_query(
+	const char *root_dir,
+	deen_term *term,
+	const uint8_t *search_expression,
+	uint32_t result_count);
+
+/*
+Asks the daemon for its latency statistics and writes them to the stream.
+It returns false if no daemon is running.
+*/
+
+deen_bool deen_cli_daemon_stats(const char *root_dir, FILE *out);
+
+#endif /* CLIDAEMON_H */
@@ -16,16 +16,23 @@
 #include "core/constants.h"
 #include "core/common.h"
 #include "core/install.h"
-#include "core/keyword.h"
 #include "core/search.h"
-#include "renderplain.h"
+#include "clibatch.h"
+#include "clidaemon.h"
+#include "clisearch.h"
+#include "rendercommon.h"
 
 typedef struct deen_cli_args deen_cli_args;
 struct deen_cli_args {
 	deen_bool version;
 	deen_bool index;
+	deen_bool daemon;
+	deen_bool daemon_stats;
+	deen_bool batch;
+	deen_bool explain;
 	deen_bool trace_enabled;
 	uint32_t result_count;
+	uint32_t worker_count;
 	uint8_t *search_expression;
 	char *ding_filename;
 };
@@ -33,8 +40,13 @@ struct deen_cli_args {
 static void deen_cli_init_args(deen_cli_args *args) {
 	args->version = DEEN_FALSE;
 	args->index = DEEN_FALSE;
+	args->daemon = DEEN_FALSE;
+	args->daemon_stats = DEEN_FALSE;
+	args->batch = DEEN_FALSE;
+	args->explain = DEEN_FALSE;
 	args->trace_enabled = DEEN_FALSE;
 	args->result_count = DEEN_RESULT_SIZE_DEFAULT;
+	args->worker_count = 0;
 	args->search_expression = NULL;
 	args->ding_filename = NULL;
 }
@@ -45,7 +57,10 @@ static void deen_cli_syntax(char *binary_name) {
 	printf("%s [-h]\n", binary_name_basename);
 	printf("%s [-v]\n", binary_name_basename);
 	printf("%s [-t] [-i] <ding-file>\n", binary_name_basename);
-	printf("%s [-t] [-c <result-count>] <search-term>\n", binary_name_basename);
+	printf("%s [-t] [-d]\n", binary_name_basename);
+	printf("%s [-s]\n", binary_name_basename);
+	printf("%s [-t] [-x] [-c <result-count>] <search-term>\n", binary_name_basename);
+	printf("%s [-t] [-c <result-count>] [-j <worker-count>] -b < <search-terms-file>\n", binary_name_basename);
 	exit(1);
 }
 
@@ -80,10 +95,40 @@ static void deen_cli_capture_args(deen_cli_args *args, int argc, char** argv) {
 					args->version = DEEN_TRUE;
 					break;
 
+				case 'd':
+					args->daemon = DEEN_TRUE;
+					break;
+
+				case 's':
+					args->daemon_stats = DEEN_TRUE;
+					break;
+
 				case 't':
 					args->trace_enabled = DEEN_TRUE;
 					break;
 
+				case 'b':
+					args->batch = DEEN_TRUE;
+					break;
+
+				case 'x':
+					args->explain = DEEN_TRUE;
+					break;
+
+				case 'j':
+					if (i == argc - 1) {
+						deen_log_error_and_exit("expected a worker count to be specified");
+					}
+
+					args->worker_count = (uint32_t) atoi(argv[i + 1]);
+
+					if (0 == args->worker_count || args->worker_count > DEEN_BATCH_WORKERS_MAX) {
+						deen_log_error_and_exit("bad worker count value [%s]", argv[i + 1]);
+					}
+
+					i++;
+					break;
+
 				case 'c':
 					if (i == argc - 1) {
 						deen_log_error_and_exit("expected a count to be specified");
@@ -119,6 +164,20 @@ static void deen_cli_validate_args(deen_cli_args *args) {
 		if (NULL != args->search_expression) {
 			deen_log_error_and_exit("when indexing, search arguments are not allowed");
 		}
+
+		if (args->daemon || args->daemon_stats) {
+			deen_log_error_and_exit("when indexing, the daemon is not able to be used");
+		}
+	}
+	else if (args->daemon || args->daemon_stats) {
+		if (NULL != args->search_expression) {
+			deen_log_error_and_exit("with the daemon, search arguments are not allowed");
+		}
+	}
+	else if (args->batch) {
+		if (NULL != args->search_expression) {
+			deen_log_error_and_exit("in batch mode, the search terms are read from the input");
+		}
 	}
 	else {
 		if (
@@ -127,6 +186,14 @@ static void deen_cli_validate_args(deen_cli_args *args) {
 			deen_log_error_and_exit("a search expression was expected");
 		}
 	}
+
+	if (args->explain && (args->index || args->daemon || args->daemon_stats || args->batch)) {
+		deen_log_error_and_exit("only a single search is able to be explained");
+	}
+
+	if (0 != args->worker_count && !args->batch) {
+		deen_log_error_and_exit("a worker count is only able to be used in batch mode");
+	}
 }
 
 
@@ -183,56 +250,81 @@ static void deen_cli_check_and_index(const char *filename) {
 	}
 }
 
+/*
+If a daemon is running then the search is passed to it.  Otherwise, or if
+tracing is enabled so that the trace output is visible, or if the search is
+to be explained, the search is done here.
+*/
+
 static void deen_cli_query(deen_cli_args *args) {
-	deen_search_result *result;
 	deen_search_context *context;
+	deen_term term;
 	char *root_dir = deen_root_dir();
-	deen_keywords *keywords = deen_keywords_create();
-	size_t search_expression_len = strlen((char *) args->search_expression);
-	uint8_t *search_expression_upper = (uint8_t *) deen_emalloc(
-		sizeof(uint8_t) * (search_expression_len + 1));
-
-	search_expression_upper[search_expression_len] = 0;
-	memcpy(
-		search_expression_upper,
-		args->search_expression,
-		search_expression_len);
 
-	deen_to_upper(search_expression_upper);
+	deen_term_init(&term, stdout);
 
-	DEEN_LOG_TRACE2("keywords; [%s] --> [%s]", args->search_expression, search_expression_upper);
-	deen_keywords_add_from_string(keywords, search_expression_upper);
+	if (args->trace_enabled || args->explain || !deen_cli_daemon_query(
+		root_dir, &term, args->search_expression, args->result_count)) {
 
-	// dump out the keywords for now
-	deen_trace_log_keywords(keywords);
+		context = deen_search_init(root_dir);
 
-	// run the search
+		if(NULL==context) {
+			deen_log_error_and_exit("unable to create a search context");
+		}
 
-	context = deen_search_init(root_dir);
+		if (args->explain) {
+			if (!deen_cli_search_render_explain(context, &term, args->search_expression, args->result_count)) {
+				deen_log_error_and_exit("unable to perform the search");
+			}
+		}
+		else {
+			if (!deen_cli_search_render_plain(context, &term, args->search_expression, args->result_count)) {
+				deen_log_error_and_exit("unable to perform the search");
+			}
+		}
 
-	if(NULL==context) {
-		deen_log_error_and_exit("unable to create a search context");
+		deen_search_free(context);
+		deen_alloc_accounting_log("query");
 	}
 
-	result = deen_search(context, keywords, args->result_count);
+	free((void *) root_dir);
+}
 
-	if (0 == result->total_count) {
-		if (deen_keywords_adjust(keywords)) {
-			DEEN_LOG_INFO0("no results found -> did adjust keywords");
-			deen_trace_log_keywords(keywords);
-			deen_search_result_free(result);
-			result = deen_search(context, keywords, args->result_count);
-		}
+
+static void deen_cli_batch(deen_cli_args *args) {
+	deen_term term;
+	char *root_dir = deen_root_dir();
+
+	deen_term_init(&term, stdout);
+
+	if (!deen_cli_batch_run(
+		root_dir, stdin, &term,
+		args->result_count,
+		(0 == args->worker_count) ? 1 : args->worker_count)) {
+		deen_log_error_and_exit("unable to run the batch");
 	}
 
-    deen_render_plain(result, keywords);
+	deen_alloc_accounting_log("batch");
+
+	free((void *) root_dir);
+}
+
+
+static void deen_cli_daemon(deen_cli_args *args) {
+	char *root_dir = deen_root_dir();
 
-    deen_search_result_free(result);
-    deen_search_free(context);
-    deen_keywords_free(keywords);
+	if (args->daemon) {
+		if (!deen_cli_daemon_run(root_dir)) {
+			deen_log_error_and_exit("unable to run the daemon");
+		}
+	}
+	else {
+		if (!deen_cli_daemon_stats(root_dir, stdout)) {
+			deen_log_error_and_exit("no daemon is running");
+		}
+	}
 
-    free((void *) root_dir);
-	free((void *) search_expression_upper);
+	free((void *) root_dir);
 }
 
 
@@ -261,6 +353,10 @@ int main(int argc, char** argv) {
 
 	if (args.index) {
 		deen_cli_check_and_index(args.ding_filename);
+	} else if (args.daemon || args.daemon_stats) {
+		deen_cli_daemon(&args);
+	} else if (args.batch) {
+		deen_cli_batch(&args);
 	} else {
 		if (NULL != args.search_expression) {
 			deen_cli_query(&args);
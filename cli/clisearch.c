@@ -0,0 +1,109 @@
+/*
+ * Copyright 2016-2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+#include "clisearch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/keyword.h"
+#include "core/search.h"
+#include "renderplain.h"
+
+
+deen_search_result *deen_cli_search(
+	deen_search_context *context,
+	const uint8_t *search_expression,
+	uint32_t result_count,
+	deen_keywords **keywords,
+	deen_search_explain *explain) {
+
+	deen_search_result *result;
+	size_t search_expression_len = strlen((char *) search_expression);
+	uint8_t *search_expression_upper = (uint8_t *) deen_emalloc(
+		sizeof(uint8_t) * (search_expression_len + 1));
+
+	*keywords = deen_keywords_create();
+
+	search_expression_upper[search_expression_len] = 0;
+	memcpy(
+		search_expression_upper,
+		search_expression,
+		search_expression_len);
+
+	deen_to_upper(search_expression_upper);
+
+	DEEN_LOG_TRACE2("keywords; [%s] --> [%s]", search_expression, search_expression_upper);
+	deen_keywords_add_from_string(*keywords, search_expression_upper);
+
+	// dump out the keywords for now
+	deen_trace_log_keywords(*keywords);
+
+	// run the search
+
+	result = deen_search_explained(context, *keywords, result_count, explain);
+
+	free((void *) search_expression_upper);
+
+	if (NULL == result) {
+		deen_keywords_free(*keywords);
+		*keywords = NULL;
+	}
+
+	return result;
+}
+
+
+deen_bool deen_cli_search_render_plain(
+	deen_search_context *context,
+	deen_term *term,
+	const uint8_t *search_expression,
+	uint32_t result_count) {
+
+	deen_keywords *keywords;
+	deen_search_result *result = deen_cli_search(
+		context, search_expression, result_count, &keywords, NULL);
+
+	if (NULL == result) {
+		return DEEN_FALSE;
+	}
+
+	deen_render_plain(term, result, keywords);
+
+	deen_search_result_free(result);
+	deen_keywords_free(keywords);
+
+	return DEEN_TRUE;
+}
+
+
+deen_bool deen_cli_search_render_explain(
+	deen_search_context *context,
+	deen_term *term,
+	const uint8_t *search_expression,
+	uint32_t result_count) {
+
+	deen_keywords *keywords;
+	deen_search_explain *explain = deen_search_explain_create();
+	deen_search_result *result = deen_cli_search(
+		context, search_expression, result_count, &keywords, explain);
+
+	if (NULL == result) {
+		deen_search_explain_free(explain);
+		return DEEN_FALSE;
+	}
+
+	deen_render_plain(term, result, keywords);
+	deen_render_explain(term, explain, keywords);
+
+	deen_search_result_free(result);
+	deen_search_explain_free(explain);
+	deen_keywords_free(keywords);
+
+	return DEEN_TRUE;
+}
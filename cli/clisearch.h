@@ -0,0 +1,52 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+#ifndef CLISEARCH_H
+#define CLISEARCH_H
+
+#include "core/common.h"
+#include "rendercommon.h"
+
+/*
+Searches for the expression.  The keywords are supplied back so that they can
+be highlighted when the result is rendered; the caller must free both the
+result and the keywords.  If the search failed then NULL is returned and there
+are no keywords to free.  If an explain is supplied then what the search did
+is written into it.
+*/
+
+deen_search_result *deen_cli_search(
+	deen_search_context *context,
+	const uint8_t *search_expression,
+	uint32_t result_count,
+	deen_keywords **keywords,
+	deen_search_explain *explain);
+
+/*
+Searches for the expression and renders the result as plain text to the
+terminal.  Returns false if the search failed.
+*/
+
+deen_bool deen_cli_search_render_plain(
+	deen_search_context *context,
+	deen_term *term,
+	const uint8_t *search_expression,
+	uint32_t result_count);
+
+/*
+As for 'deen_cli_search_render_plain', but the result is followed by an
+explanation of what the search did and how long each phase of it took.
+*/
+
+deen_bool deen_cli_search_render_explain(
+	deen_search_context *context,
+	deen_term *term,
+	const uint8_t *search_expression,
+	uint32_t result_count);
+
+#endif /* CLISEARCH_H */
@@ -1,5 +1,5 @@
 /*
- * Copyright 2016-2017, Andrew Lindesay. All Rights Reserved.
+ * Copyright 2016-2019, Andrew Lindesay. All Rights Reserved.
  * Distributed under the terms of the MIT License.
  *
  * Authors:
@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "core/common.h"
 #include "core/constants.h"
@@ -41,49 +42,55 @@ deen_bool deen_term_is_utf8() {
 }
 
 
-void deen_term_print_str(uint8_t *str) {
-	deen_term_print_str_range(str, 0, strlen((char *) str));
+void deen_term_init(deen_term *term, FILE *out) {
+	term->out = out;
+	term->is_utf8 = deen_term_is_utf8();
+#ifdef __MINGW32__
+	term->is_tty = DEEN_TRUE; // this is forced by console setup.
+#else
+	term->is_tty = isatty(fileno(out));
+#endif
 }
 
 
-static void deen_term_print_ascii_str(uint8_t *str, size_t from, size_t to) {
-	size_t i;
+void deen_term_print_str(deen_term *term, uint8_t *str) {
+	deen_term_print_str_range(term, str, 0, strlen((char *) str));
+}
 
-	for (i = from; i<to; i++) {
-		fputc((int) str[i], stdout);
-	}
+
+static void deen_term_print_ascii_str(deen_term *term, uint8_t *str, size_t from, size_t to) {
+	fwrite(&str[from], sizeof(uint8_t), to - from, term->out);
 }
 
 
-void deen_term_print_str_range(uint8_t *str, size_t from, size_t to) {
-	if (deen_term_is_utf8()) {
-		deen_term_print_ascii_str(str, from, to);
+void deen_term_print_str_range(deen_term *term, uint8_t *str, size_t from, size_t to) {
+	if (term->is_utf8) {
+		deen_term_print_ascii_str(term, str, from, to);
 	}
 	else {
 		if (deen_utf8_is_usascii_clean(&str[from], to-from)) {
-			deen_term_print_ascii_str(str, from, to);
+			deen_term_print_ascii_str(term, str, from, to);
 		}
 		else {
 			size_t i;
-			size_t len = to-from;
 
 			for (i=from;i<to;) {
 				size_t sequence_length;
 
-				switch (deen_utf8_sequence_len(&str[i], len - i, &sequence_length)) {
+				switch (deen_utf8_sequence_len(&str[i], to - i, &sequence_length)) {
 
 					case DEEN_SEQUENCE_OK:
 						if (1 == sequence_length) {
-							putchar((int) str[i]);
+							fputc((int) str[i], term->out);
 						}
 						else {
-							uint8_t *equivalent = deen_utf8_usascii_equivalent(&str[i], len - i);
+							uint8_t *equivalent = deen_utf8_usascii_equivalent(&str[i], to - i);
 
 							if (NULL!=equivalent) {
-								fputs((char *) equivalent, stdout);
+								fputs((char *) equivalent, term->out);
 							}
 							else {
-								putchar((int) '?');
+								fputc((int) '?', term->out);
 							}
 						}
 
@@ -1,5 +1,5 @@
 /*
- * Copyright 2016, Andrew Lindesay. All Rights Reserved.
+ * Copyright 2016-2019, Andrew Lindesay. All Rights Reserved.
  * Distributed under the terms of the MIT License.
  *
  * Authors:
@@ -9,21 +9,43 @@
 #ifndef RENDERCOMMON_H
 #define RENDERCOMMON_H
 
+#include <stdio.h>
+
 #include "core/types.h"
 
+/*
+This describes where the rendered output should go and what the terminal that
+will eventually display the output is able to show.  The terminal may not be
+the one that the output is written to; for example the daemon renders into
+a buffer for a client that has its own terminal.
+*/
+
+typedef struct deen_term deen_term;
+struct deen_term {
+	FILE *out;
+	deen_bool is_tty;
+	deen_bool is_utf8;
+};
+
 /*
 Figures out if the current environment is UTF8 or not.
 */
 
 deen_bool deen_term_is_utf8();
 
+/*
+Sets up the terminal to write to the stream from the current environment.
+*/
+
+void deen_term_init(deen_term *term, FILE *out);
+
 /*
 Takes into account the encoding of the terminal and will adjust accordingly.
 For example, if it is not UTF-8 then it will not print UTF-8 chars at all.
 */
 
-void deen_term_print_str(uint8_t *str);
+void deen_term_print_str(deen_term *term, uint8_t *str);
 
-void deen_term_print_str_range(uint8_t *str, size_t from, size_t to);
+void deen_term_print_str_range(deen_term *term, uint8_t *str, size_t from, size_t to);
 
 #endif /* RENDERCOMMON_H */
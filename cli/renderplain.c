@@ -1,5 +1,5 @@
 /*
- * Copyright 2016-2017, Andrew Lindesay. All Rights Reserved.
+ * Copyright 2016-2019, Andrew Lindesay. All Rights Reserved.
  * Distributed under the terms of the MIT License.
  *
  * Authors:
@@ -47,18 +47,18 @@ static uint8_t UTF8_RULE[4] = { 0xe2, 0x94, 0x80, 0x00 };
 
 
 static void deen_render_tty_or_nontty(
-	deen_bool is_tty,
+	deen_term *term,
 	const char *tty_version,
 	const char *non_tty_version) {
 
-	if (DEEN_TRUE == is_tty) {
+	if (DEEN_TRUE == term->is_tty) {
 		if (NULL != tty_version) {
-			fputs(tty_version, stdout);
+			fputs(tty_version, term->out);
 		}
 	}
 	else {
 		if (NULL != non_tty_version) {
-			fputs(non_tty_version, stdout);
+			fputs(non_tty_version, term->out);
 		}
 	}
 }
@@ -70,48 +70,50 @@ keywords as bold and print the rest.
 
 static void deen_render_plain_text_highlights(
 	uint8_t *text,
+	size_t from,
+	size_t to,
 	deen_keywords *keywords,
-	deen_bool tty) {
+	deen_term *term) {
 
-	if (deen_term_is_utf8() && tty) {
+	if (term->is_utf8 && term->is_tty) {
 
-		size_t len = strlen((char *) text);
-		size_t upto = 0;
+		size_t upto = from;
 
-		while (upto < len) {
+		while (upto < to) {
 
 			deen_first_keyword first_keyword = deen_ifind_first_keyword(
-				text, keywords, upto, len);
+				text, keywords, upto, to);
 
 			if (DEEN_NOT_FOUND == first_keyword.offset) {
-				deen_term_print_str(&text[upto]);
-				upto = len;
+				deen_term_print_str_range(term, text, upto, to);
+				upto = to;
 			}
 			else {
 				deen_bool is_valid_keyword_found;
 				size_t keyword_len = strlen((char *) first_keyword.keyword);
-				deen_term_print_str_range(text, upto, first_keyword.offset);
+				deen_term_print_str_range(term, text, upto, first_keyword.offset);
 
 				// need to make sure that highlighting is only happening at
 				// the prefix of a word and is not finding text 'randomly'
 				// within the line.
 
 				is_valid_keyword_found =
-					0 == first_keyword.offset ||
+					from == first_keyword.offset ||
 					isspace(text[first_keyword.offset-1]) ||
 					ispunct(text[first_keyword.offset-1]);
 
 				if(is_valid_keyword_found) {
-					fputs(TTYRED, stdout);
+					fputs(TTYRED, term->out);
 				}
 
 				deen_term_print_str_range(
+					term,
 					text,
 					first_keyword.offset,
 					first_keyword.offset + keyword_len);
 
 				if(is_valid_keyword_found) {
-					fputs(TTYSEQRESET, stdout);
+					fputs(TTYSEQRESET, term->out);
 				}
 
 				upto = first_keyword.offset + keyword_len;
@@ -119,27 +121,38 @@ static void deen_render_plain_text_highlights(
 		}
 	}
 	else {
-		deen_term_print_str(text);
+		deen_term_print_str_range(term, text, from, to);
 	}
 }
 
 
-static void deen_render_plain_entry_atom(deen_entry_atom *atom, deen_keywords *keywords, deen_bool tty) {
+/*
+The text of the atom is a slice of the arena's text.
+*/
+
+static void deen_render_plain_entry_atom(
+	uint8_t *text,
+	deen_entry_atom *atom,
+	deen_keywords *keywords,
+	deen_term *term) {
+
+		size_t to = atom->offset + atom->len;
+
 		switch (atom->type) {
 			case ATOM_TEXT:
-				deen_render_plain_text_highlights(atom->text, keywords, tty);
+				deen_render_plain_text_highlights(text, atom->offset, to, keywords, term);
 				break;
 
 			case ATOM_CONTEXT:
-				deen_render_tty_or_nontty(tty, TTYBLUE, "[");
-				deen_term_print_str(atom->text);
-				deen_render_tty_or_nontty(tty, TTYSEQRESET, "]");
+				deen_render_tty_or_nontty(term, TTYBLUE, "[");
+				deen_term_print_str_range(term, text, atom->offset, to);
+				deen_render_tty_or_nontty(term, TTYSEQRESET, "]");
 				break;
 
 			case ATOM_GRAMMAR:
-				deen_render_tty_or_nontty(tty, TTYORANGE, "{");
-				deen_term_print_str(atom->text);
-				deen_render_tty_or_nontty(tty, TTYSEQRESET, "}");
+				deen_render_tty_or_nontty(term, TTYORANGE, "{");
+				deen_term_print_str_range(term, text, atom->offset, to);
+				deen_render_tty_or_nontty(term, TTYSEQRESET, "}");
 				break;
 
 			default:
@@ -150,46 +163,55 @@ static void deen_render_plain_entry_atom(deen_entry_atom *atom, deen_keywords *k
 
 
 void deen_render_plain_entry_sub_sub(
+	deen_entry_arena *arena,
 	deen_entry_sub_sub *sub_sub,
 	deen_keywords *keywords,
-	deen_bool tty) {
+	deen_term *term) {
 
 	if (NULL!=sub_sub) {
 		uint32_t i;
 
 		for (i=0;i<sub_sub->atom_count;i++) {
 			if (0!=i) {
-				fputs(" ", stdout);
+				fputs(" ", term->out);
 			}
 
-			deen_render_plain_entry_atom(&(sub_sub->atoms[i]), keywords, tty);
+			deen_render_plain_entry_atom(
+				arena->text,
+				&(arena->atoms[sub_sub->atoms_offset + i]),
+				keywords, term);
 		}
 	}
 }
 
 
 void deen_render_plain_entry_sub(
+	deen_entry_arena *arena,
 	deen_entry_sub *sub,
 	deen_keywords *keywords,
-	deen_bool tty) {
+	deen_term *term) {
 
 	if (NULL!=sub) {
 		uint32_t i;
 
 		for (i=0;i<sub->sub_sub_count;i++) {
 			if (0!=i) {
-				fputs("; ", stdout);
+				fputs("; ", term->out);
 			}
 
-			deen_render_plain_entry_sub_sub(&(sub->sub_subs[i]), keywords, tty);
+			deen_render_plain_entry_sub_sub(
+				arena,
+				&(arena->sub_subs[sub->sub_subs_offset + i]),
+				keywords, term);
 		}
 	}
 }
 
 void deen_render_plain_entry(
+	deen_entry_arena *arena,
 	deen_entry *entry,
 	deen_keywords *keywords,
-	deen_bool tty) {
+	deen_term *term) {
 
 	uint32_t i;
 	uint32_t max_count = entry->german_sub_count;
@@ -200,73 +222,78 @@ void deen_render_plain_entry(
 
 	for (i=0;i<max_count;i++) {
 		if (1==max_count) {
-			fputs("    ", stdout);
+			fputs("    ", term->out);
 		}
 		else {
-			deen_render_tty_or_nontty(tty, TTYFADED, NULL);
-			printf("%2d) ", i+1);
-			deen_render_tty_or_nontty(tty, TTYSEQRESET, NULL);
+			deen_render_tty_or_nontty(term, TTYFADED, NULL);
+			fprintf(term->out, "%2d) ", i+1);
+			deen_render_tty_or_nontty(term, TTYSEQRESET, NULL);
 		}
 
 		if (i < entry->german_sub_count) {
-			deen_render_plain_entry_sub(&(entry->german_subs[i]), keywords, tty);
+			deen_render_plain_entry_sub(
+				arena,
+				&(arena->subs[entry->subs_offset + i]),
+				keywords, term);
 		}
 		else {
-			fputs("???", stdout);
+			fputs("???", term->out);
 		}
 
-		if (deen_term_is_utf8() && tty) {
-			fputs(TTYMAGENTA, stdout);
-			fputs(" ", stdout);
-			fputs((char *) UTF8_RULE, stdout);
-			fputs((char *) UTF8_RULE, stdout);
-			fputs(" ", stdout);
-			fputs(TTYSEQRESET,stdout);
+		if (term->is_utf8 && term->is_tty) {
+			fputs(TTYMAGENTA, term->out);
+			fputs(" ", term->out);
+			fputs((char *) UTF8_RULE, term->out);
+			fputs((char *) UTF8_RULE, term->out);
+			fputs(" ", term->out);
+			fputs(TTYSEQRESET,term->out);
 		}
 		else {
-			fputs(" :: ", stdout);
+			fputs(" :: ", term->out);
 		}
 
 		if (i < entry->english_sub_count) {
-			deen_render_plain_entry_sub(&(entry->english_subs[i]), keywords, tty);
+			deen_render_plain_entry_sub(
+				arena,
+				&(arena->subs[entry->subs_offset + entry->german_sub_count + i]),
+				keywords, term);
 		}
 		else {
-			fputs("???", stdout);
+			fputs("???", term->out);
 		}
 
-		fputs("\n", stdout);
+		fputs("\n", term->out);
 	}
 }
 
 
-void deen_render_rule(deen_bool tty) {
-	if (deen_term_is_utf8() && tty) {
+void deen_render_rule(deen_term *term) {
+	if (term->is_utf8 && term->is_tty) {
 
 		int i;
-		deen_render_tty_or_nontty(tty, TTYFADED, NULL);
+		deen_render_tty_or_nontty(term, TTYFADED, NULL);
 
 		for (i=0;i<32;i++) {
-			fputs((char *) UTF8_RULE, stdout);
+			fputs((char *) UTF8_RULE, term->out);
 		}
 
-		deen_render_tty_or_nontty(tty, TTYSEQRESET, NULL);
+		deen_render_tty_or_nontty(term, TTYSEQRESET, NULL);
 	}
 	else {
-		fputs("- - - - - - - - - - - - - -", stdout);
+		fputs("- - - - - - - - - - - - - -", term->out);
 	}
 
-	fputs("\n", stdout);
+	fputs("\n", term->out);
 }
 
 
-void deen_render_plain(deen_search_result *result, deen_keywords *keywords) {
+void deen_render_plain(deen_term *term, deen_search_result *result, deen_keywords *keywords) {
     if (NULL!=result) {
 		if (0 == result->entry_count) {
-			puts("not found\n");
+			fputs("not found\n\n", term->out);
 		}
 		else {
 			uint32_t i;
-			deen_bool tty;
 #ifdef __MINGW32__
 			HANDLE win_h_stdout = GetStdHandle(STD_OUTPUT_HANDLE);
 			DWORD win_old_console_mode;
@@ -283,21 +310,18 @@ void deen_render_plain(deen_search_result *result, deen_keywords *keywords) {
 
 			win_console_output_cp = GetConsoleOutputCP();
 			SetConsoleOutputCP(WIN_CODE_PAGE_UTF8);
-			tty = DEEN_TRUE;
-#else
-			tty = isatty(fileno(stdout));
 #endif
 
-			deen_render_tty_or_nontty(tty, TTYFADED, NULL);
-			printf("showing %d of %d - best match last\n", result->entry_count, result->total_count);
-			deen_render_tty_or_nontty(tty, TTYSEQRESET, NULL);
+			deen_render_tty_or_nontty(term, TTYFADED, NULL);
+			fprintf(term->out, "showing %d of %d - best match last\n", result->entry_count, result->total_count);
+			deen_render_tty_or_nontty(term, TTYSEQRESET, NULL);
 
 			i = result->entry_count;
 
 			do {
 				i--;
-				deen_render_rule(tty);
-				deen_render_plain_entry(&result->entries[i], keywords, tty);
+				deen_render_rule(term);
+				deen_render_plain_entry(&(result->arena), &result->entries[i], keywords, term);
 			}
 			while(i > 0);
 
@@ -311,3 +335,53 @@ void deen_render_plain(deen_search_result *result, deen_keywords *keywords) {
 		}
 	}
 }
+
+
+static const char *deen_render_explain_phase_name(enum deen_search_phase phase) {
+	switch (phase) {
+		case DEEN_SEARCH_PHASE_LOOKUP: return "lookup";
+		case DEEN_SEARCH_PHASE_FETCH: return "fetch";
+		case DEEN_SEARCH_PHASE_PARSE: return "parse";
+		case DEEN_SEARCH_PHASE_SCORE: return "score";
+		case DEEN_SEARCH_PHASE_SORT: return "sort";
+		default: return "???";
+	}
+}
+
+
+void deen_render_explain(deen_term *term, const deen_search_explain *explain, deen_keywords *keywords) {
+	uint32_t i;
+	deen_micros total_micros = 0;
+
+	deen_render_rule(term);
+	deen_render_tty_or_nontty(term, TTYFADED, NULL);
+
+	fprintf(term->out, "index; %s\n", explain->is_mapindex ? "binary" : "sqlite");
+
+	for (i = 0; i < explain->keyword_count && i < keywords->count; i++) {
+		const deen_search_explain_keyword *explain_keyword = &(explain->keywords[i]);
+
+		fprintf(term->out, "keyword [%s]; %s [%s]; %lu refs\n",
+			keywords->keywords[i],
+			explain_keyword->is_term_range ? "terms starting" : "prefix",
+			explain_keyword->lookup,
+			(unsigned long) explain_keyword->refs_count);
+	}
+
+	fprintf(term->out, "intersection; %lu refs\n", (unsigned long) explain->intersection_count);
+	fprintf(term->out, "lines read; %llu\n", (unsigned long long) explain->lines_read);
+	fprintf(term->out, "bytes read; %llu\n", (unsigned long long) explain->bytes_read);
+	fprintf(term->out, "lines rejected; %llu\n", (unsigned long long) explain->lines_rejected);
+	fprintf(term->out, "entries parsed; %llu\n", (unsigned long long) explain->entries_parsed);
+
+	for (i = 0; i < DEEN_SEARCH_PHASE_COUNT; i++) {
+		fprintf(term->out, "%s; %llu us\n",
+			deen_render_explain_phase_name((enum deen_search_phase) i),
+			explain->phase_micros[i]);
+		total_micros += explain->phase_micros[i];
+	}
+
+	fprintf(term->out, "total; %llu us\n", total_micros);
+
+	deen_render_tty_or_nontty(term, TTYSEQRESET, NULL);
+}
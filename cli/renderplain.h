@@ -1,5 +1,5 @@
 /*
- * Copyright 2016, Andrew Lindesay. All Rights Reserved.
+ * Copyright 2016-2019, Andrew Lindesay. All Rights Reserved.
  * Distributed under the terms of the MIT License.
  *
  * Authors:
@@ -10,7 +10,15 @@
 #define RENDERPLAIN_H
 
 #include "core/common.h"
+#include "rendercommon.h"
 
-void deen_render_plain(deen_search_result *result, deen_keywords *keywords);
+void deen_render_plain(deen_term *term, deen_search_result *result, deen_keywords *keywords);
+
+/*
+Renders the explanation of a search as one line for each of the keywords and
+then one line for each of the counts and timings.
+*/
+
+void deen_render_explain(deen_term *term, const deen_search_explain *explain, deen_keywords *keywords);
 
 #endif /* RENDERPLAIN_H */
@@ -0,0 +1,607 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+/*
+This program times the string and UTF-8 functions from the common code that
+are run for each word as the data is installed and for each candidate line as
+a search is performed.  Each function is run over a corpus of lines and of the
+words in those lines; either a built-in sample of Ding entries or the start of
+a Ding file.  Each function is timed over a number of rounds and the best and
+the median round are reported.  On x86 the time is measured in cycles of the
+time-stamp counter and otherwise in nanoseconds.  Each function is timed for
+each of the SIMD levels that the processor supports.  The results are written
+as JSON.
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "core/common.h"
+#include "core/constants.h"
+#include "core/types.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DEEN_BENCH_TSC
+#include <x86intrin.h>
+#endif
+
+#define DEEN_BENCH_ROUNDS_DEFAULT 20
+#define DEEN_BENCH_ROUNDS_MAX 1000
+
+// the built-in sample is repeated until the corpus has at least this many
+// bytes; this is also the most that is read from a file.
+
+#define DEEN_BENCH_CORPUS_MIN_BYTES (256 * 1024)
+#define DEEN_BENCH_CORPUS_FILE_MAX_BYTES (8 * 1024 * 1024)
+
+#define DEEN_BENCH_WORD_SIZE 256
+
+/*
+These lines are in the style of the Ding data with a mixture of common short
+words, compound nouns, umlauts and the markers for grammar and context.
+*/
+
+static const char *deen_bench_sample_lines[] = {
+	"Haus {n}; Gebäude {n} | Häuser {pl}; Gebäude {pl} :: house; building | houses; buildings",
+	"Haustür {f} | Haustüren {pl} :: front door | front doors",
+	"König {m} | Könige {pl} :: king | kings",
+	"Königin {f} | Königinnen {pl} :: queen | queens",
+	"Straße {f}; Str. | Straßen {pl} :: street; road; St. | streets; roads",
+	"Übung {f} | Übungen {pl} :: exercise; practice | exercises; practices",
+	"Größe {f}; Umfang {m}; Ausmaß {n} :: size; extent; magnitude",
+	"Mädchen {n} | Mädchen {pl} :: girl; lass [Br.] | girls; lasses",
+	"Käsebrötchen {n} :: cheese roll [Br.]; cheese sandwich [Am.]",
+	"auf die Dauer; auf Dauer :: in the long run; on a permanent basis",
+	"in der Regel :: as a rule; usually; normally",
+	"etw. öffnen {vt} | öffnend | geöffnet | öffnet | öffnete :: to open sth. | opening | opened | opens | opened",
+	"schließen {vt}; zumachen {vt} [ugs.] | schließend | geschlossen :: to close; to shut | closing | closed",
+	"Werkzeug {n} | Werkzeuge {pl} :: tool | tools",
+	"Werkzeugkasten {m}; Werkzeugkiste {f} :: toolbox; tool box; tool kit",
+	"Bahnhof {m}; Bhf. | Bahnhöfe {pl} :: railway station [Br.]; railroad station [Am.]; station | stations",
+	"Zeitung {f} | Zeitungen {pl} :: newspaper; paper | newspapers; papers",
+	"groß {adj} | größer | am größten :: big; large; tall | bigger; larger | biggest; largest",
+	"schön {adj} | schöner | am schönsten :: beautiful; nice; lovely | more beautiful | most beautiful",
+	"über etw. sprechen {vi} :: to talk about sth.; to speak about sth.",
+	"Regierung {f} | Regierungen {pl} :: government | governments",
+	"der, die, das {art} :: the",
+	"wir {pron} :: we",
+	"Kündigungsfrist {f} [jur.] :: period of notice; notice period",
+	"Fußball {m} [sport] | Fußbälle {pl} :: football [Br.]; soccer [Am.] | footballs",
+	"Schlüssel {m} | Schlüssel {pl} :: key | keys",
+	"Wörterbuch {n} | Wörterbücher {pl} :: dictionary | dictionaries",
+	"Öl {n} | Öle {pl} :: oil | oils",
+	"Bär {m} [zool.] | Bären {pl} :: bear | bears",
+	"süß {adj} :: sweet; cute [Am.]"
+};
+
+/*
+These are the keywords searched for in the lines; they are upper case as
+they would be from a search expression.  Some are found often, some are
+found seldom and one is never found.
+*/
+
+static const char *deen_bench_keywords[] = {
+	"HAUS", "KÖNIG", "KOENIG", "STRASSE", "THE", "ÜBUNG", "WERKZEUG", "GRÖSSE", "ZZZYX"
+};
+
+#define DEEN_BENCH_COUNT(A) (sizeof(A) / sizeof(A[0]))
+
+
+typedef struct deen_bench_corpus deen_bench_corpus;
+struct deen_bench_corpus {
+	uint8_t **lines;
+	size_t *lines_len;
+	size_t lines_count;
+	size_t lines_allocated;
+
+	uint8_t **words;
+	size_t *words_len;
+	uint8_t **words_upper;
+	size_t words_count;
+	size_t words_allocated;
+
+	uint8_t word_buffer[DEEN_BENCH_WORD_SIZE];
+};
+
+
+/*
+The functions are timed over all of the corpus for one round.  They return
+the number of calls made and the number of bytes that were processed.
+*/
+
+typedef void (*deen_bench_kernel_fn)(deen_bench_corpus *corpus, uint64_t *calls, uint64_t *bytes);
+
+typedef struct deen_bench_kernel deen_bench_kernel;
+struct deen_bench_kernel {
+	const char *name;
+	deen_bench_kernel_fn fn;
+};
+
+
+// the results of the functions are added into this so that the compiler is
+// not able to remove the calls.
+
+static volatile uint64_t deen_bench_sink = 0;
+
+
+static uint64_t deen_bench_ticks() {
+#ifdef DEEN_BENCH_TSC
+	uint64_t t;
+	_mm_lfence();
+	t = __rdtsc();
+	_mm_lfence();
+	return t;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+
+static void deen_bench_syntax(char *binary_name) {
+	printf("%s [-r <rounds>] [<ding-file>]\n", binary_name);
+	exit(1);
+}
+
+
+// ---------------------------------------------------------------
+// CORPUS
+// ---------------------------------------------------------------
+
+#define DEEN_BENCH_IS_WORD_CHAR(C) (!isspace(C) && !ispunct(C))
+
+static void deen_bench_corpus_add_word(deen_bench_corpus *corpus, const uint8_t *s, size_t len) {
+	if (len >= DEEN_BENCH_WORD_SIZE) {
+		return;
+	}
+
+	if (corpus->words_count == corpus->words_allocated) {
+		corpus->words_allocated = (0 == corpus->words_allocated) ? 1024 : corpus->words_allocated * 2;
+		corpus->words = (uint8_t **) deen_erealloc(corpus->words, sizeof(uint8_t *) * corpus->words_allocated);
+		corpus->words_len = (size_t *) deen_erealloc(corpus->words_len, sizeof(size_t) * corpus->words_allocated);
+		corpus->words_upper = (uint8_t **) deen_erealloc(corpus->words_upper, sizeof(uint8_t *) * corpus->words_allocated);
+	}
+
+	corpus->words[corpus->words_count] = (uint8_t *) deen_emalloc(len + 1);
+	memcpy(corpus->words[corpus->words_count], s, len);
+	corpus->words[corpus->words_count][len] = 0;
+
+	corpus->words_upper[corpus->words_count] = (uint8_t *) deen_emalloc(len + 1);
+	memcpy(corpus->words_upper[corpus->words_count], s, len);
+	corpus->words_upper[corpus->words_count][len] = 0;
+	deen_to_upper(corpus->words_upper[corpus->words_count]);
+
+	corpus->words_len[corpus->words_count] = len;
+	corpus->words_count++;
+}
+
+
+static void deen_bench_corpus_add_line(deen_bench_corpus *corpus, const uint8_t *s, size_t len) {
+	size_t i = 0;
+
+	if (0 == len || '#' == s[0]) {
+		return;
+	}
+
+	if (corpus->lines_count == corpus->lines_allocated) {
+		corpus->lines_allocated = (0 == corpus->lines_allocated) ? 1024 : corpus->lines_allocated * 2;
+		corpus->lines = (uint8_t **) deen_erealloc(corpus->lines, sizeof(uint8_t *) * corpus->lines_allocated);
+		corpus->lines_len = (size_t *) deen_erealloc(corpus->lines_len, sizeof(size_t) * corpus->lines_allocated);
+	}
+
+	corpus->lines[corpus->lines_count] = (uint8_t *) deen_emalloc(len + 1);
+	memcpy(corpus->lines[corpus->lines_count], s, len);
+	corpus->lines[corpus->lines_count][len] = 0;
+	corpus->lines_len[corpus->lines_count] = len;
+	corpus->lines_count++;
+
+	while (i < len) {
+		size_t start;
+
+		while (i < len && !DEEN_BENCH_IS_WORD_CHAR(s[i])) {
+			i++;
+		}
+
+		start = i;
+
+		while (i < len && DEEN_BENCH_IS_WORD_CHAR(s[i])) {
+			i++;
+		}
+
+		if (i != start) {
+			deen_bench_corpus_add_word(corpus, &s[start], i - start);
+		}
+	}
+}
+
+
+static void deen_bench_corpus_load_sample(deen_bench_corpus *corpus) {
+	size_t total = 0;
+
+	while (total < DEEN_BENCH_CORPUS_MIN_BYTES) {
+		size_t i;
+
+		for (i = 0; i < DEEN_BENCH_COUNT(deen_bench_sample_lines); i++) {
+			size_t len = strlen(deen_bench_sample_lines[i]);
+			deen_bench_corpus_add_line(corpus, (const uint8_t *) deen_bench_sample_lines[i], len);
+			total += len;
+		}
+	}
+}
+
+
+static void deen_bench_corpus_load_file(deen_bench_corpus *corpus, const char *path) {
+	uint8_t *buffer = (uint8_t *) deen_emalloc(DEEN_BENCH_CORPUS_FILE_MAX_BYTES);
+	size_t len = 0;
+	size_t start = 0;
+	size_t i;
+	ssize_t read_len;
+	int fd = open(path, O_RDONLY);
+
+	if (-1 == fd) {
+		deen_log_error_and_exit("unable to open the ding file [%s]", path);
+	}
+
+	while (len < DEEN_BENCH_CORPUS_FILE_MAX_BYTES
+		&& (read_len = read(fd, &buffer[len], DEEN_BENCH_CORPUS_FILE_MAX_BYTES - len)) > 0) {
+		len += (size_t) read_len;
+	}
+
+	close(fd);
+
+	// a line that was cut off at the end is not used.
+
+	for (i = 0; i < len; i++) {
+		if ('\n' == buffer[i]) {
+			deen_bench_corpus_add_line(corpus, &buffer[start], i - start);
+			start = i + 1;
+		}
+	}
+
+	free((void *) buffer);
+
+	if (0 == corpus->words_count) {
+		deen_log_error_and_exit("no words were found in the ding file [%s]", path);
+	}
+}
+
+
+static void deen_bench_corpus_free(deen_bench_corpus *corpus) {
+	size_t i;
+
+	for (i = 0; i < corpus->lines_count; i++) {
+		free((void *) corpus->lines[i]);
+	}
+
+	for (i = 0; i < corpus->words_count; i++) {
+		free((void *) corpus->words[i]);
+		free((void *) corpus->words_upper[i]);
+	}
+
+	free((void *) corpus->lines);
+	free((void *) corpus->lines_len);
+	free((void *) corpus->words);
+	free((void *) corpus->words_len);
+	free((void *) corpus->words_upper);
+}
+
+
+// ---------------------------------------------------------------
+// KERNELS
+// ---------------------------------------------------------------
+
+static void deen_bench_utf8_sequence_len(deen_bench_corpus *corpus, uint64_t *calls, uint64_t *bytes) {
+	uint64_t sink = 0;
+	size_t i;
+
+	for (i = 0; i < corpus->words_count; i++) {
+		const uint8_t *c = corpus->words[i];
+		size_t len = corpus->words_len[i];
+		size_t o = 0;
+
+		while (o < len) {
+			size_t sequence_len;
+
+			if (DEEN_SEQUENCE_OK != deen_utf8_sequence_len(&c[o], len - o, &sequence_len)) {
+				sequence_len = 1;
+			}
+
+			o += sequence_len;
+			(*calls)++;
+		}
+
+		*bytes += len;
+		sink += o;
+	}
+
+	deen_bench_sink += sink;
+}
+
+
+static void deen_bench_utf8_sequences_count(deen_bench_corpus *corpus, uint64_t *calls, uint64_t *bytes) {
+	uint64_t sink = 0;
+	size_t i;
+
+	for (i = 0; i < corpus->words_count; i++) {
+		size_t count = 0;
+		deen_utf8_sequences_count(corpus->words[i], corpus->words_len[i], &count);
+		sink += count;
+		*bytes += corpus->words_len[i];
+	}
+
+	*calls += corpus->words_count;
+	deen_bench_sink += sink;
+}
+
+
+// the crop changes the word and so it is cropped in a copy; the time includes
+// making the copy.
+
+static void deen_bench_utf8_crop_to_unicode_len(deen_bench_corpus *corpus, uint64_t *calls, uint64_t *bytes) {
+	uint64_t sink = 0;
+	size_t i;
+
+	for (i = 0; i < corpus->words_count; i++) {
+		memcpy(corpus->word_buffer, corpus->words[i], corpus->words_len[i] + 1);
+		sink += deen_utf8_crop_to_unicode_len(corpus->word_buffer, corpus->words_len[i], DEEN_INDEXING_DEPTH);
+		*bytes += corpus->words_len[i];
+	}
+
+	*calls += corpus->words_count;
+	deen_bench_sink += sink;
+}
+
+
+// as with the crop, the time includes making a copy.
+
+static void deen_bench_to_upper(deen_bench_corpus *corpus, uint64_t *calls, uint64_t *bytes) {
+	uint64_t sink = 0;
+	size_t i;
+
+	for (i = 0; i < corpus->words_count; i++) {
+		memcpy(corpus->word_buffer, corpus->words[i], corpus->words_len[i] + 1);
+		deen_to_upper(corpus->word_buffer);
+		sink += corpus->word_buffer[0];
+		*bytes += corpus->words_len[i];
+	}
+
+	*calls += corpus->words_count;
+	deen_bench_sink += sink;
+}
+
+
+static void deen_bench_is_common_upper_word(deen_bench_corpus *corpus, uint64_t *calls, uint64_t *bytes) {
+	uint64_t sink = 0;
+	size_t i;
+
+	for (i = 0; i < corpus->words_count; i++) {
+		sink += deen_is_common_upper_word(corpus->words_upper[i], corpus->words_len[i]);
+		*bytes += corpus->words_len[i];
+	}
+
+	*calls += corpus->words_count;
+	deen_bench_sink += sink;
+}
+
+
+/*
+Checks for each of the keywords at the start of each word in each line as
+happens when a line is checked for the keywords.
+*/
+
+static void deen_bench_imatches_at(deen_bench_corpus *corpus, uint64_t *calls, uint64_t *bytes) {
+	uint64_t sink = 0;
+	size_t i, k;
+
+	for (i = 0; i < corpus->lines_count; i++) {
+		const uint8_t *s = corpus->lines[i];
+		size_t len = corpus->lines_len[i];
+		size_t at = 0;
+
+		while (at < len) {
+			while (at < len && !DEEN_BENCH_IS_WORD_CHAR(s[at])) {
+				at++;
+			}
+
+			if (at < len) {
+				for (k = 0; k < DEEN_BENCH_COUNT(deen_bench_keywords); k++) {
+					sink += deen_imatches_at(s, (const uint8_t *) deen_bench_keywords[k], at);
+				}
+
+				*calls += DEEN_BENCH_COUNT(deen_bench_keywords);
+			}
+
+			while (at < len && DEEN_BENCH_IS_WORD_CHAR(s[at])) {
+				at++;
+			}
+		}
+
+		*bytes += len;
+	}
+
+	deen_bench_sink += sink;
+}
+
+
+static void deen_bench_ifind_first(deen_bench_corpus *corpus, uint64_t *calls, uint64_t *bytes) {
+	uint64_t sink = 0;
+	size_t i, k;
+
+	for (i = 0; i < corpus->lines_count; i++) {
+		for (k = 0; k < DEEN_BENCH_COUNT(deen_bench_keywords); k++) {
+			sink += deen_ifind_first(corpus->lines[i], (const uint8_t *) deen_bench_keywords[k], 0, corpus->lines_len[i]);
+		}
+
+		*calls += DEEN_BENCH_COUNT(deen_bench_keywords);
+		*bytes += corpus->lines_len[i] * DEEN_BENCH_COUNT(deen_bench_keywords);
+	}
+
+	deen_bench_sink += sink;
+}
+
+
+static const deen_bench_kernel deen_bench_kernels[] = {
+	{ "deen_utf8_sequence_len", &deen_bench_utf8_sequence_len },
+	{ "deen_utf8_sequences_count", &deen_bench_utf8_sequences_count },
+	{ "deen_utf8_crop_to_unicode_len", &deen_bench_utf8_crop_to_unicode_len },
+	{ "deen_to_upper", &deen_bench_to_upper },
+	{ "deen_is_common_upper_word", &deen_bench_is_common_upper_word },
+	{ "deen_imatches_at", &deen_bench_imatches_at },
+	{ "deen_ifind_first", &deen_bench_ifind_first }
+};
+
+
+// ---------------------------------------------------------------
+// TIMING
+// ---------------------------------------------------------------
+
+static int deen_bench_compare_ticks(const void *a, const void *b) {
+	uint64_t ta = *((const uint64_t *) a);
+	uint64_t tb = *((const uint64_t *) b);
+	return (ta > tb) - (ta < tb);
+}
+
+
+/*
+Runs the function once so that the caches are warm and then for each of the
+rounds.  The ticks of each round are sorted.
+*/
+
+static void deen_bench_time_kernel(
+	const deen_bench_kernel *kernel,
+	deen_bench_corpus *corpus,
+	uint32_t rounds,
+	uint64_t *round_ticks,
+	uint64_t *calls,
+	uint64_t *bytes) {
+
+	uint32_t r;
+
+	kernel->fn(corpus, calls, bytes);
+
+	for (r = 0; r < rounds; r++) {
+		uint64_t start;
+
+		*calls = 0;
+		*bytes = 0;
+
+		start = deen_bench_ticks();
+		kernel->fn(corpus, calls, bytes);
+		round_ticks[r] = deen_bench_ticks() - start;
+	}
+
+	qsort(round_ticks, rounds, sizeof(uint64_t), &deen_bench_compare_ticks);
+}
+
+
+static const char *deen_bench_simd_level_name(deen_simd_level level) {
+	switch (level) {
+		case DEEN_SIMD_SSE2: return "sse2";
+		case DEEN_SIMD_AVX2: return "avx2";
+		default: return "scalar";
+	}
+}
+
+
+int main(int argc, char** argv) {
+	deen_bench_corpus corpus;
+	deen_simd_level supported_level;
+	deen_simd_level level;
+	uint32_t rounds = DEEN_BENCH_ROUNDS_DEFAULT;
+	const char *ding_path = NULL;
+	uint64_t *round_ticks;
+	uint64_t corpus_bytes = 0;
+	deen_bool is_first = DEEN_TRUE;
+	size_t i;
+	int a;
+
+	for (a = 1; a < argc; a++) {
+		if (0 == strcmp(argv[a], "-r") && a < argc - 1) {
+			rounds = (uint32_t) atoi(argv[++a]);
+		}
+		else if ('-' != argv[a][0] && a == argc - 1) {
+			ding_path = argv[a];
+		}
+		else {
+			deen_bench_syntax(argv[0]);
+		}
+	}
+
+	if (0 == rounds || rounds > DEEN_BENCH_ROUNDS_MAX) {
+		deen_bench_syntax(argv[0]);
+	}
+
+	memset(&corpus, 0, sizeof(deen_bench_corpus));
+
+	if (NULL == ding_path) {
+		deen_bench_corpus_load_sample(&corpus);
+	}
+	else {
+		deen_bench_corpus_load_file(&corpus, ding_path);
+	}
+
+	for (i = 0; i < corpus.lines_count; i++) {
+		corpus_bytes += corpus.lines_len[i];
+	}
+
+	round_ticks = (uint64_t *) deen_emalloc(sizeof(uint64_t) * rounds);
+	supported_level = deen_get_simd_level();
+
+	printf("{\n  \"version\":\"%s\",\n  \"unit\":\"%s\",\n  \"corpus\":\"%s\",\n",
+		DEEN_VERSION,
+#ifdef DEEN_BENCH_TSC
+		"tsc-cycles",
+#else
+		"ns",
+#endif
+		(NULL == ding_path) ? "sample" : "file");
+	printf("  \"lines\":%lu,\n  \"words\":%lu,\n  \"bytes\":%llu,\n  \"rounds\":%u,\n  \"kernels\":[",
+		(unsigned long) corpus.lines_count, (unsigned long) corpus.words_count,
+		(unsigned long long) corpus_bytes, rounds);
+
+	for (level = DEEN_SIMD_SCALAR; level <= supported_level; level++) {
+		deen_set_simd_level(level);
+
+		for (i = 0; i < DEEN_BENCH_COUNT(deen_bench_kernels); i++) {
+			uint64_t calls = 0;
+			uint64_t bytes = 0;
+			uint64_t best;
+			uint64_t median;
+
+			deen_bench_time_kernel(&deen_bench_kernels[i], &corpus, rounds, round_ticks, &calls, &bytes);
+			best = round_ticks[0];
+			median = round_ticks[rounds / 2];
+
+			printf("%s\n    {\"name\":\"%s\",\"simd\":\"%s\",\"calls\":%llu,\"bytes\":%llu",
+				is_first ? "" : ",",
+				deen_bench_kernels[i].name,
+				deen_bench_simd_level_name(level),
+				(unsigned long long) calls,
+				(unsigned long long) bytes);
+			printf(",\"best_per_call\":%.2f,\"median_per_call\":%.2f,\"best_per_byte\":%.3f}",
+				(double) best / (double) calls,
+				(double) median / (double) calls,
+				(0 == bytes) ? 0.0 : (double) best / (double) bytes);
+
+			is_first = DEEN_FALSE;
+		}
+	}
+
+	printf("\n  ]\n}\n");
+
+	deen_set_simd_level(supported_level);
+	free((void *) round_ticks);
+	deen_bench_corpus_free(&corpus);
+
+	return EXIT_SUCCESS;
+}
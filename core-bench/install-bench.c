@@ -0,0 +1,768 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+/*
+This program measures the throughput of installing Ding data.  Because the
+real data is not always able to be downloaded, the program is able to generate
+synthetic data in the Ding format at a multiple of the size of the real de-en
+file.  The synthetic words are made up from syllables and their frequencies
+follow a Zipf distribution so that the indexes have about the shape that the
+real data gives them.  The data is installed into a temporary root directory
+which is removed afterwards and the results are written as JSON.  The time for
+each phase of the install is taken from the tracing spans.
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "core/common.h"
+#include "core/constants.h"
+#include "core/install.h"
+#include "core/tracing.h"
+#include "core/types.h"
+
+/*
+This is about the size of the de-en file at the time of writing.  The
+generated data is this size multiplied by the scale.
+*/
+
+#define DEEN_BENCH_DING_BYTES (34 * 1024 * 1024)
+
+#define DEEN_BENCH_SCALE_MAX 1000
+#define DEEN_BENCH_LEAF_GENERATED "generated-de-en.txt"
+
+/*
+The vocabulary of the generated data grows with the square root of the scale
+as the vocabulary of natural text grows with its size (Heaps' law).  The
+vocabulary is split between the classes of word.
+*/
+
+#define DEEN_BENCH_VOCABULARY_BASE 60000
+#define DEEN_BENCH_WORD_SIZE 128
+
+enum deen_bench_class {
+	DEEN_BENCH_CLASS_NOUN = 0,
+	DEEN_BENCH_CLASS_VERB,
+	DEEN_BENCH_CLASS_ADJECTIVE,
+	DEEN_BENCH_CLASS_COUNT
+};
+
+// these are the parts of the vocabulary out of ten in each class.
+
+static const uint32_t deen_bench_class_tenths[DEEN_BENCH_CLASS_COUNT] = { 6, 2, 2 };
+
+/*
+The words are made up from these syllables.  The German syllables have the
+umlauts and the sharp s so that the data has multi-byte characters in about
+the proportion found in the real data.
+*/
+
+static const char *deen_bench_de_onsets[] = {
+	"", "", "", "b", "br", "d", "dr", "f", "fl", "fr", "g", "gr", "h", "k", "kl",
+	"kr", "l", "m", "n", "p", "pf", "r", "s", "sch", "schl", "schw", "sp", "st",
+	"str", "t", "tr", "w", "z", "zw"
+};
+
+static const char *deen_bench_de_nuclei[] = {
+	"a", "a", "e", "e", "e", "i", "o", "u", "ä", "ö", "ü", "au", "ei", "ie", "eu"
+};
+
+static const char *deen_bench_de_codas[] = {
+	"", "", "", "n", "r", "l", "s", "t", "ck", "ch", "m", "ng", "nd", "rt", "st",
+	"ß", "tz", "ff", "cht"
+};
+
+static const char *deen_bench_en_onsets[] = {
+	"", "", "b", "bl", "br", "c", "ch", "cl", "cr", "d", "dr", "f", "fl", "g", "gr",
+	"h", "j", "k", "l", "m", "n", "p", "pl", "pr", "qu", "r", "s", "sh", "sl",
+	"sp", "st", "str", "t", "th", "tr", "v", "w", "wh", "y"
+};
+
+static const char *deen_bench_en_nuclei[] = {
+	"a", "a", "e", "e", "i", "o", "u", "ea", "ee", "oo", "ou", "ai", "oa"
+};
+
+static const char *deen_bench_en_codas[] = {
+	"", "", "n", "r", "l", "s", "t", "ck", "ng", "nd", "rt", "st", "sh", "th",
+	"m", "x", "ll"
+};
+
+// the derivations give the words endings and beginnings that are shared.
+
+static const char *deen_bench_noun_suffixes[] = {
+	"", "", "", "", "ung", "heit", "keit", "schaft", "er", "chen", "nis", "e"
+};
+
+static const char *deen_bench_verb_prefixes[] = {
+	"", "", "", "", "ver", "be", "ent", "auf", "an", "aus", "zer", "vor", "über"
+};
+
+static const char *deen_bench_adjective_suffixes[] = {
+	"", "", "ig", "lich", "isch", "bar", "sam", "los"
+};
+
+static const char *deen_bench_genders[] = { "m", "f", "n" };
+
+static const char *deen_bench_contexts[] = {
+	"[Br.]", "[Am.]", "[ugs.]", "[techn.]", "[zool.]", "[sport]", "[übtr.]", "[Schw.]", "[Ös.]"
+};
+
+#define DEEN_BENCH_COUNT(A) (sizeof(A) / sizeof(A[0]))
+
+
+/*
+The ranks of the words in each class are drawn from a Zipf distribution so
+that a few words are very common and most words are rare.  This is the
+cumulative weight of the ranks; one table serves all of the classes because
+the weights of the first ranks are the same whatever the size of the class.
+*/
+
+typedef struct deen_bench_vocabulary deen_bench_vocabulary;
+struct deen_bench_vocabulary {
+	uint32_t sizes[DEEN_BENCH_CLASS_COUNT];
+	double *cumulative;
+};
+
+
+/*
+A word of the vocabulary with the German and English text and the grammar
+marker such as "m" for a masculine noun or "vt" for a transitive verb.
+*/
+
+typedef struct deen_bench_word deen_bench_word;
+struct deen_bench_word {
+	char de[DEEN_BENCH_WORD_SIZE];
+	char en[DEEN_BENCH_WORD_SIZE];
+	const char *grammar;
+	const char *suffix;
+};
+
+
+typedef struct deen_bench_results deen_bench_results;
+struct deen_bench_results {
+	FILE *out;
+	deen_bool is_first_phase;
+};
+
+
+static uint64_t deen_bench_nanos() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+
+static void deen_bench_syntax(char *binary_name) {
+	printf("%s [-s <scale>] [-o <json-file>] [<ding-file>]\n", binary_name);
+	printf("%s [-s <scale>] -g <ding-file>\n", binary_name);
+	exit(1);
+}
+
+
+// ---------------------------------------------------------------
+// GENERATING
+// ---------------------------------------------------------------
+
+/*
+The generated data needs to be the same each time so that runs are able to be
+compared and so a simple fixed-seed xorshift generator is used.
+*/
+
+static uint32_t deen_bench_random(uint64_t *state, uint32_t bound) {
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return (uint32_t) ((x * 0x2545F4914F6CDD1DULL) >> 32) % bound;
+}
+
+
+/*
+The next random number from 0 up to but not including 1.
+*/
+
+static double deen_bench_random_unit(uint64_t *state) {
+	return (double) deen_bench_random(state, 0x40000000) / (double) 0x40000000;
+}
+
+
+/*
+Each word of the vocabulary is made from its own random state so that the
+same class and rank always makes the same word without the words being
+stored.
+*/
+
+static uint64_t deen_bench_word_state(enum deen_bench_class word_class, uint32_t rank) {
+	uint64_t x = (((uint64_t) word_class << 32) | rank) + 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	x = x ^ (x >> 31);
+	return (0 == x) ? 1 : x;
+}
+
+
+static void deen_bench_vocabulary_init(deen_bench_vocabulary *vocabulary, uint32_t scale) {
+	uint64_t target = (uint64_t) DEEN_BENCH_VOCABULARY_BASE * DEEN_BENCH_VOCABULARY_BASE * scale;
+	uint64_t size = DEEN_BENCH_VOCABULARY_BASE;
+	double total = 0.0;
+	uint32_t i;
+
+	while (size * size < target) {
+		size++;
+	}
+
+	for (i = 0; i < DEEN_BENCH_CLASS_COUNT; i++) {
+		vocabulary->sizes[i] = (uint32_t) ((size * deen_bench_class_tenths[i]) / 10);
+	}
+
+	vocabulary->cumulative = (double *) deen_emalloc(sizeof(double) * vocabulary->sizes[DEEN_BENCH_CLASS_NOUN]);
+
+	for (i = 0; i < vocabulary->sizes[DEEN_BENCH_CLASS_NOUN]; i++) {
+		total += 1.0 / (double) (i + 1);
+		vocabulary->cumulative[i] = total;
+	}
+}
+
+
+static void deen_bench_vocabulary_free(deen_bench_vocabulary *vocabulary) {
+	free((void *) vocabulary->cumulative);
+}
+
+
+static uint32_t deen_bench_vocabulary_rank(
+	deen_bench_vocabulary *vocabulary,
+	enum deen_bench_class word_class,
+	uint64_t *state) {
+
+	uint32_t size = vocabulary->sizes[word_class];
+	double target = deen_bench_random_unit(state) * vocabulary->cumulative[size - 1];
+	uint32_t low = 0;
+	uint32_t high = size - 1;
+
+	while (low < high) {
+		uint32_t mid = low + ((high - low) / 2);
+
+		if (vocabulary->cumulative[mid] <= target) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+
+static void deen_bench_append(char *buffer, const char *s) {
+	size_t len = strlen(buffer);
+	size_t s_len = strlen(s);
+
+	if (len + s_len < DEEN_BENCH_WORD_SIZE) {
+		memcpy(&buffer[len], s, s_len + 1);
+	}
+}
+
+
+static void deen_bench_append_syllables(
+	char *buffer,
+	uint64_t *state,
+	const char **onsets, size_t onsets_count,
+	const char **nuclei, size_t nuclei_count,
+	const char **codas, size_t codas_count) {
+
+	uint32_t syllables = 1 + ((deen_bench_random(state, 4) + 1) / 2);
+	uint32_t i;
+
+	for (i = 0; i < syllables; i++) {
+		deen_bench_append(buffer, onsets[deen_bench_random(state, onsets_count)]);
+		deen_bench_append(buffer, nuclei[deen_bench_random(state, nuclei_count)]);
+		deen_bench_append(buffer, codas[deen_bench_random(state, codas_count)]);
+	}
+}
+
+
+/*
+Changes the case of the first letter of the German word.  The umlauts in the
+Latin-1 Supplement are two bytes in UTF-8 and their lower case is 0x20 above.
+*/
+
+static void deen_bench_first_to_case(char *s, deen_bool is_upper) {
+	uint8_t *u = (uint8_t *) s;
+
+	if (is_upper) {
+		if (u[0] >= 'a' && u[0] <= 'z') {
+			u[0] -= 'a' - 'A';
+		}
+		else if (0xc3 == u[0] && u[1] >= 0xa0 && u[1] <= 0xbe) {
+			u[1] -= 0x20;
+		}
+	}
+	else {
+		if (u[0] >= 'A' && u[0] <= 'Z') {
+			u[0] += 'a' - 'A';
+		}
+		else if (0xc3 == u[0] && u[1] >= 0x80 && u[1] <= 0x9e) {
+			u[1] += 0x20;
+		}
+	}
+}
+
+
+/*
+Makes the word of the vocabulary at the rank in the class.  The German word
+is a stem of syllables with a derivation and the English word is a stem of
+syllables of its own.
+*/
+
+static void deen_bench_word_make(
+	deen_bench_word *word,
+	enum deen_bench_class word_class,
+	uint32_t rank) {
+
+	uint64_t state = deen_bench_word_state(word_class, rank);
+
+	word->de[0] = 0;
+	word->en[0] = 0;
+	word->suffix = "";
+
+	switch (word_class) {
+		case DEEN_BENCH_CLASS_NOUN:
+			deen_bench_append_syllables(word->de, &state,
+				deen_bench_de_onsets, DEEN_BENCH_COUNT(deen_bench_de_onsets),
+				deen_bench_de_nuclei, DEEN_BENCH_COUNT(deen_bench_de_nuclei),
+				deen_bench_de_codas, DEEN_BENCH_COUNT(deen_bench_de_codas));
+			word->suffix = deen_bench_noun_suffixes[deen_bench_random(&state, DEEN_BENCH_COUNT(deen_bench_noun_suffixes))];
+			deen_bench_append(word->de, word->suffix);
+			deen_bench_first_to_case(word->de, DEEN_TRUE);
+
+			if (0 == strcmp(word->suffix, "chen")) {
+				word->grammar = "n";
+			}
+			else if (0 == strcmp(word->suffix, "ung")
+				|| 0 == strcmp(word->suffix, "heit")
+				|| 0 == strcmp(word->suffix, "keit")
+				|| 0 == strcmp(word->suffix, "schaft")) {
+				word->grammar = "f";
+			}
+			else {
+				word->grammar = deen_bench_genders[deen_bench_random(&state, DEEN_BENCH_COUNT(deen_bench_genders))];
+			}
+			break;
+
+		case DEEN_BENCH_CLASS_VERB:
+			deen_bench_append(word->de, deen_bench_verb_prefixes[deen_bench_random(&state, DEEN_BENCH_COUNT(deen_bench_verb_prefixes))]);
+			deen_bench_append_syllables(word->de, &state,
+				deen_bench_de_onsets, DEEN_BENCH_COUNT(deen_bench_de_onsets),
+				deen_bench_de_nuclei, DEEN_BENCH_COUNT(deen_bench_de_nuclei),
+				deen_bench_de_codas, DEEN_BENCH_COUNT(deen_bench_de_codas));
+			deen_bench_append(word->de, "en");
+			deen_bench_append(word->en, "to ");
+			word->grammar = (0 == deen_bench_random(&state, 2)) ? "vt" : "vi";
+			break;
+
+		default:
+			deen_bench_append_syllables(word->de, &state,
+				deen_bench_de_onsets, DEEN_BENCH_COUNT(deen_bench_de_onsets),
+				deen_bench_de_nuclei, DEEN_BENCH_COUNT(deen_bench_de_nuclei),
+				deen_bench_de_codas, DEEN_BENCH_COUNT(deen_bench_de_codas));
+			word->suffix = deen_bench_adjective_suffixes[deen_bench_random(&state, DEEN_BENCH_COUNT(deen_bench_adjective_suffixes))];
+			deen_bench_append(word->de, word->suffix);
+			word->grammar = (0 == deen_bench_random(&state, 5)) ? "adv" : "adj";
+			break;
+	}
+
+	deen_bench_append_syllables(word->en, &state,
+		deen_bench_en_onsets, DEEN_BENCH_COUNT(deen_bench_en_onsets),
+		deen_bench_en_nuclei, DEEN_BENCH_COUNT(deen_bench_en_nuclei),
+		deen_bench_en_codas, DEEN_BENCH_COUNT(deen_bench_en_codas));
+}
+
+
+static void deen_bench_word_draw(
+	deen_bench_word *word,
+	deen_bench_vocabulary *vocabulary,
+	enum deen_bench_class word_class,
+	uint64_t *state) {
+
+	deen_bench_word_make(word, word_class, deen_bench_vocabulary_rank(vocabulary, word_class, state));
+}
+
+
+static const char *deen_bench_noun_plural(const deen_bench_word *word) {
+	if ('f' == word->grammar[0]) {
+		return ('e' == word->de[strlen(word->de) - 1]) ? "n" : "en";
+	}
+
+	if (0 == strcmp(word->suffix, "chen") || 0 == strcmp(word->suffix, "er")) {
+		return "";
+	}
+
+	return (0 == strcmp(word->suffix, "nis")) ? "se" : "e";
+}
+
+
+/*
+Writes one sense on each side of the entry; a word, a compound noun or an
+inflection with its grammar marker and sometimes with a context.
+*/
+
+static void deen_bench_write_sense(FILE *de, FILE *en, deen_bench_vocabulary *vocabulary, uint64_t *state) {
+	uint32_t kind = deen_bench_random(state, 20);
+	deen_bench_word word;
+	deen_bench_word second;
+
+	if (kind < 7) {
+		deen_bench_word_draw(&word, vocabulary, DEEN_BENCH_CLASS_NOUN, state);
+		fprintf(de, "%s {%s}", word.de, word.grammar);
+		fputs(word.en, en);
+	}
+	else if (kind < 9) {
+		deen_bench_word_draw(&word, vocabulary, DEEN_BENCH_CLASS_NOUN, state);
+		fprintf(de, "%s%s {pl}", word.de, deen_bench_noun_plural(&word));
+		fprintf(en, "%ss", word.en);
+	}
+	else if (kind < 13) {
+
+		// the German compound takes the gender of its last part and a
+		// linking 's' after some of the derivations.
+
+		deen_bench_word_draw(&word, vocabulary, DEEN_BENCH_CLASS_NOUN, state);
+		deen_bench_word_draw(&second, vocabulary, DEEN_BENCH_CLASS_NOUN, state);
+		deen_bench_first_to_case(second.de, DEEN_FALSE);
+		fprintf(de, "%s%s%s {%s}",
+			word.de,
+			(0 == strcmp(word.suffix, "ung") || 0 == strcmp(word.suffix, "heit")
+				|| 0 == strcmp(word.suffix, "keit") || 0 == strcmp(word.suffix, "schaft")) ? "s" : "",
+			second.de,
+			second.grammar);
+		fprintf(en, "%s %s", word.en, second.en);
+	}
+	else if (kind < 15) {
+		deen_bench_word_draw(&word, vocabulary, DEEN_BENCH_CLASS_VERB, state);
+		fprintf(de, "%s {%s}", word.de, word.grammar);
+		fputs(word.en, en);
+	}
+	else if (kind < 16) {
+
+		// the past participle; the infinitive ending is replaced.
+
+		deen_bench_word_draw(&word, vocabulary, DEEN_BENCH_CLASS_VERB, state);
+		word.de[strlen(word.de) - 2] = 0;
+		fprintf(de, "ge%st", word.de);
+		fprintf(en, "%sed", &word.en[3]);
+	}
+	else if (kind < 19) {
+		deen_bench_word_draw(&word, vocabulary, DEEN_BENCH_CLASS_ADJECTIVE, state);
+		fprintf(de, "%s {%s}", word.de, word.grammar);
+		fputs(word.en, en);
+	}
+	else {
+		deen_bench_word_draw(&word, vocabulary, DEEN_BENCH_CLASS_ADJECTIVE, state);
+		fprintf(de, "%ser", word.de);
+		fprintf(en, "more %s", word.en);
+	}
+
+	if (0 == deen_bench_random(state, 5)) {
+		const char *context = deen_bench_contexts[deen_bench_random(state, DEEN_BENCH_COUNT(deen_bench_contexts))];
+		fprintf(de, " %s", context);
+		fprintf(en, " %s", context);
+	}
+}
+
+
+/*
+Writes an entry made up of up to three alternatives separated by '|' where
+each alternative has up to three senses separated by ';'.  The German and
+English sides have the same number of alternatives as is the case in the real
+data.  Returns the number of bytes written.
+*/
+
+static size_t deen_bench_write_entry(
+	FILE *out,
+	deen_bench_vocabulary *vocabulary,
+	uint64_t *state,
+	char *de_buffer,
+	char *en_buffer,
+	size_t buffer_size) {
+
+	FILE *de = fmemopen(de_buffer, buffer_size, "w");
+	FILE *en = fmemopen(en_buffer, buffer_size, "w");
+	uint32_t alternatives = 1 + deen_bench_random(state, 3);
+	uint32_t a, s;
+	int len;
+
+	if (NULL == de || NULL == en) {
+		deen_log_error_and_exit("unable to create the streams for an entry");
+	}
+
+	for (a = 0; a < alternatives; a++) {
+		uint32_t senses = 1 + deen_bench_random(state, 3);
+
+		if (0 != a) {
+			fputs(" | ", de);
+			fputs(" | ", en);
+		}
+
+		for (s = 0; s < senses; s++) {
+			if (0 != s) {
+				fputs("; ", de);
+				fputs("; ", en);
+			}
+
+			deen_bench_write_sense(de, en, vocabulary, state);
+		}
+	}
+
+	fclose(de);
+	fclose(en);
+
+	len = fprintf(out, "%s :: %s\n", de_buffer, en_buffer);
+
+	if (len < 0) {
+		deen_log_error_and_exit("unable to write the generated data");
+	}
+
+	return (size_t) len;
+}
+
+
+static void deen_bench_generate(const char *path, uint32_t scale) {
+	char de_buffer[2048];
+	char en_buffer[2048];
+	deen_bench_vocabulary vocabulary;
+	uint64_t state = 0x9e3779b97f4a7c15ULL;
+	uint64_t target = (uint64_t) DEEN_BENCH_DING_BYTES * scale;
+	uint64_t written = 0;
+	FILE *out = fopen(path, "w");
+
+	if (NULL == out) {
+		deen_log_error_and_exit("unable to open the file for the generated data [%s]", path);
+	}
+
+	deen_bench_vocabulary_init(&vocabulary, scale);
+
+	fputs("# Version :: 1.8.1 synthetic\n", out);
+	fputs("# This data was generated by deen-install-bench and is not a real dictionary\n", out);
+	fputs("#\n", out);
+
+	while (written < target) {
+		written += deen_bench_write_entry(out, &vocabulary, &state, de_buffer, en_buffer, sizeof(de_buffer));
+	}
+
+	deen_bench_vocabulary_free(&vocabulary);
+
+	if (0 != fclose(out)) {
+		deen_log_error_and_exit("unable to write the generated data [%s]", path);
+	}
+}
+
+
+// ---------------------------------------------------------------
+// MEASURING
+// ---------------------------------------------------------------
+
+static uint64_t deen_bench_file_size(const char *path) {
+	struct stat s;
+
+	if (-1 == stat(path, &s)) {
+		return 0;
+	}
+
+	return (uint64_t) s.st_size;
+}
+
+
+static uint64_t deen_bench_count_lines(const char *path) {
+	char buffer[DEEN_BUFFER_SIZE_EACH_WORD_FROM_FILE];
+	uint64_t lines = 0;
+	ssize_t read_len;
+	int fd = open(path, O_RDONLY);
+
+	if (-1 == fd) {
+		deen_log_error_and_exit("unable to open the file to count the lines [%s]", path);
+	}
+
+	while ((read_len = read(fd, buffer, sizeof(buffer))) > 0) {
+		ssize_t i;
+
+		for (i = 0; i < read_len; i++) {
+			if ('\n' == buffer[i]) {
+				lines++;
+			}
+		}
+	}
+
+	close(fd);
+
+	return lines;
+}
+
+
+static char *deen_bench_path_in_root_dir(const char *root_dir, const char *leafname) {
+	char *path = (char *) deen_emalloc(strlen(root_dir) + strlen(leafname) + 2);
+	sprintf(path, "%s%s%s", root_dir, DEEN_FILE_SEP, leafname);
+	return path;
+}
+
+
+static void deen_bench_write_phase(void *context, const char *name, uint32_t count, uint64_t nanos) {
+	deen_bench_results *results = (deen_bench_results *) context;
+
+	fprintf(results->out, "%s\n    {\"name\":\"%s\",\"count\":%u,\"ms\":%.1f}",
+		results->is_first_phase ? "" : ",", name, count, (double) nanos / 1000000.0);
+	results->is_first_phase = DEEN_FALSE;
+}
+
+
+int main(int argc, char** argv) {
+	char root_dir_template[] = "/tmp/deen-install-bench.XXXXXX";
+	deen_bench_results results = { NULL, DEEN_TRUE };
+	const char *ding_path = NULL;
+	const char *generate_path = NULL;
+	const char *json_path = NULL;
+	uint32_t scale = 1;
+	char *root_dir;
+	char *generated_path;
+	char *data_path;
+	char *index_path;
+	char *mapindex_path;
+	uint64_t ding_bytes;
+	uint64_t ding_lines;
+	uint64_t start_nanos;
+	double seconds;
+	int a;
+
+	for (a = 1; a < argc; a++) {
+		if (0 == strcmp(argv[a], "-s") && a < argc - 1) {
+			scale = (uint32_t) atoi(argv[++a]);
+		}
+		else if (0 == strcmp(argv[a], "-g") && a < argc - 1) {
+			generate_path = argv[++a];
+		}
+		else if (0 == strcmp(argv[a], "-o") && a < argc - 1) {
+			json_path = argv[++a];
+		}
+		else if ('-' != argv[a][0] && a == argc - 1) {
+			ding_path = argv[a];
+		}
+		else {
+			deen_bench_syntax(argv[0]);
+		}
+	}
+
+	if (0 == scale || scale > DEEN_BENCH_SCALE_MAX) {
+		deen_bench_syntax(argv[0]);
+	}
+
+	if (NULL != generate_path) {
+		if (NULL != ding_path || NULL != json_path) {
+			deen_bench_syntax(argv[0]);
+		}
+
+		deen_bench_generate(generate_path, scale);
+		return EXIT_SUCCESS;
+	}
+
+	// the spans of the install are needed for the phases; if the user has
+	// not asked for a trace file then the trace is discarded.
+
+	if (NULL == getenv("DEENTRACEFILE")) {
+		setenv("DEENTRACEFILE", "/dev/null", 1);
+	}
+
+	if (!deen_tracing_is_enabled()) {
+		deen_log_error_and_exit("tracing is required to measure the phases of the install");
+	}
+
+	// the install logs to the standard output and so, where the results are
+	// to be written to the standard output, the logs are moved to the
+	// standard error so that the standard output is only the JSON.
+
+	if (NULL == json_path) {
+		int results_fd;
+
+		fflush(stdout);
+
+		if (-1 == (results_fd = dup(STDOUT_FILENO))
+			|| -1 == dup2(STDERR_FILENO, STDOUT_FILENO)
+			|| NULL == (results.out = fdopen(results_fd, "w"))) {
+			deen_log_error_and_exit("unable to separate the results from the logs");
+		}
+	}
+
+	if (NULL == mkdtemp(root_dir_template)) {
+		deen_log_error_and_exit("unable to create a temporary root directory");
+	}
+
+	root_dir = root_dir_template;
+	generated_path = deen_bench_path_in_root_dir(root_dir, DEEN_BENCH_LEAF_GENERATED);
+	data_path = deen_data_path(root_dir);
+	index_path = deen_index_path(root_dir);
+	mapindex_path = deen_mapindex_path(root_dir);
+
+	if (NULL == ding_path) {
+		DEEN_LOG_INFO2("generating synthetic data at scale %u; %s", scale, generated_path);
+		deen_bench_generate(generated_path, scale);
+		ding_path = generated_path;
+	}
+
+	if (DEEN_INSTALL_CHECK_OK != deen_install_check_for_ding_format(ding_path)) {
+		deen_log_error_and_exit("the data does not look like ding data [%s]", ding_path);
+	}
+
+	ding_bytes = deen_bench_file_size(ding_path);
+	ding_lines = deen_bench_count_lines(ding_path);
+
+	start_nanos = deen_bench_nanos();
+
+	if (!deen_install_from_path(root_dir, ding_path, NULL, NULL, NULL)) {
+		deen_log_error_and_exit("unable to install the data [%s]", ding_path);
+	}
+
+	seconds = (double) (deen_bench_nanos() - start_nanos) / 1000000000.0;
+
+	if (NULL != json_path && NULL == (results.out = fopen(json_path, "w"))) {
+		deen_log_error_and_exit("unable to open the file for the results [%s]", json_path);
+	}
+
+	fprintf(results.out, "{\n  \"version\":\"%s\",\n  \"scale\":%u,\n  \"is_generated\":%s,\n",
+		DEEN_VERSION, scale, (ding_path == generated_path) ? "true" : "false");
+	fprintf(results.out, "  \"bytes\":%llu,\n  \"lines\":%llu,\n  \"seconds\":%.3f,\n",
+		(unsigned long long) ding_bytes, (unsigned long long) ding_lines, seconds);
+	fprintf(results.out, "  \"mb_per_second\":%.2f,\n  \"lines_per_second\":%.1f,\n",
+		((double) ding_bytes / 1000000.0) / seconds, (double) ding_lines / seconds);
+	fprintf(results.out, "  \"index_bytes\":%llu,\n  \"mapindex_bytes\":%llu,\n  \"phases\":[",
+		(unsigned long long) deen_bench_file_size(index_path),
+		(unsigned long long) deen_bench_file_size(mapindex_path));
+	deen_tracing_span_totals(&deen_bench_write_phase, &results);
+	fprintf(results.out, "\n  ]\n}\n");
+
+	if (0 != fclose(results.out)) {
+		deen_log_error_and_exit("unable to write the results [%s]", (NULL == json_path) ? "stdout" : json_path);
+	}
+
+	remove(generated_path);
+	remove(data_path);
+	remove(index_path);
+	remove(mapindex_path);
+	rmdir(root_dir);
+
+	free((void *) generated_path);
+	free((void *) data_path);
+	free((void *) index_path);
+	free((void *) mapindex_path);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,367 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+/*
+This program replays a file of search expressions against the installed data
+and reports the latency of the searches as JSON so that the results of
+different builds can be compared.  In the warm mode, one search context is
+used for all of the searches and the searches are run once before they are
+timed.  In the cold mode, the data and index files are dropped from the page
+cache before each search and each search opens its own search context.
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "core/common.h"
+#include "core/constants.h"
+#include "core/install.h"
+#include "core/keyword.h"
+#include "core/search.h"
+#include "core/types.h"
+
+#define DEEN_BENCH_ROUNDS_DEFAULT 5
+#define DEEN_BENCH_LINE_SIZE 1024
+
+typedef struct deen_bench_queries deen_bench_queries;
+struct deen_bench_queries {
+	uint8_t **expressions;
+	size_t count;
+	size_t count_allocated;
+};
+
+
+typedef struct deen_bench_latencies deen_bench_latencies;
+struct deen_bench_latencies {
+	uint64_t *nanos;
+	size_t count;
+	uint64_t total_nanos;
+};
+
+
+static uint64_t deen_bench_nanos() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+
+static void deen_bench_syntax(char *binary_name) {
+	printf("%s [-c <result-count>] [-r <rounds>] [-m warm|cold|both] <queries-file>\n", binary_name);
+	exit(1);
+}
+
+
+/*
+Reads the search expressions from the file; one on each line.  Empty lines
+and lines starting with '#' are ignored.
+*/
+
+static void deen_bench_read_queries(deen_bench_queries *queries, const char *path) {
+	char line[DEEN_BENCH_LINE_SIZE];
+	FILE *in = fopen(path, "r");
+
+	if (NULL == in) {
+		deen_log_error_and_exit("unable to open the queries file [%s]", path);
+	}
+
+	while (NULL != fgets(line, DEEN_BENCH_LINE_SIZE, in)) {
+		size_t len = strlen(line);
+
+		while (len > 0 && ('\n' == line[len - 1] || '\r' == line[len - 1])) {
+			len--;
+		}
+
+		line[len] = 0;
+
+		if (0 != len && '#' != line[0]) {
+			if (queries->count == queries->count_allocated) {
+				queries->count_allocated = (0 == queries->count_allocated) ? 64 : queries->count_allocated * 2;
+				queries->expressions = (uint8_t **) deen_erealloc(
+					queries->expressions, sizeof(uint8_t *) * queries->count_allocated);
+			}
+
+			queries->expressions[queries->count] = (uint8_t *) deen_emalloc(len + 1);
+			memcpy(queries->expressions[queries->count], line, len + 1);
+			queries->count++;
+		}
+	}
+
+	fclose(in);
+
+	if (0 == queries->count) {
+		deen_log_error_and_exit("no search expressions were found in [%s]", path);
+	}
+}
+
+
+/*
+Asks the operating system to drop the file from the page cache.  This only
+works for pages that are not dirty and not mapped by a process.
+*/
+
+static void deen_bench_drop_from_cache(const char *path) {
+	int fd = open(path, O_RDONLY);
+
+	if (-1 != fd) {
+#ifndef __MINGW32__
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+		close(fd);
+	}
+}
+
+
+static void deen_bench_drop_all_from_cache(char *root_dir) {
+	char *data_path = deen_data_path(root_dir);
+	char *index_path = deen_index_path(root_dir);
+	char *mapindex_path = deen_mapindex_path(root_dir);
+
+	deen_bench_drop_from_cache(data_path);
+	deen_bench_drop_from_cache(index_path);
+	deen_bench_drop_from_cache(mapindex_path);
+
+	free((void *) data_path);
+	free((void *) index_path);
+	free((void *) mapindex_path);
+}
+
+
+/*
+Performs the search in the same way as the command line tool does and
+discards the result.
+*/
+
+static void deen_bench_search(
+	deen_search_context *context,
+	const uint8_t *search_expression,
+	size_t result_count) {
+
+	deen_search_result *result;
+	deen_keywords *keywords = deen_keywords_create();
+	size_t len = strlen((char *) search_expression);
+	uint8_t *search_expression_upper = (uint8_t *) deen_emalloc(len + 1);
+
+	memcpy(search_expression_upper, search_expression, len + 1);
+	deen_to_upper(search_expression_upper);
+	deen_keywords_add_from_string(keywords, search_expression_upper);
+
+	result = deen_search(context, keywords, result_count);
+
+	if (NULL == result) {
+		deen_log_error_and_exit("unable to search for [%s]", search_expression);
+	}
+
+	deen_search_result_free(result);
+	deen_keywords_free(keywords);
+	free((void *) search_expression_upper);
+}
+
+
+static deen_search_context *deen_bench_search_init(char *root_dir) {
+	deen_search_context *context = deen_search_init(root_dir);
+
+	if (NULL == context) {
+		deen_log_error_and_exit("unable to create a search context");
+	}
+
+	return context;
+}
+
+
+static void deen_bench_latencies_add(deen_bench_latencies *latencies, uint64_t nanos) {
+	latencies->nanos[latencies->count++] = nanos;
+	latencies->total_nanos += nanos;
+}
+
+
+static void deen_bench_run_warm(
+	char *root_dir,
+	deen_bench_queries *queries,
+	size_t result_count,
+	uint32_t rounds,
+	deen_bench_latencies *latencies) {
+
+	deen_search_context *context = deen_bench_search_init(root_dir);
+	uint32_t r;
+	size_t i;
+
+	for (i = 0; i < queries->count; i++) {
+		deen_bench_search(context, queries->expressions[i], result_count);
+	}
+
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < queries->count; i++) {
+			uint64_t start = deen_bench_nanos();
+			deen_bench_search(context, queries->expressions[i], result_count);
+			deen_bench_latencies_add(latencies, deen_bench_nanos() - start);
+		}
+	}
+
+	deen_search_free(context);
+}
+
+
+/*
+The time for a cold search includes opening and closing the search context
+because a context that is open keeps the binary index mapped.
+*/
+
+static void deen_bench_run_cold(
+	char *root_dir,
+	deen_bench_queries *queries,
+	size_t result_count,
+	uint32_t rounds,
+	deen_bench_latencies *latencies) {
+
+	uint32_t r;
+	size_t i;
+
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < queries->count; i++) {
+			deen_search_context *context;
+			uint64_t start;
+
+			deen_bench_drop_all_from_cache(root_dir);
+
+			start = deen_bench_nanos();
+			context = deen_bench_search_init(root_dir);
+			deen_bench_search(context, queries->expressions[i], result_count);
+			deen_search_free(context);
+			deen_bench_latencies_add(latencies, deen_bench_nanos() - start);
+		}
+	}
+}
+
+
+static int deen_bench_compare_nanos(const void *a, const void *b) {
+	uint64_t na = *((const uint64_t *) a);
+	uint64_t nb = *((const uint64_t *) b);
+	return (na > nb) - (na < nb);
+}
+
+
+// the latencies must be sorted; uses the nearest-rank method.
+
+static double deen_bench_percentile_micros(deen_bench_latencies *latencies, uint32_t percentile) {
+	size_t rank = ((latencies->count * percentile) + 99) / 100;
+
+	if (0 == rank) {
+		rank = 1;
+	}
+
+	return (double) latencies->nanos[rank - 1] / 1000.0;
+}
+
+
+static void deen_bench_write_mode(
+	FILE *out,
+	const char *mode,
+	deen_bench_latencies *latencies,
+	deen_bool is_first) {
+
+	qsort(latencies->nanos, latencies->count, sizeof(uint64_t), &deen_bench_compare_nanos);
+
+	fprintf(out, "%s\n    {\"mode\":\"%s\",\"searches\":%lu", is_first ? "" : ",", mode, (unsigned long) latencies->count);
+	fprintf(out, ",\"p50_us\":%.1f", deen_bench_percentile_micros(latencies, 50));
+	fprintf(out, ",\"p90_us\":%.1f", deen_bench_percentile_micros(latencies, 90));
+	fprintf(out, ",\"p99_us\":%.1f", deen_bench_percentile_micros(latencies, 99));
+	fprintf(out, ",\"max_us\":%.1f", (double) latencies->nanos[latencies->count - 1] / 1000.0);
+	fprintf(out, ",\"mean_us\":%.1f", ((double) latencies->total_nanos / (double) latencies->count) / 1000.0);
+	fprintf(out, ",\"searches_per_second\":%.1f}",
+		(0 == latencies->total_nanos) ? 0.0 : ((double) latencies->count * 1000000000.0) / (double) latencies->total_nanos);
+}
+
+
+int main(int argc, char** argv) {
+	deen_bench_queries queries = { NULL, 0, 0 };
+	deen_bench_latencies latencies;
+	const char *queries_path = NULL;
+	const char *mode = "both";
+	size_t result_count = DEEN_RESULT_SIZE_DEFAULT;
+	uint32_t rounds = DEEN_BENCH_ROUNDS_DEFAULT;
+	deen_bool is_first = DEEN_TRUE;
+	char *root_dir;
+	size_t i;
+	int a;
+
+	for (a = 1; a < argc; a++) {
+		if (0 == strcmp(argv[a], "-c") && a < argc - 1) {
+			result_count = (size_t) atoi(argv[++a]);
+		}
+		else if (0 == strcmp(argv[a], "-r") && a < argc - 1) {
+			rounds = (uint32_t) atoi(argv[++a]);
+		}
+		else if (0 == strcmp(argv[a], "-m") && a < argc - 1) {
+			mode = argv[++a];
+		}
+		else if ('-' != argv[a][0] && a == argc - 1) {
+			queries_path = argv[a];
+		}
+		else {
+			deen_bench_syntax(argv[0]);
+		}
+	}
+
+	if (NULL == queries_path || 0 == result_count || 0 == rounds) {
+		deen_bench_syntax(argv[0]);
+	}
+
+	if (0 != strcmp(mode, "warm") && 0 != strcmp(mode, "cold") && 0 != strcmp(mode, "both")) {
+		deen_bench_syntax(argv[0]);
+	}
+
+#ifdef __MINGW32__
+	if (0 != strcmp(mode, "warm")) {
+		deen_log_error_and_exit("only the warm mode is available on windows");
+	}
+#endif
+
+	root_dir = deen_root_dir();
+
+	if (!deen_is_installed(root_dir)) {
+		deen_log_error_and_exit("the data is not installed in [%s]", root_dir);
+	}
+
+	deen_bench_read_queries(&queries, queries_path);
+	latencies.nanos = (uint64_t *) deen_emalloc(sizeof(uint64_t) * queries.count * rounds);
+
+	printf("{\n  \"version\":\"%s\",\n  \"queries\":%lu,\n  \"rounds\":%u,\n  \"result_count\":%lu,\n  \"modes\":[",
+		DEEN_VERSION, (unsigned long) queries.count, rounds, (unsigned long) result_count);
+
+	if (0 != strcmp(mode, "cold")) {
+		latencies.count = 0;
+		latencies.total_nanos = 0;
+		deen_bench_run_warm(root_dir, &queries, result_count, rounds, &latencies);
+		deen_bench_write_mode(stdout, "warm", &latencies, is_first);
+		is_first = DEEN_FALSE;
+	}
+
+	if (0 != strcmp(mode, "warm")) {
+		latencies.count = 0;
+		latencies.total_nanos = 0;
+		deen_bench_run_cold(root_dir, &queries, result_count, rounds, &latencies);
+		deen_bench_write_mode(stdout, "cold", &latencies, is_first);
+	}
+
+	printf("\n  ]\n}\n");
+
+	for (i = 0; i < queries.count; i++) {
+		free((void *) queries.expressions[i]);
+	}
+
+	free((void *) queries.expressions);
+	free((void *) latencies.nanos);
+	free((void *) root_dir);
+
+	return EXIT_SUCCESS;
+}
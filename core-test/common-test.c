@@ -13,6 +13,7 @@
 #include <unistd.h>
 
 #include "core/common.h"
+#include "core/constants.h"
 #include "core/types.h"
 
 static void test_utf8_usascii_equivalent() {
@@ -253,6 +254,63 @@ static void test_for_each_word_from_file() {
 }
 
 
+/*
+This test processes the same input file as above, but does so in two ranges
+that are split at the start of a line.  The words from both ranges together
+should be the same as from processing the whole file.
+*/
+
+static void test_for_each_word_from_file_range() {
+	int fd = open("core-test/input_for_each_word_from_file_a.txt", O_RDONLY);
+	FILE *reference_file;
+	off_t file_len;
+	off_t split = 0;
+	uint8_t c;
+
+	if (-1 == fd) {
+		deen_log_error_and_exit("failed test 'test_for_each_word_from_file_range' -- unable to open test data");
+	}
+
+	reference_file = fopen("core-test/output_for_each_word_from_file_a.txt", "r");
+
+	if (NULL == reference_file) {
+		deen_log_error_and_exit("failed test 'test_for_each_word_from_file_range' -- unable to open reference data");
+	}
+
+	file_len = lseek(fd, 0, SEEK_END);
+	lseek(fd, file_len / 2, SEEK_SET);
+
+	while (0 == split && 1 == read(fd, &c, 1)) {
+		if ('\n' == c) {
+			split = lseek(fd, 0, SEEK_CUR);
+		}
+	}
+
+	if (0 == split) {
+		deen_log_error_and_exit("failed test 'test_for_each_word_from_file_range' -- unable to find a line to split at");
+	}
+
+	deen_for_each_word_from_file_range(
+		16, fd, 0, split,
+		&test_for_each_word_from_file_check_callback,
+		(void *) reference_file);
+
+	deen_for_each_word_from_file_range(
+		16, fd, split, file_len,
+		&test_for_each_word_from_file_check_callback,
+		(void *) reference_file);
+
+	if (!feof(reference_file) && EOF != fgetc(reference_file)) {
+		deen_log_error_and_exit("failed test 'test_for_each_word_from_file_range' -- not all words were found");
+	}
+
+	close(fd);
+	fclose(reference_file);
+
+	DEEN_LOG_INFO0("passed test 'test_for_each_word_from_file_range'");
+}
+
+
 // ---------------------------------------------------------------
 // FOR EACH WORD FROM MEMORY
 // ---------------------------------------------------------------
@@ -334,6 +392,51 @@ static void test_to_upper() {
 }
 
 
+/*
+Text longer than a block of vectors, with umlauts straddling the edges of the
+blocks, should come out the same at each of the SIMD levels.
+*/
+
+static void test_to_upper__simd_levels() {
+	const char *sample = "der apfel f\xc3\xa4llt nicht weit vom stamm; "
+		"das ist mir wurst\xc3\xbc und k\xc3\xa4se-br\xc3\xb6tchen {ist} lecker";
+	const char *expected = "DER APFEL F\xc3\x84LLT NICHT WEIT VOM STAMM; "
+		"DAS IST MIR WURST\xc3\x9c UND K\xc3\x84SE-BR\xc3\x96TCHEN {IST} LECKER";
+	deen_simd_level supported = deen_get_simd_level();
+	int level;
+	size_t offset;
+	char buffer[256];
+
+	for (level = DEEN_SIMD_SCALAR; level <= DEEN_SIMD_AVX2; level++) {
+		deen_set_simd_level((deen_simd_level) level);
+
+		// shift the text to move the umlauts across the edges of the blocks.
+
+		for (offset = 0; offset < 32; offset++) {
+			memset(buffer, 'x', offset);
+			strcpy(&buffer[offset], sample);
+
+			// - - - - - - - - - -
+			deen_to_upper((uint8_t *) &buffer[offset]);
+			// - - - - - - - - - -
+
+			if (0 != strcmp(&buffer[offset], expected)) {
+				deen_log_error_and_exit("failed test 'test_to_upper__simd_levels' -- level %d offset %zu", level, offset);
+			}
+
+			if (DEEN_NOT_FOUND == deen_ifind_first(
+				(const uint8_t *) sample, (const uint8_t *) "BR\xc3\x96TCHEN", offset, strlen(sample))) {
+				deen_log_error_and_exit("failed test 'test_to_upper__simd_levels' -- not found at level %d", level);
+			}
+		}
+	}
+
+	deen_set_simd_level(supported);
+
+	DEEN_LOG_INFO0("passed test 'test_to_upper__simd_levels'");
+}
+
+
 static void test_imatches_at__positive() {
 	uint8_t *sample = (uint8_t *) "pL\xc3\xb6tzLich";
 	uint8_t *part = (uint8_t *) "L\xc3\xb6t";
@@ -431,8 +534,10 @@ int main(int argc, char** argv) {
 	test_utf8_sequence_len__accented();
 	test_utf8_sequence_len__non_accented();
 	test_for_each_word_from_file();
+	test_for_each_word_from_file_range();
 	test_for_each_word();
 	test_to_upper();
+	test_to_upper__simd_levels();
 	test_imatches_at__positive();
 	test_imatches_at__negative();
 	test_ifind_first__positive();
@@ -14,10 +14,47 @@
 #include "core/keyword.h"
 
 
-static deen_entry deen_create_example_1() {
+#define EXAMPLE_1_GERMAN "W\xc3\xbcsst {m} [zool.] | Regensburg [geol.]; Donnau {f} {pl} [geol.]"
+#define EXAMPLE_1_ENGLISH "Chop [sport]; Peanutbutter Sauce | Toe [Br.]"
+
+
+static deen_entry deen_create_example_1(deen_entry_arena *arena) {
 	return deen_entry_create(
-		(const uint8_t *) "W\xc3\xbcsst {m} [zool.] | Regensburg [geol.]; Donnau {f} {pl} [geol.]",
-		(const uint8_t *) "Chop [sport]; Peanutbutter Sauce | Toe [Br.]");
+		arena,
+		(const uint8_t *) EXAMPLE_1_GERMAN,
+		(const uint8_t *) EXAMPLE_1_ENGLISH);
+}
+
+
+/*
+These find the parts of an entry in the arena.  The english subs of an entry
+follow its german subs.
+*/
+
+static deen_entry_sub *deen_sub(deen_entry_arena *arena, deen_entry *entry, uint32_t i) {
+	return &(arena->subs[entry->subs_offset + i]);
+}
+
+static deen_entry_sub_sub *deen_sub_sub(deen_entry_arena *arena, deen_entry_sub *sub, uint32_t i) {
+	return &(arena->sub_subs[sub->sub_subs_offset + i]);
+}
+
+/*
+The atom is a slice of the arena's text so it is compared with the expected
+text over its length.
+*/
+
+static deen_bool deen_atom_equals(
+	deen_entry_arena *arena,
+	deen_entry_sub_sub *sub_sub,
+	uint32_t i,
+	enum deen_entry_atom_type type,
+	const char *text) {
+	deen_entry_atom *atom = &(arena->atoms[sub_sub->atoms_offset + i]);
+	return i < sub_sub->atom_count
+		&& type == atom->type
+		&& strlen(text) == atom->len
+		&& 0 == memcmp(&(arena->text[atom->offset]), text, atom->len);
 }
 
 /*
@@ -26,12 +63,17 @@ static deen_entry deen_create_example_1() {
  */
 
 static void test_create() {
+	deen_entry_arena arena;
+	deen_entry entry;
+	deen_entry_sub_sub *sub_sub;
+	deen_bool result = DEEN_TRUE;
+
+	deen_entry_arena_init(&arena);
+
 	// - - - - - - - - - -
-	deen_entry entry = deen_create_example_1();
+	entry = deen_create_example_1(&arena);
 	// - - - - - - - - - -
 
-	deen_bool result = DEEN_TRUE;
-
 	if (2 != entry.english_sub_count) {
 		result = DEEN_FALSE;
 		DEEN_LOG_ERROR0("wrong number of sub count for english entry");
@@ -42,44 +84,39 @@ static void test_create() {
 		DEEN_LOG_ERROR0("wrong number of sub count for german entry");
 	}
 
-	if (2 != entry.german_subs[1].sub_sub_count) {
+	if (2 != deen_sub(&arena, &entry, 1)->sub_sub_count) {
 		result = DEEN_FALSE;
 		DEEN_LOG_ERROR0("wrong number of sub sub count for german entry 1");
 	}
 
-	if (2 != entry.german_subs[1].sub_sub_count) {
-		result = DEEN_FALSE;
-		DEEN_LOG_ERROR0("wrong number of sub sub count for german entry 1");
-	}
+	sub_sub = deen_sub_sub(&arena, deen_sub(&arena, &entry, 1), 1);
 
-	if (4 != entry.german_subs[1].sub_subs[1].atom_count) {
+	if (4 != sub_sub->atom_count) {
 		result = DEEN_FALSE;
 		DEEN_LOG_ERROR0("wrong number of sub sub atom count for german entry 1, sub sub 1");
 	}
 
-	deen_entry_atom *atoms = entry.german_subs[1].sub_subs[1].atoms;
-
-	if (ATOM_TEXT != atoms[0].type || 0 != strcmp((char *) atoms[0].text, "Donnau")) {
+	if (!deen_atom_equals(&arena, sub_sub, 0, ATOM_TEXT, "Donnau")) {
 		result = DEEN_FALSE;
 		DEEN_LOG_ERROR0("bad atom 0");
 	}
 
-	if (ATOM_GRAMMAR != atoms[1].type || 0 != strcmp((char *) atoms[1].text, "f")) {
+	if (!deen_atom_equals(&arena, sub_sub, 1, ATOM_GRAMMAR, "f")) {
 		result = DEEN_FALSE;
 		DEEN_LOG_ERROR0("bad atom 1");
 	}
 
-	if (ATOM_GRAMMAR != atoms[2].type || 0 != strcmp((char *) atoms[2].text, "pl")) {
+	if (!deen_atom_equals(&arena, sub_sub, 2, ATOM_GRAMMAR, "pl")) {
 		result = DEEN_FALSE;
 		DEEN_LOG_ERROR0("bad atom 2");
 	}
 
-	if (ATOM_CONTEXT != atoms[3].type || 0 != strcmp((char *) atoms[3].text, "geol.")) {
+	if (!deen_atom_equals(&arena, sub_sub, 3, ATOM_CONTEXT, "geol.")) {
 		result = DEEN_FALSE;
 		DEEN_LOG_ERROR0("bad atom 3");
 	}
 
-	deen_entry_free(&entry);
+	deen_entry_arena_free(&arena);
 
 	if(DEEN_TRUE != result) {
 		deen_log_error_and_exit("failed test 'test_create' -- bad parse");
@@ -88,6 +125,65 @@ static void test_create() {
 	DEEN_LOG_INFO0("passed test 'test_create'");
 }
 
+/*
+ The text is split up in some ways that are not obvious; a word of fewer than
+ three characters is made up of single character atoms, a ';' within text
+ does not start a new sub sub unless it follows grammar or context, the
+ spaces before a closing bracket are part of the grammar or context and a
+ missing closing bracket runs to the end.  The entry is added to an arena
+ that already has an entry in it.
+ */
+
+static void test_create__edge_cases() {
+	deen_entry_arena arena;
+	deen_entry entry;
+	deen_entry_sub_sub *german_0;
+	deen_entry_sub_sub *german_1;
+	deen_entry_sub *english;
+
+	deen_entry_arena_init(&arena);
+	deen_create_example_1(&arena);
+
+	// - - - - - - - - - -
+	entry = deen_entry_create(
+		&arena,
+		(const uint8_t *) "zu {prp }|Haus; Heim",
+		(const uint8_t *) "at {adv}; home [geol.");
+	// - - - - - - - - - -
+
+	german_0 = deen_sub_sub(&arena, deen_sub(&arena, &entry, 0), 0);
+	german_1 = deen_sub_sub(&arena, deen_sub(&arena, &entry, 1), 0);
+	english = deen_sub(&arena, &entry, entry.german_sub_count);
+
+	if (2 != entry.german_sub_count
+		|| 1 != deen_sub(&arena, &entry, 0)->sub_sub_count
+		|| 3 != german_0->atom_count
+		|| !deen_atom_equals(&arena, german_0, 0, ATOM_TEXT, "z")
+		|| !deen_atom_equals(&arena, german_0, 1, ATOM_TEXT, "u")
+		|| !deen_atom_equals(&arena, german_0, 2, ATOM_GRAMMAR, "prp ")) {
+		deen_log_error_and_exit("failed test 'test_create__edge_cases' -- bad german sub 0");
+	}
+
+	if (1 != deen_sub(&arena, &entry, 1)->sub_sub_count
+		|| 1 != german_1->atom_count
+		|| !deen_atom_equals(&arena, german_1, 0, ATOM_TEXT, "Haus; Heim")) {
+		deen_log_error_and_exit("failed test 'test_create__edge_cases' -- bad german sub 1");
+	}
+
+	if (1 != entry.english_sub_count
+		|| 2 != english->sub_sub_count
+		|| 3 != deen_sub_sub(&arena, english, 0)->atom_count
+		|| 2 != deen_sub_sub(&arena, english, 1)->atom_count
+		|| !deen_atom_equals(&arena, deen_sub_sub(&arena, english, 1), 0, ATOM_TEXT, "home")
+		|| !deen_atom_equals(&arena, deen_sub_sub(&arena, english, 1), 1, ATOM_CONTEXT, "geol.")) {
+		deen_log_error_and_exit("failed test 'test_create__edge_cases' -- bad english");
+	}
+
+	deen_entry_arena_free(&arena);
+
+	DEEN_LOG_INFO0("passed test 'test_create__edge_cases'");
+}
+
 /*
  The expected found bitmap is a 32bit number each bit of which indicates
  if the keyword should have been found or not.
@@ -100,18 +196,25 @@ static void test_entry_calculate_distance_from_keywords__generic(
 ) {
 	deen_keywords *keywords = deen_keywords_create();
 	deen_keywords_add_from_string(keywords, (uint8_t *) keywords_str);
-	deen_entry entry = deen_create_example_1();
-	deen_bool *keyword_use_map = (deen_bool *) deen_emalloc(
-		sizeof(deen_bool) * keywords->count);
+	deen_entry_arena arena;
+	deen_entry_arena_init(&arena);
+	deen_entry entry = deen_create_example_1(&arena);
+	deen_keywords_matcher *matcher = deen_keywords_matcher_create(keywords);
+
+	uint32_t german_sub_count;
 
 	// - - - - - - - - - -
 	uint32_t actual_distance = deen_entry_calculate_distance_from_keywords(
-		&entry, keywords, keyword_use_map);
+		&arena, &entry, matcher);
+	uint32_t actual_distance_n = deen_entry_calculate_distance_from_keywords_n(
+		(const uint8_t *) EXAMPLE_1_GERMAN, strlen(EXAMPLE_1_GERMAN),
+		(const uint8_t *) EXAMPLE_1_ENGLISH, strlen(EXAMPLE_1_ENGLISH),
+		matcher, &german_sub_count);
 	// - - - - - - - - - -
 
 
+	deen_keywords_matcher_free(matcher);
 	deen_keywords_free(keywords);
-	free(keyword_use_map);
 
 	if (expected_distance != actual_distance) {
 		deen_log_error_and_exit(
@@ -119,6 +222,20 @@ static void test_entry_calculate_distance_from_keywords__generic(
 			test_name, expected_distance, actual_distance);
 	}
 
+	if (expected_distance != actual_distance_n) {
+		deen_log_error_and_exit(
+			"failed test '%s' -- expected %d from the raw text, was %d",
+			test_name, expected_distance, actual_distance_n);
+	}
+
+	if (entry.german_sub_count != german_sub_count) {
+		deen_log_error_and_exit(
+			"failed test '%s' -- expected %d german subs from the raw text, was %d",
+			test_name, entry.german_sub_count, german_sub_count);
+	}
+
+	deen_entry_arena_free(&arena);
+
 	DEEN_LOG_INFO1("passed test '%s'", test_name);
 }
 
@@ -146,11 +263,24 @@ static void test_entry_calculate_distance_from_keywords__two_keywords() {
 		(uint8_t *) "PEANUT SAU", 6 + 2);
 }
 
+/*
+The two keywords are spellings of the same word and so the second has no
+spellings of its own; the distance is as if there was only the one keyword.
+*/
+
+static void test_entry_calculate_distance_from_keywords__two_spellings() {
+	test_entry_calculate_distance_from_keywords__generic(
+		"test_entry_calculate_distance_from_keywords__two_spellings",
+		(uint8_t *) "WUESST W\xc3\x9cSST", 0);
+}
+
 int main(int argc, char** argv) {
 	test_create();
+	test_create__edge_cases();
 	test_entry_calculate_distance_from_keywords__ok();
 	test_entry_calculate_distance_from_keywords__full_match();
 	test_entry_calculate_distance_from_keywords__not_found();
 	test_entry_calculate_distance_from_keywords__two_keywords();
+	test_entry_calculate_distance_from_keywords__two_spellings();
 	return 0;
 }
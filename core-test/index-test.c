@@ -17,10 +17,13 @@ results come out.
 #include <sqlite3.h>
 
 #include "core/index.h"
+#include "core/mapindex.h"
+#include "core/postings.h"
 #include "core/common.h"
 #include "core/types.h"
 
 #define OUTPUT_DATABASE_FILE "tmp_index_e2e.sqlite"
+#define OUTPUT_MAPINDEX_FILE "tmp_index_e2e.map"
 
 static void test_index_e2e_setup(sqlite3 *db) {
 	DEEN_LOG_TRACE0("will init database...");
@@ -64,9 +67,61 @@ static void test_index_e2e_setup(sqlite3 *db) {
 	deen_index_add_context_free(add_context);
 }
 
-static deen_bool test_index_e2e_find_ref(deen_index_lookup_result *result, off_t expected) {
-	for(int i = 0; i < result->refs_count; i++) {
-		if(result->refs[i] == expected) {
+/*
+Loads the same data as 'test_index_e2e_setup', but into an in-memory bulk
+index.
+*/
+
+static deen_index_bulk_context *test_index_bulk_create() {
+	deen_index_bulk_context *bulk_context = deen_index_bulk_context_create();
+
+	{
+		uint8_t *prefixes[3] = {
+			(uint8_t *) "ERT",
+			(uint8_t *) "RAT",
+			(uint8_t *) "DAT"
+		};
+
+		deen_index_bulk_add(bulk_context, 123, prefixes, 3);
+	}
+
+	{
+		uint8_t *prefixes[3] = {
+			(uint8_t *) "ZEE",
+			(uint8_t *) "RAT",
+			(uint8_t *) "PIN"
+		};
+
+		deen_index_bulk_add(bulk_context, 456, prefixes, 3);
+	}
+
+	{
+		uint8_t *prefixes[3] = {
+			(uint8_t *) "PIG",
+			(uint8_t *) "ZIG",
+			(uint8_t *) "DIG"
+		};
+
+		deen_index_bulk_add(bulk_context, 789, prefixes, 3);
+	}
+
+	return bulk_context;
+}
+
+static void test_index_bulk_e2e_setup(sqlite3 *db) {
+	deen_index_init(db);
+
+	deen_index_bulk_context *bulk_context = test_index_bulk_create();
+
+	deen_index_bulk_write(bulk_context, db);
+	deen_index_bulk_context_free(bulk_context);
+}
+
+static deen_bool test_index_e2e_find_ref(deen_postings_cursor *cursor, off_t expected) {
+	off_t ref;
+
+	while (deen_postings_cursor_next(cursor, &ref)) {
+		if(ref == expected) {
 			return DEEN_TRUE;
 		}
 	}
@@ -77,25 +132,37 @@ static deen_bool test_index_e2e_find_ref(deen_index_lookup_result *result, off_t
 static deen_bool test_index_e2e_lookup(sqlite3 *db) {
 
 	DEEN_LOG_TRACE0("perform lookup...");
-	deen_index_lookup_result *lookup_result = deen_index_lookup(db, (uint8_t *) "RAT");
+	deen_index_lookup_context *lookup_context = deen_index_lookup_context_create(db);
 	deen_bool result = DEEN_TRUE;
+	int i;
 
-	if (2 != lookup_result->refs_count) {
-		DEEN_LOG_ERROR0("not able to find the expected references");
-	}
+	// the second time around, the statement is re-used.
 
-	if (DEEN_TRUE != test_index_e2e_find_ref(lookup_result, 123)) {
-		DEEN_LOG_ERROR0("not able to find the expected ref 123");
-		result = DEEN_FALSE;
-	}
+	for (i = 0; i < 2; i++) {
+		deen_postings_cursor *cursor = deen_index_lookup(lookup_context, (uint8_t *) "RAT");
+
+		if (2 != cursor->count) {
+			DEEN_LOG_ERROR0("not able to find the expected references");
+			result = DEEN_FALSE;
+		}
+
+		// the refs come in ascending order.
 
-	if (DEEN_TRUE != test_index_e2e_find_ref(lookup_result, 456)) {
-		DEEN_LOG_ERROR0("not able to find the expected ref 456");
-		result = DEEN_FALSE;
+		if (DEEN_TRUE != test_index_e2e_find_ref(cursor, 123)) {
+			DEEN_LOG_ERROR0("not able to find the expected ref 123");
+			result = DEEN_FALSE;
+		}
+
+		if (DEEN_TRUE != test_index_e2e_find_ref(cursor, 456)) {
+			DEEN_LOG_ERROR0("not able to find the expected ref 456");
+			result = DEEN_FALSE;
+		}
+
+		DEEN_LOG_TRACE0("free results...");
+		deen_postings_cursor_free(cursor);
 	}
 
-	DEEN_LOG_TRACE0("free results...");
-	deen_index_lookup_result_free(lookup_result);
+	deen_index_lookup_context_free(lookup_context);
 
 	return result;
 }
@@ -106,12 +173,14 @@ static deen_bool test_index_e2e_lookup(sqlite3 *db) {
  sure that it generates sensible, expected results.
  */
 
- static void test_index_e2e() {
+ static void test_index_e2e_generic(
+	const char *test_name,
+	void (*setup)(sqlite3 *db)) {
 
 	 sqlite3 *db = NULL;
 	deen_bool result = DEEN_TRUE;
 
-	 DEEN_LOG_TRACE0("running test 'test_index_e2e'");
+	 DEEN_LOG_TRACE1("running test '%s'", test_name);
 
 	 DEEN_LOG_TRACE0("will open database...");
 	 if (SQLITE_OK != sqlite3_open_v2(
@@ -123,7 +192,7 @@ static deen_bool test_index_e2e_lookup(sqlite3 *db) {
 	 }
 
 	 if (DEEN_TRUE == result) {
-		 test_index_e2e_setup(db);
+		 setup(db);
 	}
 
 	 result = result && test_index_e2e_lookup(db);
@@ -140,13 +209,167 @@ static deen_bool test_index_e2e_lookup(sqlite3 *db) {
  	}
 
 	if (DEEN_TRUE == result) {
-		DEEN_LOG_INFO0("passed test 'test_index_e2e'");
+		DEEN_LOG_INFO1("passed test '%s'", test_name);
 	} else {
-		deen_log_error_and_exit("failed test 'test_index_e2e'");
+		deen_log_error_and_exit("failed test '%s'", test_name);
 	}
 
  }
 
+ static void test_index_e2e() {
+	test_index_e2e_generic("test_index_e2e", &test_index_e2e_setup);
+ }
+
+ static void test_index_bulk_e2e() {
+	test_index_e2e_generic("test_index_bulk_e2e", &test_index_bulk_e2e_setup);
+ }
+
+/*
+Writes the in-memory index out as a binary index and then checks that lookups
+on the binary index produce the expected, ordered, results.
+*/
+
+static void test_mapindex_e2e() {
+	deen_index_bulk_context *bulk_context = test_index_bulk_create();
+	deen_mapindex *mapindex;
+	deen_postings_cursor *cursor;
+	off_t ref;
+
+	if (!deen_mapindex_write(bulk_context, OUTPUT_MAPINDEX_FILE)) {
+		deen_log_error_and_exit("failed test 'test_mapindex_e2e' -- unable to write the binary index");
+	}
+
+	deen_index_bulk_context_free(bulk_context);
+
+	mapindex = deen_mapindex_open(OUTPUT_MAPINDEX_FILE);
+
+	if (NULL == mapindex) {
+		deen_log_error_and_exit("failed test 'test_mapindex_e2e' -- unable to open the binary index");
+	}
+
+	cursor = deen_mapindex_lookup(mapindex, (uint8_t *) "RAT");
+
+	if (2 != cursor->count
+		|| !deen_postings_cursor_next(cursor, &ref) || 123 != ref
+		|| !deen_postings_cursor_next(cursor, &ref) || 456 != ref
+		|| deen_postings_cursor_next(cursor, &ref)) {
+		deen_log_error_and_exit("failed test 'test_mapindex_e2e' -- unexpected refs for 'RAT'");
+	}
+
+	deen_postings_cursor_free(cursor);
+
+	cursor = deen_mapindex_lookup(mapindex, (uint8_t *) "DIG");
+
+	if (1 != cursor->count || !deen_postings_cursor_next(cursor, &ref) || 789 != ref) {
+		deen_log_error_and_exit("failed test 'test_mapindex_e2e' -- unexpected refs for 'DIG'");
+	}
+
+	deen_postings_cursor_free(cursor);
+
+	cursor = deen_mapindex_lookup(mapindex, (uint8_t *) "RA");
+
+	if (0 != cursor->count || deen_postings_cursor_next(cursor, &ref)) {
+		deen_log_error_and_exit("failed test 'test_mapindex_e2e' -- unexpected refs for 'RA'");
+	}
+
+	deen_postings_cursor_free(cursor);
+	deen_mapindex_close(mapindex);
+
+	if (0 != remove(OUTPUT_MAPINDEX_FILE)) {
+		deen_log_error_and_exit("failed test 'test_mapindex_e2e' -- unable to delete the temporary binary index file");
+	}
+
+	DEEN_LOG_INFO0("passed test 'test_mapindex_e2e'");
+}
+
+/*
+Checks that a lookup of the terms yields the union of the refs of all of the
+terms that start with the supplied term.  A term that is repeated for a ref
+should still only yield the ref once.
+*/
+
+static void test_mapindex_terms() {
+	deen_index_bulk_context *bulk_context = test_index_bulk_create();
+	deen_mapindex *mapindex;
+	deen_postings_cursor *cursor;
+	off_t ref;
+
+	{
+		uint8_t *terms[3] = {
+			(uint8_t *) "RATTE",
+			(uint8_t *) "RATHAUS",
+			(uint8_t *) "RATTE"
+		};
+
+		deen_index_bulk_add_terms(bulk_context, 123, terms, 3);
+	}
+
+	{
+		uint8_t *terms[1] = {
+			(uint8_t *) "RATTEN"
+		};
+
+		deen_index_bulk_add_terms(bulk_context, 456, terms, 1);
+	}
+
+	{
+		uint8_t *terms[1] = {
+			(uint8_t *) "RATHAUS"
+		};
+
+		deen_index_bulk_add_terms(bulk_context, 789, terms, 1);
+	}
+
+	if (!deen_mapindex_write(bulk_context, OUTPUT_MAPINDEX_FILE)) {
+		deen_log_error_and_exit("failed test 'test_mapindex_terms' -- unable to write the binary index");
+	}
+
+	deen_index_bulk_context_free(bulk_context);
+
+	mapindex = deen_mapindex_open(OUTPUT_MAPINDEX_FILE);
+
+	if (NULL == mapindex || 3 != mapindex->term_count || 4 != mapindex->term_refs_count) {
+		deen_log_error_and_exit("failed test 'test_mapindex_terms' -- unable to open the binary index");
+	}
+
+	cursor = deen_mapindex_lookup_terms(mapindex, (uint8_t *) "RATT");
+
+	if (2 != cursor->count
+		|| !deen_postings_cursor_next(cursor, &ref) || 123 != ref
+		|| !deen_postings_cursor_next(cursor, &ref) || 456 != ref
+		|| deen_postings_cursor_next(cursor, &ref)) {
+		deen_log_error_and_exit("failed test 'test_mapindex_terms' -- unexpected refs for 'RATT'");
+	}
+
+	deen_postings_cursor_free(cursor);
+
+	cursor = deen_mapindex_lookup_terms(mapindex, (uint8_t *) "RATHAUS");
+
+	if (2 != cursor->count
+		|| !deen_postings_cursor_next(cursor, &ref) || 123 != ref
+		|| !deen_postings_cursor_next(cursor, &ref) || 789 != ref
+		|| deen_postings_cursor_next(cursor, &ref)) {
+		deen_log_error_and_exit("failed test 'test_mapindex_terms' -- unexpected refs for 'RATHAUS'");
+	}
+
+	deen_postings_cursor_free(cursor);
+
+	cursor = deen_mapindex_lookup_terms(mapindex, (uint8_t *) "RATHAUSES");
+
+	if (0 != cursor->count || deen_postings_cursor_next(cursor, &ref)) {
+		deen_log_error_and_exit("failed test 'test_mapindex_terms' -- unexpected refs for 'RATHAUSES'");
+	}
+
+	deen_postings_cursor_free(cursor);
+	deen_mapindex_close(mapindex);
+
+	if (0 != remove(OUTPUT_MAPINDEX_FILE)) {
+		deen_log_error_and_exit("failed test 'test_mapindex_terms' -- unable to delete the temporary binary index file");
+	}
+
+	DEEN_LOG_INFO0("passed test 'test_mapindex_terms'");
+}
+
  // ---------------------------------------------------------------
  // DRIVING THE TEST
  // ---------------------------------------------------------------
@@ -155,6 +378,9 @@ static deen_bool test_index_e2e_lookup(sqlite3 *db) {
  int main(int argc, char** argv) {
 
  	test_index_e2e();
+ 	test_index_bulk_e2e();
+ 	test_mapindex_e2e();
+ 	test_mapindex_terms();
 
  	return 0;
  }
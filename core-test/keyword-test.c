@@ -30,6 +30,54 @@ static void test_keywords_all_present() {
 }
 
 
+/*
+The keywords should only be found at the start of words and the case of the
+text, including the umlauts, should not matter.
+*/
+
+static void test_keywords_matcher() {
+	const uint8_t *input = (uint8_t *) "Apfelstrudel {m} aus M\xC3\xBCnchen; xStrudel";
+	deen_keywords *keywords = deen_keywords_create();
+	deen_keywords_matcher *matcher;
+	size_t keyword_len;
+	size_t keyword_index;
+
+	deen_keywords_add_from_string(keywords, (uint8_t *) "APF M\xC3\x9CN APFELS");
+	matcher = deen_keywords_matcher_create(keywords);
+
+	// - - - - - - - - - -
+	if (DEEN_TRUE != deen_keywords_matcher_all_present_n(matcher, input, strlen((char *) input))) {
+		deen_log_error_and_exit("failed test 'test_keywords_matcher' -- expected all present");
+	}
+
+	if (DEEN_FALSE != deen_keywords_matcher_all_present_n(matcher, input, 16)) {
+		deen_log_error_and_exit("failed test 'test_keywords_matcher' -- expected not all present");
+	}
+
+	keyword_index = deen_keywords_matcher_find_at(matcher, input, 0, 12, &keyword_len);
+
+	if (0 != keyword_index || 6 != keyword_len) {
+		deen_log_error_and_exit("failed test 'test_keywords_matcher' -- expected the longest keyword");
+	}
+
+	keyword_index = deen_keywords_matcher_find_at(matcher, input, 0, 4, &keyword_len);
+
+	if (1 != keyword_index || 3 != keyword_len) {
+		deen_log_error_and_exit("failed test 'test_keywords_matcher' -- expected the keyword within the word");
+	}
+
+	if (DEEN_NOT_FOUND != deen_keywords_matcher_find_at(matcher, input, 31, 8, &keyword_len)) {
+		deen_log_error_and_exit("failed test 'test_keywords_matcher' -- expected no keyword");
+	}
+	// - - - - - - - - - -
+
+	deen_keywords_matcher_free(matcher);
+	deen_keywords_free(keywords);
+
+	DEEN_LOG_INFO0("passed test 'test_keywords_matcher'");
+}
+
+
 static void test_keywords_longest_keyword() {
 	deen_keywords *keywords = deen_keywords_create();
 
@@ -49,30 +97,48 @@ static void test_keywords_longest_keyword() {
 }
 
 
-static void test_keywords_adjust() {
-	uint8_t *keyword;
+/*
+The keywords should each be able to be spelled with or without the umlauts
+and either spelling should be found in the text.
+*/
+
+static void test_keywords_spellings() {
 	deen_keywords *keywords = deen_keywords_create();
-	deen_keywords_add_from_string(keywords, (uint8_t *) "KOENIG");
 
 	// - - - - - - - - - -
-	deen_keywords_adjust(keywords);
+	deen_keywords_add_from_string(keywords, (uint8_t *) "KOENIG STRA\xC3\x9F" "E");
 	// - - - - - - - - - -
 
-	keyword = keywords->keywords[0];
+	if (4 != keywords->spelling_count) {
+		deen_log_error_and_exit("failed test 'test_keywords_spellings' -- %u spellings", keywords->spelling_count);
+	}
+
+	if (
+		0 != strcmp((char *) keywords->spellings[0], "KOENIG") ||
+		0 != strcmp((char *) keywords->spellings[1], "K\xC3\x96NIG") ||
+		0 != strcmp((char *) keywords->spellings[2], "STRA\xC3\x9F" "E") ||
+		0 != strcmp((char *) keywords->spellings[3], "STRASSE")) {
+		deen_log_error_and_exit("failed test 'test_keywords_spellings' -- unexpected spellings");
+	}
+
+	if (!deen_keywords_all_present(keywords, (uint8_t *) "die Strasse des K\xC3\xB6nigs")) {
+		deen_log_error_and_exit("failed test 'test_keywords_spellings' -- not found");
+	}
 
-	if(0 != memcmp(keyword, "K\xC3\x96NIG", 6)) {
-		deen_log_error_and_exit("failed test 'test_keywords_adjust'");
+	if (deen_keywords_all_present(keywords, (uint8_t *) "die Stra\xC3\x9F" "e der Kaiser")) {
+		deen_log_error_and_exit("failed test 'test_keywords_spellings' -- unexpectedly found");
 	}
 
 	deen_keywords_free(keywords);
 
-	DEEN_LOG_INFO0("passed test 'test_keywords_adjust'");
+	DEEN_LOG_INFO0("passed test 'test_keywords_spellings'");
 }
 
 
 int main(int argc, char** argv) {
 	test_keywords_all_present();
+	test_keywords_matcher();
 	test_keywords_longest_keyword();
-	test_keywords_adjust();
+	test_keywords_spellings();
 	return 0;
 }
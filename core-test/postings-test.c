@@ -0,0 +1,201 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/common.h"
+#include "core/constants.h"
+#include "core/postings.h"
+#include "core/types.h"
+
+#define TEST_POSTINGS_COUNT 1000
+
+
+/*
+Produces ascending refs with a mixture of small and large gaps including one
+gap that is too large for 32 bits.
+*/
+
+static void test_postings_refs(int64_t *refs, size_t count) {
+	size_t i;
+	int64_t ref = 17;
+
+	for (i = 0; i < count; i++) {
+		refs[i] = ref;
+
+		switch (i % 7) {
+			case 0: ref += 1; break;
+			case 3: ref += 300; break;
+			case 5: ref += 70000; break;
+			default: ref += 42; break;
+		}
+
+		if (500 == i) {
+			ref += ((int64_t) UINT32_MAX) + 5;
+		}
+	}
+}
+
+
+static void test_postings_decode() {
+	int64_t refs[TEST_POSTINGS_COUNT];
+	off_t decoded[TEST_POSTINGS_COUNT];
+	uint8_t *data = (uint8_t *) deen_emalloc(deen_postings_encode_len_max(TEST_POSTINGS_COUNT));
+	uint32_t block_count;
+	size_t data_len;
+	size_t i;
+
+	test_postings_refs(refs, TEST_POSTINGS_COUNT);
+	data_len = deen_postings_encode(refs, TEST_POSTINGS_COUNT, data, &block_count);
+
+	if (block_count < (TEST_POSTINGS_COUNT / DEEN_POSTINGS_BLOCK_SIZE) + 1) {
+		deen_log_error_and_exit("failed test 'test_postings_decode' -- too few blocks (%u)", block_count);
+	}
+
+	if (!deen_postings_decode(data, data_len, block_count, TEST_POSTINGS_COUNT, decoded)) {
+		deen_log_error_and_exit("failed test 'test_postings_decode' -- unable to decode");
+	}
+
+	for (i = 0; i < TEST_POSTINGS_COUNT; i++) {
+		if ((off_t) refs[i] != decoded[i]) {
+			deen_log_error_and_exit("failed test 'test_postings_decode' -- mismatch at %u", (unsigned) i);
+		}
+	}
+
+	// a truncated posting list should be detected.
+
+	if (deen_postings_decode(data, data_len - 1, block_count, TEST_POSTINGS_COUNT, decoded)) {
+		deen_log_error_and_exit("failed test 'test_postings_decode' -- truncated data was decoded");
+	}
+
+	free((void *) data);
+
+	DEEN_LOG_INFO0("passed test 'test_postings_decode'");
+}
+
+
+static void test_postings_seek_block() {
+	int64_t refs[TEST_POSTINGS_COUNT];
+	off_t decoded[DEEN_POSTINGS_BLOCK_SIZE];
+	uint8_t *data = (uint8_t *) deen_emalloc(deen_postings_encode_len_max(TEST_POSTINGS_COUNT));
+	uint32_t block_count;
+	uint32_t block;
+	size_t data_len;
+	size_t decoded_count;
+	size_t i;
+	deen_bool found = DEEN_FALSE;
+
+	test_postings_refs(refs, TEST_POSTINGS_COUNT);
+	data_len = deen_postings_encode(refs, TEST_POSTINGS_COUNT, data, &block_count);
+
+	// the block found should contain the ref being sought.
+
+	block = deen_postings_seek_block(data, block_count, (off_t) refs[777]);
+
+	if (!deen_postings_decode_block(data, data_len, block_count, block, decoded, &decoded_count)) {
+		deen_log_error_and_exit("failed test 'test_postings_seek_block' -- unable to decode block");
+	}
+
+	for (i = 0; i < decoded_count; i++) {
+		if (decoded[i] == (off_t) refs[777]) {
+			found = DEEN_TRUE;
+		}
+	}
+
+	if (!found) {
+		deen_log_error_and_exit("failed test 'test_postings_seek_block' -- ref not in block %u", block);
+	}
+
+	if (0 != deen_postings_seek_block(data, block_count, 0)) {
+		deen_log_error_and_exit("failed test 'test_postings_seek_block' -- expected the first block");
+	}
+
+	if (block_count - 1 != deen_postings_seek_block(data, block_count, (off_t) refs[TEST_POSTINGS_COUNT - 1] + 1)) {
+		deen_log_error_and_exit("failed test 'test_postings_seek_block' -- expected the last block");
+	}
+
+	free((void *) data);
+
+	DEEN_LOG_INFO0("passed test 'test_postings_seek_block'");
+}
+
+
+/*
+A cursor should yield all of the refs in order and should be able to skip to
+refs both within the current block and in later blocks.
+*/
+
+static void test_postings_cursor() {
+	int64_t refs[TEST_POSTINGS_COUNT];
+	uint8_t *data = (uint8_t *) deen_emalloc(deen_postings_encode_len_max(TEST_POSTINGS_COUNT));
+	uint32_t block_count;
+	size_t data_len;
+	size_t i;
+	off_t ref;
+	deen_postings_cursor *cursor;
+
+	test_postings_refs(refs, TEST_POSTINGS_COUNT);
+	data_len = deen_postings_encode(refs, TEST_POSTINGS_COUNT, data, &block_count);
+
+	cursor = deen_postings_cursor_create(data, data_len, block_count, TEST_POSTINGS_COUNT);
+
+	for (i = 0; i < TEST_POSTINGS_COUNT; i++) {
+		if (!deen_postings_cursor_next(cursor, &ref) || (off_t) refs[i] != ref) {
+			deen_log_error_and_exit("failed test 'test_postings_cursor' -- mismatch at %u", (unsigned) i);
+		}
+	}
+
+	if (deen_postings_cursor_next(cursor, &ref) || cursor->is_error) {
+		deen_log_error_and_exit("failed test 'test_postings_cursor' -- expected the end");
+	}
+
+	deen_postings_cursor_free(cursor);
+
+	// skip within the first block, to a ref that is not present, to the
+	// same ref again and then across a number of blocks.
+
+	cursor = deen_postings_cursor_create(data, data_len, block_count, TEST_POSTINGS_COUNT);
+
+	if (!deen_postings_cursor_skip_to(cursor, (off_t) refs[10], &ref) || (off_t) refs[10] != ref) {
+		deen_log_error_and_exit("failed test 'test_postings_cursor' -- unable to skip within a block");
+	}
+
+	if (!deen_postings_cursor_skip_to(cursor, (off_t) refs[20] + 1, &ref) || (off_t) refs[21] != ref) {
+		deen_log_error_and_exit("failed test 'test_postings_cursor' -- unable to skip to an absent ref");
+	}
+
+	if (!deen_postings_cursor_skip_to(cursor, (off_t) refs[21], &ref) || (off_t) refs[21] != ref) {
+		deen_log_error_and_exit("failed test 'test_postings_cursor' -- should not have moved");
+	}
+
+	if (!deen_postings_cursor_skip_to(cursor, (off_t) refs[777], &ref) || (off_t) refs[777] != ref) {
+		deen_log_error_and_exit("failed test 'test_postings_cursor' -- unable to skip across blocks");
+	}
+
+	if (!deen_postings_cursor_next(cursor, &ref) || (off_t) refs[778] != ref) {
+		deen_log_error_and_exit("failed test 'test_postings_cursor' -- unexpected ref after skipping");
+	}
+
+	if (deen_postings_cursor_skip_to(cursor, (off_t) refs[TEST_POSTINGS_COUNT - 1] + 1, &ref)) {
+		deen_log_error_and_exit("failed test 'test_postings_cursor' -- skipped beyond the end");
+	}
+
+	deen_postings_cursor_free(cursor);
+	free((void *) data);
+
+	DEEN_LOG_INFO0("passed test 'test_postings_cursor'");
+}
+
+
+int main(int argc, char** argv) {
+	test_postings_decode();
+	test_postings_seek_block();
+	test_postings_cursor();
+	return 0;
+}
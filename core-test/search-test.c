@@ -0,0 +1,305 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+/*
+This test installs a small amount of data and then searches it in order to
+check what the explain records and how the lookup cache in front of the sqlite
+index behaves.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "core/common.h"
+#include "core/constants.h"
+#include "core/install.h"
+#include "core/keyword.h"
+#include "core/search.h"
+#include "core/types.h"
+
+#define TEST_ROOT_DIR "tmp_search_test"
+#define TEST_DING_FILE "tmp_search_test.txt"
+
+/*
+The last line has a word of exactly DEEN_INDEXING_TERM_DEPTH characters so
+that a longer keyword sharing those characters finds its term in the index
+and yet is not in the line.
+*/
+
+static const char *test_ding_lines[] = {
+	"# Version :: test",
+	"Rathaus {n} :: town hall",
+	"Ratte {f} | Ratten {pl} :: rat | rats",
+	"Rat {m} :: advice; council",
+	"Haus {n} :: house",
+	"Rathausplatz {m} :: town hall square",
+	"Rathausplatzverwaltu {m} :: not a real word"
+};
+
+
+static void test_install() {
+	FILE *out = fopen(TEST_DING_FILE, "w");
+	size_t i;
+
+	if (NULL == out) {
+		deen_log_error_and_exit("failed test 'test_install' -- unable to write the ding file");
+	}
+
+	for (i = 0; i < sizeof(test_ding_lines) / sizeof(test_ding_lines[0]); i++) {
+		fprintf(out, "%s\n", test_ding_lines[i]);
+	}
+
+	fclose(out);
+
+	if (!deen_install_from_path(TEST_ROOT_DIR, TEST_DING_FILE, NULL, NULL, NULL)) {
+		deen_log_error_and_exit("failed test 'test_install' -- unable to install the ding file");
+	}
+}
+
+
+static void test_uninstall() {
+	char *data_path = deen_data_path(TEST_ROOT_DIR);
+	char *index_path = deen_index_path(TEST_ROOT_DIR);
+	char *mapindex_path = deen_mapindex_path(TEST_ROOT_DIR);
+
+	remove(data_path);
+	remove(index_path);
+	remove(mapindex_path);
+	remove(TEST_DING_FILE);
+
+	if (0 != rmdir(TEST_ROOT_DIR)) {
+		deen_log_error_and_exit("failed test -- unable to delete the temporary root directory");
+	}
+
+	free((void *) data_path);
+	free((void *) index_path);
+	free((void *) mapindex_path);
+}
+
+
+static deen_search_context *test_search_init() {
+	deen_search_context *context = deen_search_init(TEST_ROOT_DIR);
+
+	if (NULL == context) {
+		deen_log_error_and_exit("failed test -- unable to create a search context");
+	}
+
+	return context;
+}
+
+
+/*
+Searches for the upper case search expression and returns the total count of
+the result.
+*/
+
+static uint32_t test_search(
+	deen_search_context *context,
+	const char *search_expression,
+	deen_search_explain *explain) {
+
+	deen_keywords *keywords = deen_keywords_create();
+	deen_search_result *result;
+	uint32_t total_count;
+
+	deen_keywords_add_from_string(keywords, (const uint8_t *) search_expression);
+	result = deen_search_explained(context, keywords, DEEN_RESULT_SIZE_DEFAULT, explain);
+
+	if (NULL == result) {
+		deen_log_error_and_exit("failed test -- unable to search for [%s]", search_expression);
+	}
+
+	total_count = result->total_count;
+	deen_search_result_free(result);
+	deen_keywords_free(keywords);
+
+	return total_count;
+}
+
+
+static void test_check_explain_keyword(
+	deen_search_explain *explain,
+	size_t i,
+	const char *lookup,
+	deen_bool is_term_range,
+	size_t refs_count) {
+
+	if (i >= explain->keyword_count) {
+		deen_log_error_and_exit("failed test 'test_search_explain' -- missing keyword %u", (unsigned) i);
+	}
+
+	if (0 != strcmp((char *) explain->keywords[i].lookup, lookup)) {
+		deen_log_error_and_exit("failed test 'test_search_explain' -- expected lookup [%s], but was [%s]",
+			lookup, explain->keywords[i].lookup);
+	}
+
+	if (is_term_range != explain->keywords[i].is_term_range) {
+		deen_log_error_and_exit("failed test 'test_search_explain' -- unexpected term range for [%s]", lookup);
+	}
+
+	if (refs_count != explain->keywords[i].refs_count) {
+		deen_log_error_and_exit("failed test 'test_search_explain' -- expected %u refs for [%s], but was %u",
+			(unsigned) refs_count, lookup, (unsigned) explain->keywords[i].refs_count);
+	}
+}
+
+
+static void test_search_explain() {
+	deen_search_context *context = test_search_init();
+	deen_search_explain *explain = deen_search_explain_create();
+
+	// the longer keyword is looked up as the terms that start with it and the
+	// shorter one as a prefix.  The line that is found is read once when it is
+	// scanned and again when its entry is parsed.
+
+	if (1 != test_search(context, "SQUARE TOWN", explain)) {
+		deen_log_error_and_exit("failed test 'test_search_explain' -- expected one result for 'SQUARE TOWN'");
+	}
+
+	if (!explain->is_mapindex || 2 != explain->keyword_count) {
+		deen_log_error_and_exit("failed test 'test_search_explain' -- unexpected keywords for 'SQUARE TOWN'");
+	}
+
+	test_check_explain_keyword(explain, 0, "SQUARE", DEEN_TRUE, 1);
+	test_check_explain_keyword(explain, 1, "TOWN", DEEN_FALSE, 2);
+
+	if (1 != explain->intersection_count
+		|| 2 != explain->lines_read
+		|| 0 != explain->lines_rejected
+		|| 1 != explain->entries_parsed) {
+		deen_log_error_and_exit("failed test 'test_search_explain' -- unexpected counts for 'SQUARE TOWN'");
+	}
+
+	// the explain is re-used; nothing from the first search should remain.
+	// The term is cut off at the depth of the terms and so the line with the
+	// shorter word is a candidate, but is rejected.
+
+	if (0 != test_search(context, "RATHAUSPLATZVERWALTUNG", explain)) {
+		deen_log_error_and_exit("failed test 'test_search_explain' -- expected no results for 'RATHAUSPLATZVERWALTUNG'");
+	}
+
+	if (1 != explain->keyword_count) {
+		deen_log_error_and_exit("failed test 'test_search_explain' -- the explain was not reset");
+	}
+
+	test_check_explain_keyword(explain, 0, "RATHAUSPLATZVERWALTU", DEEN_TRUE, 1);
+
+	if (1 != explain->intersection_count
+		|| 1 != explain->lines_read
+		|| 1 != explain->lines_rejected
+		|| 0 != explain->entries_parsed) {
+		deen_log_error_and_exit("failed test 'test_search_explain' -- unexpected counts for 'RATHAUSPLATZVERWALTUNG'");
+	}
+
+	deen_search_explain_free(explain);
+	deen_search_free(context);
+
+	DEEN_LOG_INFO0("passed test 'test_search_explain'");
+}
+
+
+static void test_check_cache_counts(deen_search_context *context, uint64_t hits, uint64_t misses, const char *when) {
+	if (hits != context->lookup_cache_hits || misses != context->lookup_cache_misses) {
+		deen_log_error_and_exit("failed test 'test_search_lookup_cache' -- %s; expected %u hits and %u misses, but was %u and %u",
+			when, (unsigned) hits, (unsigned) misses,
+			(unsigned) context->lookup_cache_hits, (unsigned) context->lookup_cache_misses);
+	}
+}
+
+
+/*
+Without the binary index, the prefixes are looked up in the sqlite database
+through the cache.
+*/
+
+static void test_search_lookup_cache() {
+	char *mapindex_path = deen_mapindex_path(TEST_ROOT_DIR);
+	deen_search_context *context;
+	deen_search_explain *explain = deen_search_explain_create();
+	char prefix[5];
+	uint32_t i;
+
+	if (0 != remove(mapindex_path)) {
+		deen_log_error_and_exit("failed test 'test_search_lookup_cache' -- unable to delete the binary index");
+	}
+
+	free((void *) mapindex_path);
+	context = test_search_init();
+
+	// a hit has the same refs as the miss before it; a keyword is looked up by
+	// its first four characters and so 'RATHAUS' is a hit on 'RATH'.
+
+	if (3 != test_search(context, "RATH", explain)) {
+		deen_log_error_and_exit("failed test 'test_search_lookup_cache' -- expected three results for 'RATH'");
+	}
+
+	if (explain->is_mapindex || explain->keywords[0].is_term_range || 3 != explain->keywords[0].refs_count) {
+		deen_log_error_and_exit("failed test 'test_search_lookup_cache' -- unexpected lookup for 'RATH'");
+	}
+
+	test_check_cache_counts(context, 0, 1, "first search");
+
+	if (3 != test_search(context, "RATHAUS", explain)) {
+		deen_log_error_and_exit("failed test 'test_search_lookup_cache' -- expected three results for 'RATHAUS'");
+	}
+
+	if (0 != strcmp((char *) explain->keywords[0].lookup, "RATH") || 3 != explain->keywords[0].refs_count) {
+		deen_log_error_and_exit("failed test 'test_search_lookup_cache' -- the hit found different refs");
+	}
+
+	test_check_cache_counts(context, 1, 1, "second search");
+
+	// fill the rest of the cache with prefixes that are not in the index.
+
+	for (i = 1; i < DEEN_SEARCH_LOOKUP_CACHE_SIZE; i++) {
+		sprintf(prefix, "QX%c%c", 'A' + (i / 26), 'A' + (i % 26));
+		test_search(context, prefix, NULL);
+	}
+
+	test_check_cache_counts(context, 1, DEEN_SEARCH_LOOKUP_CACHE_SIZE, "cache filled");
+
+	// using 'RATH' again makes the first of the others the least recently
+	// used and so it is that one that is evicted by a new prefix.
+
+	test_search(context, "RATH", NULL);
+	test_check_cache_counts(context, 2, DEEN_SEARCH_LOOKUP_CACHE_SIZE, "after using the first");
+
+	test_search(context, "QXZZ", NULL);
+	test_check_cache_counts(context, 2, DEEN_SEARCH_LOOKUP_CACHE_SIZE + 1, "after one more");
+
+	test_search(context, "RATH", NULL);
+	test_check_cache_counts(context, 3, DEEN_SEARCH_LOOKUP_CACHE_SIZE + 1, "the most recently used was evicted");
+
+	test_search(context, "QXAC", NULL);
+	test_check_cache_counts(context, 4, DEEN_SEARCH_LOOKUP_CACHE_SIZE + 1, "a later one was evicted");
+
+	test_search(context, "QXAB", NULL);
+	test_check_cache_counts(context, 4, DEEN_SEARCH_LOOKUP_CACHE_SIZE + 2, "the least recently used was not evicted");
+
+	deen_search_explain_free(explain);
+	deen_search_free(context);
+
+	DEEN_LOG_INFO0("passed test 'test_search_lookup_cache'");
+}
+
+// ---------------------------------------------------------------
+// DRIVING THE TEST
+// ---------------------------------------------------------------
+
+
+int main(int argc, char** argv) {
+
+	test_install();
+	test_search_explain();
+	test_search_lookup_cache();
+	test_uninstall();
+
+	return 0;
+}
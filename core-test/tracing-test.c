@@ -0,0 +1,281 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+#ifndef __MINGW32__
+#include <pthread.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/common.h"
+#include "core/constants.h"
+#include "core/tracing.h"
+
+#define OUTPUT_TRACE_FILE "tmp_tracing_test.json"
+#define TEST_SPAN_TOTALS_MAX 16
+#define TEST_TRACE_FILE_SIZE_MAX (16 * 1024 * 1024)
+
+#ifndef __MINGW32__
+
+typedef struct test_span_total test_span_total;
+struct test_span_total {
+	const char *name;
+	uint32_t count;
+	uint64_t nanos;
+};
+
+
+typedef struct test_span_totals test_span_totals;
+struct test_span_totals {
+	test_span_total totals[TEST_SPAN_TOTALS_MAX];
+	uint32_t count;
+};
+
+
+static void test_span_totals_cb(void *context, const char *name, uint32_t count, uint64_t nanos) {
+	test_span_totals *totals = (test_span_totals *) context;
+
+	if (totals->count < TEST_SPAN_TOTALS_MAX) {
+		totals->totals[totals->count].name = name;
+		totals->totals[totals->count].count = count;
+		totals->totals[totals->count].nanos = nanos;
+		totals->count++;
+	}
+}
+
+
+/*
+Returns the index of the named total or -1 if there is no total for the name.
+*/
+
+static int test_span_totals_find(test_span_totals *totals, const char *name) {
+	uint32_t i;
+
+	for (i = 0; i < totals->count; i++) {
+		if (0 == strcmp(totals->totals[i].name, name)) {
+			return (int) i;
+		}
+	}
+
+	return -1;
+}
+
+
+static void test_span_totals_get(test_span_totals *totals) {
+	totals->count = 0;
+	deen_tracing_span_totals(&test_span_totals_cb, totals);
+}
+
+
+static void test_remove_trace_file() {
+	remove(OUTPUT_TRACE_FILE);
+}
+
+
+static void test_nested_spans() {
+	test_span_totals totals;
+	int outer;
+	int inner;
+
+	deen_tracing_begin("outer");
+	deen_tracing_begin("inner");
+	deen_tracing_end("inner");
+	deen_tracing_counter("between", 42);
+	deen_tracing_begin("inner");
+	deen_tracing_end("inner");
+	deen_tracing_end("outer");
+
+	test_span_totals_get(&totals);
+	outer = test_span_totals_find(&totals, "outer");
+	inner = test_span_totals_find(&totals, "inner");
+
+	if (-1 == outer || -1 == inner) {
+		deen_log_error_and_exit("failed test 'test_nested_spans' -- missing total");
+	}
+
+	if (1 != totals.totals[outer].count || 2 != totals.totals[inner].count) {
+		deen_log_error_and_exit("failed test 'test_nested_spans' -- expected 1 outer and 2 inner spans, but was %u and %u",
+			totals.totals[outer].count, totals.totals[inner].count);
+	}
+
+	// the totals are in the order in which the spans first began.
+
+	if (outer > inner) {
+		deen_log_error_and_exit("failed test 'test_nested_spans' -- the inner span is before the outer span");
+	}
+
+	if (totals.totals[outer].nanos < totals.totals[inner].nanos) {
+		deen_log_error_and_exit("failed test 'test_nested_spans' -- the inner spans took longer than the outer span");
+	}
+
+	DEEN_LOG_INFO0("passed test 'test_nested_spans'");
+}
+
+
+/*
+This runs on its own thread so that it has its own ring.  The begin of the
+span is overwritten by the counters and so the end of the span has no begin.
+*/
+
+static void *test_wrapped_ring_thread(void *context) {
+	uint32_t i;
+
+	deen_tracing_begin("wrapped");
+
+	for (i = 0; i < DEEN_TRACING_BUFFER_SIZE; i++) {
+		deen_tracing_counter("filler", (int64_t) i);
+	}
+
+	deen_tracing_end("wrapped");
+	deen_tracing_begin("after");
+	deen_tracing_end("after");
+
+	return NULL;
+}
+
+
+static void test_wrapped_ring() {
+	test_span_totals totals;
+	pthread_t thread;
+	int after;
+
+	if (0 != pthread_create(&thread, NULL, &test_wrapped_ring_thread, NULL)) {
+		deen_log_error_and_exit("failed test 'test_wrapped_ring' -- unable to start the thread");
+	}
+
+	pthread_join(thread, NULL);
+
+	test_span_totals_get(&totals);
+
+	if (-1 != test_span_totals_find(&totals, "wrapped")) {
+		deen_log_error_and_exit("failed test 'test_wrapped_ring' -- the span with the overwritten begin was totalled");
+	}
+
+	after = test_span_totals_find(&totals, "after");
+
+	if (-1 == after || 1 != totals.totals[after].count) {
+		deen_log_error_and_exit("failed test 'test_wrapped_ring' -- the span after the wrap was not totalled");
+	}
+
+	DEEN_LOG_INFO0("passed test 'test_wrapped_ring'");
+}
+
+
+/*
+Checks that the brackets and braces outside of the strings balance; there are
+no escapes in the names used in this test.
+*/
+
+static deen_bool test_is_balanced(const char *s) {
+	int depth = 0;
+	deen_bool is_string = DEEN_FALSE;
+
+	for (; 0 != *s; s++) {
+		if ('"' == *s) {
+			is_string = !is_string;
+		}
+		else if (!is_string) {
+			if ('{' == *s || '[' == *s) {
+				depth++;
+			}
+			else if ('}' == *s || ']' == *s) {
+				if (0 == depth--) {
+					return DEEN_FALSE;
+				}
+			}
+		}
+	}
+
+	return 0 == depth && !is_string;
+}
+
+
+static void test_flush() {
+	static const char *prefix = "{\"traceEvents\":[\n{";
+	static const char *suffix = "}\n],\"displayTimeUnit\":\"ms\"}\n";
+	static const char *expected_events[] = {
+		"{\"name\":\"outer\",\"ph\":\"B\",",
+		"{\"name\":\"outer\",\"ph\":\"E\",",
+		"{\"name\":\"between\",\"ph\":\"C\",",
+		",\"args\":{\"between\":42}}",
+		"{\"name\":\"after\",\"ph\":\"E\","
+	};
+	char *content = (char *) deen_emalloc(TEST_TRACE_FILE_SIZE_MAX);
+	size_t content_len;
+	size_t suffix_len = strlen(suffix);
+	FILE *in;
+	size_t i;
+
+	deen_tracing_flush();
+
+	if (NULL == (in = fopen(OUTPUT_TRACE_FILE, "r"))) {
+		deen_log_error_and_exit("failed test 'test_flush' -- the trace file was not written");
+	}
+
+	content_len = fread(content, sizeof(char), TEST_TRACE_FILE_SIZE_MAX - 1, in);
+	content[content_len] = 0;
+	fclose(in);
+
+	if (0 != strncmp(content, prefix, strlen(prefix))
+		|| content_len < suffix_len
+		|| 0 != strcmp(&content[content_len - suffix_len], suffix)) {
+		deen_log_error_and_exit("failed test 'test_flush' -- the trace file does not start and end as expected");
+	}
+
+	if (!test_is_balanced(content)) {
+		deen_log_error_and_exit("failed test 'test_flush' -- the trace file is not balanced");
+	}
+
+	for (i = 0; i < sizeof(expected_events) / sizeof(expected_events[0]); i++) {
+		if (NULL == strstr(content, expected_events[i])) {
+			deen_log_error_and_exit("failed test 'test_flush' -- missing [%s]", expected_events[i]);
+		}
+	}
+
+	// the begin of this span was overwritten.
+
+	if (NULL != strstr(content, "{\"name\":\"wrapped\",\"ph\":\"B\",")) {
+		deen_log_error_and_exit("failed test 'test_flush' -- an overwritten event was written");
+	}
+
+	free((void *) content);
+
+	DEEN_LOG_INFO0("passed test 'test_flush'");
+}
+
+#endif
+
+// ---------------------------------------------------------------
+// DRIVING THE TEST
+// ---------------------------------------------------------------
+
+
+int main(int argc, char** argv) {
+
+#ifdef __MINGW32__
+	DEEN_LOG_INFO0("tracing is not available; skipped the tracing tests");
+#else
+	// tracing flushes to the file as the process exits and so the file is
+	// removed by an exit handler that is registered before tracing registers
+	// its own; the exit handlers run in the reverse order.
+
+	setenv("DEENTRACEFILE", OUTPUT_TRACE_FILE, 1);
+	atexit(&test_remove_trace_file);
+
+	if (!deen_tracing_is_enabled()) {
+		deen_log_error_and_exit("failed test -- tracing was not enabled from the environment");
+	}
+
+	test_nested_spans();
+	test_wrapped_ring();
+	test_flush();
+#endif
+
+	return 0;
+}
@@ -21,8 +21,24 @@
 
 #include "constants.h"
 
+/*
+The vector implementations are only built where the compiler is able to
+target the x86 vector extensions function by function so that the program
+as a whole is still able to run on any x86 processor.
+*/
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DEEN_SIMD_X86
+#include <immintrin.h>
+#endif
+
 #define ISWORDCHAR(C) (!isspace(C) && !ispunct(C))
 
+// when upper-casing, this many bytes are done one at a time after a block
+// that is not US-ASCII before trying for whole blocks again.
+
+#define DEEN_TO_UPPER_STRETCH 32
+
 // ---------------------------------------------------------------
 // FILE SYSTEM
 // ---------------------------------------------------------------
@@ -64,6 +80,14 @@ char *deen_index_path(const char *root_dir) {
 	return deen_leaf_path(root_dir, DEEN_LEAF_INDEX);
 }
 
+char *deen_mapindex_path(const char *root_dir) {
+	return deen_leaf_path(root_dir, DEEN_LEAF_MAPINDEX);
+}
+
+char *deen_socket_path(const char *root_dir) {
+	return deen_leaf_path(root_dir, DEEN_LEAF_SOCKET);
+}
+
 // ---------------------------------------------------------------
 // UTILITY
 // ---------------------------------------------------------------
@@ -84,6 +108,515 @@ deen_millis deen_millis_since_epoc() {
 	return (deen_millis) (te.tv_sec * 1000LL) + (te.tv_usec / 1000);
 }
 
+deen_micros deen_micros_since_epoc() {
+	struct timeval te;
+	gettimeofday(&te, NULL);
+	return (deen_micros) (te.tv_sec * 1000000LL) + te.tv_usec;
+}
+
+// ---------------------------------------------------------------
+// SIMD
+// ---------------------------------------------------------------
+
+/*
+The vector implementations classify bytes against fixed ranges of values so
+they are only correct if the classification of characters is the same as it
+is in the "C" locale.
+*/
+
+static deen_bool deen_simd_is_nonword_c(int c) {
+	return (c >= 0x09 && c <= 0x0d)
+		|| (c >= 0x20 && c <= 0x2f)
+		|| (c >= 0x3a && c <= 0x40)
+		|| (c >= 0x5b && c <= 0x60)
+		|| (c >= 0x7b && c <= 0x7e);
+}
+
+
+static deen_bool deen_simd_is_c_classification() {
+	int c;
+
+	for (c = 0; c < 256; c++) {
+		deen_bool nonword = isspace(c) || ispunct(c);
+		int upper = (c >= 'a' && c <= 'z') ? c - 0x20 : c;
+
+		if (nonword != deen_simd_is_nonword_c(c) || upper != toupper(c)) {
+			return DEEN_FALSE;
+		}
+	}
+
+	return DEEN_TRUE;
+}
+
+
+static deen_simd_level deen_simd_detect_level() {
+	deen_simd_level level = DEEN_SIMD_SCALAR;
+#ifdef DEEN_SIMD_X86
+	char *simd_env = getenv("DEENSIMD");
+
+	if (deen_simd_is_c_classification()) {
+		__builtin_cpu_init();
+
+		if (__builtin_cpu_supports("avx2")) {
+			level = DEEN_SIMD_AVX2;
+		}
+		else {
+			if (__builtin_cpu_supports("sse2")) {
+				level = DEEN_SIMD_SSE2;
+			}
+		}
+	}
+
+	if (NULL != simd_env) {
+		if (0 == strcmp(simd_env, "scalar")) {
+			level = DEEN_SIMD_SCALAR;
+		}
+
+		if (0 == strcmp(simd_env, "sse2") && level > DEEN_SIMD_SSE2) {
+			level = DEEN_SIMD_SSE2;
+		}
+	}
+#endif
+
+	return level;
+}
+
+
+// this is -1 until the level is chosen.  It is accessed atomically because
+// the level may be chosen from a number of threads.
+
+static int deen_global_simd_level = -1;
+
+
+deen_simd_level deen_get_simd_level() {
+	int level = __atomic_load_n(&deen_global_simd_level, __ATOMIC_RELAXED);
+
+	if (-1 == level) {
+		level = (int) deen_simd_detect_level();
+		__atomic_store_n(&deen_global_simd_level, level, __ATOMIC_RELAXED);
+	}
+
+	return (deen_simd_level) level;
+}
+
+
+void deen_set_simd_level(deen_simd_level level) {
+	deen_simd_level supported_level = deen_simd_detect_level();
+
+	if (level > supported_level) {
+		level = supported_level;
+	}
+
+	__atomic_store_n(&deen_global_simd_level, (int) level, __ATOMIC_RELAXED);
+}
+
+
+#ifdef DEEN_SIMD_X86
+
+// SSE2; 16 bytes at a time
+
+__attribute__((target("sse2")))
+static __m128i deen_simd_sse2_in_range(__m128i c, uint8_t lo, uint8_t hi) {
+	__m128i offset = _mm_sub_epi8(c, _mm_set1_epi8((char) lo));
+	return _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8((char) (hi - lo))), offset);
+}
+
+
+/*
+Returns a bit for each of the bytes that is a word character.
+*/
+
+__attribute__((target("sse2")))
+static uint32_t deen_simd_sse2_word_mask(__m128i c) {
+	__m128i nonword = _mm_or_si128(
+		_mm_or_si128(
+			deen_simd_sse2_in_range(c, 0x09, 0x0d),
+			deen_simd_sse2_in_range(c, 0x20, 0x2f)),
+		_mm_or_si128(
+			_mm_or_si128(
+				deen_simd_sse2_in_range(c, 0x3a, 0x40),
+				deen_simd_sse2_in_range(c, 0x5b, 0x60)),
+			deen_simd_sse2_in_range(c, 0x7b, 0x7e)));
+	return ~((uint32_t) _mm_movemask_epi8(nonword)) & 0xffff;
+}
+
+
+__attribute__((target("sse2")))
+static size_t deen_simd_sse2_classify_words(
+	const uint8_t *s, size_t len,
+	uint64_t *word_bits, uint64_t *usascii_word_bits) {
+
+	size_t i = 0;
+
+	while (i + 64 <= len) {
+		uint64_t word = 0;
+		uint64_t nonusascii = 0;
+		int j;
+
+		for (j = 0; j < 4; j++) {
+			__m128i c = _mm_loadu_si128((const __m128i *) &s[i + (j * 16)]);
+			word |= ((uint64_t) deen_simd_sse2_word_mask(c)) << (j * 16);
+			nonusascii |= ((uint64_t) _mm_movemask_epi8(c)) << (j * 16);
+		}
+
+		word_bits[i >> 6] = word;
+		usascii_word_bits[i >> 6] = word & ~nonusascii;
+		i += 64;
+	}
+
+	return i;
+}
+
+
+/*
+Reports each word that ends within the whole blocks from 'offset'.  The word
+and non-word bytes of a block are found at once and then the words are read
+off the boundaries between them.  It returns the offset from which the rest
+of the text should be processed or 'len' if the callback asked to stop.
+*/
+
+__attribute__((target("sse2")))
+static size_t deen_simd_sse2_for_each_word(
+	const uint8_t *s, size_t offset, size_t len,
+	deen_bool (*eachword_callback)(const uint8_t *s, size_t offset, size_t len, void *context),
+	void *context) {
+
+	size_t word_start = DEEN_NOT_FOUND;
+
+	while (offset + 16 <= len) {
+		uint32_t word = deen_simd_sse2_word_mask(_mm_loadu_si128((const __m128i *) &s[offset]));
+		uint32_t word_before = (word << 1) | (DEEN_NOT_FOUND == word_start ? 0 : 1);
+		uint32_t starts = word & ~word_before;
+		uint32_t ends = ~word & word_before & 0xffff;
+
+		while (0 != (starts | ends)) {
+			if (DEEN_NOT_FOUND == word_start) {
+				word_start = offset + __builtin_ctz(starts);
+				starts &= starts - 1;
+			}
+			else {
+				size_t word_end = offset + __builtin_ctz(ends);
+				ends &= ends - 1;
+
+				if (DEEN_TRUE != eachword_callback(s, word_start, word_end - word_start, context)) {
+					return len;
+				}
+
+				word_start = DEEN_NOT_FOUND;
+			}
+		}
+
+		offset += 16;
+	}
+
+	return DEEN_NOT_FOUND == word_start ? offset : word_start;
+}
+
+
+__attribute__((target("sse2")))
+static size_t deen_simd_sse2_find_either(const uint8_t *s, size_t offset, size_t len, uint8_t a, uint8_t b) {
+	__m128i a_16 = _mm_set1_epi8((char) a);
+	__m128i b_16 = _mm_set1_epi8((char) b);
+
+	while (offset + 16 <= len) {
+		__m128i c = _mm_loadu_si128((const __m128i *) &s[offset]);
+		uint32_t mask = (uint32_t) _mm_movemask_epi8(
+			_mm_or_si128(_mm_cmpeq_epi8(c, a_16), _mm_cmpeq_epi8(c, b_16)));
+
+		if (0 != mask) {
+			return offset + __builtin_ctz(mask);
+		}
+
+		offset += 16;
+	}
+
+	return offset;
+}
+
+
+__attribute__((target("sse2")))
+static size_t deen_simd_sse2_to_upper_usascii(uint8_t *s, size_t offset, size_t len) {
+	__m128i case_bit = _mm_set1_epi8(0x20);
+
+	while (offset + 16 <= len) {
+		__m128i c = _mm_loadu_si128((const __m128i *) &s[offset]);
+
+		if (0 != _mm_movemask_epi8(c)) {
+			break;
+		}
+
+		c = _mm_sub_epi8(c, _mm_and_si128(deen_simd_sse2_in_range(c, 'a', 'z'), case_bit));
+		_mm_storeu_si128((__m128i *) &s[offset], c);
+		offset += 16;
+	}
+
+	return offset;
+}
+
+
+// AVX2; 32 bytes at a time
+
+__attribute__((target("avx2")))
+static __m256i deen_simd_avx2_in_range(__m256i c, uint8_t lo, uint8_t hi) {
+	__m256i offset = _mm256_sub_epi8(c, _mm256_set1_epi8((char) lo));
+	return _mm256_cmpeq_epi8(_mm256_min_epu8(offset, _mm256_set1_epi8((char) (hi - lo))), offset);
+}
+
+
+__attribute__((target("avx2")))
+static uint32_t deen_simd_avx2_word_mask(__m256i c) {
+	__m256i nonword = _mm256_or_si256(
+		_mm256_or_si256(
+			deen_simd_avx2_in_range(c, 0x09, 0x0d),
+			deen_simd_avx2_in_range(c, 0x20, 0x2f)),
+		_mm256_or_si256(
+			_mm256_or_si256(
+				deen_simd_avx2_in_range(c, 0x3a, 0x40),
+				deen_simd_avx2_in_range(c, 0x5b, 0x60)),
+			deen_simd_avx2_in_range(c, 0x7b, 0x7e)));
+	return ~((uint32_t) _mm256_movemask_epi8(nonword));
+}
+
+
+__attribute__((target("avx2")))
+static size_t deen_simd_avx2_classify_words(
+	const uint8_t *s, size_t len,
+	uint64_t *word_bits, uint64_t *usascii_word_bits) {
+
+	size_t i = 0;
+
+	while (i + 64 <= len) {
+		__m256i c_lo = _mm256_loadu_si256((const __m256i *) &s[i]);
+		__m256i c_hi = _mm256_loadu_si256((const __m256i *) &s[i + 32]);
+		uint64_t word = ((uint64_t) deen_simd_avx2_word_mask(c_lo))
+			| (((uint64_t) deen_simd_avx2_word_mask(c_hi)) << 32);
+		uint64_t nonusascii = ((uint64_t) (uint32_t) _mm256_movemask_epi8(c_lo))
+			| (((uint64_t) (uint32_t) _mm256_movemask_epi8(c_hi)) << 32);
+
+		word_bits[i >> 6] = word;
+		usascii_word_bits[i >> 6] = word & ~nonusascii;
+		i += 64;
+	}
+
+	return i;
+}
+
+
+__attribute__((target("avx2")))
+static size_t deen_simd_avx2_for_each_word(
+	const uint8_t *s, size_t offset, size_t len,
+	deen_bool (*eachword_callback)(const uint8_t *s, size_t offset, size_t len, void *context),
+	void *context) {
+
+	size_t word_start = DEEN_NOT_FOUND;
+
+	while (offset + 32 <= len) {
+		uint32_t word = deen_simd_avx2_word_mask(_mm256_loadu_si256((const __m256i *) &s[offset]));
+		uint64_t word_before = ((uint64_t) word << 1) | (DEEN_NOT_FOUND == word_start ? 0 : 1);
+		uint32_t starts = word & ~((uint32_t) word_before);
+		uint32_t ends = ~word & (uint32_t) word_before;
+
+		while (0 != (starts | ends)) {
+			if (DEEN_NOT_FOUND == word_start) {
+				word_start = offset + __builtin_ctz(starts);
+				starts &= starts - 1;
+			}
+			else {
+				size_t word_end = offset + __builtin_ctz(ends);
+				ends &= ends - 1;
+
+				if (DEEN_TRUE != eachword_callback(s, word_start, word_end - word_start, context)) {
+					return len;
+				}
+
+				word_start = DEEN_NOT_FOUND;
+			}
+		}
+
+		offset += 32;
+	}
+
+	return DEEN_NOT_FOUND == word_start ? offset : word_start;
+}
+
+
+__attribute__((target("avx2")))
+static size_t deen_simd_avx2_find_either(const uint8_t *s, size_t offset, size_t len, uint8_t a, uint8_t b) {
+	__m256i a_32 = _mm256_set1_epi8((char) a);
+	__m256i b_32 = _mm256_set1_epi8((char) b);
+
+	while (offset + 32 <= len) {
+		__m256i c = _mm256_loadu_si256((const __m256i *) &s[offset]);
+		uint32_t mask = (uint32_t) _mm256_movemask_epi8(
+			_mm256_or_si256(_mm256_cmpeq_epi8(c, a_32), _mm256_cmpeq_epi8(c, b_32)));
+
+		if (0 != mask) {
+			return offset + __builtin_ctz(mask);
+		}
+
+		offset += 32;
+	}
+
+	return offset;
+}
+
+
+__attribute__((target("avx2")))
+static size_t deen_simd_avx2_to_upper_usascii(uint8_t *s, size_t offset, size_t len) {
+	__m256i case_bit = _mm256_set1_epi8(0x20);
+
+	while (offset + 32 <= len) {
+		__m256i c = _mm256_loadu_si256((const __m256i *) &s[offset]);
+
+		if (0 != _mm256_movemask_epi8(c)) {
+			break;
+		}
+
+		c = _mm256_sub_epi8(c, _mm256_and_si256(deen_simd_avx2_in_range(c, 'a', 'z'), case_bit));
+		_mm256_storeu_si256((__m256i *) &s[offset], c);
+		offset += 32;
+	}
+
+	return offset;
+}
+
+#endif
+
+
+/*
+Sets a bit for each byte of the text that is a word character in 'word_bits'
+and for each one that is also US-ASCII in 'usascii_word_bits'.  The bits are
+held 64 to each element with the first byte in the least significant bit.
+*/
+
+static void deen_classify_words(
+	deen_simd_level level,
+	const uint8_t *s, size_t len,
+	uint64_t *word_bits, uint64_t *usascii_word_bits) {
+
+	size_t i = 0;
+
+	switch (level) {
+#ifdef DEEN_SIMD_X86
+		case DEEN_SIMD_AVX2:
+			i = deen_simd_avx2_classify_words(s, len, word_bits, usascii_word_bits);
+			break;
+		case DEEN_SIMD_SSE2:
+			i = deen_simd_sse2_classify_words(s, len, word_bits, usascii_word_bits);
+			break;
+#endif
+		default:
+			break;
+	}
+
+	if (i < len) {
+
+		// the rest is classified one byte at a time from a table so that the
+		// classification functions are not called for every byte.
+
+		uint8_t classes[256];
+		int c;
+
+		for (c = 0; c < 256; c++) {
+			classes[c] = ISWORDCHAR(c) ? (0 == (c & 0x80) ? 3 : 1) : 0;
+		}
+
+		for (; i < len; i += 64) {
+			uint64_t word = 0;
+			uint64_t usascii_word = 0;
+			size_t j;
+			size_t j_to = (len - i > 64) ? 64 : len - i;
+
+			for (j = 0; j < j_to; j++) {
+				uint64_t class = classes[s[i + j]];
+				word |= (class & 1) << j;
+				usascii_word |= (class >> 1) << j;
+			}
+
+			word_bits[i >> 6] = word;
+			usascii_word_bits[i >> 6] = usascii_word;
+		}
+	}
+}
+
+
+/*
+Returns the offset of the first bit from 'from' that is set, or that is clear
+if 'set' is false, or 'to' if there is none.
+*/
+
+static size_t deen_find_bit(const uint64_t *bits, size_t from, size_t to, deen_bool set) {
+	uint64_t flip = set ? 0 : ~((uint64_t) 0);
+	size_t i = from >> 6;
+	uint64_t word;
+
+	if (from >= to) {
+		return to;
+	}
+
+	word = (bits[i] ^ flip) & (~((uint64_t) 0) << (from & 63));
+
+	while (0 == word) {
+		i++;
+
+		if ((i << 6) >= to) {
+			return to;
+		}
+
+		word = bits[i] ^ flip;
+	}
+
+	from = (i << 6) + __builtin_ctzll(word);
+
+	return from < to ? from : to;
+}
+
+
+/*
+Returns the offset of the first byte from 'offset' that is either 'a' or 'b'
+or 'len' if there is none.
+*/
+
+static size_t deen_find_either(const uint8_t *s, size_t offset, size_t len, uint8_t a, uint8_t b) {
+	switch (deen_get_simd_level()) {
+#ifdef DEEN_SIMD_X86
+		case DEEN_SIMD_AVX2:
+			offset = deen_simd_avx2_find_either(s, offset, len, a, b);
+			break;
+		case DEEN_SIMD_SSE2:
+			offset = deen_simd_sse2_find_either(s, offset, len, a, b);
+			break;
+#endif
+		default:
+			break;
+	}
+
+	while (offset < len && a != s[offset] && b != s[offset]) {
+		offset++;
+	}
+
+	return offset;
+}
+
+
+/*
+Upper-cases whole blocks from 'offset' while they are US-ASCII and returns
+the offset of the first block that was not.
+*/
+
+static size_t deen_to_upper_usascii(deen_simd_level level, uint8_t *s, size_t offset, size_t len) {
+	switch (level) {
+#ifdef DEEN_SIMD_X86
+		case DEEN_SIMD_AVX2:
+			return deen_simd_avx2_to_upper_usascii(s, offset, len);
+		case DEEN_SIMD_SSE2:
+			return deen_simd_sse2_to_upper_usascii(s, offset, len);
+#endif
+		default:
+			return offset;
+	}
+}
+
 // ------------------------------------------------
 // STRINGS
 // ------------------------------------------------
@@ -193,9 +726,8 @@ deen_bool deen_is_common_upper_word(const uint8_t *s, size_t len) {
 deen_bool deen_imatches_at(const uint8_t *s, const uint8_t *f, size_t at) {
 	// assume that the first char does match.
 	size_t o = 0;
-	size_t f_len = strlen((const char *)f);
 
-	while (o<f_len) {
+	while (0 != f[o]) {
 
 		uint8_t c_s = s[at+o];
 		uint8_t c_f = f[o];
@@ -268,9 +800,27 @@ size_t deen_ifind_first(const uint8_t *s, const uint8_t *f, size_t from, size_t
 	if (from != to && to >= f_len && to-from >= f_len) {
 		size_t to_minus_f_len = (to-f_len)+1;
 
+		// with the classification of the "C" locale, only a byte that is the
+		// same as the first byte of 'f' or its lower case can start a match
+		// so the search is able to skip ahead to those.
+
+		deen_bool skip_ahead = DEEN_SIMD_SCALAR != deen_get_simd_level();
+		uint8_t f_first = f[0];
+		uint8_t f_first_lower = (f_first >= 'A' && f_first <= 'Z') ? f_first + 0x20 : f_first;
+
 		while (i<to_minus_f_len) {
 
-			uint32_t c_s = (uint32_t) s[i];
+			uint32_t c_s;
+
+			if (skip_ahead) {
+				i = deen_find_either(s, i, to_minus_f_len, f_first, f_first_lower);
+
+				if (i == to_minus_f_len) {
+					break;
+				}
+			}
+
+			c_s = (uint32_t) s[i];
 
 			switch (c_s) {
 				case 0x20:
@@ -291,15 +841,13 @@ size_t deen_ifind_first(const uint8_t *s, const uint8_t *f, size_t from, size_t
 }
 
 /*
- * This will ensure that not only english latin characters are upper-cased, but
- * also german accented characters.
- */
-
-void deen_to_upper(uint8_t *s) {
-	size_t len = strlen((const char *)s);
-	size_t i;
+Upper-cases the bytes from 'i' up to 'to' one at a time and returns the offset
+after the last one; this may be one beyond 'to' if a two byte sequence was
+straddling it.
+*/
 
-	for (i=0;i<len;i++) {
+static size_t deen_to_upper_bytes(uint8_t *s, size_t i, size_t to) {
+	for (;i<to;i++) {
 		if (0xc3 == s[i]) {
 			i++;
 
@@ -315,22 +863,97 @@ void deen_to_upper(uint8_t *s) {
 			s[i] = toupper(s[i]);
 		}
 	}
+
+	return i;
 }
 
-uint8_t *deen_strnchr(uint8_t *a, uint8_t b, size_t len) {
+/*
+ * This will ensure that not only english latin characters are upper-cased, but
+ * also german accented characters.
+ */
+
+void deen_to_upper(uint8_t *s) {
+	size_t len = strlen((const char *)s);
+	size_t i = 0;
+	deen_simd_level level;
+
+	// short text such as a single word is not worth trying to do in blocks.
+
+	if (len < DEEN_TO_UPPER_STRETCH || DEEN_SIMD_SCALAR == (level = deen_get_simd_level())) {
+		deen_to_upper_bytes(s, 0, len);
+		return;
+	}
+
+	// any blocks of US-ASCII are done in one go and then the following
+	// stretch is done one byte at a time.
+
+	while (i<len) {
+		i = deen_to_upper_usascii(level, s, i, len);
+		i = deen_to_upper_bytes(s, i, (len - i > DEEN_TO_UPPER_STRETCH) ? i + DEEN_TO_UPPER_STRETCH : len);
+	}
+}
+
+
+/*
+The upper case umlauts and the sharp s with the US-ASCII characters that are
+used to spell them.  The first byte of the UTF-8 sequence is always 0xc3.
+*/
+
+static const uint8_t deen_umlaut_spellings[][3] = {
+	{ 0x84, 'A', 'E' },
+	{ 0x96, 'O', 'E' },
+	{ 0x9c, 'U', 'E' },
+	{ 0x8b, 'E', 'E' },
+	{ 0x8f, 'I', 'E' },
+	{ 0x9f, 'S', 'S' }
+};
+
+#define DEEN_UMLAUT_SPELLINGS_COUNT (sizeof(deen_umlaut_spellings) / sizeof(deen_umlaut_spellings[0]))
+
+
+void deen_fold_umlauts(uint8_t *s) {
 	size_t i;
 
-	for (i=0;i<len;i++) {
-		if (0==a[i]) {
-			return NULL;
+	for (; 0 != *s; s++) {
+		if (0xc3 == s[0]) {
+			for (i=0;i<DEEN_UMLAUT_SPELLINGS_COUNT;i++) {
+				if (deen_umlaut_spellings[i][0] == s[1]) {
+					s[0] = deen_umlaut_spellings[i][1];
+					s[1] = deen_umlaut_spellings[i][2];
+					break;
+				}
+			}
+
+			// the second byte of the sequence is skipped either way.
+
+			if (0 != s[1]) {
+				s++;
+			}
 		}
+	}
+}
+
+
+uint8_t deen_umlaut_for_usascii_pair(const uint8_t *s) {
+	size_t i;
 
-		if (b==a[i]) {
-			return &a[i];
+	for (i=0;i<DEEN_UMLAUT_SPELLINGS_COUNT;i++) {
+		if (deen_umlaut_spellings[i][1] == s[0] && deen_umlaut_spellings[i][2] == s[1]) {
+			return deen_umlaut_spellings[i][0];
 		}
 	}
 
-	return NULL;
+	return 0;
+}
+
+uint8_t *deen_strnchr(uint8_t *a, uint8_t b, size_t len) {
+	size_t i = deen_find_either(a, 0, len, b, 0);
+
+	if (i == len || 0 == a[i]) {
+		return NULL;
+	}
+
+	return &a[i];
 }
 
 
@@ -510,28 +1133,74 @@ deen_bool deen_for_each_word_from_file(
 		void *context),
 	void *context) {
 
+	// find out the length of the file.
+
+	off_t file_len = lseek(fd,0,SEEK_END);
+
+	if (-1 == file_len) {
+		DEEN_LOG_ERROR0("unable to obtain the length of the file to be processed");
+		return DEEN_FALSE;
+	}
+
+	return deen_for_each_word_from_file_range(
+		read_buffer_size, fd, 0, file_len,
+		process_callback, context);
+}
+
+
+static size_t deen_for_each_word_from_file_range_read_len(
+	size_t c_buffer_available,
+	off_t range_remaining) {
+	if ((off_t) c_buffer_available > range_remaining) {
+		return (size_t) range_remaining;
+	}
+
+	return c_buffer_available;
+}
+
+
+deen_bool deen_for_each_word_from_file_range(
+	size_t read_buffer_size,
+	int fd,
+	off_t from,
+	off_t to,
+	deen_bool (*process_callback)(
+		const uint8_t *s,
+		size_t len,
+		off_t ref, // index in file to after last newline
+		float progress,
+		void *context),
+	void *context) {
+
 	deen_bool result = DEEN_TRUE;
+	deen_simd_level simd_level = deen_get_simd_level();
 
 	uint8_t *c_buffer = (uint8_t *) deen_emalloc(sizeof(unsigned char) * read_buffer_size);
 	size_t c_buffer_len = read_buffer_size;
 	size_t c_buffer_loadedlen = 0;
 
-	// find out the length of the file.
+	// the bytes of the buffer are classified in one go after each read so
+	// that the words can be found from the bits.
 
-	off_t file_last_line_offset = 0;
+	uint64_t *c_buffer_word_bits = (uint64_t *) deen_emalloc(sizeof(uint64_t) * ((read_buffer_size / 64) + 1));
+	uint64_t *c_buffer_usascii_word_bits = (uint64_t *) deen_emalloc(sizeof(uint64_t) * ((read_buffer_size / 64) + 1));
+
+	// the offsets here are relative to the start of the range.
+
+	off_t file_last_line_offset = from;
 	off_t file_lastread = 0;
 	off_t file_read = 0;
-	off_t file_len = lseek(fd,0,SEEK_END);
+	off_t range_len = to - from;
 
-	if (-1 == file_len) {
-		DEEN_LOG_ERROR0("unable to obtain the length of the file to be processed");
+	if (range_len < 0) {
+		DEEN_LOG_ERROR0("the range of the file to be processed is the wrong way around");
 		result = DEEN_FALSE;
 	}
 
 	if (result) {
 
-		if (-1 == lseek(fd,0,SEEK_SET)) {
-			DEEN_LOG_ERROR0("unable to return the file pointer back to the start of the file to be processed");
+		if (-1 == lseek(fd,from,SEEK_SET)) {
+			DEEN_LOG_ERROR0("unable to move the file pointer to the start of the range to be processed");
 			result = DEEN_FALSE;
 		}
 
@@ -539,7 +1208,12 @@ deen_bool deen_for_each_word_from_file(
 
 		while (
 			result &&
-			((file_lastread = read(fd, &c_buffer[c_buffer_loadedlen], c_buffer_len-c_buffer_loadedlen)) > 0) )
+			((file_lastread = read(
+				fd,
+				&c_buffer[c_buffer_loadedlen],
+				deen_for_each_word_from_file_range_read_len(
+					c_buffer_len-c_buffer_loadedlen,
+					range_len - file_read))) > 0) )
 		{
 			float progress;
                         deen_bool need_more_data;
@@ -549,9 +1223,13 @@ deen_bool deen_for_each_word_from_file(
 			DEEN_LOG_TRACE1("did read %u additional bytes", file_lastread);
 
 			file_read += file_lastread;
-			progress = (float) file_read / (float) file_len;
+			progress = (float) file_read / (float) range_len;
 			c_buffer_loadedlen += (size_t) file_lastread;
 
+			deen_classify_words(
+				simd_level, c_buffer, c_buffer_loadedlen,
+				c_buffer_word_bits, c_buffer_usascii_word_bits);
+
 			// find the next non-whitespace.
 
 			need_more_data = DEEN_FALSE;
@@ -560,18 +1238,32 @@ deen_bool deen_for_each_word_from_file(
 
 			while (!need_more_data && result) {
 
-				while (c_buffer_word_start < c_buffer_loadedlen && !ISWORDCHAR(c_buffer[c_buffer_word_start])) {
-					if ('\n' == c_buffer[c_buffer_word_start]) {
-						// want the index to the next line not the newline character itself.
-						file_last_line_offset = (file_read - (c_buffer_loadedlen - c_buffer_word_start)) + 1;
-					}
+				uint32_t c_buffer_skipped_from = c_buffer_word_start;
+				uint32_t c_buffer_newline;
 
-					c_buffer_word_start++;
+				c_buffer_word_start = (uint32_t) deen_find_bit(
+					c_buffer_word_bits, c_buffer_word_start, c_buffer_loadedlen, DEEN_TRUE);
+
+				// find the last newline in the bytes that were skipped.
+
+				c_buffer_newline = c_buffer_word_start;
+
+				while (c_buffer_newline > c_buffer_skipped_from && '\n' != c_buffer[c_buffer_newline - 1]) {
+					c_buffer_newline--;
+				}
+
+				if (c_buffer_newline > c_buffer_skipped_from) {
+					// want the index to the next line not the newline character itself.
+					file_last_line_offset = from + (file_read - (c_buffer_loadedlen - c_buffer_newline));
 				}
 
 				if (c_buffer_word_start < c_buffer_loadedlen) {
 
-					c_buffer_word_end = c_buffer_word_start;
+					// US-ASCII word characters are each a complete sequence
+					// so only the rest of the word needs to be checked.
+
+					c_buffer_word_end = (uint32_t) deen_find_bit(
+						c_buffer_usascii_word_bits, c_buffer_word_start, c_buffer_loadedlen, DEEN_FALSE);
 
 					while (
 						result &&
@@ -591,7 +1283,7 @@ deen_bool deen_for_each_word_from_file(
 									break;
 
 								case DEEN_BAD_SEQUENCE:
-									DEEN_LOG_ERROR1("bad utf8 sequence at %u", file_read - (c_buffer_loadedlen - c_buffer_word_end));
+									DEEN_LOG_ERROR1("bad utf8 sequence at %u", from + (file_read - (c_buffer_loadedlen - c_buffer_word_end)));
 									result = DEEN_FALSE;
 									break;
 
@@ -644,6 +1336,10 @@ deen_bool deen_for_each_word_from_file(
 				if (0 == c_buffer_word_end) {
 					c_buffer_len += sizeof(unsigned char) * read_buffer_size;
 					c_buffer = (uint8_t *) deen_erealloc(c_buffer, c_buffer_len);
+					c_buffer_word_bits = (uint64_t *) deen_erealloc(
+						c_buffer_word_bits, sizeof(uint64_t) * ((c_buffer_len / 64) + 1));
+					c_buffer_usascii_word_bits = (uint64_t *) deen_erealloc(
+						c_buffer_usascii_word_bits, sizeof(uint64_t) * ((c_buffer_len / 64) + 1));
 					DEEN_LOG_ERROR1("requiring a larger buffer for reading words from file; %u bytes", c_buffer_len);
 				}
 				else {
@@ -663,6 +1359,9 @@ deen_bool deen_for_each_word_from_file(
 		free((void *) c_buffer);
 	}
 
+	free((void *) c_buffer_word_bits);
+	free((void *) c_buffer_usascii_word_bits);
+
 	return result;
 }
 
@@ -672,8 +1371,31 @@ void deen_for_each_word(
 	deen_bool (*eachword_callback)(const uint8_t *s, size_t offset, size_t len, void *context),
 	void *context
 ) {
+	deen_for_each_word_n(s, offset, strlen((char *) &s[offset]), eachword_callback, context);
+}
 
-	size_t len = strlen((char *) &s[offset]);
+
+void deen_for_each_word_n(
+	const uint8_t *s, size_t offset, size_t len,
+	deen_bool (*eachword_callback)(const uint8_t *s, size_t offset, size_t len, void *context),
+	void *context
+) {
+
+	// the vector implementations deal with the whole blocks and then the
+	// rest is done one byte at a time.
+
+	switch (deen_get_simd_level()) {
+#ifdef DEEN_SIMD_X86
+		case DEEN_SIMD_AVX2:
+			offset = deen_simd_avx2_for_each_word(s, offset, len, eachword_callback, context);
+			break;
+		case DEEN_SIMD_SSE2:
+			offset = deen_simd_sse2_for_each_word(s, offset, len, eachword_callback, context);
+			break;
+#endif
+		default:
+			break;
+	}
 
 	while (offset < len) {
 		size_t end;
@@ -705,6 +1427,8 @@ void deen_for_each_word(
 // ENSURED MEMORY ALLOCATION
 // ---------------------------------------------------------------
 
+#ifndef DEEN_ALLOC_ACCOUNTING
+
 void *deen_emalloc(size_t size) {
 	void *r = (void *) malloc(size);
 	if (NULL==r) {
@@ -723,6 +1447,295 @@ void *deen_erealloc(void *ptr, size_t size) {
 	return r;
 }
 
+// ---------------------------------------------------------------
+
+void deen_alloc_accounting_log(const char *phase) {
+}
+
+// ---------------------------------------------------------------
+
+void deen_alloc_accounting_write(FILE *out) {
+}
+
+#else
+
+#ifndef __linux__
+#error "allocation accounting is only available on linux"
+#endif
+
+#include <malloc.h>
+#include <pthread.h>
+
+// limits the phases that are accounted; a phase nested deeper than this or
+// with a name beyond this many different names is not included.
+
+#define DEEN_ALLOC_PHASE_DEPTH_MAX 16
+#define DEEN_ALLOC_PHASE_NAMES_MAX 32
+
+enum deen_alloc_subsystem {
+	DEEN_ALLOC_COMMON = 0,
+	DEEN_ALLOC_INSTALL,
+	DEEN_ALLOC_INDEX,
+	DEEN_ALLOC_SEARCH,
+	DEEN_ALLOC_ENTRY,
+	DEEN_ALLOC_KEYWORD,
+	DEEN_ALLOC_RENDER,
+	DEEN_ALLOC_OTHER,
+	DEEN_ALLOC_SUBSYSTEM_COUNT
+};
+
+static const char *deen_alloc_subsystem_names[DEEN_ALLOC_SUBSYSTEM_COUNT] = {
+	"common", "install", "index", "search", "entry", "keyword", "render", "other"
+};
+
+typedef struct deen_alloc_counts deen_alloc_counts;
+struct deen_alloc_counts {
+	uint64_t calls;
+	uint64_t bytes;
+};
+
+// these are all accessed atomically because allocations are made from the
+// install and the batch worker threads.
+
+static deen_alloc_counts deen_global_alloc_counts[DEEN_ALLOC_SUBSYSTEM_COUNT];
+
+static uint64_t deen_global_alloc_live_bytes = 0;
+
+static uint64_t deen_global_alloc_peak_bytes = 0;
+
+
+/*
+The calls and bytes of each thread are counted separately so that the phases
+on a thread are able to be accounted even while other threads allocate.  The
+phases of a thread are begun and ended in a stack.
+*/
+
+typedef struct deen_alloc_phase deen_alloc_phase;
+struct deen_alloc_phase {
+	const char *name;
+	uint64_t count;
+	deen_alloc_counts counts;
+};
+
+static __thread deen_alloc_counts deen_alloc_thread_counts;
+
+static __thread deen_alloc_phase deen_alloc_thread_phases[DEEN_ALLOC_PHASE_DEPTH_MAX];
+
+static __thread uint32_t deen_alloc_thread_phase_depth = 0;
+
+// the totals of the phases that have ended on any thread.
+
+static pthread_mutex_t deen_global_alloc_phases_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static deen_alloc_phase deen_global_alloc_phases[DEEN_ALLOC_PHASE_NAMES_MAX];
+
+static uint32_t deen_global_alloc_phases_count = 0;
+
+
+/*
+Works out the subsystem from the leafname of the source file that made the
+allocation.
+*/
+
+static enum deen_alloc_subsystem deen_alloc_subsystem_for_file(const char *file) {
+	const char *leaf = strrchr(file, '/');
+
+	leaf = (NULL == leaf) ? file : leaf + 1;
+
+	if (0 == strncmp(leaf, "install", 7)) {
+		return DEEN_ALLOC_INSTALL;
+	}
+	if (0 == strncmp(leaf, "index", 5)
+		|| 0 == strncmp(leaf, "mapindex", 8)
+		|| 0 == strncmp(leaf, "postings", 8)) {
+		return DEEN_ALLOC_INDEX;
+	}
+	if (0 == strncmp(leaf, "search", 6)) {
+		return DEEN_ALLOC_SEARCH;
+	}
+	if (0 == strncmp(leaf, "entry", 5)) {
+		return DEEN_ALLOC_ENTRY;
+	}
+	if (0 == strncmp(leaf, "keyword", 7)) {
+		return DEEN_ALLOC_KEYWORD;
+	}
+	if (0 == strncmp(leaf, "render", 6)) {
+		return DEEN_ALLOC_RENDER;
+	}
+	if (0 == strncmp(leaf, "common", 6) || 0 == strncmp(leaf, "tracing", 7)) {
+		return DEEN_ALLOC_COMMON;
+	}
+
+	return DEEN_ALLOC_OTHER;
+}
+
+
+static void deen_alloc_count(const char *file, size_t size) {
+	deen_alloc_counts *counts = &deen_global_alloc_counts[deen_alloc_subsystem_for_file(file)];
+	__atomic_add_fetch(&counts->calls, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&counts->bytes, (uint64_t) size, __ATOMIC_RELAXED);
+	deen_alloc_thread_counts.calls++;
+	deen_alloc_thread_counts.bytes += (uint64_t) size;
+}
+
+
+static void deen_alloc_adjust_live(size_t added, size_t removed) {
+	uint64_t live = __atomic_add_fetch(&deen_global_alloc_live_bytes, (uint64_t) added - (uint64_t) removed, __ATOMIC_RELAXED);
+	uint64_t peak = __atomic_load_n(&deen_global_alloc_peak_bytes, __ATOMIC_RELAXED);
+
+	while (live > peak && !__atomic_compare_exchange_n(
+		&deen_global_alloc_peak_bytes, &peak, live,
+		DEEN_TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
+
+
+void *deen_emalloc_accounted(size_t size, const char *file) {
+	void *r = (void *) malloc(size);
+	if (NULL==r) {
+		deen_log_error_and_exit("memory exhaustion on malloc");
+	}
+	deen_alloc_count(file, size);
+	deen_alloc_adjust_live(malloc_usable_size(r), 0);
+	return r;
+}
+
+// ---------------------------------------------------------------
+
+void *deen_erealloc_accounted(void *ptr, size_t size, const char *file) {
+	size_t removed = (NULL == ptr) ? 0 : malloc_usable_size(ptr);
+	void *r = (void *) realloc(ptr,size);
+	if (NULL==r) {
+		deen_log_error_and_exit("memory exhaustion on realloc");
+	}
+	deen_alloc_count(file, size);
+	deen_alloc_adjust_live(malloc_usable_size(r), removed);
+	return r;
+}
+
+// ---------------------------------------------------------------
+
+void deen_free_accounted(void *ptr) {
+	if (NULL != ptr) {
+		deen_alloc_adjust_live(0, malloc_usable_size(ptr));
+		(free)(ptr);
+	}
+}
+
+// ---------------------------------------------------------------
+
+void deen_alloc_accounting_phase_begin(const char *name) {
+	if (deen_alloc_thread_phase_depth < DEEN_ALLOC_PHASE_DEPTH_MAX) {
+		deen_alloc_phase *phase = &deen_alloc_thread_phases[deen_alloc_thread_phase_depth];
+		phase->name = name;
+		phase->counts = deen_alloc_thread_counts;
+	}
+
+	deen_alloc_thread_phase_depth++;
+}
+
+// ---------------------------------------------------------------
+
+void deen_alloc_accounting_phase_end(const char *name) {
+	deen_alloc_phase *begun;
+	uint32_t i;
+
+	if (0 == deen_alloc_thread_phase_depth) {
+		return;
+	}
+
+	deen_alloc_thread_phase_depth--;
+
+	if (deen_alloc_thread_phase_depth >= DEEN_ALLOC_PHASE_DEPTH_MAX) {
+		return;
+	}
+
+	begun = &deen_alloc_thread_phases[deen_alloc_thread_phase_depth];
+
+	if (0 != strcmp(begun->name, name)) {
+		return;
+	}
+
+	pthread_mutex_lock(&deen_global_alloc_phases_lock);
+
+	for (i = 0; i < deen_global_alloc_phases_count && 0 != strcmp(deen_global_alloc_phases[i].name, name); i++) {
+	}
+
+	if (i == deen_global_alloc_phases_count && i < DEEN_ALLOC_PHASE_NAMES_MAX) {
+		memset(&deen_global_alloc_phases[i], 0, sizeof(deen_alloc_phase));
+		deen_global_alloc_phases[i].name = name;
+		deen_global_alloc_phases_count++;
+	}
+
+	if (i < deen_global_alloc_phases_count) {
+		deen_alloc_phase *total = &deen_global_alloc_phases[i];
+		total->count++;
+		total->counts.calls += deen_alloc_thread_counts.calls - begun->counts.calls;
+		total->counts.bytes += deen_alloc_thread_counts.bytes - begun->counts.bytes;
+	}
+
+	pthread_mutex_unlock(&deen_global_alloc_phases_lock);
+}
+
+// ---------------------------------------------------------------
+
+void deen_alloc_accounting_write(FILE *out) {
+	uint32_t i;
+
+	fprintf(out, "allocated bytes live; %llu\n",
+		(unsigned long long) __atomic_load_n(&deen_global_alloc_live_bytes, __ATOMIC_RELAXED));
+	fprintf(out, "allocated bytes peak; %llu\n",
+		(unsigned long long) __atomic_load_n(&deen_global_alloc_peak_bytes, __ATOMIC_RELAXED));
+
+	for (i = 0; i < DEEN_ALLOC_SUBSYSTEM_COUNT; i++) {
+		uint64_t calls = __atomic_load_n(&deen_global_alloc_counts[i].calls, __ATOMIC_RELAXED);
+
+		if (0 != calls) {
+			fprintf(out, "allocations in %s; %llu calls, %llu bytes\n",
+				deen_alloc_subsystem_names[i],
+				(unsigned long long) calls,
+				(unsigned long long) __atomic_load_n(&deen_global_alloc_counts[i].bytes, __ATOMIC_RELAXED));
+		}
+	}
+}
+
+// ---------------------------------------------------------------
+
+void deen_alloc_accounting_log(const char *phase) {
+	uint64_t live = __atomic_load_n(&deen_global_alloc_live_bytes, __ATOMIC_RELAXED);
+	uint64_t peak = __atomic_exchange_n(&deen_global_alloc_peak_bytes, live, __ATOMIC_RELAXED);
+	uint32_t i;
+
+	pthread_mutex_lock(&deen_global_alloc_phases_lock);
+
+	for (i = 0; i < deen_global_alloc_phases_count; i++) {
+		DEEN_LOG_INFO3("allocations during %s; %llu calls, %llu bytes",
+			deen_global_alloc_phases[i].name,
+			(unsigned long long) deen_global_alloc_phases[i].counts.calls,
+			(unsigned long long) deen_global_alloc_phases[i].counts.bytes);
+	}
+
+	deen_global_alloc_phases_count = 0;
+	pthread_mutex_unlock(&deen_global_alloc_phases_lock);
+
+	for (i = 0; i < DEEN_ALLOC_SUBSYSTEM_COUNT; i++) {
+		uint64_t calls = __atomic_exchange_n(&deen_global_alloc_counts[i].calls, 0, __ATOMIC_RELAXED);
+		uint64_t bytes = __atomic_exchange_n(&deen_global_alloc_counts[i].bytes, 0, __ATOMIC_RELAXED);
+
+		if (0 != calls) {
+			DEEN_LOG_INFO3("allocations in %s; %llu calls, %llu bytes",
+				deen_alloc_subsystem_names[i],
+				(unsigned long long) calls,
+				(unsigned long long) bytes);
+		}
+	}
+
+	DEEN_LOG_INFO3("allocations for %s; %llu bytes live, %llu bytes peak",
+		phase, (unsigned long long) live, (unsigned long long) peak);
+}
+
+#endif
+
 // ---------------------------------------------------------------
 // LOGGING
 // ---------------------------------------------------------------
@@ -764,16 +1777,18 @@ void deen_vlog(
 }
 
 
+// accessed atomically because it may be checked from a number of threads.
+
 static deen_bool deen_global_trace_enabled = DEEN_FALSE;
 
 
 void deen_set_trace_enabled(deen_bool flag) {
-	deen_global_trace_enabled = flag;
+	__atomic_store_n(&deen_global_trace_enabled, flag, __ATOMIC_RELAXED);
 }
 
 
 deen_bool deen_is_trace_enabled() {
-	return deen_global_trace_enabled;
+	return __atomic_load_n(&deen_global_trace_enabled, __ATOMIC_RELAXED);
 }
 
 
@@ -11,6 +11,7 @@
 
 #include <ctype.h>
 #include <stdarg.h>
+#include <stdio.h>
 #include <sys/time.h>
 
 #include "constants.h"
@@ -27,6 +28,8 @@ The caller maintains ownership of this data and should free it.
 char *deen_root_dir();
 char *deen_data_path(const char *root_dir);
 char *deen_index_path(const char *root_dir);
+char *deen_mapindex_path(const char *root_dir);
+char *deen_socket_path(const char *root_dir);
 
 // ---------------------------------------------------------------
 // UTILITY
@@ -36,6 +39,8 @@ time_t deen_seconds_since_epoc();
 
 deen_millis deen_millis_since_epoc();
 
+deen_micros deen_micros_since_epoc();
+
 // ---------------------------------------------------------------
 // STRINGS
 // ---------------------------------------------------------------
@@ -100,6 +105,26 @@ deen_bool deen_for_each_word_from_file(
 		void *context),
 	void *context);
 
+/*
+This performs the same function as 'deen_for_each_word_from_file', but only
+for the bytes of the file from offset 'from' (inclusive) to 'to' (exclusive).
+The 'from' offset is expected to be at the start of a line and the progress
+that is reported is relative to the range.
+*/
+
+deen_bool deen_for_each_word_from_file_range(
+	size_t read_buffer_size,
+	int fd,
+	off_t from,
+	off_t to,
+	deen_bool (*process_callback)(
+		const uint8_t *s,
+		size_t len,
+		off_t ref, // offset after last newline.
+		float progress,
+		void *context),
+	void *context);
+
 /*
 For each non-trivial word in the source text, call the callback function.
 */
@@ -111,6 +136,37 @@ void deen_for_each_word(
 	void *context
 );
 
+/*
+This performs the same function as 'deen_for_each_word', but the source text
+need not be NULL terminated; only the bytes up to 'len' are considered.
+*/
+
+void deen_for_each_word_n(
+	const uint8_t *s,
+	size_t offset,
+	size_t len,
+	deen_bool (*eachword_callback)(const uint8_t *s, size_t offset, size_t len, void *context),
+	void *context
+);
+
+
+/*
+The vector implementations of the string handling functions are chosen when
+they are first needed based on what the processor supports.  They are only
+used if the character classification is that of the "C" locale.  The
+environment variable DEENSIMD can be set to "scalar", "sse2" or "avx2" to
+limit the implementations that are used.
+*/
+
+deen_simd_level deen_get_simd_level();
+
+/*
+Sets the implementations to use.  The level is limited to what the processor
+supports.  This is intended for testing and should be used before any threads
+are started.
+*/
+
+void deen_set_simd_level(deen_simd_level level);
 
 /*
 This function will replace US-ASCII characters with their upper case equivalent
@@ -119,6 +175,25 @@ as well as any german accented characters such as a-umlaut, o-umlaut etc..
 
 void deen_to_upper(uint8_t *s);
 
+/*
+Replaces the upper case umlauts and the sharp s in the string with the two
+US-ASCII characters that are commonly used to spell them; for example
+o-umlaut becomes "OE".  The string should already be upper case.  Each of
+these characters is two bytes in UTF-8 and so the length of the string is
+unchanged.  This is used so that the different spellings of a word share the
+same entry in the index.
+*/
+
+void deen_fold_umlauts(uint8_t *s);
+
+/*
+If the two US-ASCII characters at 's' are a spelling of an upper case umlaut
+or the sharp s then this returns the byte that follows 0xc3 in the UTF-8
+sequence for it.  Otherwise it returns zero.
+*/
+
+uint8_t deen_umlaut_for_usascii_pair(const uint8_t *s);
+
 /*
 Does the string 'f' exist in the string 's' at the offet location 'at'?  The
 comparison is done case insensitvely.
@@ -156,9 +231,62 @@ These functions will perform the same role as malloc and realloc, but they
 will cause the program to exit if the memory was not able to allocated.
 */
 
+#ifndef DEEN_ALLOC_ACCOUNTING
+
 void *deen_emalloc(size_t size);
 void *deen_erealloc(void *ptr, size_t size);
 
+#else
+
+/*
+When built with DEEN_ALLOC_ACCOUNTING defined, the ensured allocations are
+counted against the subsystem of the source file that makes them and the bytes
+that are live are tracked as memory is freed.  Memory that was not allocated
+with these functions, such as that from open_memstream, has to be released
+with (free) so that it bypasses the accounting.  Accounting is only available
+on Linux.
+*/
+
+#include <stdlib.h>
+
+void *deen_emalloc_accounted(size_t size, const char *file);
+void *deen_erealloc_accounted(void *ptr, size_t size, const char *file);
+void deen_free_accounted(void *ptr);
+
+#define deen_emalloc(SIZE) deen_emalloc_accounted(SIZE, __FILE__)
+#define deen_erealloc(PTR, SIZE) deen_erealloc_accounted(PTR, SIZE, __FILE__)
+#define free(PTR) deen_free_accounted(PTR)
+
+/*
+The phases are the spans that are traced; beginning and ending a span also
+begins and ends a phase on the current thread, whether or not tracing is
+enabled.  The calls and bytes that are allocated by a thread during a phase
+are added to the totals for phases of that name.  Phases on a thread must be
+nested.
+*/
+
+void deen_alloc_accounting_phase_begin(const char *name);
+void deen_alloc_accounting_phase_end(const char *name);
+
+#endif
+
+/*
+Logs the allocation calls and bytes for each phase and for each subsystem as
+well as the live and peak bytes since the last time that this was called.
+The phase names what has happened in that time such as an install.  This does
+nothing unless the allocations are being accounted.
+*/
+
+void deen_alloc_accounting_log(const char *phase);
+
+/*
+Writes the live and peak bytes as well as the allocation calls and bytes for
+each subsystem to the stream without resetting them.  This writes nothing
+unless the allocations are being accounted.
+*/
+
+void deen_alloc_accounting_write(FILE *out);
+
 // ---------------------------------------------------------------
 // LOGGING
 // ---------------------------------------------------------------
@@ -1,5 +1,5 @@
 /*
- * Copyright 2016-2017, Andrew Lindesay. All Rights Reserved.
+ * Copyright 2016-2019, Andrew Lindesay. All Rights Reserved.
  * Distributed under the terms of the MIT License.
  *
  * Authors:
@@ -45,6 +45,60 @@ pushed into the tree.
 
 #define DEEN_INDEXING_DEPTH 4
 
+/*
+This is the largest number of bytes that a prefix could occupy including the
+terminating NULL; each unicode character might be as many as four bytes once
+encoded as UTF-8.
+*/
+
+#define DEEN_INDEXING_PREFIX_SIZE ((DEEN_INDEXING_DEPTH * 4) + 1)
+
+/*
+The binary index also has a dictionary of the whole words, termed 'terms',
+that are longer than DEEN_INDEXING_DEPTH.  A longer keyword is looked up as the
+range of terms that start with it rather than by its prefix.  Terms are cut off
+at this many characters.
+*/
+
+#define DEEN_INDEXING_TERM_DEPTH 20
+#define DEEN_INDEXING_TERM_SIZE ((DEEN_INDEXING_TERM_DEPTH * 4) + 1)
+
+/*
+A search context keeps the refs of this many of the prefixes that it has most
+recently looked up in the sqlite database so that repeated and refined
+searches need not fetch them again.
+*/
+
+#define DEEN_SEARCH_LOOKUP_CACHE_SIZE 16
+
+/*
+When this is true, the installation process will collect all of the prefixes
+and references in memory and will then write them to the database in one bulk
+pass at the end.  When false, each line of the data is written to the database
+as it is processed.
+*/
+
+#define DEEN_INSTALL_INDEX_IN_MEMORY DEEN_TRUE
+
+/*
+When the index is accumulated in memory, the data is split into chunks that
+are indexed concurrently; one thread for each chunk.  The number of threads is
+derived from the number of processors, but each thread should have at least
+this many bytes to work on so that small files do not incur the overhead.
+The environment variable DEENINSTALLTHREADS can be used to override the number
+of threads.
+*/
+
+#define DEEN_INSTALL_THREAD_MIN_BYTES (1024 * 1024)
+#define DEEN_INSTALL_THREADS_MAX 32
+
+/*
+While the threads are indexing, the main thread will wake up at this interval
+in order to report progress and to check for cancellation.
+*/
+
+#define DEEN_INSTALL_THREAD_POLL_MILLIS 100
+
 /*
 A word must have at least this many characters to be
 worth indexing.
@@ -52,11 +106,36 @@ worth indexing.
 
 #define DEEN_INDEXING_MIN 3
 
+/*
+A keyword is able to be spelled with an umlaut or with the two US-ASCII
+characters that stand for it at each place that such a pair appears.  Each
+place doubles the number of spellings and so only up to this many places are
+considered.
+*/
+
+#define DEEN_KEYWORD_SPELLING_PAIRS_MAX 6
+
 // This constant controls how many results to show by default.
 
 #define DEEN_RESULT_SIZE_DEFAULT 10
 #define DEEN_RESULT_SIZE_MAX SIZE_MAX
 
+/*
+When tracing is enabled, each thread keeps up to this many of its most recent
+events.
+*/
+
+#define DEEN_TRACING_BUFFER_SIZE (64 * 1024)
+
+/*
+In batch mode, the output for each search expression is followed by a line
+containing only the ASCII record separator character.  The searches may be
+performed by up to this many workers concurrently.
+*/
+
+#define DEEN_BATCH_RECORD_SEPARATOR "\x1e\n"
+#define DEEN_BATCH_WORKERS_MAX 64
+
 /**
  * This constant is used when establishing the distance that a word is
  * from the keywords.  This value really means that the entry does not
@@ -68,7 +147,41 @@ worth indexing.
 #define DEEN_NOT_FOUND SIZE_MAX
 
 #define DEEN_LEAF_INDEX "deen.idx.sqllite3"
+#define DEEN_LEAF_MAPINDEX "deen.idx.map"
 #define DEEN_LEAF_DING_DATA "de-en.txt"
+#define DEEN_LEAF_SOCKET "deen.sock"
+
+/*
+These values identify the read-only binary index that is memory-mapped for
+searching.  If the format of the file changes then the version should be
+incremented so that older files are no longer used.
+*/
+
+#define DEEN_MAPINDEX_MAGIC "DEENMIDX"
+#define DEEN_MAPINDEX_MAGIC_SIZE 8
+#define DEEN_MAPINDEX_VERSION 4
+
+/*
+This is the version of the sqlite database index.  As with the binary index,
+it should be incremented when the contents of the index change.
+*/
+
+#define DEEN_INDEX_VERSION 2
+
+/*
+Each prefix in the binary index is stored in a fixed size field which is
+padded with zeros.
+*/
+
+#define DEEN_MAPINDEX_PREFIX_SIZE 20
+
+/*
+The refs of a posting list are compressed in blocks of up to this many refs.
+Each block starts with a ref held in a skip table and then the remaining refs
+are stored as varint deltas.
+*/
+
+#define DEEN_POSTINGS_BLOCK_SIZE 128
 
 #define DIR_DEEN ".deen"
 
@@ -12,90 +12,199 @@
 
 #include "common.h"
 #include "constants.h"
+#include "entry.h"
+#include "entry_parse.h"
+#include "keyword.h"
 
 // ---------------------------------------------------------------
 // CREATION
 // ---------------------------------------------------------------
 
+#define DEEN_ENTRY_ARENA_TEXT_SIZE_DEFAULT 1024
+#define DEEN_ENTRY_ARENA_ARRAY_SIZE_DEFAULT 64
 
-extern void deen_entry_create_yy(
-	const uint8_t *data,
-	deen_entry_sub **subs,
-	uint32_t *sub_count);
-
+/*
+Grows an array of the arena by doubling it so that it has room for at least
+one more item.
+*/
 
-deen_entry deen_entry_create(
-	const uint8_t *german,
-	const uint8_t *english) {
+static void *deen_entry_arena_grow(void *items, size_t item_size, uint32_t *allocated) {
+	*allocated = (0 == *allocated) ? DEEN_ENTRY_ARENA_ARRAY_SIZE_DEFAULT : *allocated * 2;
+	return deen_erealloc(items, item_size * (*allocated));
+}
 
-	deen_entry result;
 
-	deen_entry_create_yy(
-		german,
-		&(result.german_subs),
-		&(result.german_sub_count));
+void deen_entry_arena_init(deen_entry_arena *arena) {
+	memset(arena, 0, sizeof(deen_entry_arena));
+}
 
-	deen_entry_create_yy(
-		english,
-		&(result.english_subs),
-		&(result.english_sub_count));
 
-	return result;
+void deen_entry_arena_free(deen_entry_arena *arena) {
+	free((void *) arena->text);
+	free((void *) arena->atoms);
+	free((void *) arena->sub_subs);
+	free((void *) arena->subs);
+	deen_entry_arena_init(arena);
 }
 
 
-// ---------------------------------------------------------------
-// FREEING DATA
-// ---------------------------------------------------------------
+/*
+The sub sub, sub and atom being added to are always the last ones in their
+arrays so adding to them is just a matter of appending.
+*/
 
+static void deen_entry_arena_push_sub_sub(deen_entry_arena *arena) {
+	deen_entry_sub_sub *sub_sub;
 
-static void deen_entry_atom_free(deen_entry_atom *atom) {
-	if (NULL!=atom) {
-		if (NULL!=atom->text) {
-			free((void *) atom->text);
-		}
+	if (arena->sub_sub_count == arena->sub_subs_allocated) {
+		arena->sub_subs = (deen_entry_sub_sub *) deen_entry_arena_grow(
+			arena->sub_subs, sizeof(deen_entry_sub_sub), &(arena->sub_subs_allocated));
 	}
+
+	sub_sub = &(arena->sub_subs[arena->sub_sub_count]);
+	sub_sub->atoms_offset = arena->atom_count;
+	sub_sub->atom_count = 0;
+	arena->sub_sub_count++;
+	arena->subs[arena->sub_count - 1].sub_sub_count++;
 }
 
 
-static void deen_entry_sub_sub_free(deen_entry_sub_sub *sub_sub) {
-	if (NULL != sub_sub) {
-		uint32_t i;
+static void deen_entry_arena_push_sub(deen_entry_arena *arena) {
+	deen_entry_sub *sub;
 
-		for (i=0;i<sub_sub->atom_count;i++) {
-			deen_entry_atom_free(&(sub_sub->atoms[i]));
-		}
+	if (arena->sub_count == arena->subs_allocated) {
+		arena->subs = (deen_entry_sub *) deen_entry_arena_grow(
+			arena->subs, sizeof(deen_entry_sub), &(arena->subs_allocated));
+	}
+
+	sub = &(arena->subs[arena->sub_count]);
+	sub->sub_subs_offset = arena->sub_sub_count;
+	sub->sub_sub_count = 0;
+	arena->sub_count++;
+
+	deen_entry_arena_push_sub_sub(arena);
+}
+
+
+static void deen_entry_arena_push_atom(
+	deen_entry_arena *arena,
+	enum deen_entry_atom_type type,
+	size_t offset,
+	size_t len) {
+
+	deen_entry_atom *atom;
 
-		free((void *) sub_sub->atoms);
+	if (arena->atom_count == arena->atoms_allocated) {
+		arena->atoms = (deen_entry_atom *) deen_entry_arena_grow(
+			arena->atoms, sizeof(deen_entry_atom), &(arena->atoms_allocated));
 	}
+
+	atom = &(arena->atoms[arena->atom_count]);
+	atom->type = type;
+	atom->offset = (uint32_t) offset;
+	atom->len = (uint32_t) len;
+	arena->atom_count++;
+	arena->sub_subs[arena->sub_sub_count - 1].atom_count++;
 }
 
 
-static void deen_entry_sub_free(deen_entry_sub *sub) {
-	if (NULL!=sub) {
-		uint32_t i;
+static deen_bool deen_entry_arena_parse_callback(
+	const uint8_t *s,
+	enum deen_entry_parse_event event,
+	enum deen_entry_atom_type atom_type,
+	size_t offset,
+	size_t len,
+	void *context) {
+
+	deen_entry_arena *arena = (deen_entry_arena *) context;
 
-		for (i=0;i<sub->sub_sub_count;i++) {
-			deen_entry_sub_sub_free(&(sub->sub_subs[i]));
-		}
+	switch (event) {
+
+		case PARSE_EVENT_ATOM:
+			DEEN_LOG_TRACE3("  +atom; %d : >%.*s<", atom_type, (int) len, &s[offset]);
+			deen_entry_arena_push_atom(arena, atom_type, offset, len);
+			break;
+
+		case PARSE_EVENT_SUB_SUB:
+			deen_entry_arena_push_sub_sub(arena);
+			break;
+
+		case PARSE_EVENT_SUB:
+			deen_entry_arena_push_sub(arena);
+			break;
 
-		free((void *) sub->sub_subs);
 	}
+
+	return DEEN_TRUE;
+}
+
+
+/*
+Parses the text from the offset up to 'to' into subs that are appended to
+the arena and returns the number of them.
+*/
+
+static uint32_t deen_entry_arena_parse(deen_entry_arena *arena, size_t offset, size_t to) {
+	uint32_t sub_count_before = arena->sub_count;
+
+	deen_entry_arena_push_sub(arena);
+	deen_entry_parse(arena->text, offset, to, &deen_entry_arena_parse_callback, arena);
+
+	return arena->sub_count - sub_count_before;
+}
+
+
+deen_entry deen_entry_create(
+	deen_entry_arena *arena,
+	const uint8_t *german,
+	const uint8_t *english) {
+
+	return deen_entry_create_n(
+		arena,
+		german, strlen((const char *) german),
+		english, strlen((const char *) english));
 }
 
 
-void deen_entry_free(deen_entry *entry) {
-	if (NULL!=entry) {
-		uint32_t i;
+deen_entry deen_entry_create_n(
+	deen_entry_arena *arena,
+	const uint8_t *german,
+	size_t german_len,
+	const uint8_t *english,
+	size_t english_len) {
+
+	deen_entry result;
+	size_t german_offset = arena->text_len;
+	size_t english_offset = german_offset + german_len + 1;
+	size_t text_len = english_offset + english_len + 1;
+
+	// the arena takes a copy of the text so that the atoms are able to refer
+	// into it.
 
-		for (i=0;i<entry->english_sub_count;i++) {
-			deen_entry_sub_free(&(entry->english_subs[i]));
+	if (text_len > arena->text_allocated) {
+		if (0 == arena->text_allocated) {
+			arena->text_allocated = DEEN_ENTRY_ARENA_TEXT_SIZE_DEFAULT;
 		}
 
-		for (i=0;i<entry->german_sub_count;i++) {
-			deen_entry_sub_free(&(entry->german_subs[i]));
+		while (text_len > arena->text_allocated) {
+			arena->text_allocated *= 2;
 		}
+
+		arena->text = (uint8_t *) deen_erealloc(arena->text, arena->text_allocated);
 	}
+
+	memcpy(&(arena->text[german_offset]), german, german_len);
+	arena->text[german_offset + german_len] = 0;
+	memcpy(&(arena->text[english_offset]), english, english_len);
+	arena->text[english_offset + english_len] = 0;
+	arena->text_len = text_len;
+
+	result.subs_offset = arena->sub_count;
+	result.german_sub_count = deen_entry_arena_parse(arena, german_offset, german_offset + german_len);
+	result.english_sub_count = deen_entry_arena_parse(arena, english_offset, english_offset + english_len);
+	result.distance_from_keywords = 0;
+
+	return result;
 }
 
 
@@ -110,48 +219,32 @@ typedef struct
 struct deen_entry_calculate_distance_from_keywords_foreachword_callback_state
 {
 	uint32_t accumulated_distance_from_keyword;
-	deen_keywords *keywords;
-	deen_bool *keyword_use_map; // boolean
+	deen_keywords_matcher *matcher;
 };
 
 
-size_t deen_entry_find_first_keyword(
-	const uint8_t *s,
-	deen_keywords *keywords,
-	uint32_t offset) {
-	uint32_t i;
-
-	for (i=0;i<keywords->count;i++) {
-		if (deen_imatches_at(s, keywords->keywords[i], offset)) {
-			return i;
-		}
-	}
-
-	return DEEN_NOT_FOUND;
-}
-
-
 deen_bool deen_entry_calculate_distance_from_keywords_foreachword_callback(
 	const uint8_t *s, size_t offset, size_t len, void *context) {
 
 	deen_entry_calculate_distance_from_keywords_foreachword_callback_state *state =
 		(deen_entry_calculate_distance_from_keywords_foreachword_callback_state *) context;
+	size_t keyword_len;
 
 		// find the first keyword at the start of this string.
 
-	size_t keyword_offset = deen_entry_find_first_keyword(s, state->keywords, offset);
+	size_t keyword_offset = deen_keywords_matcher_find_at(state->matcher, s, offset, len, &keyword_len);
 
 	if (DEEN_NOT_FOUND == keyword_offset) {
 		state->accumulated_distance_from_keyword += (uint32_t) len;
 	}
 	else {
-		size_t keyword_len;
 		size_t sequence_count;
 
-		state->keyword_use_map[keyword_offset] = DEEN_TRUE;
+		deen_keywords_matcher_mark(state->matcher, keyword_offset);
 
 		// how many letters (decoded from UTF-8) remain in the rest of the word?
-		keyword_len = strlen((char *) state->keywords->keywords[keyword_offset]);
+		// if the data is not valid UTF-8 then the bytes are counted instead
+		// so that one bad line does not prevent the search from completing.
 
 		switch (deen_utf8_sequences_count(&s[offset + keyword_len], len-keyword_len, &sequence_count)) {
 
@@ -160,11 +253,13 @@ deen_bool deen_entry_calculate_distance_from_keywords_foreachword_callback(
 				break;
 
 			case DEEN_BAD_SEQUENCE:
-				deen_log_error_and_exit("encountered bad utf-8 sequence");
+				DEEN_LOG_ERROR0("encountered bad utf-8 sequence");
+				state->accumulated_distance_from_keyword += (uint32_t) (len - keyword_len);
 				break;
 
 			case DEEN_INCOMPLETE_SEQUENCE:
-				deen_log_error_and_exit("encountered incomplete utf-8 sequence");
+				DEEN_LOG_ERROR0("encountered incomplete utf-8 sequence");
+				state->accumulated_distance_from_keyword += (uint32_t) (len - keyword_len);
 				break;
 
 		}
@@ -181,34 +276,31 @@ add all of those up.  Keywords are expected to be in order with largest first.
 */
 
 static uint32_t deen_entry_sub_sub_calculate_distance_from_keywords(
+	deen_entry_arena *arena,
 	deen_entry_sub_sub *sub_sub,
-	deen_keywords *keywords,
-	deen_bool *keyword_use_map) {
+	deen_keywords_matcher *matcher) {
 	
 	deen_entry_calculate_distance_from_keywords_foreachword_callback_state state;
 	uint32_t i;
 
-	memset(keyword_use_map, 0, (sizeof(deen_bool) * keywords->count));
+	deen_keywords_matcher_clear_marks(matcher);
 
-	state.keywords = keywords;
-	state.keyword_use_map = keyword_use_map;
+	state.matcher = matcher;
 	state.accumulated_distance_from_keyword = 0;
 
 	for (i=0;i<sub_sub->atom_count;i++) {
+		deen_entry_atom *atom = &(arena->atoms[sub_sub->atoms_offset + i]);
 
-		if (ATOM_TEXT == sub_sub->atoms[i].type) {
-
-			deen_for_each_word(
-				sub_sub->atoms[i].text, 0,
+		if (ATOM_TEXT == atom->type) {
+			deen_for_each_word_n(
+				arena->text, atom->offset, atom->offset + atom->len,
 				&deen_entry_calculate_distance_from_keywords_foreachword_callback,
 				&state);
 		}
 	}
 
-	for (i=0;i<keywords->count;i++) {
-		if (!keyword_use_map[i]) {
-			return DEEN_MAX_SORT_DISTANCE_FROM_KEYWORDS;
-		}
+	if (!deen_keywords_matcher_all_marked(matcher)) {
+		return DEEN_MAX_SORT_DISTANCE_FROM_KEYWORDS;
 	}
 
 	return state.accumulated_distance_from_keyword;
@@ -216,16 +308,16 @@ static uint32_t deen_entry_sub_sub_calculate_distance_from_keywords(
 
 
 static uint32_t deen_entry_sub_calculate_distance_from_keywords(
+	deen_entry_arena *arena,
 	deen_entry_sub *sub,
-	deen_keywords *keywords,
-	deen_bool *keyword_use_map) {
+	deen_keywords_matcher *matcher) {
 
 	uint32_t i;
-	int result = DEEN_MAX_SORT_DISTANCE_FROM_KEYWORDS;
+	uint32_t result = DEEN_MAX_SORT_DISTANCE_FROM_KEYWORDS;
 
 	for (i=0;i<sub->sub_sub_count;i++) {
 		uint32_t sub_sub_result = deen_entry_sub_sub_calculate_distance_from_keywords(
-			&sub->sub_subs[i], keywords, keyword_use_map);
+			arena, &(arena->sub_subs[sub->sub_subs_offset + i]), matcher);
 
 		if (sub_sub_result < result) {
 			result = sub_sub_result;
@@ -237,10 +329,10 @@ static uint32_t deen_entry_sub_calculate_distance_from_keywords(
 
 
 static uint32_t deen_entry_subs_calculate_distance_from_keywords(
-	deen_entry_sub *subs,
+	deen_entry_arena *arena,
+	uint32_t subs_offset,
 	uint32_t sub_count,
-	deen_keywords *keywords,
-	deen_bool *keyword_use_map) {
+	deen_keywords_matcher *matcher) {
 
 	uint32_t result = DEEN_MAX_SORT_DISTANCE_FROM_KEYWORDS;
 	uint32_t i;
@@ -248,9 +340,9 @@ static uint32_t deen_entry_subs_calculate_distance_from_keywords(
 	for (i=0;i < sub_count;i++) {
 
 		uint32_t sub_result = deen_entry_sub_calculate_distance_from_keywords(
-			&subs[i],
-			keywords,
-			keyword_use_map);
+			arena,
+			&(arena->subs[subs_offset + i]),
+			matcher);
 
 		DEEN_LOG_TRACE2(" %u) distance from keyword; %u", i, sub_result);
 
@@ -264,15 +356,144 @@ static uint32_t deen_entry_subs_calculate_distance_from_keywords(
 
 
 uint32_t deen_entry_calculate_distance_from_keywords(
+	deen_entry_arena *arena,
 	deen_entry *entry,
-	deen_keywords *keywords,
-	deen_bool *keyword_use_map) {
+	deen_keywords_matcher *matcher) {
 
 	uint32_t german_result = deen_entry_subs_calculate_distance_from_keywords(
-		entry->german_subs, entry->german_sub_count, keywords, keyword_use_map);
+		arena,
+		entry->subs_offset, entry->german_sub_count,
+		matcher);
 
 	uint32_t english_result = deen_entry_subs_calculate_distance_from_keywords(
-		entry->english_subs, entry->english_sub_count, keywords, keyword_use_map);
+		arena,
+		entry->subs_offset + entry->german_sub_count, entry->english_sub_count,
+		matcher);
+
+	if (german_result < english_result) {
+		return german_result;
+	}
+
+	return english_result;
+}
+
+
+// ---------------------------------------------------------------
+// SCORING RAW TEXT
+// ---------------------------------------------------------------
+
+/*
+The functions below score the text of a line without creating an entry.  The
+text is parsed in the same way as it would be to create an entry, but only
+the text atoms are scored as they are found.
+*/
+
+typedef struct deen_entry_raw_state deen_entry_raw_state;
+struct deen_entry_raw_state {
+	deen_entry_calculate_distance_from_keywords_foreachword_callback_state word_state;
+	uint32_t result;
+	uint32_t sub_count;
+};
+
+
+/*
+Adds the distance of the sub sub that has just been scored to the result and
+then resets the state ready for the next sub sub.
+*/
+
+static void deen_entry_raw_sub_sub_end(deen_entry_raw_state *state) {
+	deen_entry_calculate_distance_from_keywords_foreachword_callback_state *word_state = &(state->word_state);
+	uint32_t sub_sub_result = word_state->accumulated_distance_from_keyword;
+
+	if (!deen_keywords_matcher_all_marked(word_state->matcher)) {
+		sub_sub_result = DEEN_MAX_SORT_DISTANCE_FROM_KEYWORDS;
+	}
+
+	if (sub_sub_result < state->result) {
+		state->result = sub_sub_result;
+	}
+
+	deen_keywords_matcher_clear_marks(word_state->matcher);
+	word_state->accumulated_distance_from_keyword = 0;
+}
+
+
+static deen_bool deen_entry_raw_parse_callback(
+	const uint8_t *s,
+	enum deen_entry_parse_event event,
+	enum deen_entry_atom_type atom_type,
+	size_t offset,
+	size_t len,
+	void *context) {
+
+	deen_entry_raw_state *state = (deen_entry_raw_state *) context;
+
+	switch (event) {
+
+		case PARSE_EVENT_ATOM:
+			if (ATOM_TEXT == atom_type) {
+				deen_for_each_word_n(
+					s, offset, offset + len,
+					&deen_entry_calculate_distance_from_keywords_foreachword_callback,
+					&(state->word_state));
+			}
+			break;
+
+		case PARSE_EVENT_SUB_SUB:
+			deen_entry_raw_sub_sub_end(state);
+			break;
+
+		case PARSE_EVENT_SUB:
+			deen_entry_raw_sub_sub_end(state);
+			state->sub_count++;
+			break;
+
+	}
+
+	return DEEN_TRUE;
+}
+
+
+static uint32_t deen_entry_raw_subs_calculate_distance_from_keywords(
+	const uint8_t *s,
+	size_t len,
+	deen_keywords_matcher *matcher,
+	uint32_t *sub_count) {
+
+	deen_entry_raw_state state;
+
+	deen_keywords_matcher_clear_marks(matcher);
+
+	state.word_state.matcher = matcher;
+	state.word_state.accumulated_distance_from_keyword = 0;
+	state.result = DEEN_MAX_SORT_DISTANCE_FROM_KEYWORDS;
+	state.sub_count = 1;
+
+	deen_entry_parse(s, 0, len, &deen_entry_raw_parse_callback, &state);
+
+	deen_entry_raw_sub_sub_end(&state);
+
+	*sub_count = state.sub_count;
+
+	return state.result;
+}
+
+
+uint32_t deen_entry_calculate_distance_from_keywords_n(
+	const uint8_t *german,
+	size_t german_len,
+	const uint8_t *english,
+	size_t english_len,
+	deen_keywords_matcher *matcher,
+	uint32_t *german_sub_count) {
+
+	uint32_t english_sub_count;
+
+	uint32_t german_result = deen_entry_raw_subs_calculate_distance_from_keywords(
+		german, german_len, matcher, german_sub_count);
+
+	uint32_t english_result = deen_entry_raw_subs_calculate_distance_from_keywords(
+		english, english_len, matcher, &english_sub_count);
 
 	if (german_result < english_result) {
 		return german_result;
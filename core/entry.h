@@ -11,19 +11,62 @@
 
 #include "common.h"
 
-deen_entry deen_entry_create(const uint8_t *german, const uint8_t *english);
+/*
+The parts of entries are held in an arena.  An arena that has been freed may
+be used again.
+*/
+
+void deen_entry_arena_init(deen_entry_arena *arena);
+
+void deen_entry_arena_free(deen_entry_arena *arena);
+
+/*
+Creates an entry from the german and english text with its parts added to
+the arena.  The arena takes a copy of the text.  The entry is only valid for
+as long as the arena is.
+*/
+
+deen_entry deen_entry_create(
+	deen_entry_arena *arena,
+	const uint8_t *german,
+	const uint8_t *english);
 
-void deen_entry_free(deen_entry *entry);
+/*
+This performs the same function as 'deen_entry_create', but the german and
+the english text need not be NULL terminated.
+*/
+
+deen_entry deen_entry_create_n(
+	deen_entry_arena *arena,
+	const uint8_t *german,
+	size_t german_len,
+	const uint8_t *english,
+	size_t english_len);
 
 /*
- The 'keyword_use_map' parameter here is a buffer that can be re-used between
- invocations.  The output of this buffer is not meaningful.  This just avoids
- needing to continuously re-allocate and free the memory for this buffer.
+ The 'matcher' is compiled from the keywords once and can then be re-used
+ between invocations.  The marks that it holds afterwards are not meaningful.
  */
 
-int deen_entry_calculate_distance_from_keywords(
+uint32_t deen_entry_calculate_distance_from_keywords(
+	deen_entry_arena *arena,
 	deen_entry *entry,
-	deen_keywords *keywords,
-	deen_bool *keyword_use_map);
+	deen_keywords_matcher *matcher);
+
+/*
+ This arrives at the same distance as 'deen_entry_calculate_distance_from_keywords'
+ but it works directly on the german and english text of a line so that no
+ entry needs to be created.  The text need not be NULL terminated.  The number
+ of german subs is also returned as it is used to order entries that are the
+ same distance from the keywords.
+ */
+
+uint32_t deen_entry_calculate_distance_from_keywords_n(
+	const uint8_t *german,
+	size_t german_len,
+	const uint8_t *english,
+	size_t english_len,
+	deen_keywords_matcher *matcher,
+	uint32_t *german_sub_count);
 
 #endif /* __ENTRY_H */
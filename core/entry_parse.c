@@ -0,0 +1,193 @@
+/*
+ * Copyright 2016-2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+#include "entry_parse.h"
+
+#include "common.h"
+
+/*
+The text was originally split up by a 'flex' scanner and the rules here
+arrive at exactly the same atoms as that did so that the rendering of the
+entries is unchanged.  In summary;
+
+  - spaces around '{', '}', '[', ']', '|' and ';' are not part of any atom
+  - text runs up to the next '{', '[' or '|' but does not end with a space
+    or ';' and is at least three characters long; otherwise a single
+    character is text on its own
+  - grammar and context run up to the closing bracket or the end
+  - tabs and line endings between atoms are ignored
+*/
+
+static deen_bool deen_entry_parse_is_special(uint8_t c) {
+	return ' ' == c || '{' == c || '[' == c || '|' == c || ';' == c;
+}
+
+
+static size_t deen_entry_parse_skip_spaces(const uint8_t *s, size_t offset, size_t to) {
+	while (offset < to && ' ' == s[offset]) {
+		offset++;
+	}
+
+	return offset;
+}
+
+
+/*
+Returns the length of the text that starts at the offset or zero if there is
+no text of at least three characters there.
+*/
+
+static size_t deen_entry_parse_text_len(const uint8_t *s, size_t offset, size_t to) {
+	size_t end = offset + 1;
+
+	if (deen_entry_parse_is_special(s[offset])) {
+		return 0;
+	}
+
+	while (end < to && '{' != s[end] && '[' != s[end] && '|' != s[end]) {
+		end++;
+	}
+
+	while (end - offset >= 3) {
+		if (!deen_entry_parse_is_special(s[end - 1])) {
+			return end - offset;
+		}
+
+		end--;
+	}
+
+	return 0;
+}
+
+
+/*
+Parses the grammar or context that starts at the offset, which is just after
+the opening bracket and any spaces, and returns the offset after the closing
+bracket and any spaces.  Spaces before the closing bracket are part of the
+atom unless there is nothing else in the atom.
+*/
+
+static size_t deen_entry_parse_bracketed(
+	const uint8_t *s,
+	size_t offset,
+	size_t to,
+	uint8_t close,
+	enum deen_entry_atom_type atom_type,
+	deen_bool (*parse_callback)(
+		const uint8_t *s,
+		enum deen_entry_parse_event event,
+		enum deen_entry_atom_type atom_type,
+		size_t offset,
+		size_t len,
+		void *context),
+	void *context,
+	deen_bool *is_stopped) {
+
+	while (offset < to) {
+		size_t end = deen_entry_parse_skip_spaces(s, offset, to);
+
+		if (end < to && close == s[end]) {
+			return deen_entry_parse_skip_spaces(s, end + 1, to);
+		}
+
+		end = offset;
+
+		while (end < to && close != s[end]) {
+			end++;
+		}
+
+		if (!parse_callback(s, PARSE_EVENT_ATOM, atom_type, offset, end - offset, context)) {
+			*is_stopped = DEEN_TRUE;
+			return to;
+		}
+
+		offset = end;
+	}
+
+	return offset;
+}
+
+
+void deen_entry_parse(
+	const uint8_t *s,
+	size_t offset,
+	size_t to,
+	deen_bool (*parse_callback)(
+		const uint8_t *s,
+		enum deen_entry_parse_event event,
+		enum deen_entry_atom_type atom_type,
+		size_t offset,
+		size_t len,
+		void *context),
+	void *context) {
+
+	deen_bool is_stopped = DEEN_FALSE;
+
+	while (!is_stopped && offset < to) {
+		size_t next = deen_entry_parse_skip_spaces(s, offset, to);
+
+		if (next < to && deen_entry_parse_is_special(s[next])) {
+			switch (s[next]) {
+
+				case '{':
+					offset = deen_entry_parse_bracketed(
+						s, deen_entry_parse_skip_spaces(s, next + 1, to), to,
+						'}', ATOM_GRAMMAR,
+						parse_callback, context, &is_stopped);
+					break;
+
+				case '[':
+					offset = deen_entry_parse_bracketed(
+						s, deen_entry_parse_skip_spaces(s, next + 1, to), to,
+						']', ATOM_CONTEXT,
+						parse_callback, context, &is_stopped);
+					break;
+
+				case '|':
+					DEEN_LOG_TRACE0("+sub");
+					is_stopped = !parse_callback(s, PARSE_EVENT_SUB, ATOM_TEXT, next, 0, context);
+					offset = deen_entry_parse_skip_spaces(s, next + 1, to);
+					break;
+
+				default: // ';'
+					DEEN_LOG_TRACE0(" +sub_sub");
+					is_stopped = !parse_callback(s, PARSE_EVENT_SUB_SUB, ATOM_TEXT, next, 0, context);
+					offset = deen_entry_parse_skip_spaces(s, next + 1, to);
+					break;
+
+			}
+		}
+		else {
+			if (next != offset) {
+				offset = next;
+			}
+			else {
+				size_t text_len = deen_entry_parse_text_len(s, offset, to);
+
+				if (0 != text_len) {
+					is_stopped = !parse_callback(s, PARSE_EVENT_ATOM, ATOM_TEXT, offset, text_len, context);
+					offset += text_len;
+				}
+				else {
+					switch (s[offset]) {
+						case '\t':
+						case '\n':
+						case '\r':
+							break;
+
+						default:
+							is_stopped = !parse_callback(s, PARSE_EVENT_ATOM, ATOM_TEXT, offset, 1, context);
+							break;
+					}
+
+					offset++;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2016-2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+#ifndef __ENTRY_PARSE_H
+#define __ENTRY_PARSE_H
+
+#include "types.h"
+
+/*
+The german or english text of a line in the data is made up of subs that are
+separated by '|'.  Each sub is made up of sub subs that are separated by ';'.
+A sub sub is made up of atoms which are either text, grammar in '{...}' or
+context in '[...]'.
+
+This function will parse the text from the offset up to 'to' in one pass
+and will call the callback for each atom and for the start of each sub and
+sub sub.  The offset of an atom is an offset into the text so the atom is a
+slice of the text; nothing is allocated or copied.  The text need not be
+NULL terminated.  If the callback returns false then the parse stops.
+*/
+
+void deen_entry_parse(
+	const uint8_t *s,
+	size_t offset,
+	size_t to,
+	deen_bool (*parse_callback)(
+		const uint8_t *s,
+		enum deen_entry_parse_event event,
+		enum deen_entry_atom_type atom_type,
+		size_t offset,
+		size_t len,
+		void *context),
+	void *context);
+
+#endif /* __ENTRY_PARSE_H */
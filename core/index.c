@@ -8,11 +8,14 @@
 
 #include "index.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 
 #include "common.h"
+#include "postings.h"
+#include "tracing.h"
 
 // transaction
 #define SQL_TRANSACTION_BEGIN "BEGIN"
@@ -24,13 +27,40 @@
 #define SQL_TABLE_REF_CREATE "CREATE TABLE deen_ref(id INTEGER PRIMARY KEY, deen_prefix_id INTEGER NOT NULL, ref NUMBER NOT NULL, FOREIGN KEY (deen_prefix_id) REFERENCES deen_prefix(id))"
 #define SQL_TABLE_REF_INDEX_CREATE "CREATE UNIQUE INDEX deen_ref_idx01 ON deen_ref(deen_prefix_id, ref)"
 
+// versioning
+#define SQL_VERSION_SET_FORMAT "PRAGMA user_version = %d"
+#define SQL_VERSION_FETCH "PRAGMA user_version"
+
 // adding
 #define SQL_PREFIX_BULK_FETCH "SELECT id, prefix FROM deen_prefix WHERE prefix IN "
 #define SQL_PREFIX_INSERT "INSERT INTO deen_prefix(prefix) VALUES (?)"
+#define SQL_PREFIX_INSERT_WITH_ID "INSERT INTO deen_prefix(id, prefix) VALUES (?, ?)"
 #define SQL_PREFIX_REF_INSERT "INSERT INTO deen_ref (deen_prefix_id, ref) VALUES "
 
 // searching
-#define SQL_REF_LOOKUP "SELECT r.ref FROM deen_ref r JOIN deen_prefix p ON p.id = r.deen_prefix_id WHERE p.prefix = ?"
+#define SQL_REF_LOOKUP "SELECT r.ref FROM deen_ref r JOIN deen_prefix p ON p.id = r.deen_prefix_id WHERE p.prefix = ? ORDER BY r.ref"
+
+/*
+When the in-memory index is written out, the references are inserted with
+statements that each carry this many rows.  Each row has two parameters and
+SQLite has a limit of 999 parameters on a statement.
+*/
+
+#define DEEN_INDEX_BULK_REF_TUPLES 250
+
+/*
+This is the initial number of slots in the hash table used to intern the
+prefixes.  It must be a power of two.
+*/
+
+#define DEEN_INDEX_BULK_SLOTS_INITIAL 4096
+
+/*
+This is the initial number of refs allocated when looking up a prefix; the
+allocation is doubled as necessary.
+*/
+
+#define DEEN_INDEX_LOOKUP_REFS_INITIAL 64
 
 
 static void deen_index_run_sql(sqlite3 *db, char *sql) {
@@ -55,6 +85,36 @@ void deen_index_init(sqlite3 *db) {
 	deen_index_run_sql(db, SQL_TABLE_PREFIX_INDEX_CREATE);
 	deen_index_run_sql(db, SQL_TABLE_REF_CREATE);
 	deen_index_run_sql(db, SQL_TABLE_REF_INDEX_CREATE);
+
+	{
+		char sql[64];
+		snprintf(sql, sizeof(sql), SQL_VERSION_SET_FORMAT, DEEN_INDEX_VERSION);
+		deen_index_run_sql(db, sql);
+	}
+}
+
+
+deen_bool deen_index_is_current_version(sqlite3 *db) {
+	sqlite3_stmt *stmt = NULL;
+	int version = -1;
+
+	if (SQLITE_OK != sqlite3_prepare_v2(db, SQL_VERSION_FETCH, -1, &stmt, NULL)) {
+		DEEN_LOG_ERROR2("sqllite error preparing statement for [%s]; %s", SQL_VERSION_FETCH, sqlite3_errmsg(db));
+		return DEEN_FALSE;
+	}
+
+	if (SQLITE_ROW == sqlite3_step(stmt)) {
+		version = sqlite3_column_int(stmt, 0);
+	}
+
+	sqlite3_finalize(stmt);
+
+	if (DEEN_INDEX_VERSION != version) {
+		DEEN_LOG_INFO2("index version %d is not supported (expected %d)", version, DEEN_INDEX_VERSION);
+		return DEEN_FALSE;
+	}
+
+	return DEEN_TRUE;
 }
 
 
@@ -112,6 +172,8 @@ void deen_index_add_context_free(deen_index_add_context *context) {
 
 			free((void *) context->ref_insert_stmts);
 		}
+
+		free((void *) context);
 	}
 }
 
@@ -124,7 +186,7 @@ static sqlite3_stmt *deen_index_get_or_create_find_existing_prefixes_stmt(
 		deen_log_error_and_exit("proposterous quantity of prefixes to search for; %u", prefix_count);
 	}
 
-	if (prefix_count >= index_add_context->find_existing_prefixes_stmts_count) {
+	if (prefix_count > index_add_context->find_existing_prefixes_stmts_count) {
 		size_t i;
 
 		index_add_context->find_existing_prefixes_stmts = deen_erealloc(
@@ -138,6 +200,8 @@ static sqlite3_stmt *deen_index_get_or_create_find_existing_prefixes_stmt(
 			i++) {
 			index_add_context->find_existing_prefixes_stmts[i] = NULL;
 		}
+
+		index_add_context->find_existing_prefixes_stmts_count = prefix_count;
 	}
 
 	if(NULL == index_add_context->find_existing_prefixes_stmts[prefix_count - 1]) {
@@ -180,7 +244,7 @@ static sqlite3_stmt *deen_index_get_or_create_ref_insert_stmt(
 		deen_log_error_and_exit("proposterous quantity of tupls to insert; %u", tuple_count);
 	}
 
-	if (tuple_count >= index_add_context->ref_insert_stmts_count) {
+	if (tuple_count > index_add_context->ref_insert_stmts_count) {
 		size_t i;
 
 		index_add_context->ref_insert_stmts = deen_erealloc(
@@ -194,6 +258,8 @@ static sqlite3_stmt *deen_index_get_or_create_ref_insert_stmt(
 			i++) {
 			index_add_context->ref_insert_stmts[i] = NULL;
 		}
+
+		index_add_context->ref_insert_stmts_count = tuple_count;
 	}
 
 	if(NULL == index_add_context->ref_insert_stmts[tuple_count - 1]) {
@@ -370,7 +436,7 @@ static void deen_index_add_refs(
 			deen_log_error_and_exit("sqllite error binding into statement for add indexes; %s", sqlite3_errmsg(index_add_context->db));
 		}
 
-		if (SQLITE_OK != sqlite3_bind_int(stmt, 2 + (2 * i), (int) ref)) {
+		if (SQLITE_OK != sqlite3_bind_int64(stmt, 2 + (2 * i), (sqlite3_int64) ref)) {
 			deen_log_error_and_exit("sqllite error binding into statement for add indexes; %s", sqlite3_errmsg(index_add_context->db));
 		}
 
@@ -432,42 +498,510 @@ void deen_index_add(
 }
 
 
-deen_index_lookup_result *deen_index_lookup(
-	sqlite3 *db,
-	uint8_t *prefix) {
+// ---------------------------------------------------------------
+// IN-MEMORY INDEX
+// ---------------------------------------------------------------
 
-	deen_bool processed_all_rows;
-	sqlite3_stmt *stmt;
-	uint32_t allocted_refs_count = 10;
-	deen_index_lookup_result *result = (deen_index_lookup_result *) deen_emalloc(sizeof(deen_index_lookup_result));
 
-	result->refs = (off_t *) deen_emalloc(sizeof(off_t) * allocted_refs_count);
-	result->refs_count = 0;
+static deen_index_bulk_context *deen_index_bulk_context_create_sized(size_t prefix_size) {
+	deen_index_bulk_context *result = (deen_index_bulk_context *) deen_emalloc(sizeof(deen_index_bulk_context));
+	memset(result, 0, sizeof(deen_index_bulk_context));
+	result->prefix_size = prefix_size;
+	result->prefix_slots_count = DEEN_INDEX_BULK_SLOTS_INITIAL;
+	result->prefix_slots = (uint32_t *) deen_emalloc(sizeof(uint32_t) * result->prefix_slots_count);
+	memset(result->prefix_slots, 0, sizeof(uint32_t) * result->prefix_slots_count);
+	result->prefix_refs_ascending = DEEN_TRUE;
+	return result;
+}
+
+
+deen_index_bulk_context *deen_index_bulk_context_create() {
+	deen_index_bulk_context *result = deen_index_bulk_context_create_sized(DEEN_INDEXING_PREFIX_SIZE);
+	result->terms = deen_index_bulk_context_create_sized(DEEN_INDEXING_TERM_SIZE);
+	return result;
+}
+
+
+void deen_index_bulk_context_free(deen_index_bulk_context *context) {
+	if (NULL != context) {
+		deen_index_bulk_context_free(context->terms);
+		free((void *) context->prefixes);
+		free((void *) context->prefix_slots);
+		free((void *) context->prefix_refs);
+		free((void *) context);
+	}
+}
+
+
+static uint8_t *deen_index_bulk_prefix(deen_index_bulk_context *context, uint32_t prefix_id) {
+	return &context->prefixes[(prefix_id - 1) * context->prefix_size];
+}
+
+
+/*
+This is the FNV-1a hash of the prefix.
+*/
+
+static uint32_t deen_index_bulk_hash(const uint8_t *prefix) {
+	uint32_t result = 2166136261u;
+
+	while (0 != *prefix) {
+		result ^= (uint32_t) *prefix;
+		result *= 16777619u;
+		prefix++;
+	}
+
+	return result;
+}
+
+
+/*
+Doubles the size of the hash table and re-inserts all of the prefixes that are
+already known.
+*/
+
+static void deen_index_bulk_grow_slots(deen_index_bulk_context *context) {
+	uint32_t i;
+	uint32_t mask;
+
+	free((void *) context->prefix_slots);
+	context->prefix_slots_count *= 2;
+	context->prefix_slots = (uint32_t *) deen_emalloc(sizeof(uint32_t) * context->prefix_slots_count);
+	memset(context->prefix_slots, 0, sizeof(uint32_t) * context->prefix_slots_count);
+	mask = context->prefix_slots_count - 1;
+
+	for (i = 1; i <= context->prefix_count; i++) {
+		uint32_t slot = deen_index_bulk_hash(deen_index_bulk_prefix(context, i)) & mask;
+
+		while (0 != context->prefix_slots[slot]) {
+			slot = (slot + 1) & mask;
+		}
+
+		context->prefix_slots[slot] = i;
+	}
+}
+
+
+/*
+Returns the id of the prefix; adding the prefix if it is not already known.
+*/
+
+static uint32_t deen_index_bulk_intern(deen_index_bulk_context *context, const uint8_t *prefix) {
+	uint32_t mask = context->prefix_slots_count - 1;
+	uint32_t slot = deen_index_bulk_hash(prefix) & mask;
+	size_t prefix_len;
+
+	while (0 != context->prefix_slots[slot]) {
+		uint32_t prefix_id = context->prefix_slots[slot];
+
+		if (0 == strcmp(
+			(const char *) deen_index_bulk_prefix(context, prefix_id),
+			(const char *) prefix)) {
+			return prefix_id;
+		}
+
+		slot = (slot + 1) & mask;
+	}
+
+	prefix_len = strlen((const char *) prefix);
+
+	if (prefix_len >= context->prefix_size) {
+		deen_log_error_and_exit("the prefix [%s] is too long to be indexed", prefix);
+	}
+
+	if (context->prefix_count == context->prefix_count_allocated) {
+		context->prefix_count_allocated = (0 == context->prefix_count_allocated) ? 1024 : context->prefix_count_allocated * 2;
+		context->prefixes = (uint8_t *) deen_erealloc(
+			context->prefixes,
+			sizeof(uint8_t) * context->prefix_size * context->prefix_count_allocated);
+	}
+
+	context->prefix_count++;
+	memcpy(deen_index_bulk_prefix(context, context->prefix_count), prefix, prefix_len + 1);
+	context->prefix_slots[slot] = context->prefix_count;
+
+	// keep the load on the hash table under a half so that the probe
+	// sequences remain short.
+
+	if (context->prefix_count * 2 > context->prefix_slots_count) {
+		deen_index_bulk_grow_slots(context);
+	}
+
+	return context->prefix_count;
+}
+
+
+/*
+Makes sure that there is space for at least 'additional' more references.
+*/
+
+static void deen_index_bulk_ensure_refs_allocated(
+	deen_index_bulk_context *context,
+	size_t additional) {
+
+	if (context->prefix_refs_count + additional > context->prefix_refs_allocated) {
+		context->prefix_refs_allocated = (0 == context->prefix_refs_allocated) ? 4096 : context->prefix_refs_allocated * 2;
+
+		while (context->prefix_refs_count + additional > context->prefix_refs_allocated) {
+			context->prefix_refs_allocated *= 2;
+		}
+
+		context->prefix_refs = (deen_index_prefix_ref *) deen_erealloc(
+			context->prefix_refs,
+			sizeof(deen_index_prefix_ref) * context->prefix_refs_allocated);
+	}
+}
+
+
+void deen_index_bulk_add(
+	deen_index_bulk_context *context,
+	off_t ref,
+	uint8_t **prefixes,
+	uint32_t prefix_count) {
+
+	uint32_t i;
+
+#ifdef DEBUG
+	deen_millis start_ms = deen_millis_since_epoc();
+#endif
+
+	if (0 == prefix_count) {
+		DEEN_LOG_INFO0("requested zero indexes added");
+		return;
+	}
+
+	if (ref < context->last_ref) {
+		context->prefix_refs_ascending = DEEN_FALSE;
+	}
+
+	context->last_ref = ref;
+	context->prefix_refs_sorted = DEEN_FALSE;
+
+	deen_index_bulk_ensure_refs_allocated(context, prefix_count);
+
+	for (i = 0; i < prefix_count; i++) {
+		deen_index_prefix_ref *prefix_ref = &context->prefix_refs[context->prefix_refs_count];
+		prefix_ref->ref = ref;
+		prefix_ref->prefix_id = deen_index_bulk_intern(context, prefixes[i]);
+		context->prefix_refs_count++;
+	}
+
+#ifdef DEBUG
+	context->intern_prefixes_millis += (deen_millis_since_epoc() - start_ms);
+#endif
+}
+
+
+void deen_index_bulk_add_terms(
+	deen_index_bulk_context *context,
+	off_t ref,
+	uint8_t **terms,
+	uint32_t term_count) {
+	if (0 != term_count) {
+		deen_index_bulk_add(context->terms, ref, terms, term_count);
+	}
+}
+
+
+void deen_index_bulk_merge(
+	deen_index_bulk_context *context,
+	deen_index_bulk_context *other) {
+
+	uint32_t i;
+	size_t j;
+	uint32_t *prefix_id_map;
+
+#ifdef DEBUG
+	deen_millis start_ms = deen_millis_since_epoc();
+#endif
+
+	if (NULL != context->terms && NULL != other->terms) {
+		deen_index_bulk_merge(context->terms, other->terms);
+	}
+
+	if (0 == other->prefix_refs_count) {
+		return;
+	}
+
+	// the prefix ids in 'other' are local to it and so need to be mapped
+	// into the ids of this context.
+
+	prefix_id_map = (uint32_t *) deen_emalloc(sizeof(uint32_t) * (other->prefix_count + 1));
+	prefix_id_map[0] = 0;
+
+	for (i = 1; i <= other->prefix_count; i++) {
+		prefix_id_map[i] = deen_index_bulk_intern(context, deen_index_bulk_prefix(other, i));
+	}
+
+	if (!other->prefix_refs_ascending || other->prefix_refs[0].ref < context->last_ref) {
+		context->prefix_refs_ascending = DEEN_FALSE;
+	}
+
+	deen_index_bulk_ensure_refs_allocated(context, other->prefix_refs_count);
+
+	for (j = 0; j < other->prefix_refs_count; j++) {
+		deen_index_prefix_ref *prefix_ref = &context->prefix_refs[context->prefix_refs_count + j];
+		prefix_ref->ref = other->prefix_refs[j].ref;
+		prefix_ref->prefix_id = prefix_id_map[other->prefix_refs[j].prefix_id];
+	}
+
+	context->prefix_refs_count += other->prefix_refs_count;
+	context->last_ref = other->last_ref;
+	context->prefix_refs_sorted = DEEN_FALSE;
+
+	free((void *) prefix_id_map);
+
+#ifdef DEBUG
+	context->intern_prefixes_millis += other->intern_prefixes_millis + (deen_millis_since_epoc() - start_ms);
+#endif
+}
+
+
+static int deen_index_prefix_ref_compare(const void *a, const void *b) {
+	const deen_index_prefix_ref *a_ref = (const deen_index_prefix_ref *) a;
+	const deen_index_prefix_ref *b_ref = (const deen_index_prefix_ref *) b;
+
+	if (a_ref->prefix_id != b_ref->prefix_id) {
+		return a_ref->prefix_id < b_ref->prefix_id ? -1 : 1;
+	}
+
+	if (a_ref->ref == b_ref->ref) {
+		return 0;
+	}
+
+	return a_ref->ref < b_ref->ref ? -1 : 1;
+}
+
+
+/*
+Orders the accumulated references by prefix id and then by ref.  The refs
+normally arrive in ascending order and so a stable counting sort on the prefix
+id is sufficient; otherwise a full sort is necessary.
+*/
+
+void deen_index_bulk_sort(deen_index_bulk_context *context) {
+	if (context->prefix_refs_sorted) {
+		return;
+	}
+
+	if (context->prefix_refs_ascending) {
+		uint32_t i;
+		size_t j;
+		size_t *positions = (size_t *) deen_emalloc(sizeof(size_t) * (context->prefix_count + 2));
+		deen_index_prefix_ref *sorted = (deen_index_prefix_ref *) deen_emalloc(
+			sizeof(deen_index_prefix_ref) * (context->prefix_refs_count + 1));
+
+		memset(positions, 0, sizeof(size_t) * (context->prefix_count + 2));
+
+		for (j = 0; j < context->prefix_refs_count; j++) {
+			positions[context->prefix_refs[j].prefix_id + 1]++;
+		}
+
+		for (i = 1; i <= context->prefix_count + 1; i++) {
+			positions[i] += positions[i - 1];
+		}
+
+		for (j = 0; j < context->prefix_refs_count; j++) {
+			sorted[positions[context->prefix_refs[j].prefix_id]++] = context->prefix_refs[j];
+		}
 
-	stmt = NULL;
+		free((void *) positions);
+		free((void *) context->prefix_refs);
+		context->prefix_refs = sorted;
+		context->prefix_refs_allocated = context->prefix_refs_count + 1;
+	}
+	else {
+		qsort(
+			context->prefix_refs, context->prefix_refs_count,
+			sizeof(deen_index_prefix_ref), &deen_index_prefix_ref_compare);
+	}
+
+	context->prefix_refs_sorted = DEEN_TRUE;
+}
+
+
+static void deen_index_bulk_write_prefixes(deen_index_bulk_context *context, sqlite3 *db) {
+	uint32_t i;
+	sqlite3_stmt *stmt = NULL;
 
-	if (SQLITE_OK != sqlite3_prepare_v2(db, SQL_REF_LOOKUP, -1, &stmt, NULL)) {
-		deen_log_error_and_exit("sqllite error preparing statement for [%s]; %s", SQL_REF_LOOKUP, sqlite3_errmsg(db));
+	if (SQLITE_OK != sqlite3_prepare_v2(db, SQL_PREFIX_INSERT_WITH_ID, -1, &stmt, NULL)) {
+		deen_log_error_and_exit("sqllite error preparing statement for [%s]; %s", SQL_PREFIX_INSERT_WITH_ID, sqlite3_errmsg(db));
 	}
 
+	for (i = 1; i <= context->prefix_count; i++) {
+		if (SQLITE_OK != sqlite3_bind_int(stmt, 1, (int) i)) {
+			deen_log_error_and_exit("sqllite error setting parameter in [%s]; %s", SQL_PREFIX_INSERT_WITH_ID, sqlite3_errmsg(db));
+		}
+
+		if (SQLITE_OK != sqlite3_bind_text(stmt, 2, (const char *) deen_index_bulk_prefix(context, i), -1, SQLITE_STATIC)) {
+			deen_log_error_and_exit("sqllite error setting parameter in [%s]; %s", SQL_PREFIX_INSERT_WITH_ID, sqlite3_errmsg(db));
+		}
+
+		if (SQLITE_DONE != sqlite3_step(stmt)) {
+			deen_log_error_and_exit("sqllite error executing insert for \"%s\" [%s]; %s", deen_index_bulk_prefix(context, i), SQL_PREFIX_INSERT_WITH_ID, sqlite3_errmsg(db));
+		}
+
+		if (SQLITE_OK != sqlite3_reset(stmt)) {
+			deen_log_error_and_exit("sqllite error resetting stmt [%s]; %s", SQL_PREFIX_INSERT_WITH_ID, sqlite3_errmsg(db));
+		}
+	}
+
+	if (SQLITE_OK != sqlite3_finalize(stmt)) {
+		deen_log_error_and_exit("sqllite error finalizing statement for [%s]; %s", SQL_PREFIX_INSERT_WITH_ID, sqlite3_errmsg(db));
+	}
+}
+
+
+static void deen_index_bulk_write_refs(deen_index_bulk_context *context, sqlite3 *db) {
+	size_t upto = 0;
+	deen_index_add_context *add_context = deen_index_add_context_create(db);
+
+	while (upto < context->prefix_refs_count) {
+		size_t i;
+		size_t tuple_count = context->prefix_refs_count - upto;
+		sqlite3_stmt *stmt;
+
+		if (tuple_count > DEEN_INDEX_BULK_REF_TUPLES) {
+			tuple_count = DEEN_INDEX_BULK_REF_TUPLES;
+		}
+
+		stmt = deen_index_get_or_create_ref_insert_stmt(add_context, tuple_count);
+
+		for (i = 0; i < tuple_count; i++) {
+			deen_index_prefix_ref *prefix_ref = &context->prefix_refs[upto + i];
+
+			if (SQLITE_OK != sqlite3_bind_int(stmt, 1 + (2 * i), (int) prefix_ref->prefix_id)) {
+				deen_log_error_and_exit("sqllite error binding into statement for add indexes; %s", sqlite3_errmsg(db));
+			}
+
+			if (SQLITE_OK != sqlite3_bind_int64(stmt, 2 + (2 * i), (sqlite3_int64) prefix_ref->ref)) {
+				deen_log_error_and_exit("sqllite error binding into statement for add indexes; %s", sqlite3_errmsg(db));
+			}
+		}
+
+		if (SQLITE_DONE != sqlite3_step(stmt)) {
+			deen_log_error_and_exit("sqllite error executing add indexes; %s", sqlite3_errmsg(db));
+		}
+
+		if (SQLITE_OK != sqlite3_reset(stmt)) {
+			deen_log_error_and_exit("sqllite error resetting stmt for add indexes; %s", sqlite3_errmsg(db));
+		}
+
+		upto += tuple_count;
+	}
+
+	deen_index_add_context_free(add_context);
+}
+
+
+void deen_index_bulk_write(deen_index_bulk_context *context, sqlite3 *db) {
+
+#ifdef DEBUG
+	deen_millis start_ms = deen_millis_since_epoc();
+	deen_millis after_sort_ms;
+	deen_millis after_write_prefixes_ms;
+#endif
+
+	deen_tracing_begin("sort refs");
+	deen_index_bulk_sort(context);
+	deen_tracing_end("sort refs");
+
+#ifdef DEBUG
+	after_sort_ms = deen_millis_since_epoc();
+	context->sort_refs_millis += (after_sort_ms - start_ms);
+#endif
+
+	deen_tracing_begin("write prefixes");
+	deen_index_bulk_write_prefixes(context, db);
+	deen_tracing_end("write prefixes");
+
+#ifdef DEBUG
+	after_write_prefixes_ms = deen_millis_since_epoc();
+	context->write_prefixes_millis += (after_write_prefixes_ms - after_sort_ms);
+#endif
+
+	deen_tracing_begin("write refs");
+	deen_index_bulk_write_refs(context, db);
+	deen_tracing_end("write refs");
+
+#ifdef DEBUG
+	context->write_refs_millis += (deen_millis_since_epoc() - after_write_prefixes_ms);
+#endif
+
+	DEEN_LOG_INFO2("wrote %u prefixes and %lu refs to the index",
+		context->prefix_count, (unsigned long) context->prefix_refs_count);
+}
+
+
+deen_index_lookup_context *deen_index_lookup_context_create(sqlite3 *db) {
+	deen_index_lookup_context *context = (deen_index_lookup_context *) deen_emalloc(sizeof(deen_index_lookup_context));
+	context->db = db;
+	context->ref_lookup_stmt = NULL;
+	return context;
+}
+
+
+void deen_index_lookup_context_free(deen_index_lookup_context *context) {
+	if (NULL != context) {
+		if (NULL != context->ref_lookup_stmt) {
+			if (SQLITE_OK != sqlite3_finalize(context->ref_lookup_stmt)) {
+				DEEN_LOG_ERROR2("sqllite error finalizing statement for [%s]; %s", SQL_REF_LOOKUP, sqlite3_errmsg(context->db));
+			}
+		}
+
+		free((void *) context);
+	}
+}
+
+
+/*
+The refs are ordered by the query; the unique index on the prefix id and the
+ref means that the database is able to supply them in that order without
+sorting them.  The statement is prepared on first use and then is reset after
+each lookup so that it can be used again.
+*/
+
+deen_postings_cursor *deen_index_lookup(
+	deen_index_lookup_context *context,
+	uint8_t *prefix) {
+
+	deen_bool processed_all_rows;
+	deen_bool is_error = DEEN_FALSE;
+	sqlite3 *db = context->db;
+	sqlite3_stmt *stmt;
+	size_t allocated_refs_count = DEEN_INDEX_LOOKUP_REFS_INITIAL;
+	size_t refs_count = 0;
+	off_t *refs;
+
+	if (NULL == context->ref_lookup_stmt) {
+		if (SQLITE_OK != sqlite3_prepare_v2(db, SQL_REF_LOOKUP, -1, &(context->ref_lookup_stmt), NULL)) {
+			DEEN_LOG_ERROR2("sqllite error preparing statement for [%s]; %s", SQL_REF_LOOKUP, sqlite3_errmsg(db));
+			context->ref_lookup_stmt = NULL;
+			return NULL;
+		}
+	}
+
+	stmt = context->ref_lookup_stmt;
+	refs = (off_t *) deen_emalloc(sizeof(off_t) * allocated_refs_count);
+
 	if (SQLITE_OK != sqlite3_bind_text(stmt, 1, (const char *) prefix, -1, SQLITE_TRANSIENT)) {
-		deen_log_error_and_exit("sqllite error setting parameter in [%s]; %s", SQL_REF_LOOKUP, sqlite3_errmsg(db));
+		DEEN_LOG_ERROR2("sqllite error setting parameter in [%s]; %s", SQL_REF_LOOKUP, sqlite3_errmsg(db));
+		is_error = DEEN_TRUE;
 	}
 
-	processed_all_rows = DEEN_FALSE;
+	processed_all_rows = is_error;
 
 	while (!processed_all_rows) {
 		switch (sqlite3_step(stmt)) {
 
 			case SQLITE_ROW:
 
-				if (result->refs_count >= allocted_refs_count) {
-					allocted_refs_count += 10;
-					result->refs = (off_t *) deen_erealloc(result->refs, sizeof(off_t) * allocted_refs_count);
+				if (refs_count >= allocated_refs_count) {
+					allocated_refs_count *= 2;
+					refs = (off_t *) deen_erealloc(refs, sizeof(off_t) * allocated_refs_count);
 				}
 
-				result->refs[result->refs_count] = (off_t) sqlite3_column_int(stmt, 0);
-				result->refs_count++;
+				refs[refs_count++] = (off_t) sqlite3_column_int64(stmt, 0);
 
 				break;
 
@@ -476,27 +1010,23 @@ deen_index_lookup_result *deen_index_lookup(
 				break;
 
 			default:
-				deen_log_error_and_exit("sqllite error getting row from [%s]; %s", SQL_REF_LOOKUP, sqlite3_errmsg(db));
+				DEEN_LOG_ERROR2("sqllite error getting row from [%s]; %s", SQL_REF_LOOKUP, sqlite3_errmsg(db));
+				is_error = DEEN_TRUE;
+				processed_all_rows = DEEN_TRUE;
 				break;
 
 		}
 	}
 
-	if (SQLITE_OK != sqlite3_reset(stmt)) {
-		deen_log_error_and_exit("sqllite error resetting stmt [%s]; %s", SQL_REF_LOOKUP, sqlite3_errmsg(db));
+	if (SQLITE_OK != sqlite3_reset(stmt) && !is_error) {
+		DEEN_LOG_ERROR2("sqllite error resetting stmt [%s]; %s", SQL_REF_LOOKUP, sqlite3_errmsg(db));
+		is_error = DEEN_TRUE;
 	}
 
-	if (SQLITE_OK != sqlite3_finalize(stmt)) {
-		deen_log_error_and_exit("sqllite error finalizing statement for [%s]; %s", SQL_REF_LOOKUP, sqlite3_errmsg(db));
+	if (is_error) {
+		free((void *) refs);
+		return NULL;
 	}
 
-	return result;
-}
-
-
-void deen_index_lookup_result_free(deen_index_lookup_result *result) {
-	if (NULL != result) {
-		free((void *) result->refs);
-		free((void *) result);
-	}
+	return deen_postings_cursor_create_from_refs(refs, refs_count);
 }
@@ -20,6 +20,13 @@ This function will populate the table structures into the database.
 
 void deen_index_init(sqlite3 *db);
 
+/*
+Returns true if the database was initialized by this version of the software;
+an index made by an earlier version may not be able to be searched correctly.
+*/
+
+deen_bool deen_index_is_current_version(sqlite3 *db);
+
 void deen_transaction_begin(sqlite3 *db);
 void deen_transaction_commit(sqlite3 *db);
 
@@ -51,14 +58,83 @@ void deen_index_add(
 	uint32_t prefix_count);
 
 /*
-This function will lookup the prefix to resolve it into some references.
-The result is dynamically allocated and must be freed by the caller.
+Creates a context that is able to accumulate the index entirely in memory.  No
+database is required until the accumulated data is written out.
 */
 
-deen_index_lookup_result *deen_index_lookup(
-	sqlite3 *db,
-	uint8_t *prefix);
+deen_index_bulk_context *deen_index_bulk_context_create();
+
+void deen_index_bulk_context_free(deen_index_bulk_context *context);
+
+/*
+This function will intern the prefixes and will record the reference against
+each of them in memory.  As with 'deen_index_add', it is assumed that no prior
+call was made with the same reference.
+*/
+
+void deen_index_bulk_add(
+	deen_index_bulk_context *context,
+	off_t ref,
+	uint8_t **prefixes,
+	uint32_t prefix_count);
+
+/*
+This function will intern the terms and will record the reference against each
+of them in memory.  The terms are only written to the binary index.  Unlike
+the prefixes, the same term may be supplied more than once for a reference.
+*/
+
+void deen_index_bulk_add_terms(
+	deen_index_bulk_context *context,
+	off_t ref,
+	uint8_t **terms,
+	uint32_t term_count);
 
-void deen_index_lookup_result_free(deen_index_lookup_result *result);
+/*
+Adds all of the prefixes, terms and references from 'other' into 'context'.  The
+'other' context is not altered.  The references in 'other' are expected to
+follow on from those already in 'context' in order to avoid a full sort later.
+*/
+
+void deen_index_bulk_merge(
+	deen_index_bulk_context *context,
+	deen_index_bulk_context *other);
+
+/*
+Orders the accumulated references by prefix id and then by ref.  This is done
+as part of writing the references, but is also required before the context
+is used to write a binary index.
+*/
+
+void deen_index_bulk_sort(deen_index_bulk_context *context);
+
+/*
+Sorts the accumulated references and writes the prefixes and references into
+the database in one pass.  The database should have been initialized already.
+*/
+
+void deen_index_bulk_write(deen_index_bulk_context *context, sqlite3 *db);
+
+/*
+Creates a context that can then be used to lookup prefixes.  As with the
+context for adding, the statement is cached in the context so that it is not
+parsed for each lookup.  The database is *NOT* released when the context is
+freed.
+*/
+
+deen_index_lookup_context *deen_index_lookup_context_create(sqlite3 *db);
+
+void deen_index_lookup_context_free(deen_index_lookup_context *context);
+
+/*
+This function will lookup the prefix and returns a cursor over its refs in
+ascending order.  The cursor must be freed by the caller using
+'deen_postings_cursor_free'.  If there is a problem reading from the
+database then the problem is logged and NULL is returned.
+*/
+
+deen_postings_cursor *deen_index_lookup(
+	deen_index_lookup_context *context,
+	uint8_t *prefix);
 
 #endif /* __INDEX_H */
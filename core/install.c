@@ -13,6 +13,9 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#ifndef __MINGW32__
+#include <pthread.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,6 +28,8 @@
 #include "common.h"
 #include "constants.h"
 #include "index.h"
+#include "mapindex.h"
+#include "tracing.h"
 
 /*
 This method will open the supplied file and will try to
@@ -66,6 +71,10 @@ struct deen_index_context {
 	// handle to the index database.
 	deen_index_add_context *index_add_context;
 
+	// alternatively the index is accumulated in memory; see
+	// DEEN_INSTALL_INDEX_IN_MEMORY.
+	deen_index_bulk_context *index_bulk_context;
+
 	// management of the progress of the indexing.
 	float lastprogress;
 	void *progress_cb_context;
@@ -82,6 +91,12 @@ struct deen_index_context {
 	size_t prefix_count_allocated;
 	uint8_t **prefixes;
 
+	// the whole words that are on the file offset; these are only collected
+	// for the in-memory index and may contain duplicates.
+	size_t term_count;
+	size_t term_count_allocated;
+	uint8_t **terms;
+
 };
 
 // ---------------------------------------------------------------
@@ -279,6 +294,11 @@ static deen_bool deen_install_init(const char *deen_root_dir) {
 		return DEEN_FALSE;
 	}
 
+	if (!deen_remove_fileobject_in_root_dir(deen_root_dir, DEEN_LEAF_MAPINDEX)) {
+		DEEN_LOG_ERROR0("failed to delete the existing binary index object");
+		return DEEN_FALSE;
+	}
+
 	if (!deen_remove_fileobject_in_root_dir(deen_root_dir, DEEN_LEAF_DING_DATA)) {
 			DEEN_LOG_ERROR0("failed to delete the existing data object");
 		return DEEN_FALSE;
@@ -318,7 +338,7 @@ static void deen_index_add_prefix_to_context(
 			context->prefixes,
 			sizeof(uint8_t **) * context->prefix_count_allocated);
 		context->prefixes[context->prefix_count_allocated-1] = (uint8_t *) deen_emalloc(
-			sizeof(uint8_t) * (DEEN_INDEXING_DEPTH * 4 + 1));
+			sizeof(uint8_t) * DEEN_INDEXING_PREFIX_SIZE);
 	}
 
 	memcpy(context->prefixes[context->prefix_count], s, len);
@@ -331,6 +351,29 @@ static void deen_index_add_prefix_to_context(
 		sizeof(uint8_t *), &deen_index_prefix_compare);
 }
 
+/*
+Adds the term to the context even if it is already present.
+*/
+
+static void deen_index_add_term_to_context(
+	deen_index_context *context,
+	uint8_t *s,
+	size_t len) {
+
+	if (context->term_count == context->term_count_allocated) {
+		context->term_count_allocated++;
+		context->terms = (uint8_t **) deen_erealloc(
+			context->terms,
+			sizeof(uint8_t **) * context->term_count_allocated);
+		context->terms[context->term_count_allocated-1] = (uint8_t *) deen_emalloc(
+			sizeof(uint8_t) * DEEN_INDEXING_TERM_SIZE);
+	}
+
+	memcpy(context->terms[context->term_count], s, len);
+	(context->terms[context->term_count])[len] = 0;
+	context->term_count++;
+}
+
 /*
 Checks to see if the prefix is already in place.  If it is in place,
 then it will carry on.  If it is not already in place then it will
@@ -386,13 +429,28 @@ static void deen_index_flush_context_prefixes_to_index(
 	if (0 != context->prefix_count) {
 		deen_index_flush_context_prefixes_to_index_trace_log(context);
 
-		deen_index_add(
-			context->index_add_context,
-			context->current_ref,
-			context->prefixes,
-			context->prefix_count);
+		if (NULL != context->index_bulk_context) {
+			deen_index_bulk_add(
+				context->index_bulk_context,
+				context->current_ref,
+				context->prefixes,
+				(uint32_t) context->prefix_count);
+			deen_index_bulk_add_terms(
+				context->index_bulk_context,
+				context->current_ref,
+				context->terms,
+				(uint32_t) context->term_count);
+		}
+		else {
+			deen_index_add(
+				context->index_add_context,
+				context->current_ref,
+				context->prefixes,
+				context->prefix_count);
+		}
 
 		context->prefix_count = 0;
+		context->term_count = 0;
 	}
 
 }
@@ -449,7 +507,9 @@ static deen_bool deen_index_callback(
 
 			if (context2->c_buffer_upper_len <= len) {
 				context2->c_buffer_upper_len = len + 1;
-				context2->c_buffer_upper = (uint8_t *) deen_emalloc(sizeof(uint8_t) * context2->c_buffer_upper_len);
+				context2->c_buffer_upper = (uint8_t *) deen_erealloc(
+					context2->c_buffer_upper,
+					sizeof(uint8_t) * context2->c_buffer_upper_len);
 			}
 
 			memcpy(context2->c_buffer_upper, s, len);
@@ -458,10 +518,29 @@ static deen_bool deen_index_callback(
 			deen_to_upper(context2->c_buffer_upper);
 
 			if (!deen_is_common_upper_word(context2->c_buffer_upper, len)) {
+				size_t unicode_length;
+
+				// the umlauts are folded so that the different spellings of
+				// the word share a prefix; the search folds the keywords in
+				// the same way.
+
+				deen_fold_umlauts(context2->c_buffer_upper);
+
+				// a word that is longer than a prefix is also kept whole as a
+				// term so that longer keywords can be looked up exactly.
+
+				unicode_length = deen_utf8_crop_to_unicode_len(context2->c_buffer_upper, len, DEEN_INDEXING_TERM_DEPTH);
+
+				if (unicode_length > DEEN_INDEXING_DEPTH && NULL != context2->index_bulk_context) {
+					deen_index_add_term_to_context(
+						context2,
+						context2->c_buffer_upper,
+						strlen((char *) context2->c_buffer_upper));
+				}
 
 				// create the prefix at the right length.
 
-				size_t unicode_length = deen_utf8_crop_to_unicode_len(context2->c_buffer_upper, len, DEEN_INDEXING_DEPTH);
+				unicode_length = deen_utf8_crop_to_unicode_len(context2->c_buffer_upper, len, DEEN_INDEXING_DEPTH);
 
 				if (unicode_length >= DEEN_INDEXING_MIN) {
 					deen_index_add_prefix_to_context_if_not_present(
@@ -487,6 +566,442 @@ deen_bool deen_noop_install_progress_cb(
 }
 
 
+static void deen_index_context_init(
+	deen_index_context *context,
+	void *progress_cb_context,
+	deen_install_progress_cb progress_cb,
+	deen_is_cancelled_cb is_cancelled_cb) {
+	context->index_add_context = NULL;
+	context->index_bulk_context = NULL;
+	context->lastprogress = -1.0f;
+	context->progress_cb_context = progress_cb_context;
+	context->progress_cb = progress_cb;
+	context->is_cancelled_cb = is_cancelled_cb;
+	context->c_buffer_upper = NULL;
+	context->c_buffer_upper_len = 0;
+	context->current_ref = 0;
+	context->prefix_count = 0;
+	context->prefix_count_allocated = 0;
+	context->prefixes = NULL;
+	context->term_count = 0;
+	context->term_count_allocated = 0;
+	context->terms = NULL;
+}
+
+
+/*
+Releases memory that might have been used in the indexing process as stored
+in the context.  The context itself is not freed.
+*/
+
+static void deen_index_context_clean(deen_index_context *context) {
+	if (NULL != context->index_add_context) {
+		deen_index_add_context_free(context->index_add_context);
+		context->index_add_context = NULL;
+	}
+
+	if (NULL != context->index_bulk_context) {
+		deen_index_bulk_context_free(context->index_bulk_context);
+		context->index_bulk_context = NULL;
+	}
+
+	if (NULL != context->c_buffer_upper) {
+		free((void *) context->c_buffer_upper);
+		context->c_buffer_upper = NULL;
+	}
+
+	if (NULL != context->prefixes) {
+		size_t i;
+
+		for (i=0;i<context->prefix_count_allocated;i++) {
+			free((void *) context->prefixes[i]);
+		}
+
+		free((void *) context->prefixes);
+		context->prefixes = NULL;
+	}
+
+	if (NULL != context->terms) {
+		size_t i;
+
+		for (i=0;i<context->term_count_allocated;i++) {
+			free((void *) context->terms[i]);
+		}
+
+		free((void *) context->terms);
+		context->terms = NULL;
+	}
+}
+
+
+#ifndef __MINGW32__
+
+/*
+The data is split into chunks and each chunk is indexed by a worker on its
+own thread into its own in-memory index.  Once all of the workers have
+completed, the in-memory indexes are merged in the order of the chunks.
+*/
+
+typedef struct deen_index_workers deen_index_workers;
+typedef struct deen_index_worker deen_index_worker;
+
+struct deen_index_worker {
+	deen_index_workers *workers;
+	pthread_t thread;
+	deen_bool thread_started;
+
+	// the range of the data that this worker should index.
+	off_t from;
+	off_t to;
+
+	// guarded by the lock on the workers.
+	float progress;
+
+	deen_bool is_error;
+	deen_index_context index_context;
+};
+
+struct deen_index_workers {
+	const char *data_path;
+
+	pthread_mutex_t lock;
+	pthread_cond_t completed_cond;
+	uint32_t completed_count;
+
+	// accessed atomically because it is checked for each word.
+	deen_bool is_cancelled;
+
+	uint32_t count;
+	deen_index_worker *worker;
+};
+
+
+/*
+Works out how many workers should be used to index the data.
+*/
+
+static uint32_t deen_index_worker_count(off_t file_len) {
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	char *threads_env = getenv("DEENINSTALLTHREADS");
+
+	if (NULL != threads_env && 0 != threads_env[0]) {
+		count = atol(threads_env);
+	}
+	else {
+		off_t count_by_size = file_len / DEEN_INSTALL_THREAD_MIN_BYTES;
+
+		if (count > count_by_size) {
+			count = (long) count_by_size;
+		}
+	}
+
+	if (count > DEEN_INSTALL_THREADS_MAX) {
+		count = DEEN_INSTALL_THREADS_MAX;
+	}
+
+	if (count < 1) {
+		count = 1;
+	}
+
+	return (uint32_t) count;
+}
+
+
+/*
+Returns the offset of the start of the first line that starts at or after the
+supplied offset.  If there is no such line then the length of the file is
+returned.
+*/
+
+static off_t deen_index_line_start_at_or_after(int fd, off_t offset, off_t file_len) {
+	uint8_t buffer[DEEN_SIZE_CHECK_DING_BUFFER];
+	off_t pos = offset - 1;
+
+	if (offset <= 0) {
+		return 0;
+	}
+
+	if (-1 == lseek(fd, pos, SEEK_SET)) {
+		deen_log_error_and_exit("unable to seek to find a line start");
+	}
+
+	while (pos < file_len) {
+		ssize_t i;
+		ssize_t read_len = read(fd, buffer, DEEN_SIZE_CHECK_DING_BUFFER);
+
+		if (read_len <= 0) {
+			break;
+		}
+
+		for (i = 0; i < read_len; i++) {
+			if ('\n' == buffer[i]) {
+				return pos + i + 1;
+			}
+		}
+
+		pos += read_len;
+	}
+
+	return file_len;
+}
+
+
+static deen_bool deen_index_worker_progress_cb(
+	void *context, enum deen_install_state state, float progress) {
+	deen_index_worker *worker = (deen_index_worker *) context;
+	pthread_mutex_lock(&worker->workers->lock);
+	worker->progress = progress;
+	pthread_mutex_unlock(&worker->workers->lock);
+	return DEEN_TRUE;
+}
+
+
+static deen_bool deen_index_worker_is_cancelled_cb(void *context) {
+	deen_index_worker *worker = (deen_index_worker *) context;
+	return __atomic_load_n(&worker->workers->is_cancelled, __ATOMIC_RELAXED);
+}
+
+
+static void *deen_index_worker_run(void *context) {
+	deen_index_worker *worker = (deen_index_worker *) context;
+	int fd = open(worker->workers->data_path, O_RDONLY);
+
+	deen_tracing_begin("index chunk");
+
+	if (-1 == fd) {
+		DEEN_LOG_ERROR1("unable to open the input data file %s", worker->workers->data_path);
+		worker->is_error = DEEN_TRUE;
+	}
+	else {
+		if (!deen_for_each_word_from_file_range(
+			DEEN_BUFFER_SIZE_EACH_WORD_FROM_FILE,
+			fd,
+			worker->from,
+			worker->to,
+			&deen_index_callback,
+			&worker->index_context)) {
+			worker->is_error = DEEN_TRUE;
+		}
+		else {
+			deen_index_flush_context_prefixes_to_index(&worker->index_context);
+		}
+
+		close(fd);
+	}
+
+	deen_tracing_end("index chunk");
+
+	pthread_mutex_lock(&worker->workers->lock);
+	worker->progress = 1.0f;
+	worker->workers->completed_count++;
+	pthread_cond_signal(&worker->workers->completed_cond);
+	pthread_mutex_unlock(&worker->workers->lock);
+
+	return NULL;
+}
+
+
+/*
+Waits for the workers to complete.  Whilst waiting, the progress of the
+workers is reported and the cancellation state is relayed to the workers.
+*/
+
+static void deen_index_workers_wait(deen_index_workers *workers, deen_index_context *context, uint32_t started_count) {
+	pthread_mutex_lock(&workers->lock);
+
+	while (workers->completed_count < started_count) {
+		struct timeval now;
+		struct timespec until;
+		float progress = 0.0f;
+		uint32_t i;
+
+		gettimeofday(&now, NULL);
+		until.tv_sec = now.tv_sec + (DEEN_INSTALL_THREAD_POLL_MILLIS / 1000);
+		until.tv_nsec = (now.tv_usec * 1000) + ((DEEN_INSTALL_THREAD_POLL_MILLIS % 1000) * 1000000);
+
+		if (until.tv_nsec >= 1000000000) {
+			until.tv_sec++;
+			until.tv_nsec -= 1000000000;
+		}
+
+		pthread_cond_timedwait(&workers->completed_cond, &workers->lock, &until);
+
+		// the progress is weighted by the size of each worker's chunk.
+
+		for (i = 0; i < workers->count; i++) {
+			deen_index_worker *worker = &workers->worker[i];
+			off_t file_len = workers->worker[workers->count - 1].to;
+
+			if (file_len > 0) {
+				progress += worker->progress * ((float) (worker->to - worker->from) / (float) file_len);
+			}
+		}
+
+		pthread_mutex_unlock(&workers->lock);
+
+		if ((uint8_t) (progress * 100.0) != (uint8_t) (context->lastprogress * 100.0)) {
+			context->progress_cb(context->progress_cb_context, DEEN_INSTALL_STATE_INDEXING, progress);
+			context->lastprogress = progress;
+		}
+
+		if (context->is_cancelled_cb(context->progress_cb_context)) {
+			__atomic_store_n(&workers->is_cancelled, DEEN_TRUE, __ATOMIC_RELAXED);
+		}
+
+		pthread_mutex_lock(&workers->lock);
+	}
+
+	pthread_mutex_unlock(&workers->lock);
+}
+
+
+/*
+Indexes the data using a number of worker threads and then merges the
+in-memory indexes from the workers into the in-memory index of the context.
+*/
+
+static deen_bool deen_index_data_parallel(
+	deen_index_context *context,
+	const char *data_path,
+	int fd_data,
+	off_t file_len,
+	uint32_t worker_count) {
+
+	deen_index_workers workers;
+	deen_bool is_error = DEEN_FALSE;
+	uint32_t started_count = 0;
+	uint32_t i;
+
+	DEEN_LOG_INFO1("will index with %u threads", worker_count);
+
+	workers.data_path = data_path;
+	workers.completed_count = 0;
+	workers.is_cancelled = DEEN_FALSE;
+	workers.count = worker_count;
+	workers.worker = (deen_index_worker *) deen_emalloc(sizeof(deen_index_worker) * worker_count);
+	pthread_mutex_init(&workers.lock, NULL);
+	pthread_cond_init(&workers.completed_cond, NULL);
+
+	// split the data into chunks such that each chunk starts at the start of
+	// a line.
+
+	for (i = 0; i < worker_count; i++) {
+		deen_index_worker *worker = &workers.worker[i];
+
+		worker->workers = &workers;
+		worker->thread_started = DEEN_FALSE;
+		worker->progress = 0.0f;
+		worker->is_error = DEEN_FALSE;
+		worker->from = (0 == i) ? 0 : workers.worker[i - 1].to;
+		worker->to = (i == worker_count - 1) ? file_len : deen_index_line_start_at_or_after(
+			fd_data, (file_len / worker_count) * (i + 1), file_len);
+
+		if (worker->to < worker->from) {
+			worker->to = worker->from;
+		}
+
+		deen_index_context_init(
+			&worker->index_context,
+			worker,
+			&deen_index_worker_progress_cb,
+			&deen_index_worker_is_cancelled_cb);
+		worker->index_context.index_bulk_context = deen_index_bulk_context_create();
+	}
+
+	for (i = 0; i < worker_count && !is_error; i++) {
+		deen_index_worker *worker = &workers.worker[i];
+
+		if (0 != pthread_create(&worker->thread, NULL, &deen_index_worker_run, worker)) {
+			DEEN_LOG_ERROR1("unable to start an indexing thread; %s", strerror(errno));
+			__atomic_store_n(&workers.is_cancelled, DEEN_TRUE, __ATOMIC_RELAXED);
+			is_error = DEEN_TRUE;
+		}
+		else {
+			worker->thread_started = DEEN_TRUE;
+			started_count++;
+		}
+	}
+
+	deen_index_workers_wait(&workers, context, started_count);
+
+	for (i = 0; i < worker_count; i++) {
+		deen_index_worker *worker = &workers.worker[i];
+
+		if (worker->thread_started) {
+			pthread_join(worker->thread, NULL);
+		}
+
+		if (worker->is_error) {
+			is_error = DEEN_TRUE;
+		}
+	}
+
+	// the chunks are merged in order so that the references remain ascending.
+
+	deen_tracing_begin("merge chunks");
+
+	for (i = 0; i < worker_count; i++) {
+		deen_index_worker *worker = &workers.worker[i];
+
+		if (!is_error) {
+			deen_index_bulk_merge(context->index_bulk_context, worker->index_context.index_bulk_context);
+		}
+
+		deen_index_context_clean(&worker->index_context);
+	}
+
+	deen_tracing_end("merge chunks");
+
+	pthread_cond_destroy(&workers.completed_cond);
+	pthread_mutex_destroy(&workers.lock);
+	free((void *) workers.worker);
+
+	return !is_error;
+}
+
+#endif
+
+
+/*
+Indexes the data file.  Where the index is being accumulated in memory, the
+work may be split over a number of threads.
+*/
+
+static deen_bool deen_index_data(deen_index_context *context, const char *data_path, int fd_data) {
+
+#ifndef __MINGW32__
+	if (NULL != context->index_bulk_context) {
+		off_t file_len = lseek(fd_data, 0, SEEK_END);
+		uint32_t worker_count;
+
+		if (-1 == file_len) {
+			deen_log_error_and_exit("unable to ascertain the length of the data file");
+		}
+
+		worker_count = deen_index_worker_count(file_len);
+
+		if (worker_count > 1) {
+			return deen_index_data_parallel(context, data_path, fd_data, file_len, worker_count);
+		}
+	}
+#endif
+
+	if (!deen_for_each_word_from_file(
+		DEEN_BUFFER_SIZE_EACH_WORD_FROM_FILE,
+		fd_data,
+		&deen_index_callback,
+		context)) {
+		return DEEN_FALSE;
+	}
+
+	// flush any indexes to the database.
+
+	deen_index_flush_context_prefixes_to_index(context);
+
+	return DEEN_TRUE;
+}
+
+
 #define DEEN_INSTALL_RAISE_ERROR progress_cb(process_cb_context, DEEN_INSTALL_STATE_ERROR, 0.0f); is_error=DEEN_TRUE;
 
 
@@ -510,6 +1025,7 @@ deen_bool deen_install_from_path(
 	deen_bool is_error = DEEN_FALSE;
 	char *data_path = deen_data_path(deen_root_dir);
 	char *index_path = deen_index_path(deen_root_dir);
+	char *mapindex_path = deen_mapindex_path(deen_root_dir);
 
 	progress_cb(process_cb_context, DEEN_INSTALL_STATE_STARTING, 0.0f);
 
@@ -613,72 +1129,71 @@ deen_bool deen_install_from_path(
 		time_t secs_before;
 		deen_index_context index_context;
 
-		index_context.index_add_context = deen_index_add_context_create(db);
-		index_context.lastprogress = -1.0f;
-		index_context.progress_cb_context = process_cb_context;
-		index_context.progress_cb = progress_cb;
-		index_context.is_cancelled_cb = is_cancelled_cb;
-		index_context.c_buffer_upper = NULL;
-		index_context.c_buffer_upper_len = 0;
-		index_context.current_ref = 0;
-		index_context.prefix_count = 0;
-		index_context.prefix_count_allocated = 0;
-		index_context.prefixes = NULL;
+		deen_index_context_init(&index_context, process_cb_context, progress_cb, is_cancelled_cb);
+
+		if (DEEN_INSTALL_INDEX_IN_MEMORY) {
+			index_context.index_bulk_context = deen_index_bulk_context_create();
+		}
+		else {
+			index_context.index_add_context = deen_index_add_context_create(db);
+		}
 
 		secs_before = deen_seconds_since_epoc();
 
 		deen_transaction_begin(db);
 
-		if (!deen_for_each_word_from_file(
-			DEEN_BUFFER_SIZE_EACH_WORD_FROM_FILE,
-			fd_data,
-			&deen_index_callback,
-			&index_context)) {
+		deen_tracing_begin("index data");
+
+		if (!deen_index_data(&index_context, data_path, fd_data)) {
 			DEEN_LOG_ERROR1("failure to process the file %s", data_path);
 			DEEN_INSTALL_RAISE_ERROR
 		}
 
+		deen_tracing_end("index data");
+
+		if (!is_error && NULL != index_context.index_bulk_context) {
+			deen_tracing_begin("write index");
+			deen_index_bulk_write(index_context.index_bulk_context, db);
+			deen_tracing_end("write index");
+
+			deen_tracing_begin("write binary index");
+
+			if (!deen_mapindex_write(index_context.index_bulk_context, mapindex_path)) {
+				DEEN_INSTALL_RAISE_ERROR
+			}
+
+			deen_tracing_end("write binary index");
+		}
+
+		deen_tracing_begin("commit");
 		deen_transaction_commit(db);
+		deen_tracing_end("commit");
 
 		// print out the performance of the indexing with respect to database
 		// activity
 
 #ifdef DEBUG
 		if (!is_error) {
-			DEEN_LOG_INFO1("db activity; find existing prefixes = %llu ms", index_context.index_add_context->find_existing_prefixes_millis);
-			DEEN_LOG_INFO1("db activity; add missing prefixes = %llu ms", index_context.index_add_context->add_missing_prefixes_millis);
-			DEEN_LOG_INFO1("db activity; add refs = %llu ms", index_context.index_add_context->add_refs_millis);
+			if (NULL != index_context.index_add_context) {
+				DEEN_LOG_INFO1("db activity; find existing prefixes = %llu ms", index_context.index_add_context->find_existing_prefixes_millis);
+				DEEN_LOG_INFO1("db activity; add missing prefixes = %llu ms", index_context.index_add_context->add_missing_prefixes_millis);
+				DEEN_LOG_INFO1("db activity; add refs = %llu ms", index_context.index_add_context->add_refs_millis);
+			}
+
+			if (NULL != index_context.index_bulk_context) {
+				DEEN_LOG_INFO1("db activity; intern prefixes = %llu ms", index_context.index_bulk_context->intern_prefixes_millis);
+				DEEN_LOG_INFO1("db activity; sort refs = %llu ms", index_context.index_bulk_context->sort_refs_millis);
+				DEEN_LOG_INFO1("db activity; write prefixes = %llu ms", index_context.index_bulk_context->write_prefixes_millis);
+				DEEN_LOG_INFO1("db activity; write refs = %llu ms", index_context.index_bulk_context->write_refs_millis);
+			}
 		}
 #endif
 
-		// flush any indexes to the database.
-
-		deen_index_flush_context_prefixes_to_index(&index_context);
-
 		if (!is_error) {
 			DEEN_LOG_INFO1("indexed in %u seconds", deen_seconds_since_epoc() - secs_before);
 		}
 
-		if (NULL != index_context.index_add_context) {
-			deen_index_add_context_free(index_context.index_add_context);
-		}
-
-		// release memory that might have been used in the indexing process
-		// as stored in the context.
-
-		if (NULL != index_context.c_buffer_upper) {
-			free((void *) index_context.c_buffer_upper);
-		}
-
-		if (NULL != index_context.prefixes) {
-			size_t i;
-
-			for (i=0;i<index_context.prefix_count_allocated;i++) {
-				free((void *) index_context.prefixes[i]);
-			}
-
-			free((void *) index_context.prefixes);
-		}
+		deen_index_context_clean(&index_context);
 	}
 
 	if (-1 != fd_data) {
@@ -699,10 +1214,12 @@ deen_bool deen_install_from_path(
 		DEEN_LOG_ERROR0("indexing not completed -> clean up files");
 		deen_remove_fileobject(data_path);
 		deen_remove_fileobject(index_path);
+		deen_remove_fileobject(mapindex_path);
 	}
 
 	free((void *) data_path);
 	free((void *) index_path);
+	free((void *) mapindex_path);
 
 	if (!is_error) {
 		progress_cb(process_cb_context, DEEN_INSTALL_STATE_COMPLETED, 1.0f);
@@ -712,6 +1229,8 @@ deen_bool deen_install_from_path(
 		}
 	}
 
+	deen_alloc_accounting_log("install");
+
 	return !is_error;
 }
 
@@ -15,26 +15,19 @@
 #include "constants.h"
 
 
-static size_t deen_keywords_sequence_count_or_exit(const uint8_t *c, size_t len) {
-	size_t sequence_count;
-
-	switch (deen_utf8_sequences_count(c, len, &sequence_count)) {
-
-		case DEEN_SEQUENCE_OK:
-			return sequence_count;
-			break;
-
-		case DEEN_BAD_SEQUENCE:
-			deen_log_error_and_exit("encountered bad utf-8 sequence");
-			break;
+/*
+If the keyword is not valid UTF-8 then the number of bytes is used instead
+of the number of characters; the search will report the problem.
+*/
 
-		case DEEN_INCOMPLETE_SEQUENCE:
-			deen_log_error_and_exit("encountered incomplete utf-8 sequence");
-			break;
+static size_t deen_keywords_sequence_count(const uint8_t *c, size_t len) {
+	size_t sequence_count;
 
+	if (DEEN_SEQUENCE_OK != deen_utf8_sequences_count(c, len, &sequence_count)) {
+		return len;
 	}
 
-	return 0;
+	return sequence_count;
 }
 
 static int deen_keywords_compare_length(const void *k1, const void *k2) {
@@ -42,8 +35,8 @@ static int deen_keywords_compare_length(const void *k1, const void *k2) {
 	const uint8_t *c2 = ((uint8_t **) k2)[0];
 	size_t cl1 = strlen((const char *) c1);
 	size_t cl2 = strlen((const char *) c2);
-	size_t sequence_count_1 = deen_keywords_sequence_count_or_exit(c1,cl1);
-	size_t sequence_count_2 = deen_keywords_sequence_count_or_exit(c2,cl2);
+	size_t sequence_count_1 = deen_keywords_sequence_count(c1,cl1);
+	size_t sequence_count_2 = deen_keywords_sequence_count(c2,cl2);
 
 	if (sequence_count_1==sequence_count_2) {
 
@@ -64,9 +57,27 @@ deen_keywords *deen_keywords_create() {
 	deen_keywords *keywords = (deen_keywords *) deen_emalloc(sizeof(deen_keywords));
 	keywords->count = 0;
 	keywords->keywords = NULL;
+	keywords->spelling_count = 0;
+	keywords->spellings = NULL;
+	keywords->spelling_keywords = NULL;
 	return keywords;
 }
 
+
+static void deen_keywords_free_spellings(deen_keywords *keywords) {
+	uint32_t i;
+
+	for (i=0;i<keywords->spelling_count;i++) {
+		free((void *) keywords->spellings[i]);
+	}
+
+	free((void *) keywords->spellings);
+	free((void *) keywords->spelling_keywords);
+	keywords->spelling_count = 0;
+	keywords->spellings = NULL;
+	keywords->spelling_keywords = NULL;
+}
+
 void deen_keywords_free(deen_keywords *keywords) {
 	uint32_t i;
 
@@ -78,6 +89,7 @@ void deen_keywords_free(deen_keywords *keywords) {
 		free((void *) keywords->keywords);
 	}
 
+	deen_keywords_free_spellings(keywords);
 	free((void *) keywords);
 }
 
@@ -95,7 +107,7 @@ static deen_bool deen_keywords_has_prefix(
 	uint32_t i;
 
 	for (i=0;i<keywords->count;i++) {
-		if (0 == memcmp(keywords->keywords[i], prefix, prefix_len)) {
+		if (0 == strncmp((const char *) keywords->keywords[i], (const char *) prefix, prefix_len)) {
 	    	return DEEN_TRUE;
 		}
     }
@@ -135,7 +147,99 @@ static deen_bool add_keywords_add_from_string_callback(
 	return DEEN_TRUE;
 }
 
+static void deen_keywords_add_spelling(
+	deen_keywords *keywords,
+	uint32_t keyword_index,
+	const uint8_t *spelling,
+	size_t len) {
+
+	uint32_t i;
+
+	for (i=0;i<keywords->spelling_count;i++) {
+		if (0 == strcmp((const char *) keywords->spellings[i], (const char *) spelling)) {
+			return;
+		}
+	}
+
+	keywords->spelling_count++;
+	keywords->spellings = (uint8_t **) deen_erealloc(
+		keywords->spellings,
+		sizeof(uint8_t *) * keywords->spelling_count);
+	keywords->spelling_keywords = (uint32_t *) deen_erealloc(
+		keywords->spelling_keywords,
+		sizeof(uint32_t) * keywords->spelling_count);
+	keywords->spellings[keywords->spelling_count-1] = (uint8_t *) deen_emalloc(sizeof(uint8_t) * (len + 1));
+	memcpy(keywords->spellings[keywords->spelling_count-1], spelling, len + 1);
+	keywords->spelling_keywords[keywords->spelling_count-1] = keyword_index;
+}
+
+
+/*
+The keyword is folded so that any umlauts are spelled with US-ASCII pairs and
+then each combination of those pairs being spelled with or without the umlaut
+is added.  Combinations where two pairs overlap are not possible and are
+skipped.  A spelling that is already known, perhaps from another keyword, is
+not added again.
+*/
+
+static void deen_keywords_add_spellings(deen_keywords *keywords, uint32_t keyword_index) {
+	const uint8_t *keyword = keywords->keywords[keyword_index];
+	size_t len = strlen((const char *) keyword);
+	uint8_t *folded = (uint8_t *) deen_emalloc(sizeof(uint8_t) * (len + 1));
+	uint8_t *spelling = (uint8_t *) deen_emalloc(sizeof(uint8_t) * (len + 1));
+	size_t pair_offsets[DEEN_KEYWORD_SPELLING_PAIRS_MAX];
+	uint32_t pair_count = 0;
+	uint32_t combination;
+	size_t i;
+
+	memcpy(folded, keyword, len + 1);
+	deen_fold_umlauts(folded);
+
+	deen_keywords_add_spelling(keywords, keyword_index, keyword, len);
+
+	for (i=0;i+1<len;i++) {
+		if (0 != deen_umlaut_for_usascii_pair(&folded[i])) {
+			if (DEEN_KEYWORD_SPELLING_PAIRS_MAX == pair_count) {
+				pair_count = 0;
+				break;
+			}
+
+			pair_offsets[pair_count++] = i;
+		}
+	}
+
+	for (combination=0;combination < ((uint32_t) 1 << pair_count);combination++) {
+		deen_bool is_overlapping = DEEN_FALSE;
+		uint32_t j;
+
+		memcpy(spelling, folded, len + 1);
+
+		for (j=0;j<pair_count && !is_overlapping;j++) {
+			if (0 != (combination & ((uint32_t) 1 << j))) {
+				size_t offset = pair_offsets[j];
+
+				if (0 != j && 0 != (combination & ((uint32_t) 1 << (j-1))) && pair_offsets[j-1] + 1 == offset) {
+					is_overlapping = DEEN_TRUE;
+				}
+				else {
+					spelling[offset + 1] = deen_umlaut_for_usascii_pair(&folded[offset]);
+					spelling[offset] = 0xc3;
+				}
+			}
+		}
+
+		if (!is_overlapping) {
+			deen_keywords_add_spelling(keywords, keyword_index, spelling, len);
+		}
+	}
+
+	free((void *) spelling);
+	free((void *) folded);
+}
+
+
 void deen_keywords_add_from_string(deen_keywords *keywords, const uint8_t *input) {
+	uint32_t i;
 
 	deen_for_each_word(
 		input, 0,
@@ -151,6 +255,12 @@ void deen_keywords_add_from_string(deen_keywords *keywords, const uint8_t *input
 	    keywords->count,
 	    sizeof(uint8_t *),
 	    &deen_keywords_compare_length);
+
+	deen_keywords_free_spellings(keywords);
+
+	for (i=0;i<keywords->count;i++) {
+		deen_keywords_add_spellings(keywords, i);
+	}
 }
 
 size_t deen_keywords_longest_keyword(deen_keywords *keywords) {
@@ -169,147 +279,318 @@ size_t deen_keywords_longest_keyword(deen_keywords *keywords) {
 }
 
 
-typedef struct deen_keywords_one_present_context deen_keywords_one_present_context;
-struct deen_keywords_one_present_context {
-	deen_bool found;
-	const uint8_t *keyword;
-	size_t keyword_len;
-};
+deen_bool deen_keywords_all_present(deen_keywords *keywords, const uint8_t *input) {
+	return deen_keywords_all_present_n(keywords, input, strlen((const char *) input));
+}
 
 
-static deen_bool deen_keywords_one_present_callback(
-	const uint8_t *s, size_t offset, size_t len,
-	void *context) {
+deen_bool deen_keywords_all_present_n(deen_keywords *keywords, const uint8_t *input, size_t input_len) {
+	deen_keywords_matcher *matcher = deen_keywords_matcher_create(keywords);
+	deen_bool result = deen_keywords_matcher_all_present_n(matcher, input, input_len);
+	deen_keywords_matcher_free(matcher);
+	return result;
+}
 
-	deen_keywords_one_present_context *context2 = (deen_keywords_one_present_context *) context;
 
-	if (context2->keyword_len <= len) {
-		if(DEEN_TRUE == deen_imatches_at(s, context2->keyword, offset)) {
-			DEEN_LOG_TRACE3("found [%s] at %llu in [%s]", context2->keyword, offset, s);
-			context2->found = DEEN_TRUE;
-			return DEEN_FALSE;
+deen_first_keyword deen_ifind_first_keyword(
+	const uint8_t *s,
+	deen_keywords *keywords,
+	size_t from, size_t to) {
+
+	size_t i;
+	deen_first_keyword result;
+
+	result.keyword = NULL;
+	result.offset = DEEN_NOT_FOUND;
+
+	for (i=0;i<keywords->spelling_count;i++) {
+		size_t keyword_i = deen_ifind_first(s, keywords->spellings[i], from, to);
+
+		if (DEEN_NOT_FOUND != keyword_i) {
+			if (DEEN_NOT_FOUND == result.offset || keyword_i < result.offset) {
+				result.offset = keyword_i;
+				result.keyword = keywords->spellings[i];
+			}
 		}
 	}
 
-	return DEEN_TRUE;
+	return result;
 }
 
+// ---------------------------------------------------------------
+// MATCHER
+// ---------------------------------------------------------------
 
 /*
-Returns true if the supplied keyword exists at the start of a word in the
-input.
+The matcher is a trie of the spellings of the keywords.  Each spelling leads
+to the keyword that it is a spelling of.  Keywords are only matched at the start
+of a word so, unlike an Aho-Corasick automaton, there is no need for failure
+links; each word is matched by walking down from the root of the trie.
+
+Each byte of the text is mapped to a class before it is looked up so that a
+node only needs a transition for each of the distinct bytes that appear in
+the keywords.  Class zero is for bytes that appear in no keyword.  The mapping
+also folds the case of the text in the same way as 'deen_imatches_at' does;
+the keywords are expected to be in upper case already.
+
+Keywords that are found are marked.  Rather than clearing a flag for each of
+the keywords, the marks are cleared by moving to a new stamp.
 */
 
-static deen_bool deen_keywords_one_present(const uint8_t *keyword, const uint8_t *input) {
-	deen_keywords_one_present_context context;
-	context.found = DEEN_FALSE;
-	context.keyword = keyword;
-	context.keyword_len = strlen((char *) keyword);
-	deen_for_each_word(input, 0, &deen_keywords_one_present_callback, &context);
-	return context.found;
+struct deen_keywords_matcher {
+	uint32_t keyword_count;
+
+	// the number of distinct keywords; two keywords may be spellings of the
+	// same word.
+	uint32_t terminal_count;
+
+	uint8_t byte_class[256];
+
+	// used for the byte following 0xc3 where the umlauts are folded.
+	uint8_t byte_class_after_c3[256];
+
+	uint32_t class_count;
+	uint32_t node_count;
+
+	// for each node, the next node for each class; zero means that there is
+	// no transition as no transition leads back to the root.
+	uint32_t *transitions;
+
+	// for each node, one more than the index of the keyword that ends there
+	// or zero if no keyword ends there.
+	uint32_t *node_keywords;
+
+	uint32_t *keyword_stamps;
+	uint32_t stamp;
+	uint32_t marked_count;
+};
+
+
+static uint8_t deen_keywords_matcher_fold_after_c3(uint8_t c) {
+	switch (c) {
+		case 0xab: return 0x8b; // Ee
+		case 0xbc: return 0x9c; // Ue
+		case 0xb6: return 0x96; // Oe
+		case 0xa4: return 0x84; // Ae
+		case 0xaf: return 0x8f; // Ie
+	}
+
+	return c;
 }
 
 
-deen_bool deen_keywords_all_present(deen_keywords *keywords, const uint8_t *input) {
+deen_keywords_matcher *deen_keywords_matcher_create(deen_keywords *keywords) {
+	deen_keywords_matcher *matcher = (deen_keywords_matcher *) deen_emalloc(sizeof(deen_keywords_matcher));
+	uint8_t keyword_class[256];
+	uint32_t node_max = 1;
 	uint32_t i;
 
-	for (i=0;i < keywords->count; i++) {
-		if (DEEN_FALSE == deen_keywords_one_present(keywords->keywords[i], input)) {
-		    return DEEN_FALSE;
+	// establish a class for each distinct byte in the keywords.
+
+	memset(keyword_class, 0, sizeof(keyword_class));
+	matcher->class_count = 1;
+
+	for (i=0;i<keywords->spelling_count;i++) {
+		const uint8_t *c;
+
+		for (c = keywords->spellings[i]; 0 != *c; c++) {
+			if (0 == keyword_class[*c]) {
+				keyword_class[*c] = (uint8_t) matcher->class_count++;
+			}
+
+			node_max++;
 		}
 	}
 
-	return DEEN_TRUE;
-}
+	// a byte in the text that folds to a byte in the keywords takes that
+	// byte's class.
 
+	for (i=0;i<256;i++) {
+		int upper = toupper((int) i);
+		uint8_t upper_after_c3 = deen_keywords_matcher_fold_after_c3((uint8_t) i);
 
-static deen_bool deen_keywords_single_substitute_german_usascii_abbreviations(
-	uint8_t *str,
-	const uint8_t *search,
-	const uint8_t *replace) {
+		if (upper < 0x80 && 0 != keyword_class[upper]) {
+			matcher->byte_class[i] = keyword_class[upper];
+		}
+		else {
+			matcher->byte_class[i] = keyword_class[i];
+		}
 
-	deen_bool result = DEEN_FALSE;
+		if (0 != keyword_class[upper_after_c3]) {
+			matcher->byte_class_after_c3[i] = keyword_class[upper_after_c3];
+		}
+		else {
+			matcher->byte_class_after_c3[i] = keyword_class[i];
+		}
+	}
+
+	// build the trie.
+
+	matcher->transitions = (uint32_t *) deen_emalloc(sizeof(uint32_t) * node_max * matcher->class_count);
+	matcher->node_keywords = (uint32_t *) deen_emalloc(sizeof(uint32_t) * node_max);
+	memset(matcher->transitions, 0, sizeof(uint32_t) * node_max * matcher->class_count);
+	memset(matcher->node_keywords, 0, sizeof(uint32_t) * node_max);
+	matcher->node_count = 1;
+	matcher->keyword_count = keywords->count;
+	matcher->terminal_count = 0;
+
+	matcher->keyword_stamps = (uint32_t *) deen_emalloc(sizeof(uint32_t) * (keywords->count + 1));
+	memset(matcher->keyword_stamps, 0, sizeof(uint32_t) * (keywords->count + 1));
+
+	for (i=0;i<keywords->spelling_count;i++) {
+		const uint8_t *c;
+		uint32_t node = 0;
+		uint32_t keyword_index = keywords->spelling_keywords[i];
+
+		for (c = keywords->spellings[i]; 0 != *c; c++) {
+			uint32_t *transition = &(matcher->transitions[node * matcher->class_count + keyword_class[*c]]);
+
+			if (0 == *transition) {
+				*transition = matcher->node_count++;
+			}
+
+			node = *transition;
+		}
+
+		matcher->node_keywords[node] = keyword_index + 1;
 
-	while (NULL != (str = (uint8_t *) strstr(
-		(const char *) str,
-		(const char *) search))) {
-		result = DEEN_TRUE;
-		memcpy(str, replace, 2);
-		str++;
+		// a keyword that is a duplicate of another has no spellings of its
+		// own and so is not counted.  The stamps are used here to note the
+		// keywords that have been counted.
+
+		if (0 == matcher->keyword_stamps[keyword_index]) {
+			matcher->keyword_stamps[keyword_index] = 1;
+			matcher->terminal_count++;
+		}
 	}
 
-	return result;
-}
+	memset(matcher->keyword_stamps, 0, sizeof(uint32_t) * (keywords->count + 1));
+	matcher->stamp = 1;
+	matcher->marked_count = 0;
 
+	return matcher;
+}
 
-static deen_bool deen_keywords_substitute_german_usascii_abbreviations(uint8_t *value) {
-	static uint8_t s_Ee[] = { 'E','E',0 };
-	static uint8_t s_Ue[] = { 'U','E',0 };
-	static uint8_t s_Oe[] = { 'O','E',0 };
-	static uint8_t s_Ae[] = { 'A','E',0 };
-	static uint8_t s_Ie[] = { 'I','E',0 };
-	static uint8_t s_ss[] = { 'S','S',0 };
 
-	static uint8_t r_Ee[] = { 0xc3,0x8b,0 };
-	static uint8_t r_Ue[] = { 0xc3,0x9c,0 };
-	static uint8_t r_Oe[] = { 0xc3,0x96,0 };
-	static uint8_t r_Ae[] = { 0xc3,0x84,0 };
-	static uint8_t r_Ie[] = { 0xc3,0x8f,0 };
-	static uint8_t r_ss[] = { 0xc3,0x9f,0 };
+void deen_keywords_matcher_free(deen_keywords_matcher *matcher) {
+	free((void *) matcher->transitions);
+	free((void *) matcher->node_keywords);
+	free((void *) matcher->keyword_stamps);
+	free((void *) matcher);
+}
 
-	deen_bool adjusted = DEEN_FALSE;
 
-	adjusted = adjusted | deen_keywords_single_substitute_german_usascii_abbreviations(value,s_Ee,r_Ee);
-	adjusted = adjusted | deen_keywords_single_substitute_german_usascii_abbreviations(value,s_Ue,r_Ue);
-	adjusted = adjusted | deen_keywords_single_substitute_german_usascii_abbreviations(value,s_Oe,r_Oe);
-	adjusted = adjusted | deen_keywords_single_substitute_german_usascii_abbreviations(value,s_Ae,r_Ae);
-	adjusted = adjusted | deen_keywords_single_substitute_german_usascii_abbreviations(value,s_Ie,r_Ie);
-	adjusted = adjusted | deen_keywords_single_substitute_german_usascii_abbreviations(value,s_ss,r_ss);
+void deen_keywords_matcher_clear_marks(deen_keywords_matcher *matcher) {
+	matcher->stamp++;
+	matcher->marked_count = 0;
 
-	return adjusted;
+	if (0 == matcher->stamp) {
+		memset(matcher->keyword_stamps, 0, sizeof(uint32_t) * (matcher->keyword_count + 1));
+		matcher->stamp = 1;
+	}
 }
 
 
-// happily the adjustments are applied to two consecutive characters which can
-// be replaced in-situ with the UTF-8 sequence.
+void deen_keywords_matcher_mark(deen_keywords_matcher *matcher, size_t keyword_index) {
+	if (matcher->stamp != matcher->keyword_stamps[keyword_index]) {
+		matcher->keyword_stamps[keyword_index] = matcher->stamp;
+		matcher->marked_count++;
+	}
+}
 
-deen_bool deen_keywords_adjust(deen_keywords *keywords) {
-	deen_bool adjusted = DEEN_FALSE;
-	uint32_t i;
 
-	for (i=0;i < keywords->count; i++) {
-		adjusted = adjusted | deen_keywords_substitute_german_usascii_abbreviations(keywords->keywords[i]);
-    }
+// as with the presence check, a keyword that is a duplicate of another is
+// never marked and so is not counted.
 
-    return adjusted;
+deen_bool deen_keywords_matcher_all_marked(deen_keywords_matcher *matcher) {
+	return matcher->marked_count == matcher->terminal_count;
 }
 
 
-deen_first_keyword deen_ifind_first_keyword(
-	const uint8_t *s,
-	deen_keywords *keywords,
-	size_t from, size_t to) {
+/*
+Walks down the trie with the word and returns the index of the longest keyword
+that the word starts with.  Because the keywords are ordered longest first,
+this is the first keyword in the list that the word starts with.  If
+'mark_all' is true then every keyword that the word starts with is marked.
+*/
+
+static size_t deen_keywords_matcher_walk(
+	deen_keywords_matcher *matcher,
+	const uint8_t *s, size_t offset, size_t len,
+	deen_bool mark_all,
+	size_t *keyword_len) {
 
+	const uint8_t *byte_class = matcher->byte_class;
+	size_t result = DEEN_NOT_FOUND;
+	uint32_t node = 0;
 	size_t i;
-	deen_first_keyword result;
 
-	result.keyword = NULL;
-	result.offset = DEEN_NOT_FOUND;
+	for (i=0;i<len;i++) {
+		uint8_t c = s[offset + i];
 
-	for (i=0;i<keywords->count;i++) {
-		size_t keyword_i = deen_ifind_first(s, keywords->keywords[i], from, to);
+		node = matcher->transitions[node * matcher->class_count + byte_class[c]];
 
-		if (DEEN_NOT_FOUND != keyword_i) {
-			if (DEEN_NOT_FOUND == result.offset || keyword_i < result.offset) {
-				result.offset = keyword_i;
-				result.keyword = keywords->keywords[i];
+		if (0 == node) {
+			break;
+		}
+
+		if (0 != matcher->node_keywords[node]) {
+			result = matcher->node_keywords[node] - 1;
+			*keyword_len = i + 1;
+
+			if (mark_all) {
+				deen_keywords_matcher_mark(matcher, result);
 			}
 		}
+
+		// the byte after 0xc3 completes the sequence so the one after that
+		// starts afresh.
+
+		if (0xc3 == c && byte_class == matcher->byte_class) {
+			byte_class = matcher->byte_class_after_c3;
+		}
+		else {
+			byte_class = matcher->byte_class;
+		}
 	}
 
 	return result;
 }
 
+
+size_t deen_keywords_matcher_find_at(
+	deen_keywords_matcher *matcher,
+	const uint8_t *s, size_t offset, size_t len,
+	size_t *keyword_len) {
+	return deen_keywords_matcher_walk(matcher, s, offset, len, DEEN_FALSE, keyword_len);
+}
+
+
+static deen_bool deen_keywords_matcher_all_present_callback(
+	const uint8_t *s, size_t offset, size_t len,
+	void *context) {
+
+	deen_keywords_matcher *matcher = (deen_keywords_matcher *) context;
+	size_t keyword_len;
+
+	deen_keywords_matcher_walk(matcher, s, offset, len, DEEN_TRUE, &keyword_len);
+
+	// no need to look any further once all of the keywords are found.
+	return matcher->marked_count != matcher->terminal_count;
+}
+
+
+deen_bool deen_keywords_matcher_all_present_n(
+	deen_keywords_matcher *matcher,
+	const uint8_t *input,
+	size_t input_len) {
+
+	deen_keywords_matcher_clear_marks(matcher);
+	deen_for_each_word_n(input, 0, input_len, &deen_keywords_matcher_all_present_callback, matcher);
+	return matcher->marked_count == matcher->terminal_count;
+}
+
+
 void deen_trace_log_keywords(deen_keywords *keywords) {
 	uint32_t i;
 
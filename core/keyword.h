@@ -19,7 +19,8 @@ void deen_keywords_free(deen_keywords *keywords);
 
 /*
 Adds all of the keywords found in the input into the list of keywords.
-It expects that the 'input' string is already in upper case.
+It expects that the 'input' string is already in upper case.  The spellings
+of each of the keywords are also established.
 */
 
 void deen_keywords_add_from_string(deen_keywords *keywords, const uint8_t *input);
@@ -39,22 +40,66 @@ at the *start* of words rather than anywhere in the string.
 deen_bool deen_keywords_all_present(deen_keywords *keywords, const uint8_t *input);
 
 /*
-In some cases, the keywords can contain abbreviations and so on that make
-searches difficult in the data.  For example, the string "oe" can be an
-abbreviation for o-umlaut and so if nothing is found, the keywords can be
-tweaked so that searches work.
+This performs the same function as 'deen_keywords_all_present', but the input
+need not be NULL terminated; only the first 'input_len' bytes are considered.
 */
 
-deen_bool deen_keywords_adjust(deen_keywords *keywords);
+deen_bool deen_keywords_all_present_n(deen_keywords *keywords, const uint8_t *input, size_t input_len);
 
 /*
 Out of the list of supplied keywords, find the first one in the source text.
+Any of the spellings of the keywords may be found and the spelling is
+returned as the keyword; all of the spellings of a keyword are the same
+length.
 */
 
 deen_first_keyword deen_ifind_first_keyword(const uint8_t *s, deen_keywords *keywords, size_t from, size_t to);
 
 // ---------------------------------------------------------------
 
+/*
+Compiles the keywords into a matcher.  The keywords should not be altered
+while the matcher is in use.
+*/
+
+deen_keywords_matcher *deen_keywords_matcher_create(deen_keywords *keywords);
+
+void deen_keywords_matcher_free(deen_keywords_matcher *matcher);
+
+/*
+This performs the same function as 'deen_keywords_all_present_n' but with a
+single pass over the input however many keywords there are.  It clears the
+marks on the keywords.
+*/
+
+deen_bool deen_keywords_matcher_all_present_n(
+	deen_keywords_matcher *matcher,
+	const uint8_t *input,
+	size_t input_len);
+
+/*
+Returns the index of the first keyword that the word at the offset starts
+with or DEEN_NOT_FOUND if there is none.  Only the 'len' bytes of the word
+are considered.  The length of the keyword in bytes is also returned.
+*/
+
+size_t deen_keywords_matcher_find_at(
+	deen_keywords_matcher *matcher,
+	const uint8_t *s, size_t offset, size_t len,
+	size_t *keyword_len);
+
+/*
+These functions keep track of which of the keywords have been used.
+*/
+
+void deen_keywords_matcher_clear_marks(deen_keywords_matcher *matcher);
+
+void deen_keywords_matcher_mark(deen_keywords_matcher *matcher, size_t keyword_index);
+
+deen_bool deen_keywords_matcher_all_marked(deen_keywords_matcher *matcher);
+
+// ---------------------------------------------------------------
+
 void deen_trace_log_keywords(deen_keywords *keywords);
 
 #endif /* __KEYWORD_H */
@@ -0,0 +1,657 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+#include "mapindex.h"
+
+#include <fcntl.h>
+#ifdef __MINGW32__
+#include <io.h>
+#else
+#include <sys/mman.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "constants.h"
+#include "index.h"
+#include "postings.h"
+
+/*
+Each posting list starts on a boundary of this many bytes so that its skip
+table can be read directly from the mapped data.
+*/
+
+#define DEEN_MAPINDEX_POSTINGS_ALIGN 8
+
+
+/*
+This is used to order the prefixes and the terms of the in-memory index for
+writing.
+*/
+
+typedef struct deen_mapindex_write_prefix deen_mapindex_write_prefix;
+struct deen_mapindex_write_prefix {
+	const uint8_t *prefix;
+	uint32_t prefix_id;
+};
+
+
+static int deen_mapindex_write_prefix_compare(const void *a, const void *b) {
+	return strcmp(
+		(const char *) ((const deen_mapindex_write_prefix *) a)->prefix,
+		(const char *) ((const deen_mapindex_write_prefix *) b)->prefix);
+}
+
+
+/*
+The posting lists of all of the prefixes and terms are compressed into this
+buffer one after the other.
+*/
+
+typedef struct deen_mapindex_write_postings deen_mapindex_write_postings;
+struct deen_mapindex_write_postings {
+	uint8_t *data;
+	size_t len;
+	size_t allocated;
+
+	// re-used to hold the refs of each posting list before it is encoded.
+	int64_t *refs;
+	size_t refs_allocated;
+};
+
+
+/*
+Sorts the refs of the context and then orders its prefixes so that they can
+be binary searched.  For each prefix id, the position of its first ref in the
+sorted refs is written to 'starts' and the number of its refs to 'counts'.
+*/
+
+static deen_mapindex_write_prefix *deen_mapindex_order_prefixes(
+	deen_index_bulk_context *context,
+	size_t *starts,
+	uint32_t *counts) {
+
+	deen_mapindex_write_prefix *write_prefixes;
+	uint32_t i;
+	size_t j;
+
+	deen_index_bulk_sort(context);
+
+	memset(counts, 0, sizeof(uint32_t) * (context->prefix_count + 1));
+
+	for (j = 0; j < context->prefix_refs_count; j++) {
+		uint32_t prefix_id = context->prefix_refs[j].prefix_id;
+
+		if (0 == counts[prefix_id]) {
+			starts[prefix_id] = j;
+		}
+
+		counts[prefix_id]++;
+	}
+
+	write_prefixes = (deen_mapindex_write_prefix *) deen_emalloc(
+		sizeof(deen_mapindex_write_prefix) * (context->prefix_count + 1));
+
+	for (i = 0; i < context->prefix_count; i++) {
+		write_prefixes[i].prefix = &context->prefixes[i * context->prefix_size];
+		write_prefixes[i].prefix_id = i + 1;
+	}
+
+	qsort(
+		write_prefixes, context->prefix_count,
+		sizeof(deen_mapindex_write_prefix), &deen_mapindex_write_prefix_compare);
+
+	return write_prefixes;
+}
+
+
+/*
+Compresses the refs into the postings and returns the number of refs that
+were written.  The same ref may appear more than once for a term and so any
+repeated refs are dropped.  The posting list is padded so that the next one
+is aligned.
+*/
+
+static uint32_t deen_mapindex_encode_postings(
+	deen_mapindex_write_postings *postings,
+	const deen_index_prefix_ref *prefix_refs,
+	size_t count,
+	uint64_t *postings_offset,
+	uint32_t *postings_len,
+	uint32_t *block_count) {
+
+	size_t len_max = deen_postings_encode_len_max(count) + DEEN_MAPINDEX_POSTINGS_ALIGN;
+	size_t refs_count = 0;
+	size_t j;
+
+	if (count > postings->refs_allocated) {
+		postings->refs_allocated = count;
+		postings->refs = (int64_t *) deen_erealloc(postings->refs, sizeof(int64_t) * postings->refs_allocated);
+	}
+
+	for (j = 0; j < count; j++) {
+		if (0 == refs_count || postings->refs[refs_count - 1] != (int64_t) prefix_refs[j].ref) {
+			postings->refs[refs_count++] = (int64_t) prefix_refs[j].ref;
+		}
+	}
+
+	if (postings->len + len_max > postings->allocated) {
+		postings->allocated = (postings->len + len_max) * 2;
+		postings->data = (uint8_t *) deen_erealloc(postings->data, postings->allocated);
+	}
+
+	*postings_offset = postings->len;
+	*postings_len = (uint32_t) deen_postings_encode(
+		postings->refs, refs_count, &postings->data[postings->len], block_count);
+
+	postings->len += *postings_len;
+
+	while (0 != (postings->len % DEEN_MAPINDEX_POSTINGS_ALIGN)) {
+		postings->data[postings->len++] = 0;
+	}
+
+	return (uint32_t) refs_count;
+}
+
+
+deen_bool deen_mapindex_write(deen_index_bulk_context *context, const char *path) {
+	deen_bool result = DEEN_TRUE;
+	deen_index_bulk_context *terms_context = context->terms;
+	uint32_t term_count = (NULL == terms_context) ? 0 : terms_context->prefix_count;
+	deen_mapindex_header header;
+	deen_mapindex_write_prefix *write_prefixes;
+	deen_mapindex_write_prefix *write_terms = NULL;
+	deen_mapindex_prefix *prefixes;
+	deen_mapindex_term *terms;
+	deen_mapindex_write_postings postings;
+	uint8_t *term_text;
+	size_t term_text_len = 0;
+	uint64_t term_refs_count = 0;
+	size_t *starts;
+	uint32_t *counts;
+	uint32_t i;
+	FILE *file;
+
+	memset(&postings, 0, sizeof(deen_mapindex_write_postings));
+
+	// the posting lists of the prefixes come first.
+
+	starts = (size_t *) deen_emalloc(sizeof(size_t) * (context->prefix_count + 1));
+	counts = (uint32_t *) deen_emalloc(sizeof(uint32_t) * (context->prefix_count + 1));
+	write_prefixes = deen_mapindex_order_prefixes(context, starts, counts);
+	prefixes = (deen_mapindex_prefix *) deen_emalloc(
+		sizeof(deen_mapindex_prefix) * (context->prefix_count + 1));
+
+	for (i = 0; i < context->prefix_count; i++) {
+		uint32_t prefix_id = write_prefixes[i].prefix_id;
+
+		memset(&prefixes[i], 0, sizeof(deen_mapindex_prefix));
+		strncpy(
+			(char *) prefixes[i].prefix,
+			(const char *) write_prefixes[i].prefix,
+			DEEN_MAPINDEX_PREFIX_SIZE - 1);
+		prefixes[i].refs_count = deen_mapindex_encode_postings(
+			&postings,
+			&context->prefix_refs[starts[prefix_id]],
+			counts[prefix_id],
+			&prefixes[i].postings_offset,
+			&prefixes[i].postings_len,
+			&prefixes[i].block_count);
+	}
+
+	free((void *) counts);
+	free((void *) starts);
+
+	// then those of the terms; the text of the terms is gathered as well.
+
+	terms = (deen_mapindex_term *) deen_emalloc(sizeof(deen_mapindex_term) * (term_count + 1));
+	term_text = (uint8_t *) deen_emalloc(
+		sizeof(uint8_t) * ((term_count * DEEN_INDEXING_TERM_SIZE) + DEEN_MAPINDEX_POSTINGS_ALIGN));
+
+	if (0 != term_count) {
+		starts = (size_t *) deen_emalloc(sizeof(size_t) * (term_count + 1));
+		counts = (uint32_t *) deen_emalloc(sizeof(uint32_t) * (term_count + 1));
+		write_terms = deen_mapindex_order_prefixes(terms_context, starts, counts);
+
+		for (i = 0; i < term_count; i++) {
+			uint32_t term_id = write_terms[i].prefix_id;
+			size_t len = strlen((const char *) write_terms[i].prefix);
+
+			memset(&terms[i], 0, sizeof(deen_mapindex_term));
+			terms[i].text_offset = (uint32_t) term_text_len;
+			memcpy(&term_text[term_text_len], write_terms[i].prefix, len + 1);
+			term_text_len += len + 1;
+			terms[i].refs_count = deen_mapindex_encode_postings(
+				&postings,
+				&terms_context->prefix_refs[starts[term_id]],
+				counts[term_id],
+				&terms[i].postings_offset,
+				&terms[i].postings_len,
+				&terms[i].block_count);
+			term_refs_count += terms[i].refs_count;
+		}
+
+		free((void *) counts);
+		free((void *) starts);
+	}
+
+	// the text is padded so that the posting lists following it are aligned.
+
+	while (0 != (term_text_len % DEEN_MAPINDEX_POSTINGS_ALIGN)) {
+		term_text[term_text_len++] = 0;
+	}
+
+	file = fopen(path, "wb");
+
+	if (NULL == file) {
+		DEEN_LOG_ERROR1("unable to open the binary index for writing; %s", path);
+		result = DEEN_FALSE;
+	}
+
+	if (result) {
+		memset(&header, 0, sizeof(deen_mapindex_header));
+		memcpy(header.magic, DEEN_MAPINDEX_MAGIC, DEEN_MAPINDEX_MAGIC_SIZE);
+		header.version = DEEN_MAPINDEX_VERSION;
+		header.prefix_count = context->prefix_count;
+		header.refs_count = context->prefix_refs_count;
+		header.postings_len = postings.len;
+		header.term_count = term_count;
+		header.term_text_len = (uint32_t) term_text_len;
+		header.term_refs_count = term_refs_count;
+
+		if (1 != fwrite(&header, sizeof(deen_mapindex_header), 1, file)) {
+			result = DEEN_FALSE;
+		}
+	}
+
+	if (result && context->prefix_count != fwrite(prefixes, sizeof(deen_mapindex_prefix), context->prefix_count, file)) {
+		result = DEEN_FALSE;
+	}
+
+	if (result && term_count != fwrite(terms, sizeof(deen_mapindex_term), term_count, file)) {
+		result = DEEN_FALSE;
+	}
+
+	if (result && term_text_len != fwrite(term_text, sizeof(uint8_t), term_text_len, file)) {
+		result = DEEN_FALSE;
+	}
+
+	if (result && postings.len != fwrite(postings.data, sizeof(uint8_t), postings.len, file)) {
+		result = DEEN_FALSE;
+	}
+
+	if (NULL != file) {
+		if (0 != fclose(file)) {
+			result = DEEN_FALSE;
+		}
+
+		if (!result) {
+			DEEN_LOG_ERROR1("unable to write the binary index; %s", path);
+		}
+	}
+
+	if (result) {
+		DEEN_LOG_INFO3("wrote %u prefixes and %lu refs in %lu bytes of postings to the binary index",
+			context->prefix_count, (unsigned long) context->prefix_refs_count,
+			(unsigned long) postings.len);
+		DEEN_LOG_INFO2("wrote %u terms and %lu refs to the binary index",
+			term_count, (unsigned long) term_refs_count);
+	}
+
+	free((void *) postings.refs);
+	free((void *) postings.data);
+	free((void *) term_text);
+	free((void *) terms);
+	free((void *) write_terms);
+	free((void *) prefixes);
+	free((void *) write_prefixes);
+
+	return result;
+}
+
+
+/*
+Each posting list is expected to be within the postings and aligned so that a
+lookup can never stray outside of the data.
+*/
+
+static deen_bool deen_mapindex_is_postings_in_bounds(
+	const deen_mapindex *mapindex,
+	uint64_t postings_offset,
+	uint32_t postings_len) {
+	return postings_offset <= mapindex->postings_len
+		&& postings_len <= mapindex->postings_len - postings_offset
+		&& 0 == (postings_offset % DEEN_MAPINDEX_POSTINGS_ALIGN);
+}
+
+
+/*
+Checks that the data looks like a binary index and, if so, configures the
+pointers into the data.
+*/
+
+static deen_bool deen_mapindex_configure(deen_mapindex *mapindex) {
+	const deen_mapindex_header *header = (const deen_mapindex_header *) mapindex->data;
+	uint64_t expected_len;
+	uint64_t refs_count = 0;
+	uint64_t term_refs_count = 0;
+	size_t offset;
+	uint32_t i;
+
+	if (mapindex->data_len < sizeof(deen_mapindex_header)) {
+		return DEEN_FALSE;
+	}
+
+	if (0 != memcmp(header->magic, DEEN_MAPINDEX_MAGIC, DEEN_MAPINDEX_MAGIC_SIZE)) {
+		return DEEN_FALSE;
+	}
+
+	if (DEEN_MAPINDEX_VERSION != header->version) {
+		DEEN_LOG_INFO2("binary index version %u is not supported (expected %u)",
+			header->version, DEEN_MAPINDEX_VERSION);
+		return DEEN_FALSE;
+	}
+
+	expected_len = sizeof(deen_mapindex_header)
+		+ ((uint64_t) header->prefix_count * sizeof(deen_mapindex_prefix))
+		+ ((uint64_t) header->term_count * sizeof(deen_mapindex_term))
+		+ header->term_text_len
+		+ header->postings_len;
+
+	if (expected_len != (uint64_t) mapindex->data_len
+		|| 0 != (header->term_text_len % DEEN_MAPINDEX_POSTINGS_ALIGN)) {
+		return DEEN_FALSE;
+	}
+
+	offset = sizeof(deen_mapindex_header);
+	mapindex->prefix_count = header->prefix_count;
+	mapindex->prefixes = (const deen_mapindex_prefix *) &mapindex->data[offset];
+	mapindex->refs_count = header->refs_count;
+	offset += header->prefix_count * sizeof(deen_mapindex_prefix);
+	mapindex->term_count = header->term_count;
+	mapindex->terms = (const deen_mapindex_term *) &mapindex->data[offset];
+	mapindex->term_refs_count = header->term_refs_count;
+	offset += header->term_count * sizeof(deen_mapindex_term);
+	mapindex->term_text_len = header->term_text_len;
+	mapindex->term_text = &mapindex->data[offset];
+	offset += header->term_text_len;
+	mapindex->postings_len = header->postings_len;
+	mapindex->postings = &mapindex->data[offset];
+
+	for (i = 0; i < mapindex->prefix_count; i++) {
+		const deen_mapindex_prefix *prefix = &mapindex->prefixes[i];
+
+		if (!deen_mapindex_is_postings_in_bounds(mapindex, prefix->postings_offset, prefix->postings_len)) {
+			return DEEN_FALSE;
+		}
+
+		refs_count += prefix->refs_count;
+	}
+
+	// the text of each term must be terminated before the end of the text
+	// of all of the terms; the text ends with at least one NULL.
+
+	if (0 != mapindex->term_count
+		&& (0 == mapindex->term_text_len || 0 != mapindex->term_text[mapindex->term_text_len - 1])) {
+		return DEEN_FALSE;
+	}
+
+	for (i = 0; i < mapindex->term_count; i++) {
+		const deen_mapindex_term *term = &mapindex->terms[i];
+
+		if (term->text_offset >= mapindex->term_text_len
+			|| !deen_mapindex_is_postings_in_bounds(mapindex, term->postings_offset, term->postings_len)) {
+			return DEEN_FALSE;
+		}
+
+		term_refs_count += term->refs_count;
+	}
+
+	return refs_count == mapindex->refs_count && term_refs_count == mapindex->term_refs_count;
+}
+
+
+deen_mapindex *deen_mapindex_open(const char *path) {
+	deen_mapindex *mapindex;
+	struct stat st;
+	int fd = open(path, O_RDONLY
+#ifdef __MINGW32__
+		|O_BINARY
+#endif
+	);
+
+	if (-1 == fd) {
+#ifdef DEBUG
+		DEEN_LOG_INFO1("no binary index is available; %s", path);
+#endif
+		return NULL;
+	}
+
+	if (0 != fstat(fd, &st) || st.st_size < (off_t) sizeof(deen_mapindex_header)) {
+		DEEN_LOG_ERROR1("the binary index is not valid; %s", path);
+		close(fd);
+		return NULL;
+	}
+
+	mapindex = (deen_mapindex *) deen_emalloc(sizeof(deen_mapindex));
+	mapindex->data_len = (size_t) st.st_size;
+
+#ifdef __MINGW32__
+	{
+		size_t data_read = 0;
+
+		mapindex->is_mapped = DEEN_FALSE;
+		mapindex->data = (uint8_t *) deen_emalloc(mapindex->data_len);
+
+		while (data_read < mapindex->data_len) {
+			int actuallyread = read(fd, &mapindex->data[data_read], mapindex->data_len - data_read);
+
+			if (actuallyread <= 0) {
+				DEEN_LOG_ERROR1("unable to read the binary index; %s", path);
+				free((void *) mapindex->data);
+				free((void *) mapindex);
+				close(fd);
+				return NULL;
+			}
+
+			data_read += (size_t) actuallyread;
+		}
+	}
+#else
+	mapindex->is_mapped = DEEN_TRUE;
+	mapindex->data = (uint8_t *) mmap(NULL, mapindex->data_len, PROT_READ, MAP_SHARED, fd, 0);
+
+	if (MAP_FAILED == (void *) mapindex->data) {
+		DEEN_LOG_ERROR1("unable to map the binary index; %s", path);
+		free((void *) mapindex);
+		close(fd);
+		return NULL;
+	}
+#endif
+
+	close(fd);
+
+	if (!deen_mapindex_configure(mapindex)) {
+		DEEN_LOG_ERROR1("the binary index is not valid; %s", path);
+		deen_mapindex_close(mapindex);
+		return NULL;
+	}
+
+#ifdef DEBUG
+	DEEN_LOG_INFO1("opened binary index; %s", path);
+#endif
+
+	return mapindex;
+}
+
+
+void deen_mapindex_close(deen_mapindex *mapindex) {
+	if (NULL != mapindex) {
+#ifndef __MINGW32__
+		if (mapindex->is_mapped) {
+			munmap((void *) mapindex->data, mapindex->data_len);
+		}
+		else
+#endif
+		{
+			free((void *) mapindex->data);
+		}
+
+		free((void *) mapindex);
+	}
+}
+
+
+deen_postings_cursor *deen_mapindex_lookup(
+	deen_mapindex *mapindex,
+	const uint8_t *prefix) {
+
+	uint32_t low = 0;
+	uint32_t high = mapindex->prefix_count;
+
+	while (low < high) {
+		uint32_t mid = low + ((high - low) / 2);
+		const deen_mapindex_prefix *mid_prefix = &mapindex->prefixes[mid];
+		int cmp = strncmp(
+			(const char *) prefix,
+			(const char *) mid_prefix->prefix,
+			DEEN_MAPINDEX_PREFIX_SIZE);
+
+		if (0 == cmp) {
+			return deen_postings_cursor_create(
+				&mapindex->postings[mid_prefix->postings_offset],
+				mid_prefix->postings_len,
+				mid_prefix->block_count,
+				mid_prefix->refs_count);
+		}
+
+		if (cmp < 0) {
+			high = mid;
+		}
+		else {
+			low = mid + 1;
+		}
+	}
+
+	return deen_postings_cursor_create_from_refs(NULL, 0);
+}
+
+
+/*
+Only the first 'len' bytes of each term are compared with the supplied term so
+that all of the terms that start with it are treated as equal to it.  This
+returns the position, from 'low' onwards, of the first term that is not
+ordered before the supplied term or, if 'is_after_equal', is ordered after it.
+*/
+
+static uint32_t deen_mapindex_term_lower_bound(
+	const deen_mapindex *mapindex,
+	uint32_t low,
+	const uint8_t *term,
+	size_t len,
+	deen_bool is_after_equal) {
+
+	uint32_t high = mapindex->term_count;
+
+	while (low < high) {
+		uint32_t mid = low + ((high - low) / 2);
+		const char *mid_text = (const char *) &mapindex->term_text[mapindex->terms[mid].text_offset];
+		int cmp = strncmp(mid_text, (const char *) term, len);
+
+		if (cmp < 0 || (is_after_equal && 0 == cmp)) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+
+static int deen_mapindex_ref_compare(const void *a, const void *b) {
+	off_t a_ref = *((const off_t *) a);
+	off_t b_ref = *((const off_t *) b);
+
+	if (a_ref == b_ref) {
+		return 0;
+	}
+
+	return a_ref < b_ref ? -1 : 1;
+}
+
+
+deen_postings_cursor *deen_mapindex_lookup_terms(
+	deen_mapindex *mapindex,
+	const uint8_t *term) {
+
+	size_t len = strlen((const char *) term);
+	uint32_t first = deen_mapindex_term_lower_bound(mapindex, 0, term, len, DEEN_FALSE);
+	uint32_t last = deen_mapindex_term_lower_bound(mapindex, first, term, len, DEEN_TRUE);
+	uint64_t count = 0;
+	off_t *refs;
+	size_t refs_count = 0;
+	size_t unique_count = 0;
+	deen_postings_cursor *cursor;
+	uint32_t i;
+	size_t j;
+
+	// a single term is able to be read straight from the mapped index.
+
+	if (last - first == 1) {
+		const deen_mapindex_term *mapindex_term = &mapindex->terms[first];
+
+		return deen_postings_cursor_create(
+			&mapindex->postings[mapindex_term->postings_offset],
+			mapindex_term->postings_len,
+			mapindex_term->block_count,
+			mapindex_term->refs_count);
+	}
+
+	// otherwise the posting lists of the terms are decoded together and then
+	// sorted; a line that has more than one of the terms appears only once.
+
+	for (i = first; i < last; i++) {
+		count += mapindex->terms[i].refs_count;
+	}
+
+	refs = (off_t *) deen_emalloc(sizeof(off_t) * (count + 1));
+
+	for (i = first; i < last; i++) {
+		const deen_mapindex_term *mapindex_term = &mapindex->terms[i];
+
+		if (!deen_postings_decode(
+			&mapindex->postings[mapindex_term->postings_offset],
+			mapindex_term->postings_len,
+			mapindex_term->block_count,
+			mapindex_term->refs_count,
+			&refs[refs_count])) {
+			cursor = deen_postings_cursor_create_from_refs(refs, 0);
+			cursor->is_error = DEEN_TRUE;
+			return cursor;
+		}
+
+		refs_count += mapindex_term->refs_count;
+	}
+
+	qsort(refs, refs_count, sizeof(off_t), &deen_mapindex_ref_compare);
+
+	for (j = 0; j < refs_count; j++) {
+		if (0 == unique_count || refs[unique_count - 1] != refs[j]) {
+			refs[unique_count++] = refs[j];
+		}
+	}
+
+	return deen_postings_cursor_create_from_refs(refs, unique_count);
+}
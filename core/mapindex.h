@@ -0,0 +1,66 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+#ifndef __MAPINDEX_H
+#define __MAPINDEX_H
+
+#include <stdint.h>
+
+#include "types.h"
+
+/*
+The map index is a read-only binary form of the index that is written at
+install time alongside the sqlite database.  At search time it is mapped into
+memory such that a lookup is a binary search of the prefixes yielding a
+pointer to the refs; there is no SQL to parse and no rows to copy.  The binary
+index also has the whole words, or terms, so that a longer keyword is able to
+find exactly those refs that have a word starting with the keyword.
+*/
+
+/*
+Writes the prefixes, terms and references from the context into a binary index
+at the supplied path.  Returns false if the file was not able to be written.
+*/
+
+deen_bool deen_mapindex_write(deen_index_bulk_context *context, const char *path);
+
+/*
+Opens the binary index at the supplied path.  If the file does not exist or
+is not a valid binary index then NULL is returned and the caller may fall back
+to using the sqlite database.
+*/
+
+deen_mapindex *deen_mapindex_open(const char *path);
+
+void deen_mapindex_close(deen_mapindex *mapindex);
+
+/*
+This function will lookup the prefix and returns a cursor over its refs.  The
+cursor must be freed by the caller using 'deen_postings_cursor_free' before
+the index is closed because it reads the posting list from the mapped index.
+If the prefix is not present then the cursor has no refs.  The posting list
+is decoded as the cursor is moved so any corruption is reported by the
+cursor.
+*/
+
+deen_postings_cursor *deen_mapindex_lookup(
+	deen_mapindex *mapindex,
+	const uint8_t *prefix);
+
+/*
+This function will lookup all of the terms that start with the supplied term
+and returns a cursor over the union of their refs.  If there is only one such
+term then the cursor reads from the mapped index in the same way as for a
+prefix.  If there are no such terms then the cursor has no refs.
+*/
+
+deen_postings_cursor *deen_mapindex_lookup_terms(
+	deen_mapindex *mapindex,
+	const uint8_t *term);
+
+#endif /* __MAPINDEX_H */
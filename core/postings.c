@@ -0,0 +1,469 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+#include "postings.h"
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "common.h"
+#include "constants.h"
+
+/*
+A delta of up to 32 bits requires at most this many bytes as a varint.
+*/
+
+#define DEEN_POSTINGS_VARINT_LEN_MAX 5
+
+
+size_t deen_postings_encode_len_max(size_t count) {
+	// in the worst case, each ref is in its own block.
+	return count * (sizeof(deen_postings_skip) + DEEN_POSTINGS_VARINT_LEN_MAX);
+}
+
+
+/*
+Returns the index of the ref after the last ref in the block starting at
+'start'.
+*/
+
+static size_t deen_postings_block_end(const int64_t *refs, size_t count, size_t start) {
+	size_t end = start + 1;
+
+	while (end < count
+		&& (end - start) < DEEN_POSTINGS_BLOCK_SIZE
+		&& (uint64_t) (refs[end] - refs[start]) <= (uint64_t) UINT32_MAX) {
+		end++;
+	}
+
+	return end;
+}
+
+
+static size_t deen_postings_encode_varint(uint32_t value, uint8_t *out) {
+	size_t len = 0;
+
+	while (value >= 0x80) {
+		out[len++] = (uint8_t) (value | 0x80);
+		value >>= 7;
+	}
+
+	out[len++] = (uint8_t) value;
+	return len;
+}
+
+
+size_t deen_postings_encode(
+	const int64_t *refs,
+	size_t count,
+	uint8_t *out,
+	uint32_t *block_count) {
+
+	size_t start;
+	size_t data_len = 0;
+	uint8_t *data;
+	deen_postings_skip *skips = (deen_postings_skip *) out;
+
+	*block_count = 0;
+
+	// the skip table comes first so the number of blocks is needed before
+	// anything can be written.
+
+	for (start = 0; start < count; start = deen_postings_block_end(refs, count, start)) {
+		(*block_count)++;
+	}
+
+	data = &out[sizeof(deen_postings_skip) * (*block_count)];
+	*block_count = 0;
+
+	for (start = 0; start < count;) {
+		size_t end = deen_postings_block_end(refs, count, start);
+		size_t i;
+		deen_postings_skip *skip = &skips[(*block_count)++];
+
+		skip->first_ref = refs[start];
+		skip->data_offset = (uint32_t) data_len;
+		skip->count = (uint32_t) (end - start);
+
+		for (i = start + 1; i < end; i++) {
+			data_len += deen_postings_encode_varint((uint32_t) (refs[i] - refs[i - 1]), &data[data_len]);
+		}
+
+		start = end;
+	}
+
+	return (sizeof(deen_postings_skip) * (*block_count)) + data_len;
+}
+
+
+/*
+Decodes 'count' varints into 32 bit deltas.  Returns false if the data runs
+out before all of the varints are decoded.
+*/
+
+static deen_bool deen_postings_decode_varints(
+	const uint8_t *data,
+	size_t data_len,
+	size_t count,
+	uint32_t *deltas) {
+
+	size_t upto = 0;
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+
+		// most deltas are small enough to fit in one byte.
+
+		if (upto < data_len && data[upto] < 0x80) {
+			deltas[i] = data[upto++];
+		}
+		else {
+			uint32_t value = 0;
+			uint32_t shift = 0;
+			uint8_t c;
+
+			do {
+				if (upto >= data_len || shift > 28) {
+					return DEEN_FALSE;
+				}
+
+				c = data[upto++];
+				value |= ((uint32_t) (c & 0x7f)) << shift;
+				shift += 7;
+			}
+			while (0 != (c & 0x80));
+
+			deltas[i] = value;
+		}
+	}
+
+	return DEEN_TRUE;
+}
+
+
+/*
+Writes the running sum of the deltas added to the base into 'out'.  The sum
+within a block never exceeds 32 bits.
+*/
+
+static void deen_postings_prefix_sum(
+	off_t base,
+	const uint32_t *deltas,
+	size_t count,
+	off_t *out) {
+
+	size_t i = 0;
+	uint32_t running = 0;
+
+#ifdef __SSE2__
+	if (sizeof(off_t) == sizeof(int64_t)) {
+		__m128i zero = _mm_setzero_si128();
+		__m128i carry = _mm_setzero_si128();
+		__m128i base_wide = _mm_set1_epi64x((long long) base);
+
+		for (; i + 4 <= count; i += 4) {
+			__m128i x = _mm_loadu_si128((const __m128i *) &deltas[i]);
+			x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+			x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+			x = _mm_add_epi32(x, carry);
+			carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+			_mm_storeu_si128((__m128i *) &out[i], _mm_add_epi64(base_wide, _mm_unpacklo_epi32(x, zero)));
+			_mm_storeu_si128((__m128i *) &out[i + 2], _mm_add_epi64(base_wide, _mm_unpackhi_epi32(x, zero)));
+		}
+
+		running = (uint32_t) _mm_cvtsi128_si32(carry);
+	}
+#endif
+
+	for (; i < count; i++) {
+		running += deltas[i];
+		out[i] = base + (off_t) running;
+	}
+}
+
+
+deen_bool deen_postings_decode_block(
+	const uint8_t *data,
+	size_t data_len,
+	uint32_t block_count,
+	uint32_t block,
+	off_t *out,
+	size_t *out_count) {
+
+	const deen_postings_skip *skip = &((const deen_postings_skip *) data)[block];
+	size_t skips_len = sizeof(deen_postings_skip) * block_count;
+	uint32_t deltas[DEEN_POSTINGS_BLOCK_SIZE];
+
+	if (block >= block_count
+		|| skips_len > data_len
+		|| 0 == skip->count
+		|| skip->count > DEEN_POSTINGS_BLOCK_SIZE
+		|| skip->data_offset > data_len - skips_len) {
+		return DEEN_FALSE;
+	}
+
+	if (!deen_postings_decode_varints(
+		&data[skips_len + skip->data_offset],
+		data_len - skips_len - skip->data_offset,
+		skip->count - 1,
+		deltas)) {
+		return DEEN_FALSE;
+	}
+
+	out[0] = (off_t) skip->first_ref;
+	deen_postings_prefix_sum(out[0], deltas, skip->count - 1, &out[1]);
+	*out_count = skip->count;
+
+	return DEEN_TRUE;
+}
+
+
+deen_bool deen_postings_decode(
+	const uint8_t *data,
+	size_t data_len,
+	uint32_t block_count,
+	size_t count,
+	off_t *out) {
+
+	uint32_t block;
+	size_t decoded = 0;
+
+	for (block = 0; block < block_count; block++) {
+		size_t block_decoded;
+		const deen_postings_skip *skip = &((const deen_postings_skip *) data)[block];
+
+		if (sizeof(deen_postings_skip) * block_count > data_len
+			|| skip->count > count - decoded) {
+			return DEEN_FALSE;
+		}
+
+		if (!deen_postings_decode_block(data, data_len, block_count, block, &out[decoded], &block_decoded)) {
+			return DEEN_FALSE;
+		}
+
+		decoded += block_decoded;
+	}
+
+	return decoded == count;
+}
+
+
+uint32_t deen_postings_seek_block(
+	const uint8_t *data,
+	uint32_t block_count,
+	off_t ref) {
+
+	const deen_postings_skip *skips = (const deen_postings_skip *) data;
+	uint32_t low = 0;
+	uint32_t high = block_count;
+
+	// find the first block that starts after the ref and then step back.
+
+	while (low < high) {
+		uint32_t mid = low + ((high - low) / 2);
+
+		if (skips[mid].first_ref <= (int64_t) ref) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+
+	return (0 == low) ? 0 : low - 1;
+}
+
+
+deen_postings_cursor *deen_postings_cursor_create(
+	const uint8_t *data,
+	size_t data_len,
+	uint32_t block_count,
+	size_t count) {
+
+	deen_postings_cursor *cursor = (deen_postings_cursor *) deen_emalloc(sizeof(deen_postings_cursor));
+
+	cursor->data = data;
+	cursor->data_len = data_len;
+	cursor->block_count = block_count;
+	cursor->next_block = 0;
+	cursor->refs = cursor->block_refs;
+	cursor->refs_count = 0;
+	cursor->upto = 0;
+	cursor->count = count;
+	cursor->is_error = sizeof(deen_postings_skip) * block_count > data_len;
+
+	return cursor;
+}
+
+
+deen_postings_cursor *deen_postings_cursor_create_from_refs(off_t *refs, size_t count) {
+	deen_postings_cursor *cursor = (deen_postings_cursor *) deen_emalloc(sizeof(deen_postings_cursor));
+
+	cursor->data = NULL;
+	cursor->data_len = 0;
+	cursor->block_count = 0;
+	cursor->next_block = 0;
+	cursor->refs = refs;
+	cursor->refs_count = count;
+	cursor->upto = 0;
+	cursor->count = count;
+	cursor->is_error = DEEN_FALSE;
+
+	return cursor;
+}
+
+
+void deen_postings_cursor_free(deen_postings_cursor *cursor) {
+	if (NULL != cursor) {
+		if (NULL == cursor->data) {
+			free((void *) cursor->refs);
+		}
+
+		free((void *) cursor);
+	}
+}
+
+
+/*
+Decodes the next block of a compressed posting list into the cursor.
+Returns false if there are no more blocks or if the block is corrupt.
+*/
+
+static deen_bool deen_postings_cursor_load_block(deen_postings_cursor *cursor) {
+	if (NULL == cursor->data || cursor->is_error || cursor->next_block >= cursor->block_count) {
+		return DEEN_FALSE;
+	}
+
+	if (!deen_postings_decode_block(
+		cursor->data,
+		cursor->data_len,
+		cursor->block_count,
+		cursor->next_block,
+		cursor->block_refs,
+		&cursor->refs_count)) {
+		cursor->is_error = DEEN_TRUE;
+		cursor->refs_count = 0;
+		cursor->upto = 0;
+		return DEEN_FALSE;
+	}
+
+	cursor->next_block++;
+	cursor->upto = 0;
+
+	return DEEN_TRUE;
+}
+
+
+deen_bool deen_postings_cursor_next(deen_postings_cursor *cursor, off_t *ref) {
+	if (cursor->upto == cursor->refs_count && !deen_postings_cursor_load_block(cursor)) {
+		return DEEN_FALSE;
+	}
+
+	*ref = cursor->refs[cursor->upto++];
+	return DEEN_TRUE;
+}
+
+
+deen_bool deen_postings_cursor_skip_to(deen_postings_cursor *cursor, off_t target, off_t *ref) {
+
+	// the cursor may already be at or past the target.
+
+	if (0 != cursor->upto && cursor->refs[cursor->upto - 1] >= target) {
+		*ref = cursor->refs[cursor->upto - 1];
+		return DEEN_TRUE;
+	}
+
+	while (DEEN_TRUE) {
+
+		// if the target is within the refs that are to hand then a binary
+		// search will find it.
+
+		if (cursor->upto < cursor->refs_count && cursor->refs[cursor->refs_count - 1] >= target) {
+			size_t low = cursor->upto;
+			size_t high = cursor->refs_count - 1;
+
+			while (low < high) {
+				size_t mid = low + ((high - low) / 2);
+
+				if (cursor->refs[mid] < target) {
+					low = mid + 1;
+				}
+				else {
+					high = mid;
+				}
+			}
+
+			cursor->upto = low + 1;
+			*ref = cursor->refs[low];
+			return DEEN_TRUE;
+		}
+
+		cursor->upto = cursor->refs_count;
+
+		// otherwise the skip table is used to jump to the block that would
+		// contain the target; the blocks in between are never decoded.
+
+		if (NULL == cursor->data || cursor->is_error || cursor->next_block >= cursor->block_count) {
+			return DEEN_FALSE;
+		}
+
+		cursor->next_block += deen_postings_seek_block(
+			(const uint8_t *) &((const deen_postings_skip *) cursor->data)[cursor->next_block],
+			cursor->block_count - cursor->next_block,
+			target);
+
+		if (!deen_postings_cursor_load_block(cursor)) {
+			return DEEN_FALSE;
+		}
+	}
+}
+
+
+size_t deen_postings_cursor_intersect(
+	deen_postings_cursor *cursor,
+	off_t *refs,
+	size_t refs_count) {
+
+	size_t result_count = 0;
+	size_t i;
+	off_t ref;
+
+	if (0 == refs_count || !deen_postings_cursor_skip_to(cursor, refs[0], &ref)) {
+		return 0;
+	}
+
+	for (i = 0; i < refs_count; i++) {
+
+		// move through the refs that are to hand without any calls and only
+		// skip once they run out.
+
+		if (ref < refs[i]) {
+			while (cursor->upto < cursor->refs_count && cursor->refs[cursor->upto] < refs[i]) {
+				cursor->upto++;
+			}
+
+			if (cursor->upto < cursor->refs_count) {
+				ref = cursor->refs[cursor->upto++];
+			}
+			else {
+				if (!deen_postings_cursor_skip_to(cursor, refs[i], &ref)) {
+					break;
+				}
+			}
+		}
+
+		if (ref == refs[i]) {
+			refs[result_count++] = ref;
+		}
+	}
+
+	return result_count;
+}
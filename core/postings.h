@@ -0,0 +1,131 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+#ifndef __POSTINGS_H
+#define __POSTINGS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "types.h"
+
+/*
+A posting list is the ascending list of refs for a prefix.  It is compressed
+as a skip table followed by blocks of varint encoded deltas.  A block is ended
+early if the refs in it would span more than 32 bits so that the deltas in a
+block can always be summed in 32 bits.
+*/
+
+/*
+Returns the maximum number of bytes that encoding this many refs could
+require.
+*/
+
+size_t deen_postings_encode_len_max(size_t count);
+
+/*
+Encodes the ascending refs into the supplied buffer which must be at least
+'deen_postings_encode_len_max' bytes long.  The number of bytes used is
+returned and the number of blocks is written to 'block_count'.
+*/
+
+size_t deen_postings_encode(
+	const int64_t *refs,
+	size_t count,
+	uint8_t *out,
+	uint32_t *block_count);
+
+/*
+Decodes all of the refs from the posting list into 'out' which must have
+space for 'count' refs.  Returns false if the data is corrupt.
+*/
+
+deen_bool deen_postings_decode(
+	const uint8_t *data,
+	size_t data_len,
+	uint32_t block_count,
+	size_t count,
+	off_t *out);
+
+/*
+Decodes just the refs of one block into 'out' which must have space for
+DEEN_POSTINGS_BLOCK_SIZE refs.  The number of refs decoded is written to
+'out_count'.  Returns false if the data is corrupt.
+*/
+
+deen_bool deen_postings_decode_block(
+	const uint8_t *data,
+	size_t data_len,
+	uint32_t block_count,
+	uint32_t block,
+	off_t *out,
+	size_t *out_count);
+
+/*
+Uses the skip table to find the block which would contain the supplied ref if
+it is present in the posting list; that is the last block whose first ref is
+less than or equal to the supplied ref.  If the supplied ref is before all of
+the refs then the first block is returned.
+*/
+
+uint32_t deen_postings_seek_block(
+	const uint8_t *data,
+	uint32_t block_count,
+	off_t ref);
+
+/*
+Creates a cursor over a compressed posting list.  The data must remain in
+place while the cursor is in use.
+*/
+
+deen_postings_cursor *deen_postings_cursor_create(
+	const uint8_t *data,
+	size_t data_len,
+	uint32_t block_count,
+	size_t count);
+
+/*
+Creates a cursor over the ascending refs.  The cursor takes ownership of the
+refs which must have been dynamically allocated; they may be NULL if there
+are no refs.
+*/
+
+deen_postings_cursor *deen_postings_cursor_create_from_refs(off_t *refs, size_t count);
+
+void deen_postings_cursor_free(deen_postings_cursor *cursor);
+
+/*
+Moves to the next ref and writes it into 'ref'.  Returns false if there are
+no more refs or if the posting list is corrupt; the 'is_error' of the cursor
+is set in the latter case.
+*/
+
+deen_bool deen_postings_cursor_next(deen_postings_cursor *cursor, off_t *ref);
+
+/*
+Moves forward to the first ref that is equal to or greater than 'target' and
+writes it into 'ref'.  The refs in between are skipped and, where possible,
+are not decoded at all.  If the ref that the cursor last moved to is already
+equal to or greater than 'target' then the cursor stays where it is.
+Returns false in the same situations as 'deen_postings_cursor_next'.
+*/
+
+deen_bool deen_postings_cursor_skip_to(deen_postings_cursor *cursor, off_t target, off_t *ref);
+
+/*
+Keeps only those of the ascending 'refs' that the cursor also has and returns
+how many are kept; they are moved to the start of 'refs'.  Blocks of the
+posting list that lie between the 'refs' are not decoded.
+*/
+
+size_t deen_postings_cursor_intersect(
+	deen_postings_cursor *cursor,
+	off_t *refs,
+	size_t refs_count);
+
+#endif /* __POSTINGS_H */
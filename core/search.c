@@ -11,10 +11,14 @@
 #include <fcntl.h>
 #ifdef __MINGW32__
 #include <io.h>
+#else
+#include <pthread.h>
+#include <sys/mman.h>
 #endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -23,18 +27,220 @@
 #include "entry.h"
 #include "index.h"
 #include "keyword.h"
+#include "mapindex.h"
+#include "postings.h"
+#include "tracing.h"
 
 #define SIZE_BUFFER_LINE_DEFAULT 196
 
+// ---------------------------------------------------------------
+// LOOKUP CACHE
+// ---------------------------------------------------------------
+
+/*
+The cache is small so it is simply searched from end to end.  Each time an
+entry is used it takes the next value of the clock so that the entry with the
+lowest value is the one that was least recently used.
+*/
+
+static deen_search_lookup_cache_entry *deen_search_lookup_cache_get(
+	deen_search_context *context,
+	const uint8_t *prefix) {
+
+	size_t i;
+
+	for (i = 0; i < DEEN_SEARCH_LOOKUP_CACHE_SIZE; i++) {
+		deen_search_lookup_cache_entry *entry = &(context->lookup_cache[i]);
+
+		if (0 != entry->last_used && 0 == strcmp((const char *) entry->prefix, (const char *) prefix)) {
+			entry->last_used = ++(context->lookup_cache_clock);
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+
+static void deen_search_lookup_cache_put(
+	deen_search_context *context,
+	const uint8_t *prefix,
+	const off_t *refs,
+	size_t refs_count) {
+
+	deen_search_lookup_cache_entry *entry = &(context->lookup_cache[0]);
+	size_t prefix_len = strlen((const char *) prefix);
+	size_t i;
+
+	if (prefix_len >= DEEN_INDEXING_PREFIX_SIZE) {
+		return;
+	}
+
+	for (i = 1; i < DEEN_SEARCH_LOOKUP_CACHE_SIZE && 0 != entry->last_used; i++) {
+		if (context->lookup_cache[i].last_used < entry->last_used) {
+			entry = &(context->lookup_cache[i]);
+		}
+	}
+
+	free((void *) entry->refs);
+	memcpy(entry->prefix, prefix, prefix_len + 1);
+	entry->refs = (off_t *) deen_emalloc(sizeof(off_t) * (refs_count + 1));
+	memcpy(entry->refs, refs, sizeof(off_t) * refs_count);
+	entry->refs_count = refs_count;
+	entry->last_used = ++(context->lookup_cache_clock);
+}
+
+
+static void deen_search_lookup_cache_clear(deen_search_context *context) {
+	size_t i;
+
+	for (i = 0; i < DEEN_SEARCH_LOOKUP_CACHE_SIZE; i++) {
+		free((void *) context->lookup_cache[i].refs);
+		context->lookup_cache[i].refs = NULL;
+		context->lookup_cache[i].refs_count = 0;
+		context->lookup_cache[i].last_used = 0;
+	}
+
+	context->lookup_cache_clock = 0;
+}
+
+
+/*
+Returns a cursor over the refs for the prefix.  The binary index is already
+in memory and its posting lists are decoded as they are read so there is
+nothing to be gained from caching them.  The refs from the sqlite database
+are cached and each cursor is given its own copy of them so that the entry
+is able to be replaced while the cursor is still in use.
+*/
+
+static deen_postings_cursor *deen_search_lookup(
+	deen_search_context *context,
+	uint8_t *prefix) {
+
+	deen_search_lookup_cache_entry *entry;
+	deen_postings_cursor *cursor;
+	off_t *refs;
+
+	if (NULL != context->mapindex) {
+		return deen_mapindex_lookup(context->mapindex, prefix);
+	}
+
+	entry = deen_search_lookup_cache_get(context, prefix);
+
+	if (NULL != entry) {
+		context->lookup_cache_hits++;
+		refs = (off_t *) deen_emalloc(sizeof(off_t) * (entry->refs_count + 1));
+		memcpy(refs, entry->refs, sizeof(off_t) * entry->refs_count);
+		return deen_postings_cursor_create_from_refs(refs, entry->refs_count);
+	}
+
+	context->lookup_cache_misses++;
+	cursor = deen_index_lookup(context->index_lookup_context, prefix);
+
+	if (NULL != cursor) {
+		deen_search_lookup_cache_put(context, prefix, cursor->refs, cursor->refs_count);
+	}
+
+	return cursor;
+}
+
+// ---------------------------------------------------------------
+// EXPLAIN
+// ---------------------------------------------------------------
+
+/*
+Each phase is timed from the previous mark to the next so that the times of
+the phases add up to the time of the whole search.  When there is no explain
+then nothing is timed.
+*/
+
+static deen_micros deen_search_explain_mark(deen_search_explain *explain) {
+	return (NULL == explain) ? 0 : deen_micros_since_epoc();
+}
+
+
+static void deen_search_explain_lap(
+	deen_search_explain *explain,
+	deen_micros *mark,
+	enum deen_search_phase phase) {
+
+	if (NULL != explain) {
+		deen_micros now = deen_micros_since_epoc();
+
+		if (now > *mark) {
+			explain->phase_micros[phase] += now - *mark;
+		}
+
+		*mark = now;
+	}
+}
+
+
+static void deen_search_explain_line_read(deen_search_explain *explain, size_t line_len) {
+	if (NULL != explain) {
+		explain->lines_read++;
+		explain->bytes_read += line_len;
+	}
+}
+
+
+deen_search_explain *deen_search_explain_create() {
+	deen_search_explain *explain = (deen_search_explain *) deen_emalloc(sizeof(deen_search_explain));
+	memset(explain, 0, sizeof(deen_search_explain));
+	return explain;
+}
+
+
+void deen_search_explain_free(deen_search_explain *explain) {
+	if (NULL != explain) {
+		free((void *) explain->keywords);
+		free((void *) explain);
+	}
+}
+
+
+/*
+Clears anything from an earlier search and makes space to explain each of the
+keywords.
+*/
+
+static void deen_search_explain_reset(
+	deen_search_context *context,
+	deen_search_explain *explain,
+	uint32_t keyword_count) {
+
+	free((void *) explain->keywords);
+	memset(explain, 0, sizeof(deen_search_explain));
+	explain->is_mapindex = NULL != context->mapindex;
+	explain->keyword_count = keyword_count;
+	explain->keywords = (deen_search_explain_keyword *) deen_emalloc(
+		sizeof(deen_search_explain_keyword) * (keyword_count + 1));
+	memset(explain->keywords, 0, sizeof(deen_search_explain_keyword) * (keyword_count + 1));
+}
+
+// ---------------------------------------------------------------
+
+
 void deen_search_free(deen_search_context *context) {
+#ifndef __MINGW32__
+	if (NULL != context->data) {
+		munmap((void *) context->data, context->data_len);
+	}
+#endif
+
 	if (-1 != context->fd_data) {
 		close(context->fd_data);
 	}
 
+	deen_search_lookup_cache_clear(context);
+	deen_index_lookup_context_free(context->index_lookup_context);
+
 	if (NULL != context->db) {
 		sqlite3_close_v2(context->db);
 	}
 
+	deen_mapindex_close(context->mapindex);
+
 	free((void *) context);
 }
 
@@ -46,7 +252,17 @@ deen_search_context *deen_search_init(char *deen_root_dir) {
 	deen_bool is_error = DEEN_FALSE;
 	char *data_path = deen_data_path(deen_root_dir);
 	char *index_path = deen_index_path(deen_root_dir);
-
+	char *mapindex_path = deen_mapindex_path(deen_root_dir);
+
+	context->db = NULL;
+	context->index_lookup_context = NULL;
+	context->mapindex = NULL;
+	context->data = NULL;
+	memset(context->lookup_cache, 0, sizeof(context->lookup_cache));
+	context->lookup_cache_clock = 0;
+	context->lookup_cache_hits = 0;
+	context->lookup_cache_misses = 0;
+	context->data_len = 0;
 	context->fd_data = open(data_path, O_RDONLY
 #ifdef __MINGW32__
 		|O_BINARY
@@ -60,14 +276,53 @@ deen_search_context *deen_search_init(char *deen_root_dir) {
 #ifdef DEBUG
 		DEEN_LOG_INFO1("opened data file; %s", data_path);
 #endif
+
+#ifndef __MINGW32__
+		// map the data so that lines can be read without any system calls;
+		// the lines are accessed in no particular order.  If this fails then
+		// the lines are read from the file instead.
+
+		{
+			struct stat st;
+
+			if (0 == fstat(context->fd_data, &st) && st.st_size > 0) {
+				void *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, context->fd_data, 0);
+
+				if (MAP_FAILED != data) {
+					madvise(data, (size_t) st.st_size, MADV_RANDOM);
+					context->data = (const uint8_t *) data;
+					context->data_len = (size_t) st.st_size;
+				}
+				else {
+					DEEN_LOG_INFO1("unable to map the data file; will read it instead; %s", data_path);
+				}
+			}
+		}
+#endif
 	}
 
-	if (SQLITE_OK != sqlite3_open_v2(index_path, &(context->db), SQLITE_OPEN_READONLY, NULL)) {
-		DEEN_LOG_ERROR1("unable to open the sqllite3 database; %s", index_path);
+	// the binary index is preferred, but if it is not present then the
+	// sqlite database can be used instead.
+
+	context->mapindex = deen_mapindex_open(mapindex_path);
+
+	if (NULL == context->mapindex) {
+		if (SQLITE_OK != sqlite3_open_v2(index_path, &(context->db), SQLITE_OPEN_READONLY, NULL)) {
+			DEEN_LOG_ERROR1("unable to open the sqllite3 database; %s", index_path);
+		}
+		else {
+			if (!deen_index_is_current_version(context->db)) {
+				DEEN_LOG_ERROR0("the index was made by an earlier version and the data should be installed again");
+				is_error = DEEN_TRUE;
+			}
+
+			context->index_lookup_context = deen_index_lookup_context_create(context->db);
+		}
 	}
 
 	free((void *) data_path);
 	free((void *) index_path);
+	free((void *) mapindex_path);
 
 	if (is_error) {
 		deen_search_free(context);
@@ -79,367 +334,905 @@ deen_search_context *deen_search_init(char *deen_root_dir) {
 
 
 /*
-This function is used with quick sort to order the
-references into the data.
+This function is used with quick sort to order the cursors such that the
+shortest posting lists come first.
 */
 
-static int deen_compare_refs(const void *item1, const void *item2) {
-	off_t int1 = ((off_t *)item1)[0];
-	off_t int2 = ((off_t *)item2)[0];
-	if (int1 == int2) return 0;
-	if (int1 < int2) return -1;
+static int deen_compare_cursors_by_count(const void *item1, const void *item2) {
+	size_t count1 = (*((deen_postings_cursor **) item1))->count;
+	size_t count2 = (*((deen_postings_cursor **) item2))->count;
+	if (count1 == count2) return 0;
+	if (count1 < count2) return -1;
 	return 1;
 }
 
 
 /**
- * This function will find the intersection of the "refs_combined" and the
- * "refs".  It will return the new length of the "refs_combined".  The length
- * will be the same or smaller than the "refs_length" value.
+ * This function will read the line at the ref from the data file into the
+ * buffer; enlarging the buffer as necessary.  It will return false if there
+ * was a problem reading the data.
  */
 
-static int deen_search_intersect_refs(
-	off_t *refs_combined,
-	off_t *refs,
-	size_t refs_combined_length,
-	size_t refs_length) {
+static deen_bool deen_search_read_line(
+	deen_search_context *context,
+	off_t ref,
+	uint8_t **buffer,
+	size_t *buffer_size,
+	size_t *line_len) {
 
-	size_t i;
+	ssize_t bufferread_size = 0;
+	uint8_t *newline_c = NULL;
+
+#ifdef __MINGW32__
+	// move to the point in the file where the line starts.
 
-	for (i=0;i<refs_combined_length;) {
-		if (NULL == bsearch(
-			&refs_combined[i], // what to find
-			refs,
-			refs_length,
-			sizeof(off_t),
-			&deen_compare_refs)) {
-			if (i<refs_combined_length-1)
-				memmove(
-					&refs_combined[i],
-					&refs_combined[i+1],
-					sizeof(size_t) * ((refs_combined_length-i)-1)
-				);
-			refs_combined_length--;
+	if (-1 == lseek(context->fd_data, ref, SEEK_SET)) {
+		DEEN_LOG_ERROR1("unable to seek in data to; %d", (int) ref);
+		return DEEN_FALSE;
+	}
+#endif
+
+	// read in a line of data; this should fairly quickly right-size the
+	// buffer and therefore will be fairly optimal.  The reads are positional
+	// so that a number of threads are able to share the file descriptor.
+
+	do {
+		ssize_t actuallyread;
+
+	// if the buffer is too small then resize it to make it
+	// larger.
+
+		if (bufferread_size == *buffer_size) {
+			*buffer_size *= 2;
+			*buffer = (uint8_t *) deen_erealloc(*buffer, *buffer_size);
 		}
-		else {
-			i++;
+
+#ifdef __MINGW32__
+		actuallyread = read(context->fd_data, &(*buffer)[bufferread_size], (*buffer_size-bufferread_size));
+#else
+		actuallyread = pread(
+			context->fd_data,
+			&(*buffer)[bufferread_size],
+			(*buffer_size-bufferread_size),
+			ref + bufferread_size);
+#endif
+
+		switch (actuallyread) {
+			case 0:
+				(*buffer)[bufferread_size] = '\n';
+				bufferread_size++;
+				break;
+
+			case -1:
+				DEEN_LOG_ERROR1("an error has arisen accessing the data at; %u", ref);
+				return DEEN_FALSE;
+
+			default:
+				bufferread_size += actuallyread;
+				break;
 		}
 	}
+	while (NULL == (newline_c = deen_strnchr(*buffer,'\n',bufferread_size)));
 
-	return refs_combined_length;
+	*line_len = (size_t) (newline_c - *buffer);
+
+	return DEEN_TRUE;
 }
 
+
 /**
- * This function will take the refs and will return the results, unsorted.
+ * This function will find the line at the ref.  If the data is mapped then
+ * the line is taken directly from the mapped data and otherwise it is read
+ * into the buffer.  The line is not NULL terminated.
  */
 
-
-static deen_search_result *deen_search_refs_to_result(
+static deen_bool deen_search_line(
 	deen_search_context *context,
-	deen_keywords *keywords,
-	off_t *refs,
-	size_t refs_length) {
-
-	size_t i;
-	deen_bool is_error = DEEN_FALSE;
-	uint8_t *buffer = (uint8_t *) deen_emalloc(sizeof(uint8_t) * SIZE_BUFFER_LINE_DEFAULT);
-	size_t buffer_size = SIZE_BUFFER_LINE_DEFAULT;
+	off_t ref,
+	uint8_t **buffer,
+	size_t *buffer_size,
+	const uint8_t **line,
+	size_t *line_len) {
+
+	if (NULL != context->data) {
+		const uint8_t *newline_c;
+
+		if (ref < 0 || (size_t) ref >= context->data_len) {
+			DEEN_LOG_ERROR1("an error has arisen accessing the data at; %u", ref);
+			return DEEN_FALSE;
+		}
 
-	deen_search_result *result = (deen_search_result *) deen_emalloc(sizeof(deen_search_result));
-	result->entries = NULL;
-	result->total_count = 0;
-	result->entry_count = 0;
+		*line = &context->data[ref];
+		newline_c = (const uint8_t *) memchr(*line, '\n', context->data_len - (size_t) ref);
+		*line_len = (NULL == newline_c) ? context->data_len - (size_t) ref : (size_t) (newline_c - *line);
 
-	for (i=0;!is_error && i<refs_length;i++) {
+		return DEEN_TRUE;
+	}
 
-		ssize_t bufferread_size;
-		uint8_t *newline_c;
+	if (!deen_search_read_line(context, ref, buffer, buffer_size, line_len)) {
+		return DEEN_FALSE;
+	}
 
-	// move to the point in the file where the line starts.
+	*line = *buffer;
 
-		if (-1 == lseek(context->fd_data, refs[i], SEEK_SET)) {
-			DEEN_LOG_ERROR1("unable to seek in data to; %d", (int) refs[i]);
-			is_error = DEEN_TRUE;
-		}
+	return DEEN_TRUE;
+}
 
-	// now read the line containing the data.
 
-		bufferread_size = 0;
-		newline_c = NULL;
+/**
+ * This function will find the '::' separator in the line and will then work
+ * out where the german and english parts of the line are.  The german part
+ * starts at the start of the line.  It returns false if the line is a comment
+ * or is not able to be split.
+ */
 
-	// read in a line of data; this should fairly quickly right-size the
-	// buffer and therefore will be fairly optimal.
+static deen_bool deen_search_line_split(
+	const uint8_t *line,
+	size_t line_len,
+	off_t ref,
+	size_t *german_len,
+	size_t *english_offset) {
 
-		do {
-			ssize_t actuallyread;
+	size_t separator_offset = 0;
+	const uint8_t *colon;
 
-	// if the buffer is too small then resize it to make it
-	// larger.
+	// if the line starts with '#' then it is a comment and we do not
+	// wish to process comments.
 
-			if (bufferread_size == buffer_size) {
-				buffer_size *= 2;
-				buffer = (uint8_t *) deen_erealloc(buffer, buffer_size);
-			}
+	if (0 == line_len || '#' == line[0]) {
+		return DEEN_FALSE;
+	}
 
-			actuallyread = read(context->fd_data, &buffer[bufferread_size], (buffer_size-bufferread_size));
+	// look from one colon to the next until there are two together.
 
-			switch (actuallyread) {
-				case 0:
-					buffer[bufferread_size] = '\n';
-					bufferread_size++;
-					break;
+	while (separator_offset + 1 < line_len) {
+		colon = (const uint8_t *) memchr(&line[separator_offset], ':', line_len - separator_offset - 1);
 
-				case -1:
-					DEEN_LOG_ERROR1("an error has arisen accessing the data at; %u", refs[i]);
-					is_error = DEEN_TRUE;
-					break;
+		if (NULL == colon) {
+			separator_offset = line_len;
+		}
+		else {
+			separator_offset = (size_t) (colon - line);
 
-				default:
-					bufferread_size += actuallyread;
-					break;
+			if (':' == line[separator_offset + 1]) {
+				break;
 			}
+
+			separator_offset++;
 		}
-		while (!is_error && NULL == (newline_c = deen_strnchr(buffer,'\n',bufferread_size)));
+	}
 
-	// if the line starts with '#' then it is a comment and we do not
-	// wish to process comments.
+	if (separator_offset + 1 >= line_len) {
+#ifdef DEBUG
+		DEEN_LOG_ERROR3("corrupted line missing '::' separator at offset %d \"%.*s\"",
+			(int) ref, (int) line_len, line);
+#else
+		DEEN_LOG_ERROR1("corrupted line missing '::' separator at offset %d",(int) ref);
+#endif
+		return DEEN_FALSE;
+	}
 
-		if (!is_error && 0 != buffer[0] && '#' != buffer[0]) {
-			uint8_t *separator_c;
+	// now remove whitespace from the end of the german data.
 
-			newline_c[0] = 0;
+	*german_len = separator_offset;
 
-	// need to make sure that all of the keywords are able to be found
-	// in the line.
+	while (*german_len > 1 && isspace(line[*german_len - 1])) {
+		(*german_len)--;
+	}
 
-			separator_c = (uint8_t *) strstr((const char *)buffer, "::");
+	// now remove whitespace from the start of the english data.
 
-			if (NULL == separator_c) {
-#ifdef DEBUG
-				DEEN_LOG_ERROR2("corrupted line missing '::' separator at offset %d \"%s\n",
-				(int) refs[i], buffer);
-#else
-				DEEN_LOG_ERROR1("corrupted line missing '::' separator at offset %d",(int) refs[i]);
-#endif
-			}
-			else {
+	*english_offset = separator_offset + 2;
 
-				uint8_t *german_c = buffer;
-				uint8_t *english_c = &separator_c[2];
+	while (*english_offset < line_len && isspace(line[*english_offset])) {
+		(*english_offset)++;
+	}
 
-				// now remove whitespace from the end of the german data.
+	return DEEN_TRUE;
+}
 
-				{
-					uint8_t *german_end_c = separator_c;
 
-					do {
-						german_end_c[0] = 0;
-						german_end_c--;
-					}
-					while(german_end_c > german_c && isspace(german_end_c[0]));
-				}
+/**
+ * This function will build an entry from the german and english parts of the
+ * line.  The parts of the entry are added to the arena of the result.
+ */
 
-// now remove whitespace from the start of the english data.
+static deen_entry deen_search_line_to_entry(
+	deen_entry_arena *arena,
+	const uint8_t *line,
+	size_t line_len,
+	size_t german_len,
+	size_t english_offset) {
+
+	return deen_entry_create_n(
+		arena,
+		line, german_len,
+		&line[english_offset], line_len - english_offset);
+}
 
-				while(0 != english_c[0] && isspace(english_c[0])) {
-					english_c++;
-				}
 
-// check that all of the keywords appear in either the english
-// or the german text.
+/*
+Candidates are collected into a bounded heap such that only the best
+'max_count' of them are retained at any one time.  The root of the heap is
+the worst of the retained candidates so that it can be quickly evicted when a
+better candidate is found.  A candidate is scored from the raw line and only
+records where the line is; entries are only built for the candidates that
+are retained at the end.  The ordinal is the position of the candidate in the
+order in which the candidates were found and is used to order candidates that
+would otherwise be equal.
+*/
 
-				if (deen_keywords_all_present(keywords, german_c) ||
-					deen_keywords_all_present(keywords, english_c)) {
+typedef struct deen_search_candidate deen_search_candidate;
+struct deen_search_candidate {
+	off_t ref;
+	uint32_t distance_from_keywords;
+	uint32_t german_sub_count;
+	size_t ordinal;
+};
 
-// this entry looks like a viable one so build it.
 
-					deen_entry entry = deen_entry_create(german_c, english_c);
+typedef struct deen_search_top deen_search_top;
+struct deen_search_top {
+	deen_search_candidate *candidates;
+	size_t count;
+	size_t allocated;
+	size_t max_count;
+};
 
-					if (
-						(0 != entry.english_sub_count) &&
-						(0 != entry.german_sub_count) ) {
 
-						if (0==result->entry_count) {
-							result->entries = (deen_entry *) deen_emalloc(sizeof(deen_entry));
-						}
-						else {
-							result->entries = (deen_entry *) deen_erealloc(
-								result->entries,
-								(result->entry_count + 1) * sizeof(deen_entry)
-							);
-						}
+/**
+ * This function will check that all of the keywords are present in either
+ * the german or the english part of the line and, if so, will score the line
+ * into the candidate.  It returns true if the line is a candidate.  The line
+ * is not altered.
+ */
 
-						memcpy(
-							&(result->entries[result->entry_count]),
-							&entry,
-							sizeof(deen_entry));
+static deen_bool deen_search_line_to_candidate(
+	deen_keywords_matcher *matcher,
+	const uint8_t *line,
+	size_t line_len,
+	off_t ref,
+	deen_search_candidate *candidate,
+	deen_search_explain *explain,
+	deen_micros *explain_mark) {
 
-						DEEN_LOG_TRACE1("added entry; total now at %d",result->entry_count);
+	size_t german_len;
+	size_t english_offset;
+	deen_bool is_split = deen_search_line_split(line, line_len, ref, &german_len, &english_offset);
 
-						result->total_count++;
-						result->entry_count++;
-					}
+	deen_search_explain_lap(explain, explain_mark, DEEN_SEARCH_PHASE_PARSE);
 
-				}
-				else {
-					DEEN_LOG_TRACE2("keywords not found in; %s :: %s", german_c, english_c);
-				}
-			}
-		}
+	if (!is_split) {
+		return DEEN_FALSE;
 	}
 
-	if (is_error) {
-		deen_search_result_free(result);
-		return NULL;
+	// check that all of the keywords appear in either the english
+	// or the german text.
+
+	if (deen_keywords_matcher_all_present_n(matcher, line, german_len) ||
+		deen_keywords_matcher_all_present_n(matcher, &line[english_offset], line_len - english_offset)) {
+
+		candidate->ref = ref;
+		candidate->distance_from_keywords = deen_entry_calculate_distance_from_keywords_n(
+			line, german_len,
+			&line[english_offset], line_len - english_offset,
+			matcher,
+			&candidate->german_sub_count);
+
+		deen_search_explain_lap(explain, explain_mark, DEEN_SEARCH_PHASE_SCORE);
+
+		return DEEN_TRUE;
 	}
 
-	return result;
+	DEEN_LOG_TRACE1("keywords not found in line at; %d", (int) ref);
+
+	if (NULL != explain) {
+		explain->lines_rejected++;
+		deen_search_explain_lap(explain, explain_mark, DEEN_SEARCH_PHASE_SCORE);
+	}
+
+	return DEEN_FALSE;
+}
+
+
+/*
+Candidates that are closer to the keywords come first.  If they are the same
+distance from the keywords, the less complex one comes first.
+*/
+
+static int deen_search_candidate_compare(
+	const deen_search_candidate *a,
+	const deen_search_candidate *b) {
+
+	if (a->distance_from_keywords != b->distance_from_keywords) {
+		return a->distance_from_keywords < b->distance_from_keywords ? -1 : 1;
+	}
+
+	if (a->german_sub_count != b->german_sub_count) {
+		return a->german_sub_count < b->german_sub_count ? -1 : 1;
+	}
+
+	if (a->ordinal != b->ordinal) {
+		return a->ordinal < b->ordinal ? -1 : 1;
+	}
+
+	return 0;
 }
 
 
 static int deen_search_sort_callback(const void *a, const void *b) {
-	deen_entry *entry_a = (deen_entry *) a;
-	deen_entry *entry_b = (deen_entry *) b;
+	return deen_search_candidate_compare(
+		(const deen_search_candidate *) a,
+		(const deen_search_candidate *) b);
+}
+
+
+static void deen_search_top_swap(deen_search_top *top, size_t i, size_t j) {
+	deen_search_candidate candidate = top->candidates[i];
+	top->candidates[i] = top->candidates[j];
+	top->candidates[j] = candidate;
+}
 
-	// if they are the same distance from the keywords, perhaps choose the
-	// less complex one first.
 
-	if (entry_a->distance_from_keywords == entry_b->distance_from_keywords) {
-		int sub_count_a = entry_a->german_sub_count;
-		int sub_count_b = entry_b->german_sub_count;
-		return sub_count_a - sub_count_b;
+static void deen_search_top_sift_up(deen_search_top *top, size_t i) {
+	while (i > 0) {
+		size_t parent = (i - 1) / 2;
+
+		if (deen_search_candidate_compare(&top->candidates[i], &top->candidates[parent]) <= 0) {
+			return;
+		}
 
-		// TODO; some more complex comparisons?
+		deen_search_top_swap(top, i, parent);
+		i = parent;
 	}
+}
+
+
+static void deen_search_top_sift_down(deen_search_top *top, size_t i) {
+	while (DEEN_TRUE) {
+		size_t worst = i;
+		size_t left = (2 * i) + 1;
+		size_t right = left + 1;
 
-	return (int) (entry_a->distance_from_keywords - entry_b->distance_from_keywords);
+		if (left < top->count && deen_search_candidate_compare(&top->candidates[left], &top->candidates[worst]) > 0) {
+			worst = left;
+		}
+
+		if (right < top->count && deen_search_candidate_compare(&top->candidates[right], &top->candidates[worst]) > 0) {
+			worst = right;
+		}
+
+		if (worst == i) {
+			return;
+		}
+
+		deen_search_top_swap(top, i, worst);
+		i = worst;
+	}
 }
 
 
-static void deen_search_sort(deen_search_result *search_result, deen_keywords *keywords) {
-	if (search_result->entry_count > 0) {
-		uint32_t i;
+/*
+Offers the candidate to the heap which will retain it only if it is one of
+the best candidates seen so far.
+*/
+
+static void deen_search_top_add(deen_search_top *top, deen_search_candidate *candidate) {
+	if (top->count < top->max_count) {
+		if (top->count == top->allocated) {
+			top->allocated = (0 == top->allocated) ? 16 : top->allocated * 2;
 
-		// allocated once to avoid continuously allocating memory.
-		deen_bool *keyword_use_map = (deen_bool *) deen_emalloc(sizeof(deen_bool) * keywords->count);
+			if (top->allocated > top->max_count) {
+				top->allocated = top->max_count;
+			}
 
-		for (i=0;i<search_result->entry_count;i++) {
-			search_result->entries[i].distance_from_keywords = deen_entry_calculate_distance_from_keywords(
-				&(search_result->entries[i]), keywords, keyword_use_map);
+			top->candidates = (deen_search_candidate *) deen_erealloc(
+				top->candidates,
+				sizeof(deen_search_candidate) * top->allocated);
 		}
 
-		qsort(
-			search_result->entries, search_result->entry_count,
-			sizeof(deen_entry), deen_search_sort_callback);
+		top->candidates[top->count] = *candidate;
+		top->count++;
+		deen_search_top_sift_up(top, top->count - 1);
+	}
+	else {
+		if (0 != top->count && deen_search_candidate_compare(candidate, &top->candidates[0]) < 0) {
+			top->candidates[0] = *candidate;
+			deen_search_top_sift_down(top, 0);
+		}
+	}
+}
+
+
+/*
+Builds entries for the retained candidates and puts them, best first, into
+the result.  The lines for the candidates are found again from their refs
+because a line that was read into a buffer is not kept.  Returns false if a
+line was not able to be found again.
+*/
+
+static deen_bool deen_search_top_to_result(
+	deen_search_context *context,
+	deen_search_top *top,
+	uint8_t **buffer,
+	size_t *buffer_size,
+	deen_search_result *result,
+	deen_search_explain *explain,
+	deen_micros *explain_mark) {
+
+	size_t i;
+	deen_bool is_error = DEEN_FALSE;
+
+	qsort(
+		top->candidates, top->count,
+		sizeof(deen_search_candidate), deen_search_sort_callback);
+
+	deen_search_explain_lap(explain, explain_mark, DEEN_SEARCH_PHASE_SORT);
 
+	if (0 != top->count) {
+		result->entries = (deen_entry *) deen_emalloc(sizeof(deen_entry) * top->count);
+	}
+
+	for (i = 0; !is_error && i < top->count; i++) {
+		const uint8_t *line;
+		size_t line_len;
+		size_t german_len;
+		size_t english_offset;
+		off_t ref = top->candidates[i].ref;
+
+		if (!deen_search_line(context, ref, buffer, buffer_size, &line, &line_len)) {
+			is_error = DEEN_TRUE;
+		}
+		else {
+			deen_search_explain_line_read(explain, line_len);
+			deen_search_explain_lap(explain, explain_mark, DEEN_SEARCH_PHASE_FETCH);
+
+			if (!deen_search_line_split(line, line_len, ref, &german_len, &english_offset)) {
+				is_error = DEEN_TRUE;
+			}
+			else {
+				result->entries[i] = deen_search_line_to_entry(
+					&(result->arena),
+					line, line_len,
+					german_len, english_offset);
+				result->entries[i].distance_from_keywords = top->candidates[i].distance_from_keywords;
+				result->entry_count++;
+
+				if (NULL != explain) {
+					explain->entries_parsed++;
+				}
+			}
+
+			deen_search_explain_lap(explain, explain_mark, DEEN_SEARCH_PHASE_PARSE);
+		}
 	}
+
+	free((void *) top->candidates);
+	top->candidates = NULL;
+	top->count = 0;
+	top->allocated = 0;
+
+	return !is_error;
 }
 
 
-static void deen_search_crop(deen_search_result *search_result, size_t max_result_count) {
-	if (max_result_count < search_result->entry_count) {
-		uint32_t i;
+/**
+ * This function will take the refs and will return the best results up to
+ * the maximum count, sorted.  The total count of the result is the number of
+ * entries found before any were discarded.
+ */
+
+
+static deen_search_result *deen_search_refs_to_result(
+	deen_search_context *context,
+	deen_keywords *keywords,
+	off_t *refs,
+	size_t refs_length,
+	size_t max_result_count,
+	deen_search_explain *explain) {
 
-		for (i=max_result_count;i<search_result->entry_count;i++) {
-			deen_entry_free(&search_result->entries[i]);
+	size_t i;
+	deen_micros explain_mark = deen_search_explain_mark(explain);
+	deen_bool is_error = DEEN_FALSE;
+	uint8_t *buffer = (uint8_t *) deen_emalloc(sizeof(uint8_t) * SIZE_BUFFER_LINE_DEFAULT);
+	size_t buffer_size = SIZE_BUFFER_LINE_DEFAULT;
+
+	// the keywords are compiled once for all of the lines.
+	deen_keywords_matcher *matcher = deen_keywords_matcher_create(keywords);
+
+	deen_search_top top;
+
+	deen_search_result *result = (deen_search_result *) deen_emalloc(sizeof(deen_search_result));
+	result->entries = NULL;
+	result->total_count = 0;
+	result->entry_count = 0;
+	deen_entry_arena_init(&(result->arena));
+
+	top.candidates = NULL;
+	top.count = 0;
+	top.allocated = 0;
+	top.max_count = max_result_count;
+
+	deen_tracing_begin("scan");
+
+	for (i=0;!is_error && i<refs_length;i++) {
+		const uint8_t *line;
+		size_t line_len;
+		deen_search_candidate candidate;
+
+		if (!deen_search_line(context, refs[i], &buffer, &buffer_size, &line, &line_len)) {
+			is_error = DEEN_TRUE;
 		}
+		else {
+			deen_search_explain_line_read(explain, line_len);
+			deen_search_explain_lap(explain, &explain_mark, DEEN_SEARCH_PHASE_FETCH);
+
+			if (deen_search_line_to_candidate(
+				matcher,
+				line, line_len, refs[i],
+				&candidate,
+				explain, &explain_mark)) {
+
+				candidate.ordinal = i;
+				deen_search_top_add(&top, &candidate);
+				deen_search_explain_lap(explain, &explain_mark, DEEN_SEARCH_PHASE_SORT);
+
+				result->total_count++;
+			}
+		}
+	}
 
-		search_result->entries = (deen_entry *) deen_erealloc(
-			search_result->entries,
-			sizeof(deen_entry) * max_result_count);
+	deen_tracing_end("scan");
+	deen_tracing_begin("build entries");
 
-		search_result->entry_count = max_result_count;
+	if (!deen_search_top_to_result(context, &top, &buffer, &buffer_size, result, explain, &explain_mark)) {
+		is_error = DEEN_TRUE;
+	}
+
+	deen_tracing_end("build entries");
+	deen_tracing_counter("entries", (int64_t) result->total_count);
+
+	deen_keywords_matcher_free(matcher);
+	free((void *) buffer);
+
+	if (is_error) {
+		deen_search_result_free(result);
+		return NULL;
 	}
+
+	return result;
 }
 
 
+
 deen_search_result *deen_search(
 	deen_search_context *context,
 	deen_keywords *keywords,
 	size_t max_result_count) {
+	return deen_search_explained(context, keywords, max_result_count, NULL);
+}
 
-	size_t keywords_longest_len = deen_keywords_longest_keyword(keywords);
-	uint8_t *keyword_prefix_buffer = (uint8_t *) deen_emalloc(sizeof(uint8_t) * keywords_longest_len);
+
+static deen_search_result *deen_search_keywords(
+	deen_search_context *context,
+	deen_keywords *keywords,
+	size_t max_result_count,
+	deen_search_explain *explain) {
+
+	deen_micros explain_mark = deen_search_explain_mark(explain);
+	size_t keywords_longest_len;
+	uint8_t *keyword_prefix_buffer;
+	deen_postings_cursor **cursors;
 
 	off_t *refs_combined = NULL;
 	size_t refs_combined_length = 0;
 	size_t i;
 
 	deen_search_result *search_result;
+	deen_bool is_error = DEEN_FALSE;
+
+	// the keywords have come from the user and so may not be valid.
 
 	for (i=0;i<keywords->count;i++) {
-		deen_index_lookup_result *lookup_result;
+		size_t sequence_count;
+
+		if (DEEN_SEQUENCE_OK != deen_utf8_sequences_count(
+			keywords->keywords[i],
+			strlen((char *) keywords->keywords[i]),
+			&sequence_count)) {
+			DEEN_LOG_ERROR1("the keyword [%s] is not valid utf-8", keywords->keywords[i]);
+			return NULL;
+		}
+	}
+
+	if (NULL != explain) {
+		deen_search_explain_reset(context, explain, keywords->count);
+	}
+
+	deen_tracing_begin("lookup");
 
-		// copy the keyword into a buffer and then cut it off
-		// to make the prefix to search on.
+	keywords_longest_len = deen_keywords_longest_keyword(keywords);
+	keyword_prefix_buffer = (uint8_t *) deen_emalloc(sizeof(uint8_t) * (keywords_longest_len + 1));
+	cursors = (deen_postings_cursor **) deen_emalloc(
+		sizeof(deen_postings_cursor *) * (keywords->count + 1));
+
+	for (i=0;!is_error && i<keywords->count;i++) {
+
+		// copy the keyword into a buffer, fold the umlauts in the same way
+		// as the index does and then cut it off to make the prefix to
+		// search on.  A keyword that is longer than a prefix is instead
+		// looked up in the terms of the binary index where there is one.
 
 		size_t keyword_len = strlen((char *) keywords->keywords[i]);
-		memcpy(keyword_prefix_buffer, keywords->keywords[i], keyword_len);
-		deen_utf8_crop_to_unicode_len(keyword_prefix_buffer, keyword_len, DEEN_INDEXING_DEPTH);
+		size_t unicode_length;
+		memcpy(keyword_prefix_buffer, keywords->keywords[i], keyword_len + 1);
+		deen_fold_umlauts(keyword_prefix_buffer);
+		unicode_length = deen_utf8_crop_to_unicode_len(keyword_prefix_buffer, keyword_len, DEEN_INDEXING_TERM_DEPTH);
+
+		// now open a cursor over the references for the keyword; nothing is
+		// read until the cursor is moved.
 
-// now actually find all of the references for the keyword and
-// then we can put the references into a set.  For the first
-// keyword, all of the references are added to the set and for
-// the remaining keywords, references which were in the set are
-// removed if they are not found for the keyword; essentially an
-// intersection of all of the refs for all of the keywords
-// supplied.
+		if (NULL != context->mapindex && unicode_length > DEEN_INDEXING_DEPTH) {
+			cursors[i] = deen_mapindex_lookup_terms(context->mapindex, keyword_prefix_buffer);
+		}
+		else {
+			deen_utf8_crop_to_unicode_len(keyword_prefix_buffer, keyword_len, DEEN_INDEXING_DEPTH);
+			cursors[i] = deen_search_lookup(context, keyword_prefix_buffer);
+		}
 
-		lookup_result = deen_index_lookup(
-			context->db,
-			keyword_prefix_buffer);
+		if (NULL == cursors[i]) {
+			is_error = DEEN_TRUE;
+		}
+		else if (NULL != explain) {
+			deen_search_explain_keyword *explain_keyword = &(explain->keywords[i]);
+			memcpy(explain_keyword->lookup, keyword_prefix_buffer, strlen((char *) keyword_prefix_buffer) + 1);
+			explain_keyword->is_term_range = NULL != context->mapindex && unicode_length > DEEN_INDEXING_DEPTH;
+			explain_keyword->refs_count = cursors[i]->count;
+		}
+	}
 
+	free((void *) keyword_prefix_buffer);
+	deen_tracing_end("lookup");
+
+	if (is_error) {
+		size_t j;
+
+		for (j=0;j<i;j++) {
+			deen_postings_cursor_free(cursors[j]);
+		}
+
+		free((void *) cursors);
+		return NULL;
+	}
+
+// the references for all of the keywords are intersected; only those
+// references that appear for every keyword are kept.  Starting with the
+// shortest list keeps the intermediate results as small as possible and
+// means that the longer lists are only decoded where they might overlap.
+
+	deen_tracing_begin("intersect");
+
+	if (keywords->count > 0) {
 		qsort(
-			lookup_result->refs,
-			lookup_result->refs_count,
-			sizeof(off_t),deen_compare_refs);
+			cursors,
+			keywords->count,
+			sizeof(deen_postings_cursor *),
+			deen_compare_cursors_by_count);
+
+		refs_combined = (off_t *) deen_emalloc(sizeof(off_t) * (cursors[0]->count + 1));
 
-		if (NULL==refs_combined) {
-			refs_combined = (off_t *) deen_emalloc(sizeof(off_t) * lookup_result->refs_count);
-			refs_combined_length = lookup_result->refs_count;
-			memcpy(refs_combined,lookup_result->refs,sizeof(off_t) * lookup_result->refs_count);
+		while (refs_combined_length < cursors[0]->count
+			&& deen_postings_cursor_next(cursors[0], &refs_combined[refs_combined_length])) {
+			refs_combined_length++;
 		}
-		else {
-			refs_combined_length = deen_search_intersect_refs(
+
+		for (i=1;i<keywords->count && 0!=refs_combined_length;i++) {
+			refs_combined_length = deen_postings_cursor_intersect(
+				cursors[i],
 				refs_combined,
-				lookup_result->refs,
-				refs_combined_length,
-				lookup_result->refs_count);
+				refs_combined_length);
 		}
+	}
 
-		deen_index_lookup_result_free(lookup_result);
+	for (i=0;i<keywords->count;i++) {
+		if (cursors[i]->is_error) {
+			DEEN_LOG_ERROR0("corrupted posting list in the index");
+			is_error = DEEN_TRUE;
+		}
+
+		deen_postings_cursor_free(cursors[i]);
 	}
 
-	free((void *) keyword_prefix_buffer);
+	free((void *) cursors);
+	deen_tracing_end("intersect");
+
+	if (is_error) {
+		free((void *) refs_combined);
+		return NULL;
+	}
 
 	// now take the references and load-up those lines that are
 	// at those references.  Then check that, for each line that
 	// is loaded, all of the supplied keywords can be found on
 	// that line.
 
-	for (i=0;i<refs_combined_length;i++) {
-		DEEN_LOG_TRACE1("ref; %d", (int) refs_combined[i]);
+	if (deen_is_trace_enabled()) {
+		for (i=0;i<refs_combined_length;i++) {
+			DEEN_LOG_TRACE1("ref; %d", (int) refs_combined[i]);
+		}
+	}
+
+	deen_tracing_counter("candidates", (int64_t) refs_combined_length);
+
+	if (NULL != explain) {
+		explain->intersection_count = refs_combined_length;
+		deen_search_explain_lap(explain, &explain_mark, DEEN_SEARCH_PHASE_LOOKUP);
 	}
 
 	search_result = deen_search_refs_to_result(
 		context, keywords,
 		refs_combined,
-		refs_combined_length);
+		refs_combined_length,
+		max_result_count,
+		explain);
 
-	deen_search_sort(search_result, keywords);
-	deen_search_crop(search_result, max_result_count);
+	free((void *) refs_combined);
 
 	return search_result;
 }
 
+
+deen_search_result *deen_search_explained(
+	deen_search_context *context,
+	deen_keywords *keywords,
+	size_t max_result_count,
+	deen_search_explain *explain) {
+
+	deen_search_result *result;
+
+	deen_tracing_begin("search");
+	result = deen_search_keywords(context, keywords, max_result_count, explain);
+	deen_tracing_end("search");
+
+	return result;
+}
+
+/*
+The parts of the entries are all in the arena so there is no need to go
+through the entries to free them.
+*/
+
 void deen_search_result_free(deen_search_result *result) {
 	if (NULL != result) {
-		uint32_t i;
+		deen_entry_arena_free(&(result->arena));
+		free((void *) result->entries);
+		free((void *) result);
+	}
+}
+
+
+/*
+The idle contexts are held in a stack so that the most recently used
+context, which is likely to be warmest, is handed out next.
+*/
 
-		for (i=0;i<result->entry_count;i++) {
-			deen_entry_free(&(result->entries[i]));
+struct deen_search_pool {
+	char *root_dir;
+	size_t max_count;
+	size_t created_count;
+	size_t idle_count;
+	deen_search_context **idle;
+#ifndef __MINGW32__
+	pthread_mutex_t lock;
+	pthread_cond_t released_cond;
+#endif
+};
+
+
+deen_search_pool *deen_search_pool_create(const char *deen_root_dir, size_t max_count) {
+	deen_search_pool *pool = (deen_search_pool *) deen_emalloc(sizeof(deen_search_pool));
+	size_t root_dir_len = strlen(deen_root_dir);
+
+	if (0 == max_count) {
+		max_count = 1;
+	}
+
+	pool->root_dir = (char *) deen_emalloc(sizeof(char) * (root_dir_len + 1));
+	memcpy(pool->root_dir, deen_root_dir, root_dir_len + 1);
+	pool->max_count = max_count;
+	pool->created_count = 0;
+	pool->idle_count = 0;
+	pool->idle = (deen_search_context **) deen_emalloc(sizeof(deen_search_context *) * max_count);
+#ifndef __MINGW32__
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->released_cond, NULL);
+#endif
+
+	return pool;
+}
+
+
+deen_search_context *deen_search_pool_acquire(deen_search_pool *pool) {
+	deen_search_context *context = NULL;
+	deen_bool should_create = DEEN_FALSE;
+
+#ifndef __MINGW32__
+	pthread_mutex_lock(&pool->lock);
+
+	while (0 == pool->idle_count && pool->created_count == pool->max_count) {
+		pthread_cond_wait(&pool->released_cond, &pool->lock);
+	}
+#endif
+
+	if (0 != pool->idle_count) {
+		pool->idle_count--;
+		context = pool->idle[pool->idle_count];
+	}
+	else {
+		if (pool->created_count < pool->max_count) {
+			pool->created_count++;
+			should_create = DEEN_TRUE;
 		}
+	}
 
-		free((void *) result);
+#ifndef __MINGW32__
+	pthread_mutex_unlock(&pool->lock);
+#endif
+
+	// the context is created outside of the lock because opening the files
+	// may take some time.
+
+	if (should_create) {
+		context = deen_search_init(pool->root_dir);
+
+		if (NULL == context) {
+#ifndef __MINGW32__
+			pthread_mutex_lock(&pool->lock);
+#endif
+			pool->created_count--;
+#ifndef __MINGW32__
+			pthread_cond_signal(&pool->released_cond);
+			pthread_mutex_unlock(&pool->lock);
+#endif
+		}
+	}
+
+	return context;
+}
+
+
+void deen_search_pool_release(deen_search_pool *pool, deen_search_context *context) {
+#ifndef __MINGW32__
+	pthread_mutex_lock(&pool->lock);
+#endif
+
+	pool->idle[pool->idle_count] = context;
+	pool->idle_count++;
+
+#ifndef __MINGW32__
+	pthread_cond_signal(&pool->released_cond);
+	pthread_mutex_unlock(&pool->lock);
+#endif
+}
+
+
+void deen_search_pool_free(deen_search_pool *pool) {
+	size_t i;
+
+	if (pool->idle_count != pool->created_count) {
+		DEEN_LOG_ERROR0("freeing a search pool with contexts still acquired");
+	}
+
+	for (i = 0; i < pool->idle_count; i++) {
+		deen_search_free(pool->idle[i]);
 	}
+
+#ifndef __MINGW32__
+	pthread_cond_destroy(&pool->released_cond);
+	pthread_mutex_destroy(&pool->lock);
+#endif
+
+	free((void *) pool->idle);
+	free((void *) pool->root_dir);
+	free((void *) pool);
 }
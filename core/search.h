@@ -23,13 +23,58 @@ deen_search_context *deen_search_init(char *deen_root_dir);
 void deen_search_free(deen_search_context *context);
 
 
+/*
+Searches for entries that have all of the keywords.  The result is
+dynamically allocated and must be freed by the caller.  If the search was not
+able to be performed then the problem is logged and NULL is returned.  A
+context must not be used by more than one thread at the same time, but
+searches on different contexts are able to run concurrently.
+*/
+
 deen_search_result *deen_search(
 	deen_search_context *context,
 	deen_keywords *keywords,
 	size_t max_result_count);
 
 
+/*
+This is the same as 'deen_search', but also writes into the explain what the
+search did and how long each phase of it took.  The explain may be re-used
+for a number of searches.  Timing the phases adds a little to the time taken.
+*/
+
+deen_search_result *deen_search_explained(
+	deen_search_context *context,
+	deen_keywords *keywords,
+	size_t max_result_count,
+	deen_search_explain *explain);
+
+
 void deen_search_result_free(deen_search_result *result);
 
+deen_search_explain *deen_search_explain_create();
+
+void deen_search_explain_free(deen_search_explain *explain);
+
+/*
+The pool creates search contexts on demand up to the maximum count.  When
+all of the contexts are in use, acquiring one will wait until another thread
+releases one.  Acquiring returns NULL if a new context was not able to be
+created.
+*/
+
+deen_search_pool *deen_search_pool_create(const char *deen_root_dir, size_t max_count);
+
+deen_search_context *deen_search_pool_acquire(deen_search_pool *pool);
+
+void deen_search_pool_release(deen_search_pool *pool, deen_search_context *context);
+
+/*
+Frees the pool and all of its contexts.  All of the contexts must have been
+released first.
+*/
+
+void deen_search_pool_free(deen_search_pool *pool);
+
 
 #endif /* __SEARCH_H */
@@ -0,0 +1,356 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+#include "tracing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "constants.h"
+
+#ifndef __MINGW32__
+
+// limits the spans that are totalled; a span nested deeper than this or with
+// a name beyond this many different names is not included.
+
+#define DEEN_TRACING_SPAN_DEPTH_MAX 32
+#define DEEN_TRACING_SPAN_NAMES_MAX 64
+
+typedef struct deen_tracing_event deen_tracing_event;
+struct deen_tracing_event {
+	const char *name;
+	uint64_t nanos;
+	int64_t value;
+
+	// as in the trace event format; 'B' begins a span, 'E' ends a span and
+	// 'C' is a counter.
+	char phase;
+};
+
+
+/*
+Each thread has one of these.  Only the thread that owns the buffer writes to
+it.  The buffers are chained together so that they can all be found in order
+to write them out; a buffer is never removed from the chain and so the events
+of a thread that has finished are still written out.
+*/
+
+typedef struct deen_tracing_buffer deen_tracing_buffer;
+struct deen_tracing_buffer {
+	deen_tracing_buffer *next;
+	uint32_t thread_id;
+
+	// the total number of events ever recorded; the event is at this count
+	// modulo the size of the ring.
+	uint64_t count;
+	deen_tracing_event events[DEEN_TRACING_BUFFER_SIZE];
+};
+
+
+// this is -1 until the environment has been checked.  It is accessed
+// atomically because tracing may start on a number of threads at once.
+
+static int deen_global_tracing_state = -1;
+
+static const char *deen_global_tracing_path = NULL;
+
+static deen_tracing_buffer *deen_global_tracing_buffers = NULL;
+
+static uint32_t deen_global_tracing_thread_id = 0;
+
+static __thread deen_tracing_buffer *deen_tracing_thread_buffer = NULL;
+
+
+static uint64_t deen_tracing_nanos() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+
+static void deen_tracing_flush_at_exit() {
+	deen_tracing_flush();
+}
+
+
+deen_bool deen_tracing_is_enabled() {
+	int state = __atomic_load_n(&deen_global_tracing_state, __ATOMIC_ACQUIRE);
+
+	if (-1 == state) {
+		char *path = getenv("DEENTRACEFILE");
+		int expected = -1;
+
+		state = (NULL != path && 0 != path[0]) ? DEEN_TRUE : DEEN_FALSE;
+
+		// only the thread that settles the state registers the flush.
+
+		if (__atomic_compare_exchange_n(
+			&deen_global_tracing_state, &expected, state,
+			DEEN_FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+
+			if (state) {
+				deen_global_tracing_path = path;
+				atexit(&deen_tracing_flush_at_exit);
+			}
+		}
+		else {
+			state = expected;
+		}
+	}
+
+	return (deen_bool) state;
+}
+
+
+/*
+Returns the buffer for the current thread; creating it if this is the first
+event on the thread.  The new buffer is pushed onto the chain without a lock.
+*/
+
+static deen_tracing_buffer *deen_tracing_buffer_for_thread() {
+	deen_tracing_buffer *buffer = deen_tracing_thread_buffer;
+
+	if (NULL == buffer) {
+		buffer = (deen_tracing_buffer *) deen_emalloc(sizeof(deen_tracing_buffer));
+		buffer->count = 0;
+		buffer->thread_id = __atomic_add_fetch(&deen_global_tracing_thread_id, 1, __ATOMIC_RELAXED);
+		buffer->next = __atomic_load_n(&deen_global_tracing_buffers, __ATOMIC_ACQUIRE);
+
+		while (!__atomic_compare_exchange_n(
+			&deen_global_tracing_buffers, &buffer->next, buffer,
+			DEEN_TRUE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		}
+
+		deen_tracing_thread_buffer = buffer;
+	}
+
+	return buffer;
+}
+
+
+static void deen_tracing_record(char phase, const char *name, int64_t value) {
+	if (deen_tracing_is_enabled()) {
+		deen_tracing_buffer *buffer = deen_tracing_buffer_for_thread();
+		deen_tracing_event *event = &buffer->events[buffer->count % DEEN_TRACING_BUFFER_SIZE];
+
+		event->name = name;
+		event->nanos = deen_tracing_nanos();
+		event->value = value;
+		event->phase = phase;
+
+		__atomic_store_n(&buffer->count, buffer->count + 1, __ATOMIC_RELEASE);
+	}
+}
+
+
+void deen_tracing_begin(const char *name) {
+#ifdef DEEN_ALLOC_ACCOUNTING
+	deen_alloc_accounting_phase_begin(name);
+#endif
+	deen_tracing_record('B', name, 0);
+}
+
+
+void deen_tracing_end(const char *name) {
+	deen_tracing_record('E', name, 0);
+#ifdef DEEN_ALLOC_ACCOUNTING
+	deen_alloc_accounting_phase_end(name);
+#endif
+}
+
+
+void deen_tracing_counter(const char *name, int64_t value) {
+	deen_tracing_record('C', name, value);
+}
+
+
+static void deen_tracing_write_event(FILE *file, const deen_tracing_event *event, uint32_t thread_id, deen_bool is_first) {
+	fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":%d,\"tid\":%u,\"ts\":%llu.%03u",
+		is_first ? "" : ",",
+		event->name,
+		event->phase,
+		(int) getpid(),
+		thread_id,
+		(unsigned long long) (event->nanos / 1000),
+		(unsigned) (event->nanos % 1000));
+
+	if ('C' == event->phase) {
+		fprintf(file, ",\"args\":{\"%s\":%lld}", event->name, (long long) event->value);
+	}
+
+	fputs("}", file);
+}
+
+
+void deen_tracing_flush() {
+	deen_tracing_buffer *buffer;
+	deen_bool is_first = DEEN_TRUE;
+	FILE *file;
+
+	if (!deen_tracing_is_enabled()) {
+		return;
+	}
+
+	file = fopen(deen_global_tracing_path, "w");
+
+	if (NULL == file) {
+		DEEN_LOG_ERROR1("unable to open the trace file for writing; %s", deen_global_tracing_path);
+		return;
+	}
+
+	fputs("{\"traceEvents\":[", file);
+
+	for (buffer = __atomic_load_n(&deen_global_tracing_buffers, __ATOMIC_ACQUIRE);
+		NULL != buffer;
+		buffer = buffer->next) {
+
+		uint64_t count = __atomic_load_n(&buffer->count, __ATOMIC_ACQUIRE);
+		uint64_t i = (count > DEEN_TRACING_BUFFER_SIZE) ? count - DEEN_TRACING_BUFFER_SIZE : 0;
+
+		for (; i < count; i++) {
+			deen_tracing_write_event(file, &buffer->events[i % DEEN_TRACING_BUFFER_SIZE], buffer->thread_id, is_first);
+			is_first = DEEN_FALSE;
+		}
+	}
+
+	fputs("\n],\"displayTimeUnit\":\"ms\"}\n", file);
+
+	if (0 != fclose(file)) {
+		DEEN_LOG_ERROR1("unable to write the trace file; %s", deen_global_tracing_path);
+	}
+}
+
+
+typedef struct deen_tracing_span_total deen_tracing_span_total;
+struct deen_tracing_span_total {
+	const char *name;
+	uint64_t first_nanos;
+	uint64_t nanos;
+	uint32_t count;
+};
+
+
+static void deen_tracing_span_totals_add(
+	deen_tracing_span_total *totals,
+	uint32_t *totals_count,
+	const deen_tracing_event *begin,
+	const deen_tracing_event *end) {
+
+	uint32_t i;
+
+	for (i = 0; i < *totals_count && 0 != strcmp(totals[i].name, begin->name); i++) {
+	}
+
+	if (i == *totals_count) {
+		if (DEEN_TRACING_SPAN_NAMES_MAX == i) {
+			return;
+		}
+
+		totals[i].name = begin->name;
+		totals[i].first_nanos = begin->nanos;
+		totals[i].nanos = 0;
+		totals[i].count = 0;
+		(*totals_count)++;
+	}
+
+	if (begin->nanos < totals[i].first_nanos) {
+		totals[i].first_nanos = begin->nanos;
+	}
+
+	totals[i].nanos += end->nanos - begin->nanos;
+	totals[i].count++;
+}
+
+
+static int deen_tracing_span_total_compare(const void *a, const void *b) {
+	uint64_t na = ((const deen_tracing_span_total *) a)->first_nanos;
+	uint64_t nb = ((const deen_tracing_span_total *) b)->first_nanos;
+	return (na > nb) - (na < nb);
+}
+
+
+void deen_tracing_span_totals(deen_tracing_span_total_cb cb, void *context) {
+	deen_tracing_span_total totals[DEEN_TRACING_SPAN_NAMES_MAX];
+	const deen_tracing_event *begins[DEEN_TRACING_SPAN_DEPTH_MAX];
+	uint32_t totals_count = 0;
+	deen_tracing_buffer *buffer;
+	uint32_t i;
+
+	for (buffer = __atomic_load_n(&deen_global_tracing_buffers, __ATOMIC_ACQUIRE);
+		NULL != buffer;
+		buffer = buffer->next) {
+
+		uint64_t count = __atomic_load_n(&buffer->count, __ATOMIC_ACQUIRE);
+		uint64_t e = (count > DEEN_TRACING_BUFFER_SIZE) ? count - DEEN_TRACING_BUFFER_SIZE : 0;
+		uint32_t depth = 0;
+
+		// an end for which the begin has been overwritten in the ring is
+		// ignored.
+
+		for (; e < count; e++) {
+			const deen_tracing_event *event = &buffer->events[e % DEEN_TRACING_BUFFER_SIZE];
+
+			switch (event->phase) {
+				case 'B':
+					if (depth < DEEN_TRACING_SPAN_DEPTH_MAX) {
+						begins[depth] = event;
+					}
+					depth++;
+					break;
+
+				case 'E':
+					if (depth > 0) {
+						depth--;
+
+						if (depth < DEEN_TRACING_SPAN_DEPTH_MAX && 0 == strcmp(begins[depth]->name, event->name)) {
+							deen_tracing_span_totals_add(totals, &totals_count, begins[depth], event);
+						}
+					}
+					break;
+			}
+		}
+	}
+
+	qsort(totals, totals_count, sizeof(deen_tracing_span_total), &deen_tracing_span_total_compare);
+
+	for (i = 0; i < totals_count; i++) {
+		cb(context, totals[i].name, totals[i].count, totals[i].nanos);
+	}
+}
+
+#else
+
+deen_bool deen_tracing_is_enabled() {
+	return DEEN_FALSE;
+}
+
+
+void deen_tracing_begin(const char *name) {
+}
+
+
+void deen_tracing_end(const char *name) {
+}
+
+
+void deen_tracing_counter(const char *name, int64_t value) {
+}
+
+
+void deen_tracing_flush() {
+}
+
+
+void deen_tracing_span_totals(deen_tracing_span_total_cb cb, void *context) {
+}
+
+#endif
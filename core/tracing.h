@@ -0,0 +1,72 @@
+/*
+ * Copyright 2019, Andrew Lindesay. All Rights Reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Authors:
+ *		Andrew Lindesay, apl@lindesay.co.nz
+ */
+
+#ifndef __TRACING_H
+#define __TRACING_H
+
+#include <stdint.h>
+
+#include "types.h"
+
+/*
+Tracing records spans of time and counters from the phases of installing and
+searching so that they can be viewed in a trace viewer such as the one in the
+Chrome browser.  Unlike the trace logging, tracing is intended to have little
+effect on the timings.  It is enabled by setting the environment variable
+DEENTRACEFILE to the path of a file.  Each thread records its events into its
+own ring buffer without taking any locks; once the buffer is full the oldest
+events are overwritten.  The events are written to the file in the Chrome
+trace event JSON format as the process exits.  Tracing is not available on
+Windows.
+*/
+
+/*
+Returns true if tracing is enabled.  The environment variable is checked on
+the first call.
+*/
+
+deen_bool deen_tracing_is_enabled();
+
+/*
+Begins and ends a span on the current thread.  The name must be a string
+constant because it is only referenced by the event.  The spans on a thread
+must be nested.
+*/
+
+void deen_tracing_begin(const char *name);
+
+void deen_tracing_end(const char *name);
+
+/*
+Records the value of a counter at this time.  As with a span, the name must be
+a string constant.
+*/
+
+void deen_tracing_counter(const char *name, int64_t value);
+
+/*
+Writes all of the events recorded so far to the file.  This is done
+automatically as the process exits, but may also be called once no other
+threads are recording events.
+*/
+
+void deen_tracing_flush();
+
+/*
+Calls the callback once for each name of span with the number of such spans
+that have ended and the total time spent in them.  Where spans with the same
+name were on a number of threads, the time is the sum over those threads.  The
+names are in the order in which they first began.  As with flushing, this may
+only be called once no other threads are recording events.
+*/
+
+typedef void (*deen_tracing_span_total_cb)(void *context, const char *name, uint32_t count, uint64_t nanos);
+
+void deen_tracing_span_totals(deen_tracing_span_total_cb cb, void *context);
+
+#endif /* __TRACING_H */
@@ -26,6 +26,12 @@ Represents a quantity of milliseconds.
 
 typedef unsigned long long deen_millis;
 
+/*
+Represents a quantity of microseconds.
+*/
+
+typedef unsigned long long deen_micros;
+
 /*
 When seeing how long a UTF-8 sequence is, the function will return
 this type in order to indicate the result.
@@ -38,6 +44,19 @@ enum deen_utf8_sequence_result {
 	DEEN_INCOMPLETE_SEQUENCE // UTF-8 sequence ran out of characters to consume
 };
 
+/*
+Some of the string handling functions have implementations that use the
+vector instructions of the processor.  This identifies which implementation
+is used.
+*/
+
+typedef enum deen_simd_level deen_simd_level;
+enum deen_simd_level {
+	DEEN_SIMD_SCALAR, // one byte at a time
+	DEEN_SIMD_SSE2, // 16 bytes at a time
+	DEEN_SIMD_AVX2 // 32 bytes at a time
+};
+
 /*
 This is used to identify the first found keyword from a list of
 keywords within a string.  It is returned as the result of a
@@ -59,52 +78,312 @@ enum deen_entry_atom_type {
 };
 
 
+/*
+The parser reports these as it goes through the text of an entry.  The text
+starts in a sub with a single sub sub so there is no event for that.
+*/
+
+enum deen_entry_parse_event {
+    PARSE_EVENT_ATOM,
+    PARSE_EVENT_SUB_SUB, // a new sub sub has started
+    PARSE_EVENT_SUB // a new sub with a new sub sub has started
+};
+
+
+/*
+The atoms, sub subs and subs of entries are held in flat arrays in an arena
+rather than each being allocated separately.  Each refers to its parts as a
+range of indexes into the array below it.  The text of an atom is a slice of
+the text in the arena.
+*/
+
 typedef struct deen_entry_atom deen_entry_atom;
 struct deen_entry_atom {
     enum deen_entry_atom_type type;
-    uint8_t *text;
+    uint32_t offset;
+    uint32_t len;
 };
 
 
 typedef struct deen_entry_sub_sub deen_entry_sub_sub;
 struct deen_entry_sub_sub {
-    deen_entry_atom *atoms;
+    uint32_t atoms_offset;
     uint32_t atom_count;
 };
 
 
 typedef struct deen_entry_sub deen_entry_sub;
 struct deen_entry_sub {
-    deen_entry_sub_sub *sub_subs;
+    uint32_t sub_subs_offset;
     uint32_t sub_sub_count;
 };
 
 
 typedef struct deen_entry deen_entry;
 struct deen_entry {
-    deen_entry_sub *german_subs;
-    deen_entry_sub *english_subs;
-    uint32_t english_sub_count;
+    // the german subs are followed by the english subs.
+    uint32_t subs_offset;
     uint32_t german_sub_count;
+    uint32_t english_sub_count;
 	uint32_t distance_from_keywords;
 };
 
 
+/*
+The arrays only ever grow and are freed all together.  The text holds the
+german and then the english text of each entry; each NULL terminated.
+*/
+
+typedef struct deen_entry_arena deen_entry_arena;
+struct deen_entry_arena {
+    uint8_t *text;
+    size_t text_len;
+    size_t text_allocated;
+    deen_entry_atom *atoms;
+    uint32_t atom_count;
+    uint32_t atoms_allocated;
+    deen_entry_sub_sub *sub_subs;
+    uint32_t sub_sub_count;
+    uint32_t sub_subs_allocated;
+    deen_entry_sub *subs;
+    uint32_t sub_count;
+    uint32_t subs_allocated;
+};
+
+
 typedef struct deen_search_result deen_search_result;
 struct deen_search_result {
     uint32_t total_count;
     uint32_t entry_count;
     deen_entry *entries;
+    deen_entry_arena arena;
+};
+
+
+/*
+These are the phases of a search for which the time taken is explained.
+*/
+
+enum deen_search_phase {
+	DEEN_SEARCH_PHASE_LOOKUP = 0,
+	DEEN_SEARCH_PHASE_FETCH,
+	DEEN_SEARCH_PHASE_PARSE,
+	DEEN_SEARCH_PHASE_SCORE,
+	DEEN_SEARCH_PHASE_SORT,
+	DEEN_SEARCH_PHASE_COUNT
+};
+
+
+/*
+Explains how one keyword was looked up in the index.  The lookup is either
+the prefix of the keyword or, for a longer keyword in the binary index, the
+start of the range of terms.
+*/
+
+typedef struct deen_search_explain_keyword deen_search_explain_keyword;
+struct deen_search_explain_keyword {
+	uint8_t lookup[DEEN_INDEXING_TERM_SIZE];
+	deen_bool is_term_range;
+	size_t refs_count;
+};
+
+
+/*
+Explains the work that a search has done so that a slow search is able to be
+understood.  The lines and bytes read include those read again in order to
+build the entries of the result.
+*/
+
+typedef struct deen_search_explain deen_search_explain;
+struct deen_search_explain {
+	deen_bool is_mapindex;
+	uint32_t keyword_count;
+	deen_search_explain_keyword *keywords;
+
+	// the number of refs left once the refs for the keywords are intersected.
+	size_t intersection_count;
+
+	uint64_t lines_read;
+	uint64_t bytes_read;
+
+	// lines on which not all of the keywords were present.
+	uint64_t lines_rejected;
+
+	uint64_t entries_parsed;
+
+	deen_micros phase_micros[DEEN_SEARCH_PHASE_COUNT];
+};
+
+
+/*
+A compressed posting list starts with a skip table that has one of these for
+each block.  The data offset is relative to the end of the skip table.
+*/
+
+typedef struct deen_postings_skip deen_postings_skip;
+struct deen_postings_skip {
+	int64_t first_ref;
+	uint32_t data_offset;
+	uint32_t count;
+};
+
+
+/*
+A cursor moves forward through the refs of a posting list in ascending order.
+The refs either come from a compressed posting list, which is decoded one
+block at a time as it is needed, or from an array that the cursor owns.
+*/
+
+typedef struct deen_postings_cursor deen_postings_cursor;
+struct deen_postings_cursor {
+
+	// the compressed posting list or NULL if the refs are in an array.
+	const uint8_t *data;
+	size_t data_len;
+	uint32_t block_count;
+	uint32_t next_block;
+
+	// the refs that are being read; either the decoded block or the array.
+	off_t *refs;
+	size_t refs_count;
+	size_t upto;
+
+	// the total number of refs in the posting list.
+	size_t count;
+
+	deen_bool is_error;
+
+	off_t block_refs[DEEN_POSTINGS_BLOCK_SIZE];
+};
+
+
+/*
+The binary index file starts with this header.  It is followed by the prefix
+table which is ordered by the prefix, the term table which is ordered by the
+term, the text of the terms and then by the compressed posting lists for all
+of the prefixes and terms.
+*/
+
+typedef struct deen_mapindex_header deen_mapindex_header;
+struct deen_mapindex_header {
+	uint8_t magic[DEEN_MAPINDEX_MAGIC_SIZE];
+	uint32_t version;
+	uint32_t prefix_count;
+	uint64_t refs_count;
+	uint64_t postings_len;
+	uint32_t term_count;
+	uint32_t term_text_len;
+	uint64_t term_refs_count;
+};
+
+
+typedef struct deen_mapindex_prefix deen_mapindex_prefix;
+struct deen_mapindex_prefix {
+	uint8_t prefix[DEEN_MAPINDEX_PREFIX_SIZE];
+	uint32_t refs_count;
+
+	// the posting list for this prefix is at this offset from the start of
+	// the postings.
+	uint64_t postings_offset;
+	uint32_t postings_len;
+	uint32_t block_count;
+};
+
+
+/*
+The text of a term is NULL terminated and is at 'text_offset' from the start
+of the text of all of the terms.
+*/
+
+typedef struct deen_mapindex_term deen_mapindex_term;
+struct deen_mapindex_term {
+	uint32_t text_offset;
+	uint32_t refs_count;
+	uint64_t postings_offset;
+	uint32_t postings_len;
+	uint32_t block_count;
+};
+
+
+typedef struct deen_mapindex deen_mapindex;
+struct deen_mapindex {
+	uint8_t *data;
+	size_t data_len;
+
+	// false if the data was read into memory rather than mapped.
+	deen_bool is_mapped;
+
+	const deen_mapindex_prefix *prefixes;
+	uint32_t prefix_count;
+
+	uint64_t refs_count;
+
+	const deen_mapindex_term *terms;
+	uint32_t term_count;
+	const uint8_t *term_text;
+	uint32_t term_text_len;
+
+	uint64_t term_refs_count;
+
+	const uint8_t *postings;
+	uint64_t postings_len;
+};
+
+
+/*
+Holds the statement that is used to lookup the refs for a prefix so that it
+is only parsed once for a database connection.
+*/
+
+typedef struct deen_index_lookup_context deen_index_lookup_context;
+struct deen_index_lookup_context {
+	sqlite3 *db;
+	sqlite3_stmt *ref_lookup_stmt;
+};
+
+
+/*
+An entry in the cache of refs for the prefixes that have been looked up
+recently.  An entry that is not in use has a 'last_used' of zero.
+*/
+
+typedef struct deen_search_lookup_cache_entry deen_search_lookup_cache_entry;
+struct deen_search_lookup_cache_entry {
+	uint8_t prefix[DEEN_INDEXING_PREFIX_SIZE];
+	off_t *refs;
+	size_t refs_count;
+	uint64_t last_used;
 };
 
 
 typedef struct deen_search_context deen_search_context;
 struct deen_search_context {
     sqlite3 *db;
+    deen_index_lookup_context *index_lookup_context;
+    deen_mapindex *mapindex;
     int fd_data;
+
+    // where possible the data is mapped into memory so that lines can be
+    // read from it directly; otherwise this is NULL.
+    const uint8_t *data;
+    size_t data_len;
+
+    // the refs most recently fetched from the sqlite database.
+    deen_search_lookup_cache_entry lookup_cache[DEEN_SEARCH_LOOKUP_CACHE_SIZE];
+    uint64_t lookup_cache_clock;
+    uint64_t lookup_cache_hits;
+    uint64_t lookup_cache_misses;
 };
 
 
+/*
+A search context may only be used by one thread at a time.  The pool hands
+out search contexts to threads such that each thread has one to itself.
+*/
+
+typedef struct deen_search_pool deen_search_pool;
+
+
 /*
 This struct maintains state around the database connection as well as any
 statements that can be re-used as part of the indexing process.  This
@@ -133,19 +412,90 @@ struct deen_index_add_context {
 };
 
 
+/*
+This is a single reference into the data for a prefix.  These are accumulated
+in memory as an index is being built.
+*/
+
+typedef struct deen_index_prefix_ref deen_index_prefix_ref;
+struct deen_index_prefix_ref {
+	off_t ref;
+	uint32_t prefix_id;
+};
+
+
+/*
+This struct maintains the state of an index that is being built entirely in
+memory.  Each distinct prefix is interned into a hash table in order to obtain
+its id and the (prefix id, ref) pairs are accumulated so that they can later be
+sorted and written to the database in one bulk pass.
+*/
+
+typedef struct deen_index_bulk_context deen_index_bulk_context;
+struct deen_index_bulk_context {
+
+	// the prefixes are stored with a fixed stride of 'prefix_size' bytes.
+	// The id of a prefix is its position in this storage plus one.
+	size_t prefix_size;
+	uint8_t *prefixes;
+	uint32_t prefix_count;
+	uint32_t prefix_count_allocated;
+
+	// open-addressed hash table of prefix ids; zero marks an empty slot.
+	uint32_t *prefix_slots;
+	uint32_t prefix_slots_count;
+
+	deen_index_prefix_ref *prefix_refs;
+	size_t prefix_refs_count;
+	size_t prefix_refs_allocated;
+
+	// if the refs arrive in ascending order then a stable sort on the prefix
+	// id alone will yield the final ordering.
+	deen_bool prefix_refs_ascending;
+	off_t last_ref;
+
+	// true once the refs are ordered by prefix id and then by ref.
+	deen_bool prefix_refs_sorted;
+
+	// the terms are accumulated in the same way as the prefixes, but in
+	// their own context; the terms context itself has no terms.
+	deen_index_bulk_context *terms;
+
+#ifdef DEBUG
+	deen_millis intern_prefixes_millis;
+	deen_millis sort_refs_millis;
+	deen_millis write_prefixes_millis;
+	deen_millis write_refs_millis;
+#endif
+
+};
+
+
+/*
+Each keyword may be spelled in a number of ways; for example o-umlaut may also
+be written as "OE".  The spellings of all of the keywords are held together
+and 'spelling_keywords' gives the index of the keyword for each spelling.
+*/
+
 typedef struct deen_keywords deen_keywords;
 struct deen_keywords
 {
 	uint32_t count;
 	uint8_t **keywords;
+
+	uint32_t spelling_count;
+	uint8_t **spellings;
+	uint32_t *spelling_keywords;
 };
 
 
-typedef struct deen_index_lookup_result deen_index_lookup_result;
-struct deen_index_lookup_result {
-	off_t *refs;
-	uint32_t refs_count;
-};
+/*
+The keywords of a query are compiled into a matcher so that the text of each
+line can be checked against all of the keywords at once.  A matcher has some
+working state and so may only be used by one thread at a time.
+*/
+
+typedef struct deen_keywords_matcher deen_keywords_matcher;
 
 
 #endif /* __TYPES_H */
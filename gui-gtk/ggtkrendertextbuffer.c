@@ -57,21 +57,22 @@ keywords as bold and print the rest.
 static void deen_ggtk_render_plain_text_highlights(
 	GtkTextBuffer *target,
 	uint8_t *text,
+	size_t from,
+	size_t to,
 	deen_keywords *keywords) {
 
-	size_t len = strlen((char *) text);
-	size_t upto = 0;
+	size_t upto = from;
 
-	while (upto < len) {
+	while (upto < to) {
 		deen_first_keyword first_keyword = deen_ifind_first_keyword(
-			text, keywords, upto, len);
+			text, keywords, upto, to);
 
 		if (DEEN_NOT_FOUND == first_keyword.offset) {
 			deen_ggtk_append_to_textbuffer(
 				target,
 				(gchar *) &text[upto],
-				strlen((char *) &text[upto]));
-			upto = len;
+				to - upto);
+			upto = to;
 		}
 		else {
 			deen_bool is_valid_keyword_found;
@@ -86,7 +87,7 @@ static void deen_ggtk_render_plain_text_highlights(
 			// within the line.
 
 			is_valid_keyword_found =
-				0 == first_keyword.offset ||
+				from == first_keyword.offset ||
 				isspace(text[first_keyword.offset-1]) ||
 				ispunct(text[first_keyword.offset-1]);
 
@@ -109,20 +110,26 @@ static void deen_ggtk_render_plain_text_highlights(
 }
 
 
+/*
+The text of the atom is a slice of the arena's text.
+*/
+
 static void deen_ggtk_render_plain_entry_atom(
 	GtkTextBuffer *target,
+	uint8_t *text,
 	deen_entry_atom *atom,
 	deen_keywords *keywords) {
 
 		switch (atom->type) {
 			case ATOM_TEXT:
-				deen_ggtk_render_plain_text_highlights(target, atom->text, keywords);
+				deen_ggtk_render_plain_text_highlights(
+					target, text, atom->offset, atom->offset + atom->len, keywords);
 				break;
 
 			case ATOM_CONTEXT:
 				deen_ggtk_append_space_to_textbuffer(target);
 				deen_ggtk_append_to_textbuffer_with_tag(
-					target, (gchar *) atom->text, strlen((char *) atom->text),
+					target, (gchar *) &text[atom->offset], atom->len,
 					deen_ggtk_state_global->search->tag_foreground_context);
 				deen_ggtk_append_space_to_textbuffer(target);
 				break;
@@ -130,7 +137,7 @@ static void deen_ggtk_render_plain_entry_atom(
 			case ATOM_GRAMMAR:
 				deen_ggtk_append_space_to_textbuffer(target);
 				deen_ggtk_append_to_textbuffer_with_tag(
-					target, (gchar *) atom->text, strlen((char *) atom->text),
+					target, (gchar *) &text[atom->offset], atom->len,
 					deen_ggtk_state_global->search->tag_foreground_grammar);
 				deen_ggtk_append_space_to_textbuffer(target);
 				break;
@@ -144,6 +151,7 @@ static void deen_ggtk_render_plain_entry_atom(
 
 void deen_ggtk_render_plain_entry_sub_sub(
 	GtkTextBuffer *target,
+	deen_entry_arena *arena,
 	deen_entry_sub_sub *sub_sub,
 	deen_keywords *keywords) {
 
@@ -155,7 +163,8 @@ void deen_ggtk_render_plain_entry_sub_sub(
 				deen_ggtk_append_to_textbuffer(target, " ", 1);
 			}
 
-			deen_ggtk_render_plain_entry_atom(target, &(sub_sub->atoms[i]), keywords);
+			deen_ggtk_render_plain_entry_atom(
+				target, arena->text, &(arena->atoms[sub_sub->atoms_offset + i]), keywords);
 		}
 	}
 }
@@ -163,6 +172,7 @@ void deen_ggtk_render_plain_entry_sub_sub(
 
 void deen_ggtk_render_plain_entry_sub(
 	GtkTextBuffer *target,
+	deen_entry_arena *arena,
 	deen_entry_sub *sub,
 	deen_keywords *keywords) {
 
@@ -174,13 +184,15 @@ void deen_ggtk_render_plain_entry_sub(
 				deen_ggtk_append_to_textbuffer(target, "; ", 2);
 			}
 
-			deen_ggtk_render_plain_entry_sub_sub(target, &(sub->sub_subs[i]), keywords);
+			deen_ggtk_render_plain_entry_sub_sub(
+				target, arena, &(arena->sub_subs[sub->sub_subs_offset + i]), keywords);
 		}
 	}
 }
 
 void deen_ggtk_render_plain_entry(
 	GtkTextBuffer *target,
+	deen_entry_arena *arena,
 	deen_entry *entry,
 	deen_keywords *keywords) {
 
@@ -205,7 +217,8 @@ void deen_ggtk_render_plain_entry(
 		}
 
 		if (i < entry->german_sub_count) {
-			deen_ggtk_render_plain_entry_sub(target, &(entry->german_subs[i]), keywords);
+			deen_ggtk_render_plain_entry_sub(
+				target, arena, &(arena->subs[entry->subs_offset + i]), keywords);
 		}
 		else {
 			deen_ggtk_append_to_textbuffer(target, "???", 3);
@@ -216,7 +229,10 @@ void deen_ggtk_render_plain_entry(
 			deen_ggtk_state_global->search->tag_foreground_layout);
 
 		if (i < entry->english_sub_count) {
-			deen_ggtk_render_plain_entry_sub(target, &(entry->english_subs[i]), keywords);
+			deen_ggtk_render_plain_entry_sub(
+				target, arena,
+				&(arena->subs[entry->subs_offset + entry->german_sub_count + i]),
+				keywords);
 		}
 		else {
 			deen_ggtk_append_to_textbuffer(target, "???", 3);
@@ -245,7 +261,7 @@ void deen_ggtk_render_textbuffer(
 				deen_ggtk_render_entry_separator(target);
 			}
 			i--;
-			deen_ggtk_render_plain_entry(target, &result->entries[i], keywords);
+			deen_ggtk_render_plain_entry(target, &(result->arena), &result->entries[i], keywords);
 		}
 		while(i > 0);
 	}
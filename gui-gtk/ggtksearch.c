@@ -37,9 +37,14 @@ deen_search_context *deen_ggtk_ensure_search_context() {
 void deen_ggtk_set_results_notes(deen_search_result *result) {
 	char notes_assembly_buffer[1024];
 
-	snprintf(
-		notes_assembly_buffer, 1024,
-		"Showing %d of %d", result->entry_count, result->total_count);
+	if (NULL == result) {
+		snprintf(notes_assembly_buffer, 1024, "The search failed");
+	}
+	else {
+		snprintf(
+			notes_assembly_buffer, 1024,
+			"Showing %d of %d", result->entry_count, result->total_count);
+	}
 
 	gtk_label_set_text(
 		GTK_LABEL(deen_ggtk_state_global->widgets->label_results_notes),
@@ -97,15 +102,6 @@ void deen_ggtk_search_by_provided_keywords(size_t max_result_count) {
 
 	result = deen_search(context, keywords, max_result_count);
 
-	if(0 == result->total_count) {
-		if(deen_keywords_adjust(keywords)) {
-			DEEN_LOG_INFO0("no results found -> did adjust keywords");
-			deen_trace_log_keywords(keywords);
-			deen_search_result_free(result);
-			result = deen_search(context, keywords, max_result_count);
-		}
-	}
-
 	gtk_text_buffer_set_text(
 		deen_ggtk_state_global->search->text_buffer, "", 0);
 